@@ -0,0 +1,251 @@
+#include "Scene/DynamicBvh.h"
+#include "Core/JobSystem.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <random>
+#include <vector>
+
+// Compares DynamicBvh queries against testing every object, on a random
+// scene of boxes in a cube: closest hit raycasts (one at a time, as packets
+// of four, and as packets spread over the job system) for random rays and
+// for a camera's worth of coherent ones, box overlap queries,
+// and a frame loop that moves a tenth of the objects through moveProxy()
+// or the batched moveProxies(). Every BVH result is checked against the
+// brute force one; the benchmark fails on any mismatch.
+//
+// Usage: plasterBvhBench [objects] [queries] [frames]
+//
+// Brute force only runs a sample of the queries and reports the time per
+// query, so large scenes finish in reasonable time.
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const float WORLD_SIZE = 1000.0f;
+const uint32_t BRUTE_FORCE_SAMPLE = 2000;
+
+double elapsedMs(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+void printRow(const char* test, const char* method, double totalMs, uint32_t queries) {
+    std::printf("%-10s %-22s %10.3f %12.3f\n", test, method, totalMs, totalMs * 1000.0 / std::max(queries, 1u));
+}
+
+bool bruteForceRaycast(const std::vector<plaster::Aabb>& boxes, const plaster::Ray& ray, float& closest) {
+    glm::vec3 inverseDirection = glm::vec3(1.0f) / ray.direction;
+    closest = ray.maxDistance;
+    bool found = false;
+    for (const plaster::Aabb& box : boxes) {
+        float distance;
+        if (plaster::intersectRay(ray, inverseDirection, box, closest, distance)) {
+            closest = distance;
+            found = true;
+        }
+    }
+    return found;
+}
+
+// Hits may land on different proxies at the same distance, so only the distances have to agree
+bool sameHit(bool found, float distance, const plaster::RayHit& hit) {
+    bool bvhFound = hit.proxy != plaster::DynamicBvh::NULL_NODE;
+    return found == bvhFound && (!found || std::fabs(distance - hit.distance) <= 1e-3f * (1.0f + distance));
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    uint32_t objectCount = argc > 1 ? static_cast<uint32_t>(std::atoi(argv[1])) : 100000;
+    uint32_t queryCount = argc > 2 ? static_cast<uint32_t>(std::atoi(argv[2])) : 100000;
+    uint32_t frames = argc > 3 ? static_cast<uint32_t>(std::atoi(argv[3])) : 120;
+
+    try {
+        plaster::JobSystem jobSystem;
+        std::mt19937 random(1234);
+        std::uniform_real_distribution<float> position(0.0f, WORLD_SIZE);
+        std::uniform_real_distribution<float> size(0.25f, 2.0f);
+        std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+        std::vector<plaster::Aabb> boxes(objectCount);
+        for (plaster::Aabb& box : boxes) {
+            glm::vec3 center(position(random), position(random), position(random));
+            box = plaster::Aabb::fromCenter(center, glm::vec3(size(random), size(random), size(random)));
+        }
+
+        std::vector<plaster::Ray> rays(queryCount);
+        for (plaster::Ray& ray : rays) {
+            ray.origin = glm::vec3(position(random), position(random), position(random));
+            glm::vec3 direction(unit(random), unit(random), unit(random));
+            ray.direction = glm::normalize(direction + glm::vec3(1e-4f));
+            ray.maxDistance = WORLD_SIZE * 0.5f;
+        }
+
+        std::vector<plaster::Aabb> regions(queryCount);
+        for (plaster::Aabb& region : regions) {
+            glm::vec3 center(position(random), position(random), position(random));
+            region = plaster::Aabb::fromCenter(center, glm::vec3(10.0f));
+        }
+
+        std::printf("%u objects, %u queries, %u worker threads\n", objectCount, queryCount,
+                    jobSystem.getWorkerCount());
+        std::printf("%-10s %-22s %10s %12s\n", "test", "method", "total ms", "us/query");
+
+        plaster::DynamicBvh bvh;
+        auto start = Clock::now();
+        std::vector<uint32_t> proxies(objectCount);
+        for (uint32_t i = 0; i < objectCount; ++i) {
+            proxies[i] = bvh.createProxy(boxes[i], i);
+        }
+        printRow("build", "createProxy", elapsedMs(start), objectCount);
+        std::printf("%-10s height %u, area ratio %.1f\n", "", bvh.getHeight(), bvh.getAreaRatio());
+
+        uint32_t mismatches = 0;
+        uint32_t sample = std::min(queryCount, BRUTE_FORCE_SAMPLE);
+
+        // Raycasts
+        std::vector<float> expected(sample);
+        std::vector<bool> expectedFound(sample);
+        start = Clock::now();
+        for (uint32_t i = 0; i < sample; ++i) {
+            float distance;
+            expectedFound[i] = bruteForceRaycast(boxes, rays[i], distance);
+            expected[i] = distance;
+        }
+        printRow("raycast", "brute force", elapsedMs(start), sample);
+
+        std::vector<plaster::RayHit> hits(queryCount);
+        start = Clock::now();
+        for (uint32_t i = 0; i < queryCount; ++i) {
+            bvh.raycast(rays[i], hits[i]);
+        }
+        printRow("raycast", "bvh", elapsedMs(start), queryCount);
+        for (uint32_t i = 0; i < sample; ++i) {
+            mismatches += sameHit(expectedFound[i], expected[i], hits[i]) ? 0 : 1;
+        }
+
+        start = Clock::now();
+        bvh.raycastBatch(rays.data(), hits.data(), queryCount);
+        printRow("raycast", "bvh packets", elapsedMs(start), queryCount);
+        for (uint32_t i = 0; i < sample; ++i) {
+            mismatches += sameHit(expectedFound[i], expected[i], hits[i]) ? 0 : 1;
+        }
+
+        start = Clock::now();
+        bvh.raycastBatch(rays.data(), hits.data(), queryCount, &jobSystem);
+        printRow("raycast", "bvh packets, threaded", elapsedMs(start), queryCount);
+        for (uint32_t i = 0; i < sample; ++i) {
+            mismatches += sameHit(expectedFound[i], expected[i], hits[i]) ? 0 : 1;
+        }
+
+        // Coherent rays, a camera's pixels: four neighbours per packet share most of their path
+        uint32_t gridSize = static_cast<uint32_t>(std::sqrt(static_cast<double>(queryCount)));
+        std::vector<plaster::Ray> cameraRays(gridSize * gridSize);
+        for (uint32_t y = 0; y < gridSize; ++y) {
+            for (uint32_t x = 0; x < gridSize; ++x) {
+                plaster::Ray& ray = cameraRays[y * gridSize + x];
+                ray.origin = glm::vec3(-10.0f);
+                glm::vec3 target(WORLD_SIZE * (x + 0.5f) / gridSize, WORLD_SIZE * (y + 0.5f) / gridSize, WORLD_SIZE);
+                ray.direction = glm::normalize(target - ray.origin);
+                ray.maxDistance = WORLD_SIZE * 2.0f;
+            }
+        }
+        uint32_t cameraCount = static_cast<uint32_t>(cameraRays.size());
+        std::vector<plaster::RayHit> cameraHits(cameraCount);
+        std::vector<plaster::RayHit> cameraPacketHits(cameraCount);
+        start = Clock::now();
+        for (uint32_t i = 0; i < cameraCount; ++i) {
+            bvh.raycast(cameraRays[i], cameraHits[i]);
+        }
+        printRow("camera", "bvh", elapsedMs(start), cameraCount);
+        start = Clock::now();
+        bvh.raycastBatch(cameraRays.data(), cameraPacketHits.data(), cameraCount);
+        printRow("camera", "bvh packets", elapsedMs(start), cameraCount);
+        start = Clock::now();
+        bvh.raycastBatch(cameraRays.data(), cameraPacketHits.data(), cameraCount, &jobSystem);
+        printRow("camera", "bvh packets, threaded", elapsedMs(start), cameraCount);
+        for (uint32_t i = 0; i < cameraCount; ++i) {
+            bool found = cameraHits[i].proxy != plaster::DynamicBvh::NULL_NODE;
+            mismatches += sameHit(found, cameraHits[i].distance, cameraPacketHits[i]) ? 0 : 1;
+        }
+
+        // Overlap queries
+        std::vector<uint32_t> expectedCounts(sample);
+        start = Clock::now();
+        for (uint32_t i = 0; i < sample; ++i) {
+            expectedCounts[i] = static_cast<uint32_t>(
+                std::count_if(boxes.begin(), boxes.end(),
+                              [&](const plaster::Aabb& box) { return box.overlaps(regions[i]); }));
+        }
+        printRow("overlap", "brute force", elapsedMs(start), sample);
+
+        std::vector<uint32_t> found;
+        uint64_t total = 0;
+        start = Clock::now();
+        for (uint32_t i = 0; i < queryCount; ++i) {
+            found.clear();
+            bvh.queryOverlaps(regions[i], found);
+            total += found.size();
+            if (i < sample && found.size() != expectedCounts[i]) {
+                ++mismatches;
+            }
+        }
+        printRow("overlap", "bvh", elapsedMs(start), queryCount);
+        std::printf("%-10s %.2f overlaps per query\n", "", static_cast<double>(total) / std::max(queryCount, 1u));
+
+        // Dynamic scenes: a tenth of the objects moves every frame
+        uint32_t moving = std::max(objectCount / 10, 1u);
+        std::vector<glm::vec3> velocities(moving);
+        for (glm::vec3& velocity : velocities) {
+            velocity = glm::vec3(unit(random), unit(random), unit(random)) * 0.2f;
+        }
+        std::vector<plaster::Aabb> moved(moving);
+
+        uint32_t reinserts = 0;
+        start = Clock::now();
+        for (uint32_t frame = 0; frame < frames; ++frame) {
+            for (uint32_t i = 0; i < moving; ++i) {
+                boxes[i] = plaster::Aabb(boxes[i].min + velocities[i], boxes[i].max + velocities[i]);
+                reinserts += bvh.moveProxy(proxies[i], boxes[i], velocities[i]) ? 1 : 0;
+            }
+        }
+        printRow("move", "moveProxy", elapsedMs(start) / std::max(frames, 1u), moving);
+        std::printf("%-10s %.1f reinserts per frame, height %u, area ratio %.1f\n", "",
+                    static_cast<double>(reinserts) / std::max(frames, 1u), bvh.getHeight(), bvh.getAreaRatio());
+
+        start = Clock::now();
+        for (uint32_t frame = 0; frame < frames; ++frame) {
+            for (uint32_t i = 0; i < moving; ++i) {
+                boxes[i] = plaster::Aabb(boxes[i].min + velocities[i], boxes[i].max + velocities[i]);
+                moved[i] = boxes[i];
+            }
+            bvh.moveProxies(proxies.data(), moved.data(), moving);
+            bvh.optimize(moving / 20);
+        }
+        printRow("move", "moveProxies+optimize", elapsedMs(start) / std::max(frames, 1u), moving);
+        std::printf("%-10s height %u, area ratio %.1f\n", "", bvh.getHeight(), bvh.getAreaRatio());
+
+        // The tree still has to answer correctly after all that movement
+        for (uint32_t i = 0; i < sample; ++i) {
+            float distance;
+            bool hit = bruteForceRaycast(boxes, rays[i], distance);
+            plaster::RayHit bvhHit;
+            bvh.raycast(rays[i], bvhHit);
+            mismatches += sameHit(hit, distance, bvhHit) ? 0 : 1;
+        }
+
+        if (mismatches > 0) {
+            std::fprintf(stderr, "%u BVH results differ from brute force\n", mismatches);
+            return 1;
+        }
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "Benchmark failed: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
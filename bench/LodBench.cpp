@@ -0,0 +1,238 @@
+#include "Graphics/MeshLod.h"
+#include "Graphics/Mesh.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <random>
+#include <vector>
+
+// Builds a LOD chain for a lumpy sphere and reports, per level, the triangle
+// count, the recorded error and the largest distance measured from a sample
+// of original vertices to the level's surface.
+//
+// Then selects levels for a field of instances seen by a camera slowly
+// dollying back and forth with some jitter, with and without hysteresis, and
+// reports the triangles drawn against full detail and how often instances
+// switched level. Every level must keep the mesh closed (no triangle may be
+// lost to a crack), and hysteresis must not switch more often than none; the
+// benchmark fails otherwise.
+//
+// Usage: plasterLodBench [triangles] [instances] [frames]
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const float PI = 3.14159265f;
+const uint32_t SAMPLE_VERTICES = 256;
+
+double elapsedMs(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// Closed, with the poles and the seam welded so nothing is locked
+plaster::MeshData makeMesh(uint32_t triangles) {
+    plaster::MeshData mesh;
+    uint32_t rings = std::max(4u, static_cast<uint32_t>(std::sqrt(triangles / 4.0)));
+    uint32_t segments = rings * 2;
+    auto position = [](float theta, float phi) {
+        glm::vec3 direction(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi));
+        float lumps = 1.0f + 0.08f * std::sin(phi * 7.0f) * std::sin(theta * 5.0f) +
+                      0.03f * std::sin(phi * 23.0f + theta * 17.0f);
+        return direction * 10.0f * lumps;
+    };
+    mesh.vertices.push_back({position(0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec2(0.0f)});
+    for (uint32_t ring = 1; ring < rings; ++ring) {
+        for (uint32_t segment = 0; segment < segments; ++segment) {
+            glm::vec3 p = position(PI * ring / rings, 2.0f * PI * segment / segments);
+            mesh.vertices.push_back({p, glm::normalize(p), glm::vec2(0.0f)});
+        }
+    }
+    mesh.vertices.push_back({position(PI, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f), glm::vec2(0.0f)});
+    uint32_t south = static_cast<uint32_t>(mesh.vertices.size() - 1);
+
+    auto ringVertex = [segments](uint32_t ring, uint32_t segment) {
+        return 1 + (ring - 1) * segments + segment % segments;
+    };
+    // Counter-clockwise seen from outside
+    for (uint32_t segment = 0; segment < segments; ++segment) {
+        mesh.indices.insert(mesh.indices.end(), {0, ringVertex(1, segment + 1), ringVertex(1, segment)});
+        mesh.indices.insert(mesh.indices.end(),
+                            {south, ringVertex(rings - 1, segment), ringVertex(rings - 1, segment + 1)});
+    }
+    for (uint32_t ring = 1; ring < rings - 1; ++ring) {
+        for (uint32_t segment = 0; segment < segments; ++segment) {
+            uint32_t a = ringVertex(ring, segment);
+            uint32_t b = ringVertex(ring, segment + 1);
+            uint32_t c = ringVertex(ring + 1, segment);
+            uint32_t d = ringVertex(ring + 1, segment + 1);
+            mesh.indices.insert(mesh.indices.end(), {a, b, c, b, d, c});
+        }
+    }
+    return mesh;
+}
+
+float pointTriangleDistance(const glm::vec3& p, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c) {
+    // Ericson, Real-Time Collision Detection 5.1.5
+    glm::vec3 ab = b - a, ac = c - a, ap = p - a;
+    float d1 = glm::dot(ab, ap), d2 = glm::dot(ac, ap);
+    if (d1 <= 0.0f && d2 <= 0.0f) return glm::length(p - a);
+    glm::vec3 bp = p - b;
+    float d3 = glm::dot(ab, bp), d4 = glm::dot(ac, bp);
+    if (d3 >= 0.0f && d4 <= d3) return glm::length(p - b);
+    float vc = d1 * d4 - d3 * d2;
+    if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) return glm::length(p - (a + ab * (d1 / (d1 - d3))));
+    glm::vec3 cp = p - c;
+    float d5 = glm::dot(ab, cp), d6 = glm::dot(ac, cp);
+    if (d6 >= 0.0f && d5 <= d6) return glm::length(p - c);
+    float vb = d5 * d2 - d1 * d6;
+    if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) return glm::length(p - (a + ac * (d2 / (d2 - d6))));
+    float va = d3 * d6 - d5 * d4;
+    if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f) {
+        return glm::length(p - (b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)))));
+    }
+    float denominator = 1.0f / (va + vb + vc);
+    return glm::length(p - (a + ab * (vb * denominator) + ac * (vc * denominator)));
+}
+
+// Every edge of a closed mesh is shared by exactly two triangles
+bool isClosed(const uint32_t* indices, uint32_t indexCount) {
+    std::vector<uint64_t> edges;
+    for (uint32_t i = 0; i < indexCount; i += 3) {
+        for (uint32_t k = 0; k < 3; ++k) {
+            uint32_t u = indices[i + k];
+            uint32_t v = indices[i + (k + 1) % 3];
+            edges.push_back(static_cast<uint64_t>(std::min(u, v)) << 32 | std::max(u, v));
+        }
+    }
+    std::sort(edges.begin(), edges.end());
+    for (size_t i = 0; i < edges.size(); i += 2) {
+        if (i + 1 >= edges.size() || edges[i] != edges[i + 1] || (i + 2 < edges.size() && edges[i + 2] == edges[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+struct SelectionResult {
+    uint64_t triangles;
+    uint64_t fullDetailTriangles;
+    uint32_t switches;
+};
+
+SelectionResult simulate(const plaster::MeshLodData& lods, uint32_t instanceCount, uint32_t frames,
+                         float hysteresis) {
+    plaster::LodSelector selector;
+    selector.getSettings().hysteresis = hysteresis;
+    std::vector<uint32_t> meshes;
+    std::vector<float> errors;
+    std::vector<uint32_t> triangles;
+    for (size_t level = 0; level < lods.levels.size(); ++level) {
+        meshes.push_back(static_cast<uint32_t>(level));
+        errors.push_back(lods.levels[level].error);
+        triangles.push_back(lods.levels[level].indexCount / 3);
+    }
+    uint32_t mesh = selector.addMesh(meshes.data(), errors.data(), triangles.data(),
+                                     static_cast<uint32_t>(meshes.size()), glm::vec3(0.0f), 11.0f);
+
+    // A row of instances receding from the camera
+    std::mt19937 random(99);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    std::vector<glm::mat4> transforms;
+    for (uint32_t i = 0; i < instanceCount; ++i) {
+        glm::mat4 transform(1.0f);
+        transform[3] = glm::vec4(unit(random) * 100.0f, 0.0f, -30.0f - 600.0f * i / instanceCount, 1.0f);
+        transforms.push_back(transform);
+        selector.addInstance(mesh);
+    }
+
+    // 60 degree vertical field of view onto 1080 rows
+    glm::mat4 projection(0.0f);
+    projection[1][1] = 1.0f / std::tan(PI / 6.0f);
+    for (uint32_t frame = 0; frame < frames; ++frame) {
+        float z = 10.0f * std::sin(frame * 0.01f) + 0.5f * unit(random);
+        glm::mat4 view(1.0f);
+        view[3] = glm::vec4(0.0f, 0.0f, -z, 1.0f);
+        selector.setCamera(view, projection, 1080.0f);
+        for (uint32_t i = 0; i < instanceCount; ++i) {
+            selector.select(i, transforms[i]);
+        }
+    }
+    const plaster::LodStats& stats = selector.getStats();
+    return {stats.triangles, stats.fullDetailTriangles, stats.switches};
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    uint32_t triangleTarget = argc > 1 ? static_cast<uint32_t>(std::atoi(argv[1])) : 250000;
+    uint32_t instanceCount = argc > 2 ? static_cast<uint32_t>(std::atoi(argv[2])) : 2000;
+    uint32_t frameCount = argc > 3 ? static_cast<uint32_t>(std::atoi(argv[3])) : 600;
+
+    try {
+        plaster::MeshData mesh = makeMesh(triangleTarget);
+        uint32_t triangleCount = static_cast<uint32_t>(mesh.indices.size() / 3);
+
+        auto start = Clock::now();
+        plaster::MeshLodData lods =
+            plaster::buildMeshLods(&mesh.vertices[0].position.x, sizeof(plaster::Vertex),
+                                   static_cast<uint32_t>(mesh.vertices.size()), mesh.indices.data(),
+                                   static_cast<uint32_t>(mesh.indices.size()));
+        double buildMs = elapsedMs(start);
+        std::printf("%u triangles -> %zu levels in %.1f ms\n", triangleCount, lods.levels.size(), buildMs);
+
+        uint32_t failures = 0;
+        std::mt19937 random(1234);
+        std::uniform_int_distribution<size_t> pick(0, mesh.vertices.size() - 1);
+        std::vector<glm::vec3> samples;
+        for (uint32_t i = 0; i < SAMPLE_VERTICES; ++i) {
+            samples.push_back(mesh.vertices[pick(random)].position);
+        }
+        for (size_t level = 0; level < lods.levels.size(); ++level) {
+            const plaster::MeshLodLevel& lod = lods.levels[level];
+            const uint32_t* indices = &lods.indices[lod.firstIndex];
+            bool closed = isClosed(indices, lod.indexCount);
+            failures += closed ? 0 : 1;
+
+            float measured = 0.0f;
+            for (const glm::vec3& sample : samples) {
+                float nearest = INFINITY;
+                for (uint32_t i = 0; i < lod.indexCount; i += 3) {
+                    nearest = std::min(nearest, pointTriangleDistance(sample, mesh.vertices[indices[i]].position,
+                                                                      mesh.vertices[indices[i + 1]].position,
+                                                                      mesh.vertices[indices[i + 2]].position));
+                }
+                measured = std::max(measured, nearest);
+            }
+            std::printf("  level %zu: %8u triangles, error %.4f recorded, %.4f measured%s\n", level,
+                        lod.indexCount / 3, lod.error, measured, closed ? "" : ", NOT CLOSED");
+        }
+
+        start = Clock::now();
+        SelectionResult plain = simulate(lods, instanceCount, frameCount, 0.0f);
+        SelectionResult damped = simulate(lods, instanceCount, frameCount, 0.25f);
+        double selectMs = elapsedMs(start);
+        std::printf("selection over %u instances x %u frames (%.1f ns each):\n", instanceCount, frameCount,
+                    selectMs * 1e6 / (2.0 * instanceCount * std::max(frameCount, 1u)));
+        std::printf("  no hysteresis:  %.1f%% of full detail triangles, %u switches\n",
+                    100.0 * plain.triangles / std::max<double>(static_cast<double>(plain.fullDetailTriangles), 1.0),
+                    plain.switches);
+        std::printf("  25%% hysteresis: %.1f%% of full detail triangles, %u switches\n",
+                    100.0 * damped.triangles / std::max<double>(static_cast<double>(damped.fullDetailTriangles), 1.0),
+                    damped.switches);
+        failures += damped.switches > plain.switches ? 1 : 0;
+
+        if (failures > 0) {
+            std::fprintf(stderr, "%u LOD check failures\n", failures);
+            return 1;
+        }
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "Benchmark failed: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,183 @@
+#include "Graphics/Meshlet.h"
+#include "Graphics/Mesh.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <random>
+#include <vector>
+
+// Builds meshlets for a lumpy sphere with a scatter of small disconnected
+// quads appended (the foliage-card case), and reports build time, how full
+// the meshlets are and how many vertices they duplicate. Then, from cameras
+// around and inside the mesh, counts the triangles the normal cones cull.
+//
+// Every triangle must come out of exactly one meshlet, every bounding sphere
+// must hold its vertices and every cone-culled meshlet must be entirely back
+// facing from the camera that culled it; the benchmark fails otherwise.
+//
+// Usage: plasterMeshletBench [triangles] [cameras]
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const float PI = 3.14159265f;
+const uint32_t CARD_COUNT = 2000;
+
+double elapsedMs(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+plaster::MeshData makeMesh(uint32_t triangles, std::mt19937& random) {
+    plaster::MeshData mesh;
+    uint32_t rings = std::max(4u, static_cast<uint32_t>(std::sqrt(triangles / 4.0)));
+    uint32_t segments = rings * 2;
+    for (uint32_t ring = 0; ring <= rings; ++ring) {
+        float theta = PI * ring / rings;
+        for (uint32_t segment = 0; segment <= segments; ++segment) {
+            float phi = 2.0f * PI * segment / segments;
+            glm::vec3 direction(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi));
+            float lumps = 1.0f + 0.08f * std::sin(phi * 7.0f) * std::sin(theta * 5.0f) +
+                          0.03f * std::sin(phi * 23.0f + theta * 17.0f);
+            mesh.vertices.push_back({direction * 10.0f * lumps, direction,
+                                     glm::vec2(static_cast<float>(segment) / segments,
+                                               static_cast<float>(ring) / rings)});
+        }
+    }
+    // Counter-clockwise seen from outside
+    for (uint32_t ring = 0; ring < rings; ++ring) {
+        for (uint32_t segment = 0; segment < segments; ++segment) {
+            uint32_t a = ring * (segments + 1) + segment;
+            uint32_t b = a + segments + 1;
+            if (ring != 0) {
+                mesh.indices.insert(mesh.indices.end(), {a, a + 1, b});
+            }
+            if (ring != rings - 1) {
+                mesh.indices.insert(mesh.indices.end(), {a + 1, b + 1, b});
+            }
+        }
+    }
+
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    for (uint32_t card = 0; card < CARD_COUNT; ++card) {
+        glm::vec3 centre = glm::vec3(unit(random), unit(random), unit(random)) * 20.0f;
+        glm::vec3 u = glm::normalize(glm::vec3(unit(random), unit(random), unit(random)) + glm::vec3(0.0f, 0.0f, 2.0f));
+        glm::vec3 v = glm::normalize(glm::cross(u, glm::vec3(0.0f, 1.0f, 0.0f)));
+        glm::vec3 normal = glm::cross(u, v);
+        uint32_t first = static_cast<uint32_t>(mesh.vertices.size());
+        mesh.vertices.push_back({centre - u - v, normal, glm::vec2(0.0f, 0.0f)});
+        mesh.vertices.push_back({centre + u - v, normal, glm::vec2(1.0f, 0.0f)});
+        mesh.vertices.push_back({centre + u + v, normal, glm::vec2(1.0f, 1.0f)});
+        mesh.vertices.push_back({centre - u + v, normal, glm::vec2(0.0f, 1.0f)});
+        mesh.indices.insert(mesh.indices.end(), {first, first + 1, first + 2, first, first + 2, first + 3});
+    }
+    return mesh;
+}
+
+std::array<uint32_t, 3> sortedTriangle(uint32_t a, uint32_t b, uint32_t c) {
+    std::array<uint32_t, 3> triangle = {a, b, c};
+    std::sort(triangle.begin(), triangle.end());
+    return triangle;
+}
+
+bool coneCulls(const plaster::Meshlet& meshlet, const glm::vec3& camera) {
+    glm::vec3 toCenter = meshlet.center - camera;
+    return glm::dot(toCenter, meshlet.coneAxis) >= meshlet.coneCutoff * glm::length(toCenter) + meshlet.radius;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    uint32_t triangleTarget = argc > 1 ? static_cast<uint32_t>(std::atoi(argv[1])) : 1000000;
+    uint32_t cameraCount = argc > 2 ? static_cast<uint32_t>(std::atoi(argv[2])) : 32;
+
+    try {
+        std::mt19937 random(1234);
+        plaster::MeshData mesh = makeMesh(triangleTarget, random);
+        uint32_t triangleCount = static_cast<uint32_t>(mesh.indices.size() / 3);
+
+        auto start = Clock::now();
+        plaster::MeshletData meshlets =
+            plaster::buildMeshlets(&mesh.vertices[0].position.x, sizeof(plaster::Vertex),
+                                   static_cast<uint32_t>(mesh.vertices.size()), mesh.indices.data(),
+                                   static_cast<uint32_t>(mesh.indices.size()));
+        double buildMs = elapsedMs(start);
+
+        size_t meshletCount = meshlets.meshlets.size();
+        std::printf("%u vertices, %u triangles -> %zu meshlets in %.1f ms\n",
+                    static_cast<uint32_t>(mesh.vertices.size()), triangleCount, meshletCount, buildMs);
+        std::printf("average %.1f / %u vertices, %.1f / %u triangles; %.3f vertex references per vertex\n",
+                    static_cast<double>(meshlets.vertices.size()) / meshletCount, plaster::MESHLET_MAX_VERTICES,
+                    static_cast<double>(triangleCount) / meshletCount, plaster::MESHLET_MAX_TRIANGLES,
+                    static_cast<double>(meshlets.vertices.size()) / mesh.vertices.size());
+
+        // Every source triangle exactly once, and bounds that hold their vertices
+        uint32_t failures = 0;
+        std::vector<std::array<uint32_t, 3>> expected;
+        std::vector<std::array<uint32_t, 3>> found;
+        for (uint32_t i = 0; i < triangleCount; ++i) {
+            expected.push_back(sortedTriangle(mesh.indices[i * 3], mesh.indices[i * 3 + 1], mesh.indices[i * 3 + 2]));
+        }
+        for (const plaster::Meshlet& meshlet : meshlets.meshlets) {
+            const uint32_t* vertices = &meshlets.vertices[meshlet.vertexOffset];
+            const uint8_t* local = &meshlets.triangles[meshlet.triangleOffset];
+            failures += meshlet.vertexCount > plaster::MESHLET_MAX_VERTICES ||
+                        meshlet.triangleCount > plaster::MESHLET_MAX_TRIANGLES ? 1 : 0;
+            for (uint32_t t = 0; t < meshlet.triangleCount; ++t) {
+                found.push_back(sortedTriangle(vertices[local[t * 3]], vertices[local[t * 3 + 1]],
+                                               vertices[local[t * 3 + 2]]));
+            }
+            for (uint32_t v = 0; v < meshlet.vertexCount; ++v) {
+                float distance = glm::length(mesh.vertices[vertices[v]].position - meshlet.center);
+                failures += distance > meshlet.radius * 1.0001f + 1e-5f ? 1 : 0;
+            }
+        }
+        std::sort(expected.begin(), expected.end());
+        std::sort(found.begin(), found.end());
+        failures += expected == found ? 0 : 1;
+
+        // Cameras on a ring outside the sphere, and one at its centre where everything faces away
+        uint32_t culledTriangles = 0;
+        uint32_t unsound = 0;
+        start = Clock::now();
+        for (uint32_t camera = 0; camera < cameraCount; ++camera) {
+            float angle = 2.0f * PI * camera / cameraCount;
+            glm::vec3 position = camera == 0 ? glm::vec3(0.0f)
+                                             : glm::vec3(std::cos(angle), 0.3f, std::sin(angle)) * 30.0f;
+            for (const plaster::Meshlet& meshlet : meshlets.meshlets) {
+                if (!coneCulls(meshlet, position)) {
+                    continue;
+                }
+                culledTriangles += meshlet.triangleCount;
+                const uint32_t* vertices = &meshlets.vertices[meshlet.vertexOffset];
+                const uint8_t* local = &meshlets.triangles[meshlet.triangleOffset];
+                for (uint32_t t = 0; t < meshlet.triangleCount; ++t) {
+                    const glm::vec3& a = mesh.vertices[vertices[local[t * 3]]].position;
+                    const glm::vec3& b = mesh.vertices[vertices[local[t * 3 + 1]]].position;
+                    const glm::vec3& c = mesh.vertices[vertices[local[t * 3 + 2]]].position;
+                    glm::vec3 normal = glm::cross(b - a, c - a);
+                    // Front facing when the camera is on the side the normal points to
+                    unsound += glm::dot(normal, position - a) > 1e-4f * glm::length(normal) ? 1 : 0;
+                }
+            }
+        }
+        double cullMs = elapsedMs(start);
+        std::printf("cone culling: %.1f%% of triangles over %u cameras (%.3f ms per camera), %u front facing culled\n",
+                    100.0 * culledTriangles / (static_cast<double>(triangleCount) * std::max(cameraCount, 1u)),
+                    cameraCount, cullMs / std::max(cameraCount, 1u), unsound);
+
+        if (failures > 0 || unsound > 0) {
+            std::fprintf(stderr, "%u meshlet check failures, %u front facing triangles culled\n", failures, unsound);
+            return 1;
+        }
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "Benchmark failed: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
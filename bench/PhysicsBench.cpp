@@ -0,0 +1,141 @@
+#include "Physics/PhysicsWorld.h"
+#include "Core/JobSystem.h"
+#include "Core/FrameArena.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <random>
+#include <vector>
+
+// Drops a grid of stacks of boxes and spheres onto a static floor, far
+// enough apart that most stacks stay islands of their own, and steps the world
+// at 60Hz, reporting the time spent in each phase of a step. Along the way
+// the broadphase's pair count is checked against testing every pair of
+// bounds, and at the end no body over the floor may be below it and none
+// may have gone non-finite; the benchmark fails otherwise.
+//
+// Usage: plasterPhysicsBench [bodies] [steps]
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const float TIME_STEP = 1.0f / 60.0f;
+const uint32_t LAYERS = 4;
+const float SPACING = 3.0f;
+
+uint32_t bruteForcePairs(const plaster::PhysicsWorld& world, const std::vector<uint32_t>& bodies) {
+    std::vector<plaster::Aabb> bounds(bodies.size());
+    for (size_t i = 0; i < bodies.size(); ++i) {
+        bounds[i] = world.getBody(bodies[i]).computeBounds();
+    }
+    uint32_t pairs = 0;
+    for (size_t i = 0; i < bodies.size(); ++i) {
+        bool staticI = world.getBody(bodies[i]).type == plaster::BodyType::Static;
+        for (size_t j = i + 1; j < bodies.size(); ++j) {
+            bool staticJ = world.getBody(bodies[j]).type == plaster::BodyType::Static;
+            pairs += !(staticI && staticJ) && bounds[i].overlaps(bounds[j]) ? 1 : 0;
+        }
+    }
+    return pairs;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    uint32_t bodyCount = argc > 1 ? static_cast<uint32_t>(std::atoi(argv[1])) : 4000;
+    uint32_t steps = argc > 2 ? static_cast<uint32_t>(std::atoi(argv[2])) : 300;
+
+    try {
+        plaster::JobSystem jobSystem;
+        plaster::PhysicsWorld world(&jobSystem);
+        std::mt19937 random(1234);
+        std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+        uint32_t columns = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(bodyCount) / LAYERS)));
+        // Spheres keep rolling, so leave them room
+        float floorSize = columns * SPACING * 0.5f + 50.0f;
+
+        std::vector<uint32_t> bodies;
+        plaster::BodyDesc floor;
+        floor.type = plaster::BodyType::Static;
+        floor.shape = plaster::CollisionShape::box(glm::vec3(floorSize, 1.0f, floorSize));
+        floor.position = glm::vec3(0.0f, -1.0f, 0.0f);
+        bodies.push_back(world.createBody(floor));
+
+        for (uint32_t i = 0; i < bodyCount; ++i) {
+            uint32_t layer = i / (columns * columns);
+            uint32_t cell = i % (columns * columns);
+            plaster::BodyDesc desc;
+            desc.shape = i % 3 == 0 ? plaster::CollisionShape::sphere(0.5f)
+                                    : plaster::CollisionShape::box(glm::vec3(0.5f, 0.4f, 0.3f));
+            desc.position = glm::vec3((cell % columns - columns * 0.5f) * SPACING, 1.0f + layer * 1.2f,
+                                      (cell / columns - columns * 0.5f) * SPACING) +
+                            glm::vec3(unit(random), 0.0f, unit(random)) * 0.2f;
+            desc.orientation = glm::normalize(glm::quat(1.0f, unit(random) * 0.1f, unit(random) * 0.1f, unit(random) * 0.1f));
+            bodies.push_back(world.createBody(desc));
+        }
+
+        std::printf("%u bodies, %u steps, %u worker threads\n", bodyCount, steps, jobSystem.getWorkerCount());
+
+        double broadphase = 0.0;
+        double narrowphase = 0.0;
+        double solver = 0.0;
+        double worst = 0.0;
+        uint32_t mismatches = 0;
+        auto start = Clock::now();
+        for (uint32_t step = 0; step < steps; ++step) {
+            plaster::FrameArena::beginFrame(step + 1, 2);
+            world.step(TIME_STEP);
+
+            const plaster::PhysicsStepStats& stats = world.getLastStepStats();
+            broadphase += stats.broadphaseMs;
+            narrowphase += stats.narrowphaseMs;
+            solver += stats.solverMs;
+            worst = std::max(worst, stats.broadphaseMs + stats.narrowphaseMs + stats.solverMs);
+            if (step % 60 == 0 || step + 1 == steps) {
+                std::printf("step %4u: %6.2f ms, %6u pairs, %6u contacts, %5u islands (largest %u), %u awake\n", step,
+                            stats.broadphaseMs + stats.narrowphaseMs + stats.solverMs, stats.pairCount,
+                            stats.contactCount, stats.islandCount, stats.largestIsland, stats.awakeBodyCount);
+            }
+            // Pairs were found from the bounds the previous step left
+            if (step == steps / 2) {
+                auto bruteStart = Clock::now();
+                plaster::FrameArena::beginFrame(step + 1, 2);
+                uint32_t expected = bruteForcePairs(world, bodies);
+                double bruteMs = std::chrono::duration<double, std::milli>(Clock::now() - bruteStart).count();
+                world.step(TIME_STEP);
+                uint32_t found = world.getLastStepStats().pairCount;
+                std::printf("broadphase check: %u pairs, brute force %u in %.2f ms vs sweep and prune %.2f ms\n",
+                            found, expected, bruteMs, world.getLastStepStats().broadphaseMs);
+                mismatches += found == expected ? 0 : 1;
+            }
+        }
+        double total = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+        double perStep = 1.0 / std::max(steps, 1u);
+        std::printf("per step: broadphase %.3f ms, narrowphase %.3f ms, solver %.3f ms; worst %.3f ms; wall %.3f ms\n",
+                    broadphase * perStep, narrowphase * perStep, solver * perStep, worst, total * perStep);
+
+        uint32_t lost = 0;
+        for (size_t i = 1; i < bodies.size(); ++i) {
+            const plaster::RigidBody& body = world.getBody(bodies[i]);
+            bool finite = std::isfinite(body.position.x) && std::isfinite(body.position.y) &&
+                          std::isfinite(body.position.z);
+            bool overFloor = std::fabs(body.position.x) < floorSize && std::fabs(body.position.z) < floorSize;
+            lost += !finite || (overFloor && body.position.y < 0.0f) ? 1 : 0;
+        }
+        if (lost > 0 || mismatches > 0) {
+            std::fprintf(stderr, "%u bodies fell through the floor, %u broadphase mismatches\n", lost, mismatches);
+            return 1;
+        }
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "Benchmark failed: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
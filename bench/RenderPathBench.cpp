@@ -0,0 +1,198 @@
+#include "Core/Window.h"
+#include "Core/JobSystem.h"
+#include "Graphics/VulkanContext.h"
+#include "Graphics/Renderer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <new>
+#include <vector>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+// Compares the render pass and dynamic rendering paths of the Renderer:
+// CPU time to record and submit a frame (on the render thread), how long
+// render() itself blocks the caller, GPU time between the frame's first and
+// last timestamp, the cost of rebuilding the swapchain on resize, and
+// how many heap allocations render() makes once warmed up.
+//
+// Usage: plasterRenderPathBench [frames] [resizes] [max allocations per frame]
+//
+// With the third argument the benchmark fails when any measured frame
+// allocates more than that, so heap churn on the frame path can be caught.
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Every operator new in the process, including job workers and drivers calling into C++
+std::atomic<uint64_t> g_allocationCount{0};
+
+struct Summary {
+    double mean = 0.0;
+    double p50 = 0.0;
+    double p99 = 0.0;
+};
+
+Summary summarize(std::vector<double> samples) {
+    Summary summary;
+    if (samples.empty()) {
+        return summary;
+    }
+    std::sort(samples.begin(), samples.end());
+    for (double sample : samples) {
+        summary.mean += sample;
+    }
+    summary.mean /= samples.size();
+    summary.p50 = samples[samples.size() / 2];
+    summary.p99 = samples[std::min(samples.size() - 1, samples.size() * 99 / 100)];
+    return summary;
+}
+
+void printRow(const char* path, const char* metric, const Summary& summary) {
+    std::printf("%-18s %-14s %9.3f %9.3f %9.3f\n", path, metric, summary.mean, summary.p50, summary.p99);
+}
+
+// Returns the most allocations any measured frame made
+uint64_t runPath(plaster::Window& window, plaster::VulkanContext& context, plaster::JobSystem& jobSystem,
+                 plaster::RenderPath path, uint32_t frames, uint32_t resizes) {
+    plaster::Renderer renderer(&window, &context, &jobSystem, path);
+    // Both paths have to render the same number of pixels to be comparable
+    renderer.getDynamicResolution().getSettings().enabled = false;
+    const char* name = renderer.getRenderPath() == plaster::RenderPath::DynamicRendering ? "dynamic rendering"
+                                                                                         : "render pass";
+    if (renderer.getRenderPath() != path) {
+        std::printf("%-18s not supported by this device, skipped\n", "dynamic rendering");
+        return 0;
+    }
+
+    // Let pipeline compiles and the first few frames settle
+    for (uint32_t i = 0; i < 120; ++i) {
+        window.pollEvents();
+        renderer.render();
+    }
+
+    std::vector<double> cpu, frame, gpu, allocations;
+    cpu.reserve(frames);
+    frame.reserve(frames);
+    gpu.reserve(frames);
+    allocations.reserve(frames);
+    for (uint32_t i = 0; i < frames; ++i) {
+        window.pollEvents();
+        uint64_t before = g_allocationCount.load(std::memory_order_relaxed);
+        auto start = Clock::now();
+        renderer.render();
+        frame.push_back(std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+        allocations.push_back(static_cast<double>(g_allocationCount.load(std::memory_order_relaxed) - before));
+        cpu.push_back(renderer.getFrameTimings().cpuRecordMs);
+        gpu.push_back(renderer.getFrameTimings().gpuMs);
+    }
+
+    // Alternate between two sizes so every rebuild really changes the extent
+    std::vector<double> resize;
+    for (uint32_t i = 0; i < resizes; ++i) {
+        window.setSize(i % 2 ? 1280 : 1600, i % 2 ? 720 : 900);
+        window.pollEvents();
+
+        auto start = Clock::now();
+        renderer.recreateSwapchain();
+        resize.push_back(std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+
+        renderer.render();
+    }
+
+    renderer.waitIdle();
+    printRow(name, "cpu record ms", summarize(cpu));
+    printRow(name, "render() ms", summarize(frame));
+    printRow(name, "gpu ms", summarize(gpu));
+    printRow(name, "resize ms", summarize(resize));
+    printRow(name, "allocs/frame", summarize(allocations));
+    if (allocations.empty()) {
+        return 0;
+    }
+    return static_cast<uint64_t>(*std::max_element(allocations.begin(), allocations.end()));
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    uint32_t frames = argc > 1 ? static_cast<uint32_t>(std::atoi(argv[1])) : 2000;
+    uint32_t resizes = argc > 2 ? static_cast<uint32_t>(std::atoi(argv[2])) : 50;
+    long maxAllocations = argc > 3 ? std::atol(argv[3]) : -1;
+    if (frames == 0) {
+        std::fprintf(stderr, "Usage: plasterRenderPathBench [frames] [resizes] [max allocations per frame]\n");
+        return 1;
+    }
+
+    try {
+        plaster::Window window(1280, 720, "plasterRenderPathBench");
+        plaster::VulkanContext context(&window);
+        plaster::JobSystem jobSystem;
+
+        std::printf("%-18s %-14s %9s %9s %9s\n", "path", "metric", "mean", "p50", "p99");
+        uint64_t worst = runPath(window, context, jobSystem, plaster::RenderPath::RenderPass, frames, resizes);
+        worst = std::max(worst, runPath(window, context, jobSystem, plaster::RenderPath::DynamicRendering,
+                                        frames, resizes));
+
+        if (maxAllocations >= 0 && worst > static_cast<uint64_t>(maxAllocations)) {
+            std::fprintf(stderr, "A frame made %llu heap allocations, more than the allowed %ld\n",
+                         static_cast<unsigned long long>(worst), maxAllocations);
+            return 1;
+        }
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "Benchmark failed: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
+
+// Counting replacements for the global allocation functions; the array,
+// nothrow and sized/aligned delete forms forward to these by default
+void* operator new(std::size_t size) {
+    g_allocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (void* pointer = std::malloc(size ? size : 1)) {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+    g_allocationCount.fetch_add(1, std::memory_order_relaxed);
+    std::size_t align = static_cast<std::size_t>(alignment);
+#ifdef _WIN32
+    void* pointer = _aligned_malloc(size ? size : 1, align);
+#else
+    // aligned_alloc wants a multiple of the alignment
+    void* pointer = std::aligned_alloc(align, (std::max<std::size_t>(size, 1) + align - 1) / align * align);
+#endif
+    if (pointer) {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* pointer) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, std::align_val_t) noexcept {
+#ifdef _WIN32
+    _aligned_free(pointer);
+#else
+    std::free(pointer);
+#endif
+}
+
+void operator delete(void* pointer, std::size_t, std::align_val_t alignment) noexcept {
+    operator delete(pointer, alignment);
+}
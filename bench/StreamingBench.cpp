@@ -0,0 +1,224 @@
+#include "Core/Window.h"
+#include "Core/JobSystem.h"
+#include "Graphics/VulkanContext.h"
+#include "Graphics/Renderer.h"
+#include "Graphics/MeshLoader.h"
+#include "Graphics/Mesh.h"
+#include "Asset/ArchiveWriter.h"
+#include "Asset/AssetStreamer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+
+// Streams mesh blobs through AssetStreamer and the MeshLoader into the
+// Renderer. Writes an archive of wavy grids of varying size (half of them
+// LZ4 compressed, when the build has LZ4) to the temp directory, then:
+//
+//   load:  requests every mesh with a random priority and renders until all
+//          are resident, reporting the time taken and the read throughput
+//   churn: lowers the VRAM budget to half the meshes and resolves a window
+//          of them that slides across the set, so assets are evicted and
+//          streamed back in, reporting the cost of update() per frame
+//
+// The benchmark fails if any mesh fails to stream or the load phase doesn't
+// finish within the frame limit.
+//
+// Usage: plasterStreamingBench [meshes] [frames]
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const float PI = 3.14159265f;
+
+struct Summary {
+    double mean = 0.0;
+    double p50 = 0.0;
+    double p99 = 0.0;
+};
+
+Summary summarize(std::vector<double> samples) {
+    Summary summary;
+    if (samples.empty()) {
+        return summary;
+    }
+    std::sort(samples.begin(), samples.end());
+    for (double sample : samples) {
+        summary.mean += sample;
+    }
+    summary.mean /= samples.size();
+    summary.p50 = samples[samples.size() / 2];
+    summary.p99 = samples[std::min(samples.size() - 1, samples.size() * 99 / 100)];
+    return summary;
+}
+
+// A mesh blob in the layout the packer writes, see MeshBlobHeader
+std::vector<uint8_t> makeGridBlob(uint32_t size) {
+    std::vector<plaster::Vertex> vertices;
+    for (uint32_t z = 0; z <= size; ++z) {
+        for (uint32_t x = 0; x <= size; ++x) {
+            float u = static_cast<float>(x) / size;
+            float v = static_cast<float>(z) / size;
+            glm::vec3 position(u * 10.0f, std::sin(u * 4.0f * PI) * std::cos(v * 4.0f * PI), v * 10.0f);
+            vertices.push_back({position, glm::vec3(0.0f, 1.0f, 0.0f), glm::vec2(u, v)});
+        }
+    }
+    std::vector<uint32_t> indices;
+    for (uint32_t z = 0; z < size; ++z) {
+        for (uint32_t x = 0; x < size; ++x) {
+            uint32_t a = z * (size + 1) + x;
+            uint32_t c = a + size + 1;
+            indices.insert(indices.end(), {a, c, a + 1, a + 1, c, c + 1});
+        }
+    }
+
+    plaster::MeshBlobHeader header{};
+    header.magic = plaster::MESH_BLOB_MAGIC;
+    header.vertexStride = sizeof(plaster::Vertex);
+    header.vertexCount = static_cast<uint32_t>(vertices.size());
+    header.indexCount = static_cast<uint32_t>(indices.size());
+
+    size_t vertexBytes = vertices.size() * sizeof(plaster::Vertex);
+    std::vector<uint8_t> blob(sizeof(header) + vertexBytes + indices.size() * sizeof(uint32_t));
+    std::memcpy(blob.data(), &header, sizeof(header));
+    std::memcpy(blob.data() + sizeof(header), vertices.data(), vertexBytes);
+    std::memcpy(blob.data() + sizeof(header) + vertexBytes, indices.data(), indices.size() * sizeof(uint32_t));
+    return blob;
+}
+
+std::string meshPath(uint32_t index) {
+    return "bench/grid" + std::to_string(index) + ".mesh";
+}
+
+bool anyFailed(const plaster::AssetStreamer& streamer, const std::vector<plaster::AssetHandle>& handles) {
+    for (plaster::AssetHandle handle : handles) {
+        if (streamer.getState(handle) == plaster::AssetState::Failed) {
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    uint32_t meshCount = argc > 1 ? static_cast<uint32_t>(std::atoi(argv[1])) : 256;
+    uint32_t frames = argc > 2 ? static_cast<uint32_t>(std::atoi(argv[2])) : 2000;
+    if (meshCount == 0 || frames == 0) {
+        std::fprintf(stderr, "Usage: plasterStreamingBench [meshes] [frames]\n");
+        return 1;
+    }
+
+    std::filesystem::path archivePath = std::filesystem::temp_directory_path() / "plasterStreamingBench.ppak";
+    int result = 0;
+    try {
+        std::mt19937 random(7);
+        std::uniform_int_distribution<uint32_t> gridSize(16, 128);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+        uint64_t totalBytes = 0;
+        {
+            plaster::ArchiveWriter writer;
+            for (uint32_t i = 0; i < meshCount; ++i) {
+                std::vector<uint8_t> blob = makeGridBlob(gridSize(random));
+                totalBytes += blob.size() - sizeof(plaster::MeshBlobHeader);
+                writer.add(meshPath(i), std::move(blob),
+                           i % 2 ? plaster::Compression::LZ4 : plaster::Compression::None);
+            }
+            writer.write(archivePath.string());
+        }
+
+        plaster::Window window(1280, 720, "plasterStreamingBench");
+        plaster::VulkanContext context(&window);
+        plaster::JobSystem jobSystem;
+        plaster::Renderer renderer(&window, &context, &jobSystem);
+        plaster::MeshLoader loader(&renderer);
+        plaster::AssetStreamer streamer(&jobSystem, UINT64_MAX, plaster::Renderer::MAX_FRAMES_IN_FLIGHT);
+        streamer.mountArchive(archivePath.string());
+
+        std::vector<plaster::AssetHandle> handles;
+        for (uint32_t i = 0; i < meshCount; ++i) {
+            float priority = plaster::computeStreamingPriority(unit(random) * 0.1f, unit(random) * 100.0f);
+            handles.push_back(streamer.request(meshPath(i), &loader, priority));
+        }
+
+        uint64_t frameNumber = 0;
+        auto start = Clock::now();
+        uint32_t loadFrames = 0;
+        for (; loadFrames < frames; ++loadFrames) {
+            window.pollEvents();
+            streamer.update(++frameNumber);
+            for (plaster::AssetHandle handle : handles) {
+                streamer.resolve(handle);
+            }
+            renderer.render();
+            if (streamer.getStats().resident == meshCount || anyFailed(streamer, handles)) {
+                break;
+            }
+        }
+        double loadMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        plaster::StreamingStats loadStats = streamer.getStats();
+
+        std::printf("%-6s %-20s %12s\n", "phase", "metric", "value");
+        std::printf("%-6s %-20s %12u\n", "load", "meshes resident", loadStats.resident);
+        std::printf("%-6s %-20s %12u\n", "load", "frames", loadFrames + 1);
+        std::printf("%-6s %-20s %12.3f\n", "load", "ms", loadMs);
+        std::printf("%-6s %-20s %12.1f\n", "load", "read MB/s",
+                    loadStats.bytesRead / (1024.0 * 1024.0) / std::max(loadMs / 1000.0, 1e-6));
+        if (anyFailed(streamer, handles) || loadStats.resident != meshCount) {
+            std::fprintf(stderr, "Only %u of %u meshes became resident\n", loadStats.resident, meshCount);
+            result = 1;
+        } else {
+            // Half the set fits; a quarter of it is visible at a time
+            streamer.setVramBudget(totalBytes / 2);
+            uint32_t visible = std::max(1u, meshCount / 4);
+            std::vector<double> updateMs;
+            updateMs.reserve(frames);
+            for (uint32_t i = 0; i < frames; ++i) {
+                window.pollEvents();
+                auto updateStart = Clock::now();
+                streamer.update(++frameNumber);
+                updateMs.push_back(std::chrono::duration<double, std::milli>(Clock::now() - updateStart).count());
+
+                uint32_t first = i / 4;
+                for (uint32_t j = 0; j < visible; ++j) {
+                    streamer.resolve(handles[(first + j) % meshCount]);
+                }
+                renderer.render();
+            }
+            plaster::StreamingStats churnStats = streamer.getStats();
+            Summary update = summarize(updateMs);
+            std::printf("%-6s %-20s %12.3f\n", "churn", "update() ms mean", update.mean);
+            std::printf("%-6s %-20s %12.3f\n", "churn", "update() ms p50", update.p50);
+            std::printf("%-6s %-20s %12.3f\n", "churn", "update() ms p99", update.p99);
+            std::printf("%-6s %-20s %12u\n", "churn", "evictions", churnStats.evictions);
+            std::printf("%-6s %-20s %12.1f\n", "churn", "re-read MB",
+                        (churnStats.bytesRead - loadStats.bytesRead) / (1024.0 * 1024.0));
+            std::printf("%-6s %-20s %12.1f\n", "churn", "resident MB", churnStats.residentBytes / (1024.0 * 1024.0));
+            if (anyFailed(streamer, handles)) {
+                std::fprintf(stderr, "A mesh failed to stream back in\n");
+                result = 1;
+            }
+        }
+
+        // Evict through the loader while it and the renderer are still alive
+        renderer.waitIdle();
+        streamer.shutdown();
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "Benchmark failed: %s\n", e.what());
+        result = 1;
+    }
+
+    std::error_code ignored;
+    std::filesystem::remove(archivePath, ignored);
+    return result;
+}
@@ -0,0 +1,80 @@
+#pragma once
+#include "Animation/Skeleton.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace plaster {
+
+// Every joint sampled at a fixed rate, as exported
+struct RawAnimationClip {
+  float sampleRate = 30.0f;   // frames per second
+  uint32_t frameCount = 0;
+  uint32_t jointCount = 0;
+  std::vector<JointTransform> samples;   // frame major: samples[frame * jointCount + joint]
+};
+
+// Largest error a removed key may introduce, per component
+struct ClipCompressionSettings {
+  float rotationTolerance = 0.0005f;      // quaternion units
+  float translationTolerance = 0.0005f;   // model units
+  float scaleTolerance = 0.0005f;
+};
+
+// A clip stored as one curve per joint and channel. Rotations are quantized
+// to 48 bits with the smallest three encoding (the largest component is
+// dropped and rebuilt from unit length, the other three get 15 bits each),
+// and every curve keeps only the keys linear interpolation between its
+// neighbours cannot reproduce within the tolerance. Held joints end up with
+// two keys however long the clip is.
+class AnimationClip {
+public:
+  AnimationClip();
+
+  // Throws if the clip has more than 65536 frames or its samples don't match its size
+  static AnimationClip compress(const RawAnimationClip& raw,
+                                const ClipCompressionSettings& settings = ClipCompressionSettings());
+
+  // Writes the pose at time (seconds, wrapped when looping, clamped otherwise)
+  // into getJointCount() joints' worth of lanes; padding lanes are set to the identity
+  void sample(float time, bool loop, SoaTransform* pose) const;
+
+  float getDuration() const { return m_duration; }
+  uint32_t getJointCount() const { return m_jointCount; }
+  uint32_t getKeyCount() const;
+  size_t getCompressedSize() const;
+
+private:
+  // Smallest three: 2 bits for the dropped component, 3 x 15 bits for the rest
+  struct QuantizedRotation {
+    uint16_t words[3];
+  };
+
+  // Keys of one curve, a range of the channel's arrays
+  struct Curve {
+    uint32_t firstKey;
+    uint32_t keyCount;
+  };
+
+  float m_sampleRate;
+  float m_duration;
+  uint32_t m_frameCount;
+  uint32_t m_jointCount;
+
+  std::vector<Curve> m_rotationCurves;   // one per joint
+  std::vector<Curve> m_translationCurves;
+  std::vector<Curve> m_scaleCurves;
+  // Frame numbers of the keys, parallel to the key arrays
+  std::vector<uint16_t> m_rotationFrames;
+  std::vector<uint16_t> m_translationFrames;
+  std::vector<uint16_t> m_scaleFrames;
+  std::vector<QuantizedRotation> m_rotations;
+  std::vector<glm::vec3> m_translations;
+  std::vector<glm::vec3> m_scales;
+
+  static QuantizedRotation quantize(const glm::quat& rotation);
+  static glm::quat dequantize(const QuantizedRotation& rotation);
+};
+
+} // namespace plaster
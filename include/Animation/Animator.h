@@ -0,0 +1,58 @@
+#pragma once
+#include "Animation/AnimationClip.h"
+#include "Animation/Skeleton.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace plaster {
+
+class JobSystem;
+
+// One animated skeleton playing a clip, optionally blended towards a second
+// one. The second clip runs at the same normalized time, so cycles of
+// different lengths (a walk and a run) stay in step while blending.
+struct AnimatedCharacter {
+  const Skeleton* skeleton = nullptr;
+  const AnimationClip* clip = nullptr;
+  const AnimationClip* blendClip = nullptr;
+  float blendWeight = 0.0f;   // 0 plays clip only, 1 blendClip only
+  float speed = 1.0f;
+  bool loop = true;
+  float phase = 0.0f;         // normalized playback position of clip, [0, 1]
+};
+
+// Samples, blends and skins every character each frame, spread over the job
+// system's workers. The palettes of all characters are written into one
+// contiguous array, each at the offset it was given when added, ready to be
+// copied to the GPU as a whole (see SkinningPass).
+class Animator {
+public:
+  explicit Animator(JobSystem* jobSystem);
+
+  Animator(const Animator&) = delete;
+  Animator& operator=(const Animator&) = delete;
+
+  // The skeleton and clips must outlive the character. Returns its id.
+  uint32_t addCharacter(const Skeleton* skeleton, const AnimationClip* clip);
+  AnimatedCharacter& getCharacter(uint32_t id) { return m_characters[id]; }
+  uint32_t getCharacterCount() const { return static_cast<uint32_t>(m_characters.size()); }
+  // Index of the character's first joint in getPalettes()
+  uint32_t getPaletteOffset(uint32_t id) const { return m_paletteOffsets[id]; }
+
+  void update(float deltaTime);
+
+  const std::vector<SkinningMatrix>& getPalettes() const { return m_palettes; }
+
+private:
+  JobSystem* m_jobSystem;
+  std::vector<AnimatedCharacter> m_characters;
+  std::vector<uint32_t> m_paletteOffsets;
+  std::vector<SkinningMatrix> m_palettes;
+
+  static const uint32_t CHARACTERS_PER_JOB = 8;
+
+  void updateCharacter(AnimatedCharacter& character, float deltaTime, SkinningMatrix* palette) const;
+};
+
+} // namespace plaster
@@ -0,0 +1,61 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace plaster {
+
+struct JointTransform {
+  glm::quat rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+  glm::vec3 translation = glm::vec3(0.0f);
+  glm::vec3 scale = glm::vec3(1.0f);
+};
+
+// Joints are ordered so every parent comes before its children
+struct Skeleton {
+  std::vector<int32_t> parents;                 // -1 for roots
+  std::vector<JointTransform> bindPose;         // local to the parent
+  std::vector<glm::mat4> inverseBindMatrices;   // model space to joint space at the bind pose
+
+  uint32_t getJointCount() const { return static_cast<uint32_t>(parents.size()); }
+  // Number of SoaTransforms a pose of this skeleton takes
+  uint32_t getLaneCount() const { return (getJointCount() + 3) / 4; }
+};
+
+// Four joints' local transforms, one component per vec4, so that sampling and
+// blending run the same arithmetic on four joints at once. Lanes past the last
+// joint hold the identity.
+struct SoaTransform {
+  glm::vec4 rotation[4];      // x, y, z, w
+  glm::vec4 translation[3];   // x, y, z
+  glm::vec4 scale[3];
+
+  static SoaTransform identity();
+  void set(uint32_t lane, const JointTransform& transform);
+  JointTransform get(uint32_t lane) const;
+};
+
+// Transposed affine part of a joint's skinning matrix, three rows of a 3x4 so
+// the palette costs 48 bytes a joint. Mirrors the palette in shaders/skinning.comp.
+struct SkinningMatrix {
+  glm::vec4 rows[3];
+};
+
+// Fills getLaneCount() transforms with the skeleton's bind pose
+void setBindPose(const Skeleton& skeleton, SoaTransform* pose);
+
+// Per lane: translation and scale lerp, rotation nlerp along the shorter arc.
+// The weights go from a (0) to b (1).
+SoaTransform blendTransforms(const SoaTransform& a, const SoaTransform& b, const glm::vec4& rotationWeight,
+                             const glm::vec4& translationWeight, const glm::vec4& scaleWeight);
+void blendPoses(const SoaTransform* a, const SoaTransform* b, float weight, SoaTransform* out, uint32_t laneCount);
+
+// Local transforms to model space. Builds the local matrices four joints at a
+// time, then walks the hierarchy once.
+void localToModel(const Skeleton& skeleton, const SoaTransform* pose, glm::mat4* model);
+// Model space joint matrices times the inverse bind matrices, getJointCount() of each
+void buildPalette(const Skeleton& skeleton, const glm::mat4* model, SkinningMatrix* palette);
+
+} // namespace plaster
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace plaster {
+
+// On-disk layout of a .ppak archive (little endian):
+//
+//   ArchiveHeader
+//   ArchiveEntry[entryCount]       sorted by pathHash
+//   string table                   null-terminated paths, for tooling only
+//   blobs                          each starts on an ARCHIVE_ALIGNMENT boundary
+//
+// Compressed blobs start with an ArchiveChunk[chunkCount] table followed by
+// the independently compressed chunks, so any chunk can be decoded in place.
+
+constexpr uint32_t ARCHIVE_MAGIC = 0x4b505050; // "PPPK"
+constexpr uint32_t ARCHIVE_VERSION = 1;
+constexpr uint64_t ARCHIVE_ALIGNMENT = 4096;
+constexpr uint32_t ARCHIVE_CHUNK_SIZE = 256 * 1024;
+
+enum class Compression : uint32_t {
+  None = 0,
+  LZ4 = 1,
+  Zstd = 2
+};
+
+struct ArchiveHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t entryCount;
+  uint32_t reserved;
+  uint64_t tocOffset;
+  uint64_t stringTableOffset;
+  uint64_t stringTableSize;
+  uint64_t fileSize;
+};
+
+struct ArchiveEntry {
+  uint64_t pathHash;
+  uint64_t offset;           // from start of archive, aligned
+  uint64_t storedSize;       // bytes on disk, including the chunk table
+  uint64_t size;             // uncompressed size
+  uint64_t checksum;         // xxHash64 of the uncompressed data
+  Compression compression;
+  uint32_t chunkCount;
+  uint32_t nameOffset;       // into the string table
+  uint32_t reserved;
+};
+
+struct ArchiveChunk {
+  uint64_t offset;           // from the start of the entry's blob
+  uint32_t storedSize;       // equal to size when the chunk is stored raw
+  uint32_t size;
+};
+
+// Mesh blobs are stored in GPU layout: header, Vertex[vertexCount], uint32_t[indexCount]
+constexpr uint32_t MESH_BLOB_MAGIC = 0x4853454d; // "MESH"
+
+struct MeshBlobHeader {
+  uint32_t magic;
+  uint32_t vertexStride;
+  uint32_t vertexCount;
+  uint32_t indexCount;
+};
+
+// Meshlet blobs are written by the packer next to a mesh blob, at the mesh's
+// path plus MESHLET_BLOB_SUFFIX: header, Meshlet[meshletCount] (see
+// Graphics/Meshlet.h), uint32_t[vertexCount] mesh vertex indices, then
+// triangleByteCount bytes of local triangle indices (a multiple of four)
+constexpr uint32_t MESHLET_BLOB_MAGIC = 0x54454c4d; // "MLET"
+constexpr const char* MESHLET_BLOB_SUFFIX = ".meshlets";
+
+struct MeshletBlobHeader {
+  uint32_t magic;
+  uint32_t meshletCount;
+  uint32_t vertexCount;
+  uint32_t triangleByteCount;
+};
+
+// LOD blobs are written next to a mesh blob like meshlet blobs, at the mesh's
+// path plus LOD_BLOB_SUFFIX: header, MeshLodLevel[levelCount] (see
+// Graphics/MeshLod.h), then uint32_t[indexCount] indices into the mesh's
+// vertices, level 0 first
+constexpr uint32_t LOD_BLOB_MAGIC = 0x53444f4c; // "LODS"
+constexpr const char* LOD_BLOB_SUFFIX = ".lods";
+
+struct LodBlobHeader {
+  uint32_t magic;
+  uint32_t levelCount;
+  uint32_t indexCount;
+  uint32_t reserved;
+};
+
+// Static batches are mesh blobs written by the packer's --static option: one
+// per material of a scene manifest, at the manifest's name plus
+// STATIC_BATCH_BLOB_SUFFIX plus the material number, with every instance's
+// vertices baked into world space (see mergeStaticGeometry() in
+// Graphics/Mesh.h). vertexStride is sizeof(Vertex).
+constexpr const char* STATIC_BATCH_BLOB_SUFFIX = ".batch";
+
+// Texture blobs hold pre-transcoded mips in upload layout: header,
+// TextureBlobMip[mipCount], then the mip data with mip 0 the largest
+constexpr uint32_t TEXTURE_BLOB_MAGIC = 0x58455454; // "TTEX"
+
+struct TextureBlobHeader {
+  uint32_t magic;
+  uint32_t format;           // VkFormat
+  uint32_t width;
+  uint32_t height;
+  uint32_t mipCount;
+  uint32_t reserved;
+};
+
+struct TextureBlobMip {
+  uint64_t offset;           // from the start of the blob
+  uint64_t size;
+};
+
+static_assert(sizeof(ArchiveHeader) == 48, "ArchiveHeader layout changed");
+static_assert(sizeof(ArchiveEntry) == 56, "ArchiveEntry layout changed");
+static_assert(sizeof(ArchiveChunk) == 16, "ArchiveChunk layout changed");
+static_assert(sizeof(MeshBlobHeader) == 16, "MeshBlobHeader layout changed");
+static_assert(sizeof(MeshletBlobHeader) == 16, "MeshletBlobHeader layout changed");
+static_assert(sizeof(LodBlobHeader) == 16, "LodBlobHeader layout changed");
+static_assert(sizeof(TextureBlobHeader) == 24, "TextureBlobHeader layout changed");
+static_assert(sizeof(TextureBlobMip) == 16, "TextureBlobMip layout changed");
+
+// Paths are hashed lower-case with forward slashes so lookups are platform independent
+std::string normalizeAssetPath(const std::string& path);
+uint64_t hashAssetPath(const std::string& path);
+
+} // namespace plaster
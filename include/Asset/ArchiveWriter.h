@@ -0,0 +1,32 @@
+#pragma once
+
+#include "Asset/ArchiveFormat.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace plaster {
+
+// Builds a .ppak archive in memory; used by the packer tool
+class ArchiveWriter {
+public:
+  void add(const std::string& path, std::vector<uint8_t> data, Compression compression = Compression::None);
+  void write(const std::string& outputPath) const;
+
+  size_t getEntryCount() const { return m_entries.size(); }
+
+private:
+  struct PendingEntry {
+    std::string path;
+    uint64_t pathHash;
+    std::vector<uint8_t> data;
+    Compression compression;
+  };
+
+  std::vector<PendingEntry> m_entries;
+
+  static std::vector<uint8_t> encode(const PendingEntry& entry, ArchiveEntry& tocEntry);
+};
+
+} // namespace plaster
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "Asset/ArchiveFormat.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace plaster {
+
+// Direct view of an uncompressed blob inside the mapping
+struct AssetView {
+  const uint8_t* data = nullptr;
+  size_t size = 0;
+
+  explicit operator bool() const { return data != nullptr; }
+};
+
+// Read-only, memory-mapped .ppak archive. Uncompressed entries are handed out
+// as pointers into the mapping, so they can be copied straight into a staging
+// buffer; compressed entries are decoded chunk by chunk directly into the
+// caller's memory.
+class AssetArchive {
+public:
+  explicit AssetArchive(const std::string& path);
+  ~AssetArchive();
+
+  AssetArchive(const AssetArchive&) = delete;
+  AssetArchive& operator=(const AssetArchive&) = delete;
+
+  const ArchiveEntry* find(const std::string& path) const;
+  const ArchiveEntry* find(uint64_t pathHash) const;
+
+  // Empty view for compressed entries, use read() for those
+  AssetView view(const ArchiveEntry& entry) const;
+
+  // Writes entry.size bytes to dst, decompressing if needed
+  bool read(const ArchiveEntry& entry, void* dst) const;
+
+  // Same as read(), for stored bytes that were fetched some other way
+  static bool decode(const ArchiveEntry& entry, const uint8_t* stored, void* dst);
+
+  bool verify(const ArchiveEntry& entry) const;
+
+  // Hints the OS to start paging the blob in ahead of use
+  void prefetch(const ArchiveEntry& entry) const;
+
+  const char* getName(const ArchiveEntry& entry) const;
+  uint32_t getEntryCount() const { return m_header ? m_header->entryCount : 0; }
+  const ArchiveEntry* getEntries() const { return m_entries; }
+  const std::string& getPath() const { return m_path; }
+
+private:
+  std::string m_path;
+  const uint8_t* m_data;
+  size_t m_size;
+  const ArchiveHeader* m_header;
+  const ArchiveEntry* m_entries;
+
+#ifdef _WIN32
+  void* m_fileHandle;
+  void* m_mappingHandle;
+#else
+  int m_fileDescriptor;
+#endif
+
+  void mapFile();
+  void unmapFile();
+  void validate();
+};
+
+} // namespace plaster
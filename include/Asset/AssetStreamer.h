@@ -0,0 +1,171 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace plaster {
+
+class JobSystem;
+class AssetArchive;
+struct ArchiveEntry;
+
+struct AssetHandle {
+  uint32_t index = UINT32_MAX;
+
+  bool isValid() const { return index != UINT32_MAX; }
+};
+
+enum class AssetState {
+  Unloaded,
+  Queued,
+  Loading,
+  Decoded,
+  Resident,
+  Failed
+};
+
+// Turns streamed bytes into a GPU resource. decode() runs on a worker
+// thread, upload() and evict() on the main thread. Resources are opaque
+// 64-bit ids chosen by the loader (a mesh id, an image index, ...).
+class AssetLoader {
+public:
+  virtual ~AssetLoader() = default;
+
+  virtual bool decode(std::vector<uint8_t>& data) = 0;
+  virtual uint64_t upload(const std::vector<uint8_t>& data, uint64_t& residentBytes) = 0;
+  virtual void evict(uint64_t resource) = 0;
+  virtual uint64_t getPlaceholder() const = 0;
+};
+
+struct StreamingStats {
+  uint32_t queued = 0;
+  uint32_t loading = 0;
+  uint32_t resident = 0;
+  uint64_t residentBytes = 0;
+  uint64_t budgetBytes = 0;
+  uint64_t bytesRead = 0;
+  uint32_t evictions = 0;
+};
+
+// Higher is more urgent. screenCoverage is the fraction of the screen the
+// object's bounds cover, distance is in world units from the camera.
+float computeStreamingPriority(float screenCoverage, float distance);
+
+// Streams archive entries in priority order. A dedicated thread does the
+// reads (io_uring when available, pread/ReadFile otherwise), decoding runs on
+// the job system, and uploads happen in update() under a per-frame byte cap.
+// Resident data is kept under a VRAM budget by evicting the least recently
+// resolved assets that no frame in flight can still reference.
+//
+// Loaders are borrowed: the owner calls shutdown() while they are still
+// alive. The destructor never calls into a loader; resident assets left
+// then are reported and leaked.
+class AssetStreamer {
+public:
+  AssetStreamer(JobSystem* jobSystem, uint64_t vramBudget, uint32_t framesInFlight);
+  ~AssetStreamer();
+
+  AssetStreamer(const AssetStreamer&) = delete;
+  AssetStreamer& operator=(const AssetStreamer&) = delete;
+
+  // Later mounts take precedence over earlier ones
+  void mountArchive(const std::string& path);
+
+  AssetHandle request(const std::string& path, AssetLoader* loader, float priority);
+  void setPriority(AssetHandle handle, float priority);
+
+  // Resource id if resident, the loader's placeholder otherwise. Marks the
+  // asset as used this frame and re-queues it if it had been evicted.
+  uint64_t resolve(AssetHandle handle);
+  AssetState getState(AssetHandle handle) const;
+
+  void update(uint64_t frameNumber);
+  void evictAll();
+  // Stops reads and decodes and evicts everything through the loaders. Call
+  // once the GPU is idle; nothing may be requested afterwards.
+  void shutdown();
+
+  void setVramBudget(uint64_t bytes) { m_vramBudget = bytes; }
+  void setUploadBytesPerFrame(uint64_t bytes) { m_uploadBytesPerFrame = bytes; }
+  StreamingStats getStats() const;
+
+private:
+  struct MountedArchive;
+  struct IoBackend;
+
+  struct Asset {
+    std::string path;
+    AssetLoader* loader;
+    uint32_t archive;
+    const ArchiveEntry* entry;
+    AssetState state;
+    bool resident;             // main-thread copy of state == Resident, read without locking
+    float priority;
+    uint64_t requestSequence;
+    uint64_t resource;
+    uint64_t residentBytes;
+    uint64_t lastUsedFrame;
+    std::list<uint32_t>::iterator lruPosition;
+  };
+
+  struct ReadRequest {
+    float priority;
+    uint64_t sequence;
+    uint32_t asset;
+
+    bool operator<(const ReadRequest& other) const {
+      // Max-heap on priority, FIFO among equals
+      if (priority != other.priority) return priority < other.priority;
+      return sequence > other.sequence;
+    }
+  };
+
+  struct DecodedAsset {
+    uint32_t asset;
+    float priority;
+    std::vector<uint8_t> data;
+  };
+
+  JobSystem* m_jobSystem;
+  std::vector<std::unique_ptr<MountedArchive>> m_archives;
+  std::unique_ptr<IoBackend> m_io;
+
+  std::vector<Asset> m_assets;
+  std::priority_queue<ReadRequest> m_readQueue;
+  std::vector<DecodedAsset> m_decoded;
+  std::vector<DecodedAsset> m_pendingUploads;
+  std::list<uint32_t> m_lru;
+
+  mutable std::mutex m_mutex;
+  std::condition_variable m_condition;
+  std::thread m_ioThread;
+  bool m_stopping;
+  std::atomic<uint32_t> m_decodesInFlight;
+  std::atomic<uint64_t> m_bytesRead;
+
+  uint64_t m_sequence;
+  uint64_t m_frameNumber;
+  uint64_t m_vramBudget;
+  uint64_t m_residentBytes;
+  uint64_t m_uploadBytesPerFrame;
+  uint32_t m_framesInFlight;
+  uint32_t m_evictions;
+
+  void stopWorkers();
+  void enqueueLocked(uint32_t asset);
+  void ioThreadLoop();
+  bool popReadLocked(uint32_t& asset, uint32_t& archive, uint64_t& offset, uint64_t& size);
+  void onReadComplete(uint32_t asset, std::vector<uint8_t> stored, bool success);
+  void evictAsset(uint32_t asset);
+  void enforceBudget();
+};
+
+} // namespace plaster
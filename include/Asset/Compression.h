@@ -0,0 +1,18 @@
+#pragma once
+
+#include "Asset/ArchiveFormat.h"
+
+#include <cstddef>
+#include <vector>
+
+namespace plaster {
+
+bool isCompressionSupported(Compression compression);
+
+// Appends the compressed form of src to dst and returns the number of bytes
+// written, or 0 if the codec is unavailable or the data did not shrink
+size_t compressChunk(Compression compression, const void* src, size_t srcSize, std::vector<uint8_t>& dst);
+
+bool decompressChunk(Compression compression, const void* src, size_t srcSize, void* dst, size_t dstSize);
+
+} // namespace plaster
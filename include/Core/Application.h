@@ -1,10 +1,18 @@
 #pragma once
 
+#include <cstdint>
+#include <string>
+
 namespace plaster {
 
 class Window;
 class VulkanContext;
 class Renderer;
+class JobSystem;
+class AssetStreamer;
+class MeshLoader;
+class Animator;
+class PhysicsWorld;
 
 class Application {
 public:
@@ -13,10 +21,28 @@ public:
 
   void run();
 
+  JobSystem* getJobSystem() { return m_jobSystem; }
+  AssetStreamer* getAssetStreamer() { return m_assetStreamer; }
+  // Pass to AssetStreamer::request() for mesh blobs; resolves to draw batcher mesh ids
+  MeshLoader* getMeshLoader() { return m_meshLoader; }
+  Animator* getAnimator() { return m_animator; }
+  PhysicsWorld* getPhysicsWorld() { return m_physicsWorld; }
+  Renderer* getRenderer() { return m_renderer; }
+
 private:
   Window* m_window;
   VulkanContext* m_vulkanContext;
   Renderer* m_renderer;
+  JobSystem* m_jobSystem;
+  AssetStreamer* m_assetStreamer;
+  MeshLoader* m_meshLoader;
+  Animator* m_animator;
+  PhysicsWorld* m_physicsWorld;
+  uint64_t m_frameNumber;
+  float m_physicsTime;          // frame time not yet simulated
+  std::string m_metricsPath;
+
+  void writeMetrics();
 };
 
 } // namespace plaster
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace plaster {
+
+// Bump allocator over a list of chunks. Nothing is freed individually;
+// reset() rewinds to the first chunk and keeps every chunk for reuse, so
+// after warm-up an arena allocates from the heap only when a frame needs
+// more than any frame before it.
+class LinearArena {
+public:
+  explicit LinearArena(size_t chunkSize = 256 * 1024);
+  ~LinearArena();
+
+  LinearArena(const LinearArena&) = delete;
+  LinearArena& operator=(const LinearArena&) = delete;
+
+  void* allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+  void reset();
+
+  size_t getUsed() const { return m_used; }
+  size_t getPeak() const { return m_peak; }
+  size_t getCapacity() const { return m_capacity; }
+  uint32_t getChunkCount() const { return static_cast<uint32_t>(m_chunks.size()); }
+
+private:
+  struct Chunk {
+    char* data;
+    size_t size;
+  };
+
+  std::vector<Chunk> m_chunks;
+  size_t m_chunkSize;
+  uint32_t m_current;
+  size_t m_offset;
+  size_t m_used;        // including alignment padding and skipped chunk tails
+  size_t m_peak;
+  size_t m_capacity;
+};
+
+struct FrameArenaStats {
+  uint32_t threadCount = 0;
+  size_t usedBytes = 0;       // summed over threads, each for the last frame it reset
+  size_t peakBytes = 0;
+  size_t capacityBytes = 0;
+  uint32_t chunkCount = 0;
+};
+
+// Per-thread LinearArenas, one per frame in flight, for data that only has
+// to live as long as the frame it was made for. A thread's arena for a frame
+// is reset the first time that thread allocates in it, which beginFrame()
+// guarantees is after the frame that last used it has retired. Any thread,
+// including job workers, can allocate without locking.
+class FrameArena {
+public:
+  static const uint32_t MAX_FRAMES_IN_FLIGHT = 4;
+
+  // After waiting on the fence of frameNumber - framesInFlight
+  static void beginFrame(uint64_t frameNumber, uint32_t framesInFlight);
+
+  // The calling thread's arena for the current frame
+  static LinearArena& get();
+  static void* allocate(size_t size, size_t alignment = alignof(std::max_align_t)) {
+    return get().allocate(size, alignment);
+  }
+
+  static FrameArenaStats getStats();
+};
+
+// STL allocator over a LinearArena, the calling thread's frame arena by
+// default. deallocate() is a no-op, so containers that grow leave their old
+// storage behind until the reset; reserve() when the size is known.
+template <typename T>
+class ArenaAllocator {
+public:
+  using value_type = T;
+
+  ArenaAllocator() : m_arena(&FrameArena::get()) {}
+  explicit ArenaAllocator(LinearArena* arena) : m_arena(arena) {}
+  template <typename U>
+  ArenaAllocator(const ArenaAllocator<U>& other) : m_arena(other.getArena()) {}
+
+  T* allocate(size_t count) { return static_cast<T*>(m_arena->allocate(count * sizeof(T), alignof(T))); }
+  void deallocate(T*, size_t) {}
+
+  LinearArena* getArena() const { return m_arena; }
+
+private:
+  LinearArena* m_arena;
+};
+
+template <typename T, typename U>
+bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) { return a.getArena() == b.getArena(); }
+template <typename T, typename U>
+bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) { return a.getArena() != b.getArena(); }
+
+// Scratch vector valid until the end of the frame it was created in
+template <typename T>
+using FrameVector = std::vector<T, ArenaAllocator<T>>;
+
+} // namespace plaster
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+namespace plaster {
+
+// 64-bit FNV-1a, used for cache keys that need to be stable across runs
+constexpr uint64_t FNV_OFFSET_BASIS = 0xcbf29ce484222325ull;
+constexpr uint64_t FNV_PRIME = 0x100000001b3ull;
+
+inline uint64_t hashBytes(const void* data, size_t size, uint64_t seed = FNV_OFFSET_BASIS) {
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  uint64_t hash = seed;
+  for (size_t i = 0; i < size; ++i) {
+    hash ^= bytes[i];
+    hash *= FNV_PRIME;
+  }
+  return hash;
+}
+
+inline uint64_t hashString(const std::string& str, uint64_t seed = FNV_OFFSET_BASIS) {
+  return hashBytes(str.data(), str.size(), seed);
+}
+
+template <typename T>
+inline uint64_t hashValue(const T& value, uint64_t seed = FNV_OFFSET_BASIS) {
+  return hashBytes(&value, sizeof(T), seed);
+}
+
+// xxHash64, used for content checksums where FNV-1a would be too slow
+inline uint64_t xxHash64(const void* data, size_t size, uint64_t seed = 0) {
+  const uint64_t PRIME1 = 0x9e3779b185ebca87ull;
+  const uint64_t PRIME2 = 0xc2b2ae3d27d4eb4full;
+  const uint64_t PRIME3 = 0x165667b19e3779f9ull;
+  const uint64_t PRIME4 = 0x85ebca77c2b2ae63ull;
+  const uint64_t PRIME5 = 0x27d4eb2f165667c5ull;
+
+  auto rotl = [](uint64_t x, int r) { return (x << r) | (x >> (64 - r)); };
+  auto read64 = [](const uint8_t* p) { uint64_t v; std::memcpy(&v, p, 8); return v; };
+  auto read32 = [](const uint8_t* p) { uint32_t v; std::memcpy(&v, p, 4); return v; };
+  auto round = [&](uint64_t acc, uint64_t input) {
+    acc += input * PRIME2;
+    acc = rotl(acc, 31);
+    return acc * PRIME1;
+  };
+  auto mergeRound = [&](uint64_t acc, uint64_t value) {
+    acc ^= round(0, value);
+    return acc * PRIME1 + PRIME4;
+  };
+
+  const uint8_t* p = static_cast<const uint8_t*>(data);
+  const uint8_t* end = p + size;
+  uint64_t hash;
+
+  if (size >= 32) {
+    uint64_t v1 = seed + PRIME1 + PRIME2;
+    uint64_t v2 = seed + PRIME2;
+    uint64_t v3 = seed;
+    uint64_t v4 = seed - PRIME1;
+    const uint8_t* limit = end - 32;
+    do {
+      v1 = round(v1, read64(p));
+      v2 = round(v2, read64(p + 8));
+      v3 = round(v3, read64(p + 16));
+      v4 = round(v4, read64(p + 24));
+      p += 32;
+    } while (p <= limit);
+
+    hash = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+    hash = mergeRound(hash, v1);
+    hash = mergeRound(hash, v2);
+    hash = mergeRound(hash, v3);
+    hash = mergeRound(hash, v4);
+  } else {
+    hash = seed + PRIME5;
+  }
+
+  hash += static_cast<uint64_t>(size);
+
+  while (p + 8 <= end) {
+    hash ^= round(0, read64(p));
+    hash = rotl(hash, 27) * PRIME1 + PRIME4;
+    p += 8;
+  }
+  if (p + 4 <= end) {
+    hash ^= static_cast<uint64_t>(read32(p)) * PRIME1;
+    hash = rotl(hash, 23) * PRIME2 + PRIME3;
+    p += 4;
+  }
+  while (p < end) {
+    hash ^= (*p) * PRIME5;
+    hash = rotl(hash, 11) * PRIME1;
+    ++p;
+  }
+
+  hash ^= hash >> 33;
+  hash *= PRIME2;
+  hash ^= hash >> 29;
+  hash *= PRIME3;
+  hash ^= hash >> 32;
+  return hash;
+}
+
+inline uint64_t hashCombine(uint64_t seed, uint64_t value) {
+  return seed ^ (value + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2));
+}
+
+} // namespace plaster
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace plaster {
+
+// Fixed pool of worker threads shared by engine systems
+class JobSystem {
+public:
+  explicit JobSystem(uint32_t workerCount = 0);
+  ~JobSystem();
+
+  JobSystem(const JobSystem&) = delete;
+  JobSystem& operator=(const JobSystem&) = delete;
+
+  void schedule(std::function<void()> job);
+
+  // Splits [0, count) into batches and blocks until all have run. The calling
+  // thread takes batches too, so this is safe to call from a worker.
+  void parallelFor(uint32_t count, uint32_t batchSize, const std::function<void(uint32_t begin, uint32_t end)>& fn);
+
+  uint32_t getWorkerCount() const { return static_cast<uint32_t>(m_workers.size()); }
+
+private:
+  std::vector<std::thread> m_workers;
+  std::deque<std::function<void()>> m_jobs;
+  std::mutex m_mutex;
+  std::condition_variable m_condition;
+  bool m_stopping;
+
+  void workerLoop();
+  bool runPendingJob();
+};
+
+} // namespace plaster
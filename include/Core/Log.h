@@ -0,0 +1,26 @@
+#pragma once
+
+#include <string>
+
+namespace plaster {
+
+enum class LogLevel {
+  Verbose,
+  Info,
+  Warning,
+  Error
+};
+
+// Engine-wide log sink. Lines are written whole, so threads can log freely;
+// warnings and errors go to stderr, everything else to stdout.
+void logMessage(LogLevel level, const char* channel, const std::string& message);
+
+// Messages below this level are dropped (Info by default)
+void setLogLevel(LogLevel minimum);
+
+inline void logVerbose(const char* channel, const std::string& message) { logMessage(LogLevel::Verbose, channel, message); }
+inline void logInfo(const char* channel, const std::string& message) { logMessage(LogLevel::Info, channel, message); }
+inline void logWarning(const char* channel, const std::string& message) { logMessage(LogLevel::Warning, channel, message); }
+inline void logError(const char* channel, const std::string& message) { logMessage(LogLevel::Error, channel, message); }
+
+} // namespace plaster
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+namespace plaster {
+
+// Metrics are registered by name through Metrics and live until exit, so
+// call sites keep the reference, typically in a function-local static:
+//
+//   static Counter& uploads = Metrics::counter("upload.mesh_bytes", "bytes");
+//   uploads.add(size);
+//
+// Updates are relaxed atomics and safe from any thread.
+
+class Counter {
+public:
+  void add(uint64_t amount = 1) { m_value.fetch_add(amount, std::memory_order_relaxed); }
+  uint64_t get() const { return m_value.load(std::memory_order_relaxed); }
+
+private:
+  std::atomic<uint64_t> m_value{0};
+};
+
+class Gauge {
+public:
+  void set(double value) { m_value.store(value, std::memory_order_relaxed); }
+  double get() const { return m_value.load(std::memory_order_relaxed); }
+
+private:
+  std::atomic<double> m_value{0.0};
+};
+
+// Log-linear buckets in the manner of HdrHistogram: exact below 16, then 16
+// buckets per power of two, so a recorded value is reported within 1/16 of
+// itself. Values of 2^40 and above land in the last bucket.
+class Histogram {
+public:
+  static const uint32_t SUB_BUCKET_BITS = 4;
+  static const uint32_t MAX_VALUE_BITS = 40;
+  static const uint32_t BUCKET_COUNT = (MAX_VALUE_BITS - SUB_BUCKET_BITS + 1) << SUB_BUCKET_BITS;
+
+  Histogram();
+
+  Histogram(const Histogram&) = delete;
+  Histogram& operator=(const Histogram&) = delete;
+
+  void record(uint64_t value);
+
+  uint64_t getCount() const { return m_count.load(std::memory_order_relaxed); }
+  uint64_t getSum() const { return m_sum.load(std::memory_order_relaxed); }
+  uint64_t getMax() const { return m_max.load(std::memory_order_relaxed); }
+  // Copies BUCKET_COUNT counts; concurrent records may or may not be included
+  void copyBuckets(uint64_t* counts) const;
+
+  static uint32_t bucketIndex(uint64_t value);
+  // The highest value that falls into the bucket
+  static uint64_t bucketValue(uint32_t index);
+  // Over copied counts; 0 when they are all empty
+  static uint64_t percentile(const uint64_t* counts, double fraction);
+
+private:
+  std::atomic<uint64_t> m_buckets[BUCKET_COUNT];
+  std::atomic<uint64_t> m_count;
+  std::atomic<uint64_t> m_sum;
+  std::atomic<uint64_t> m_max;
+};
+
+// Records the microseconds between construction and destruction
+class ScopedTimer {
+public:
+  explicit ScopedTimer(Histogram& histogram)
+      : m_histogram(histogram), m_start(std::chrono::steady_clock::now()) {}
+  ~ScopedTimer() {
+    m_histogram.record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+                                                 std::chrono::steady_clock::now() - m_start)
+                                                 .count()));
+  }
+
+  ScopedTimer(const ScopedTimer&) = delete;
+  ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+private:
+  Histogram& m_histogram;
+  std::chrono::steady_clock::time_point m_start;
+};
+
+enum class MetricType {
+  Counter,
+  Gauge,
+  Histogram
+};
+
+struct MetricSnapshot {
+  const std::string* name;
+  const std::string* unit;
+  MetricType type;
+  double value;   // counter total, gauge value, histogram sample count
+  // Histograms only, over every sample so far
+  double mean;
+  double p50;
+  double p90;
+  double p99;
+  double max;
+  // One sample per collect(): the counter's increase, the gauge's value or the
+  // p99 of the histogram's new samples. Oldest first starting at historyOffset.
+  const float* history;
+  uint32_t historyCount;
+  uint32_t historyOffset;
+};
+
+// Process-wide registry. collect() turns the live values into per-frame
+// history; it, forEach() and the writers run on one thread (the main thread).
+class Metrics {
+public:
+  static const uint32_t HISTORY_LENGTH = 300;
+
+  // Returns the existing metric for a known name; throws if it has another type
+  static Counter& counter(const std::string& name, const std::string& unit = "");
+  static Gauge& gauge(const std::string& name, const std::string& unit = "");
+  static Histogram& histogram(const std::string& name, const std::string& unit = "us");
+
+  // Once per frame
+  static void collect();
+  static uint64_t getCollectCount();
+
+  // In registration order. fn must not register metrics.
+  static void forEach(const std::function<void(const MetricSnapshot&)>& fn);
+
+  // Summaries as of the last collect(); JSON includes the history. Throws on I/O errors.
+  static void writeCsv(const std::string& path);
+  static void writeJson(const std::string& path);
+  // CSV for a .csv path, JSON otherwise
+  static void write(const std::string& path);
+};
+
+} // namespace plaster
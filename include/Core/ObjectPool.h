@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace plaster {
+
+// Fixed-size slots for one type, carved from blocks of BlockSize and linked
+// through a free list, for objects that are created and destroyed at a high
+// rate. Slots are never returned to the heap until the pool is destroyed,
+// which must happen after every object has been destroyed. Not thread-safe.
+template <typename T, uint32_t BlockSize = 64>
+class ObjectPool {
+public:
+  ObjectPool() : m_freeList(nullptr), m_liveCount(0) {}
+
+  ObjectPool(const ObjectPool&) = delete;
+  ObjectPool& operator=(const ObjectPool&) = delete;
+
+  template <typename... Args>
+  T* create(Args&&... args) {
+    if (!m_freeList) {
+      grow();
+    }
+    // Unlinked before constructing, since the object overwrites the link; a
+    // throwing constructor hands the slot back
+    Slot* slot = m_freeList;
+    m_freeList = slot->next;
+    T* object;
+    try {
+      object = new (slot->storage) T(std::forward<Args>(args)...);
+    } catch (...) {
+      slot->next = m_freeList;
+      m_freeList = slot;
+      throw;
+    }
+    ++m_liveCount;
+    return object;
+  }
+
+  void destroy(T* object) {
+    if (!object) {
+      return;
+    }
+    object->~T();
+    Slot* slot = reinterpret_cast<Slot*>(object);
+    slot->next = m_freeList;
+    m_freeList = slot;
+    --m_liveCount;
+  }
+
+  uint32_t getLiveCount() const { return m_liveCount; }
+  uint32_t getCapacity() const { return static_cast<uint32_t>(m_blocks.size()) * BlockSize; }
+
+private:
+  union Slot {
+    Slot* next;
+    alignas(T) unsigned char storage[sizeof(T)];
+  };
+
+  std::vector<std::unique_ptr<Slot[]>> m_blocks;
+  Slot* m_freeList;
+  uint32_t m_liveCount;
+
+  void grow() {
+    m_blocks.push_back(std::make_unique<Slot[]>(BlockSize));
+    Slot* block = m_blocks.back().get();
+    for (uint32_t i = 0; i < BlockSize; ++i) {
+      block[i].next = i + 1 < BlockSize ? &block[i + 1] : m_freeList;
+    }
+    m_freeList = block;
+  }
+};
+
+} // namespace plaster
@@ -0,0 +1,8 @@
+#pragma once
+
+// SSE2 is part of x86-64 and opt-in on 32-bit x86. Code with a PLASTER_SSE2
+// path keeps a scalar one for every other target.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define PLASTER_SSE2 1
+#endif
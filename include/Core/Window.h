@@ -17,8 +17,14 @@ public:
   void waitEvents();
 
   GLFWwindow* getHandle() const { return m_window; }
+  // Framebuffer size in pixels, kept current by the resize callback
   uint32_t getWidth() const { return m_width; }
   uint32_t getHeight() const { return m_height; }
+  void setSize(uint32_t width, uint32_t height);
+
+  // Set when the framebuffer changes size, cleared by the swapchain owner
+  bool wasResized() const { return m_resized; }
+  void clearResized() { m_resized = false; }
   
   void toggleFullscreen();
   bool isFullscreen() const { return m_isFullscreen; }
@@ -28,6 +34,9 @@ private:
   uint32_t m_width;
   uint32_t m_height;
   bool m_isFullscreen = false;
+  bool m_resized = false;
+
+  static void FramebufferSizeCallback(GLFWwindow* window, int width, int height);
 };
 
 } // namespace plaster
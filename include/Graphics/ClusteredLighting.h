@@ -0,0 +1,160 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <glm/glm.hpp>
+#include "Graphics/PipelineManager.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace plaster {
+
+class VulkanContext;
+class DeletionQueue;
+class DescriptorAllocator;
+class UniformRing;
+class ShadowCascades;
+
+// Froxel grid: screen tiles by exponential depth slices. Mirrored in shaders/lighting.glsl.
+static const uint32_t LIGHT_CLUSTERS_X = 16;
+static const uint32_t LIGHT_CLUSTERS_Y = 9;
+static const uint32_t LIGHT_CLUSTERS_Z = 24;
+static const uint32_t LIGHT_CLUSTER_COUNT = LIGHT_CLUSTERS_X * LIGHT_CLUSTERS_Y * LIGHT_CLUSTERS_Z;
+
+enum class LightType : uint32_t {
+  Point,
+  Spot
+};
+
+struct Light {
+  LightType type = LightType::Point;
+  glm::vec3 position = glm::vec3(0.0f);
+  glm::vec3 color = glm::vec3(1.0f);                      // linear
+  float intensity = 1.0f;
+  float range = 10.0f;                                    // falls off to nothing at this distance
+  glm::vec3 direction = glm::vec3(0.0f, -1.0f, 0.0f);     // spot lights only, need not be normalized
+  float innerAngle = 0.4f;                                // half angles in radians; full intensity inside
+  float outerAngle = 0.6f;                                // the inner cone, none outside the outer one
+};
+
+struct LightingSettings {
+  glm::vec3 sunDirection = glm::vec3(0.4f, 1.0f, 0.3f);   // toward the sun
+  glm::vec3 sunColor = glm::vec3(0.8f);
+  glm::vec3 ambientColor = glm::vec3(0.2f);
+  // View depths the slices span. Everything nearer than nearDepth falls in
+  // the first slice; nothing beyond farDepth receives clustered lights.
+  float nearDepth = 0.5f;
+  float farDepth = 400.0f;
+  // Lights past this many in a cluster are dropped, bounding the cost of a pixel
+  uint32_t maxClusterLights = 128;
+  // Tints the scene by each pixel's cluster light count, red at heatmapScale lights
+  bool heatmap = false;
+  float heatmapScale = 32.0f;
+};
+
+// Counted by the binning pass, read back MAX_FRAMES_IN_FLIGHT frames late
+// except lightCount and visibleLights, which are this frame's
+struct LightingStats {
+  uint32_t lightCount = 0;
+  uint32_t visibleLights = 0;        // binned: inside the view frustum and nearer than farDepth
+  uint32_t lightIndices = 0;         // entries of all clusters' light lists
+  uint32_t occupiedClusters = 0;     // with at least one light
+  uint32_t maxClusterLights = 0;
+  uint32_t overflowedClusters = 0;   // lost lights to maxClusterLights or a full index buffer
+};
+
+// Clustered forward shading. The view frustum is split into a grid of
+// froxels and every frame a compute pass bins the visible point and spot
+// lights into them: each invocation builds one cluster's view space bounds
+// and tests them against every light's bounding sphere, 64 lights at a time
+// from shared memory. It counts its lights, reserves room in one compact
+// index buffer with a single atomic add, then writes them, so a cluster's
+// list is a range of that buffer. mesh.frag finds its pixel's cluster from
+// the screen position and view depth and loops over only those lights.
+//
+// Lights are culled against the view frustum on the CPU and streamed through
+// the uniform ring every frame, so they can all move freely. The sun is
+// shadowed by ShadowCascades, whose atlas and cascade matrices travel in the
+// shading set too. Settings are read by update(); change them on the main
+// thread.
+class ClusteredLighting {
+public:
+  // lightCapacity bounds the lights binned per frame, indexCapacity the
+  // entries of all clusters' lists together. shadows must be updated before
+  // update() and recorded before the scene pass.
+  ClusteredLighting(VulkanContext* vulkanContext, PipelineManager* pipelineManager, DeletionQueue* deletionQueue,
+                    UniformRing* uniformRing, const ShadowCascades* shadows, uint32_t framesInFlight,
+                    uint32_t lightCapacity, uint32_t indexCapacity);
+  ~ClusteredLighting();
+
+  ClusteredLighting(const ClusteredLighting&) = delete;
+  ClusteredLighting& operator=(const ClusteredLighting&) = delete;
+
+  uint32_t addLight(const Light& light);
+  void setLight(uint32_t light, const Light& value);
+  const Light& getLight(uint32_t light) const { return m_lights[light]; }
+  // Its id is handed out again by a later addLight()
+  void removeLight(uint32_t light);
+
+  // On the main thread once per frame, after the uniform ring's beginFrame()
+  // and once the frame's fence has been waited on
+  void update(uint32_t frameIndex, const glm::mat4& view, const glm::mat4& projection);
+  // Binning, outside any render pass and before the scene pass
+  void record(VkCommandBuffer commandBuffer, uint32_t frameIndex, DescriptorAllocator* descriptorAllocator);
+
+  // Set SHADING_SET of mesh.frag for this frame, bound at getShadingOffset();
+  // valid once record() has run
+  VkDescriptorSet getShadingSet() const { return m_shadingSet; }
+  uint32_t getShadingOffset() const { return m_constantsOffset; }
+
+  LightingSettings& getSettings() { return m_settings; }
+  const LightingStats& getStats() const { return m_stats; }
+
+  static const uint32_t SHADING_SET = 3;
+
+private:
+  struct StorageBuffer {
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize size = 0;
+  };
+
+  struct Readback {
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    const void* mapped = nullptr;
+    bool written = false;
+  };
+
+  VulkanContext* m_vulkanContext;
+  PipelineManager* m_pipelineManager;
+  DeletionQueue* m_deletionQueue;
+  UniformRing* m_uniformRing;
+  const ShadowCascades* m_shadows;
+  PipelineHandle m_binPipeline;
+  LightingSettings m_settings;
+  LightingStats m_stats;
+  uint32_t m_lightCapacity;
+  uint32_t m_indexCapacity;
+
+  std::vector<Light> m_lights;
+  std::vector<bool> m_lightActive;
+  std::vector<uint32_t> m_freeLights;
+
+  StorageBuffer m_state;      // counters
+  StorageBuffer m_clusters;   // first index and light count per cluster
+  StorageBuffer m_indices;
+  std::vector<Readback> m_readbacks;   // per frame in flight
+
+  // Written by update() for the next record()
+  bool m_bin;
+  uint32_t m_constantsOffset;
+  uint32_t m_lightsOffset;
+  uint32_t m_boundsOffset;
+  uint32_t m_visibleCount;
+  VkDescriptorSetLayout m_shadingLayout;
+  VkDescriptorSet m_shadingSet;
+
+  StorageBuffer createStorageBuffer(VkDeviceSize size, VkBufferUsageFlags usage, const char* name);
+};
+
+} // namespace plaster
@@ -0,0 +1,66 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+
+namespace plaster {
+
+class VulkanContext;
+
+// Defers destroying Vulkan objects until no submitted frame can still use
+// them. Everything released is tagged with the most recent frame that has
+// been or is being recorded, and destroyed in a batch by collect() once that
+// frame's fence has signaled. Runtime changes like texture residency,
+// render target resizes and shader reloads therefore never wait for the
+// device to go idle. Work submitted outside the frame loop must be
+// submitted before the frame it is tagged with, or waited on.
+//
+// release() may be called from any thread; null handles are ignored.
+class DeletionQueue {
+public:
+  DeletionQueue(VulkanContext* vulkanContext);
+  // Destroys whatever is still queued; the device must be idle
+  ~DeletionQueue();
+
+  DeletionQueue(const DeletionQueue&) = delete;
+  DeletionQueue& operator=(const DeletionQueue&) = delete;
+
+  // Releases from now on wait for frameNumber to complete
+  void beginFrame(uint64_t frameNumber);
+  // Destroys everything tagged with completedFrame or earlier
+  void collect(uint64_t completedFrame);
+  // Destroys everything; the device must be idle
+  void flush();
+
+  void release(VkBuffer buffer);
+  void release(VkImage image);
+  void release(VkImageView view);
+  void release(VkDeviceMemory memory);
+  void release(VkPipeline pipeline);
+  void release(VkShaderModule module);
+  void release(VkFramebuffer framebuffer);
+  void release(VkSampler sampler);
+  // In an order that is valid to destroy in
+  void release(VkImage image, VkDeviceMemory memory, VkImageView view);
+  void release(VkBuffer buffer, VkDeviceMemory memory);
+
+  size_t getPendingCount() const;
+
+private:
+  struct Entry {
+    VkObjectType type;
+    uint64_t handle;
+    uint64_t frameNumber;
+  };
+
+  VulkanContext* m_vulkanContext;
+  mutable std::mutex m_mutex;
+  std::deque<Entry> m_entries;   // in release order, so frame numbers never decrease
+  uint64_t m_frameNumber;
+
+  void push(VkObjectType type, uint64_t handle);
+  void destroy(const Entry& entry);
+};
+
+} // namespace plaster
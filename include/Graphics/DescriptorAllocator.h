@@ -0,0 +1,83 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <cstdint>
+#include <initializer_list>
+#include <unordered_map>
+
+namespace plaster {
+
+class VulkanContext;
+
+struct DescriptorBinding {
+  uint32_t binding = 0;
+  VkDescriptorType type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+  VkDescriptorBufferInfo bufferInfo{};
+  VkDescriptorImageInfo imageInfo{};
+
+  static DescriptorBinding buffer(uint32_t binding, VkDescriptorType type, VkBuffer buffer,
+                                  VkDeviceSize offset, VkDeviceSize range);
+  static DescriptorBinding image(uint32_t binding, VkDescriptorType type, VkImageView view,
+                                 VkSampler sampler, VkImageLayout layout);
+};
+
+// Hands out descriptor sets from per-frame-in-flight pool chains. Sets from
+// allocate() live until the same frame index comes around again, at which
+// point beginFrame() resets every pool of that frame in one call. Sets that
+// never change are cached by layout + binding hash in a chain that is never reset.
+class DescriptorAllocator {
+public:
+  DescriptorAllocator(VulkanContext* vulkanContext, uint32_t framesInFlight);
+  ~DescriptorAllocator();
+
+  DescriptorAllocator(const DescriptorAllocator&) = delete;
+  DescriptorAllocator& operator=(const DescriptorAllocator&) = delete;
+
+  // Must be called once the fence of frameIndex has been waited on
+  void beginFrame(uint32_t frameIndex);
+
+  VkDescriptorSet allocate(VkDescriptorSetLayout layout);
+  VkDescriptorSet allocate(VkDescriptorSetLayout layout, const DescriptorBinding* bindings, uint32_t count);
+  // Brace lists pick this overload and never touch the heap
+  VkDescriptorSet allocate(VkDescriptorSetLayout layout, std::initializer_list<DescriptorBinding> bindings) {
+    return allocate(layout, bindings.begin(), static_cast<uint32_t>(bindings.size()));
+  }
+  VkDescriptorSet allocate(VkDescriptorSetLayout layout, const std::vector<DescriptorBinding>& bindings) {
+    return allocate(layout, bindings.data(), static_cast<uint32_t>(bindings.size()));
+  }
+
+  VkDescriptorSet getImmutable(VkDescriptorSetLayout layout, const std::vector<DescriptorBinding>& bindings);
+
+  // Caller must guarantee no cached set is still referenced by the GPU
+  void clearImmutableCache();
+
+  uint32_t getPoolCount() const;
+  uint32_t getFrameSetCount() const { return m_frameSetCount; }
+
+private:
+  struct PoolChain {
+    std::vector<VkDescriptorPool> usedPools;
+    std::vector<VkDescriptorPool> freePools;
+    VkDescriptorPool current = VK_NULL_HANDLE;
+    uint32_t setsPerPool = 0;
+  };
+
+  VulkanContext* m_vulkanContext;
+  std::vector<PoolChain> m_frameChains;
+  PoolChain m_immutableChain;
+  std::unordered_map<uint64_t, VkDescriptorSet> m_immutableSets;
+  uint32_t m_currentFrame;
+  uint32_t m_frameSetCount;
+
+  static const uint32_t INITIAL_SETS_PER_POOL = 128;
+  static const uint32_t MAX_SETS_PER_POOL = 4096;
+
+  VkDescriptorSet allocateFromChain(PoolChain& chain, VkDescriptorSetLayout layout);
+  VkDescriptorPool createPool(uint32_t maxSets);
+  void resetChain(PoolChain& chain);
+  void destroyChain(PoolChain& chain);
+  void writeSet(VkDescriptorSet set, const DescriptorBinding* bindings, uint32_t count);
+  static uint64_t hashBindings(VkDescriptorSetLayout layout, const std::vector<DescriptorBinding>& bindings);
+};
+
+} // namespace plaster
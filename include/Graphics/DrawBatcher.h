@@ -0,0 +1,120 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include <cstdint>
+
+#include "Graphics/Mesh.h"
+#include "Graphics/PipelineManager.h"
+
+namespace plaster {
+
+class VulkanContext;
+
+struct DrawItem {
+  uint64_t sortKey;
+  glm::mat4 transform;
+};
+
+// Pushed whenever the material changes, see mesh.frag
+struct MaterialConstants {
+  glm::vec4 baseColor;
+};
+
+// One instanced draw covering a run of identical pipeline + material + mesh
+struct DrawBatch {
+  uint32_t pipeline;
+  uint32_t material;
+  uint32_t mesh;
+  uint32_t firstInstance;
+  uint32_t instanceCount;
+};
+
+// Collects per-object draws, sorts them by a 64-bit key with a radix sort and
+// collapses runs of the same mesh + material into instanced draws. Per-instance
+// transforms are streamed into a persistently mapped per-frame instance buffer.
+//
+// Pipelines it draws follow the mesh shader interface: the frame constants
+// at FRAME_SET, the material's descriptor set at MATERIAL_SET, the clustered
+// lights at LIGHT_SET when a pipeline manager pipeline's layout has that set
+// and, when the layout has push constants, MaterialConstants.
+class DrawBatcher {
+public:
+  DrawBatcher(VulkanContext* vulkanContext, uint32_t framesInFlight);
+  ~DrawBatcher();
+
+  DrawBatcher(const DrawBatcher&) = delete;
+  DrawBatcher& operator=(const DrawBatcher&) = delete;
+
+  uint32_t registerPipeline(VkPipeline pipeline, VkPipelineLayout layout);
+  // Resolved at record time: the fallback is drawn until the pipeline has compiled
+  uint32_t registerPipeline(const PipelineManager* manager, PipelineHandle handle);
+  uint32_t registerMaterial(uint32_t pipeline, VkDescriptorSet descriptorSet,
+                            const glm::vec4& baseColor = glm::vec4(1.0f));
+  uint32_t registerMesh(const GpuMesh& mesh);
+  // The id is handed out again by a later registerMesh(), so it must not be submitted after this
+  void releaseMesh(uint32_t mesh);
+  const GpuMesh& getMesh(uint32_t mesh) const { return m_meshes[mesh]; }
+
+  void submit(uint32_t mesh, uint32_t material, const glm::mat4& transform);
+
+  // Sorts, batches and uploads instance data for frameIndex, whose fence must have retired
+  void build(uint32_t frameIndex);
+  // frameSet is the uniform ring's frame constants set, bound at frameOffset;
+  // lightSet is ClusteredLighting's shading set, bound at lightOffset
+  void record(VkCommandBuffer commandBuffer, uint32_t frameIndex, VkDescriptorSet frameSet, uint32_t frameOffset,
+              VkDescriptorSet lightSet = VK_NULL_HANDLE, uint32_t lightOffset = 0) const;
+
+  const std::vector<DrawBatch>& getBatches() const { return m_batches; }
+  uint32_t getSubmittedCount() const { return m_submittedCount; }
+
+  static const uint32_t PIPELINE_BITS = 12;
+  static const uint32_t MATERIAL_BITS = 26;
+  static const uint32_t MESH_BITS = 26;
+  static const uint32_t FRAME_SET = 0;
+  static const uint32_t MATERIAL_SET = 1;
+  static const uint32_t LIGHT_SET = 3;
+  static uint64_t makeSortKey(uint32_t pipeline, uint32_t material, uint32_t mesh);
+
+private:
+  struct Pipeline {
+    VkPipeline pipeline;
+    VkPipelineLayout layout;
+    const PipelineManager* manager;
+    PipelineHandle handle;
+  };
+
+  struct Material {
+    uint32_t pipeline;
+    VkDescriptorSet descriptorSet;
+    MaterialConstants constants;
+  };
+
+  struct InstanceBuffer {
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    InstanceData* mapped = nullptr;
+    uint32_t capacity = 0;
+  };
+
+  VulkanContext* m_vulkanContext;
+  std::vector<Pipeline> m_pipelines;
+  std::vector<Material> m_materials;
+  std::vector<GpuMesh> m_meshes;
+  std::vector<uint32_t> m_freeMeshes;
+
+  std::vector<DrawItem> m_items;
+  std::vector<uint64_t> m_keys;
+  std::vector<uint64_t> m_keyScratch;
+  std::vector<uint32_t> m_order;
+  std::vector<uint32_t> m_orderScratch;
+  std::vector<DrawBatch> m_batches;
+  std::vector<InstanceBuffer> m_instanceBuffers;
+  uint32_t m_submittedCount;
+
+  void radixSort();
+  void ensureInstanceCapacity(InstanceBuffer& buffer, uint32_t count);
+  void destroyInstanceBuffer(InstanceBuffer& buffer);
+};
+
+} // namespace plaster
@@ -0,0 +1,42 @@
+#pragma once
+#include <cstdint>
+
+namespace plaster {
+
+struct DynamicResolutionSettings {
+  bool enabled = true;
+  float targetMs = 1000.0f / 60.0f;
+  float headroom = 0.9f;          // aim for this fraction of the target so spikes still fit
+  float minScale = 0.5f;
+  float maxScale = 1.0f;
+  float decreaseGain = 0.3f;      // react quickly when over budget...
+  float increaseGain = 0.05f;     // ...and creep back up slowly
+  uint32_t settleFrames = 4;      // frames to wait after a change for its timings to arrive
+};
+
+// Picks the scene's render scale from measured GPU frame times. GPU cost is
+// modelled as proportional to the pixel count, so each sample is first
+// normalized by the scale that frame was rendered at; the smoothed cost per
+// unit area then gives the scale that would hit the target, which the
+// current scale approaches in whole steps with asymmetric gains. A small
+// dead band around the ideal keeps the resolution from jittering.
+class DynamicResolution {
+public:
+  DynamicResolution();
+
+  // gpuMs was measured for a frame rendered at frameScale; returns the scale
+  // to render the next frame at
+  float update(float gpuMs, float frameScale, float currentScale);
+  void reset();
+
+  DynamicResolutionSettings& getSettings() { return m_settings; }
+  float getSmoothedMs() const { return m_smoothedMs; }
+
+private:
+  DynamicResolutionSettings m_settings;
+  float m_costPerArea;     // smoothed GPU ms at scale 1
+  float m_smoothedMs;
+  uint32_t m_settleCounter;
+};
+
+} // namespace plaster
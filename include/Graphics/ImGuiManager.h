@@ -3,24 +3,46 @@
 #include <vulkan/vulkan.h>
 #include "imgui.h"
 
+#include <cstdint>
+#include <memory>
+#include <vector>
+
 namespace plaster {
 
 class Window;
 class VulkanContext;
 
+// The UI is finalized once per frame by endFrame(), which deep-copies the
+// draw data into a snapshot owned by that frame in flight. Recording reads
+// only the snapshot, so it can happen on another thread while the next
+// frame's UI is built.
 class ImGuiManager {
 public:
-    ImGuiManager(Window* window, VulkanContext* vulkanContext, VkRenderPass renderPass);
+    // With a null renderPass the backend is set up for dynamic rendering into colorFormat
+    ImGuiManager(Window* window, VulkanContext* vulkanContext, VkRenderPass renderPass, VkFormat colorFormat,
+                 uint32_t framesInFlight, VkPipelineCache pipelineCache = VK_NULL_HANDLE);
     ~ImGuiManager();
 
     void newFrame();
-    void render(VkCommandBuffer commandBuffer);
+    // ImGui::Render() into frameIndex's snapshot, reusing the capacity of its buffers
+    void endFrame(uint32_t frameIndex);
+    // Uploads new and changed ImGui textures and resolves the snapshot's references to
+    // them. Submits to the graphics queue, so nothing else may be submitting meanwhile.
+    void updateTextures(uint32_t frameIndex);
+    void render(VkCommandBuffer commandBuffer, uint32_t frameIndex);
     void setTheme();
 
 private:
+    struct DrawDataSnapshot {
+        ImDrawData drawData;
+        std::vector<std::unique_ptr<ImDrawList>> drawLists;   // grows to the most lists ever drawn
+    };
+
     VulkanContext* m_vulkanContext;
     Window* m_window;
     VkDescriptorPool m_imguiDescriptorPool;
+    VkFormat m_colorFormat;   // referenced by the backend's pipeline rendering info
+    std::vector<DrawDataSnapshot> m_snapshots;
 };
 
 } // namespace plaster
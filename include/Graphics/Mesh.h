@@ -0,0 +1,70 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <glm/glm.hpp>
+#include <array>
+#include <vector>
+#include <cstdint>
+
+namespace plaster {
+
+struct Vertex {
+  glm::vec3 position;
+  glm::vec3 normal;
+  glm::vec2 uv;
+};
+
+// Source vertex of a skinned mesh, read by shaders/skinning.comp. Up to four
+// joints per vertex with 8-bit weights that sum to 255.
+struct SkinnedVertex {
+  glm::vec3 position;
+  glm::vec3 normal;
+  glm::vec2 uv;
+  uint8_t joints[4];
+  uint8_t weights[4];
+};
+
+// Per-instance data streamed into the per-frame instance buffer (binding 1)
+struct InstanceData {
+  glm::mat4 model;
+};
+
+struct MeshData {
+  std::vector<Vertex> vertices;
+  std::vector<uint32_t> indices;
+};
+
+// Joint indices refer to the skeleton the mesh was bound to
+struct SkinnedMeshData {
+  std::vector<SkinnedVertex> vertices;
+  std::vector<uint32_t> indices;
+};
+
+// A range inside (possibly shared) vertex and index buffers
+struct GpuMesh {
+  VkBuffer vertexBuffer = VK_NULL_HANDLE;
+  VkBuffer indexBuffer = VK_NULL_HANDLE;
+  uint32_t firstIndex = 0;
+  uint32_t indexCount = 0;
+  int32_t vertexOffset = 0;
+};
+
+struct StaticMeshInstance {
+  const MeshData* mesh = nullptr;
+  glm::mat4 transform = glm::mat4(1.0f);
+  uint32_t material = 0;
+};
+
+struct StaticBatch {
+  uint32_t material = 0;
+  MeshData mesh;
+};
+
+// Vertex input layout shared by every instanced mesh pipeline
+std::array<VkVertexInputBindingDescription, 2> getMeshBindingDescriptions();
+std::array<VkVertexInputAttributeDescription, 7> getMeshAttributeDescriptions();
+
+// Bakes static instances into one vertex/index stream per material, so
+// geometry that never moves costs one draw per material instead of one per object
+std::vector<StaticBatch> mergeStaticGeometry(const std::vector<StaticMeshInstance>& instances);
+
+} // namespace plaster
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "Asset/AssetStreamer.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace plaster {
+
+class Renderer;
+
+// Streams mesh blobs (see MeshBlobHeader) into the Renderer. Resources are
+// draw batcher mesh ids; until a mesh is resident, AssetStreamer::resolve()
+// returns a degenerate triangle that draws nothing. Call shutdown() on every
+// AssetStreamer using the loader before destroying it.
+class MeshLoader : public AssetLoader {
+public:
+  explicit MeshLoader(Renderer* renderer);
+  ~MeshLoader() override;
+
+  MeshLoader(const MeshLoader&) = delete;
+  MeshLoader& operator=(const MeshLoader&) = delete;
+
+  // Rejects blobs that aren't in the Renderer's vertex layout or that index out of range
+  bool decode(std::vector<uint8_t>& data) override;
+  uint64_t upload(const std::vector<uint8_t>& data, uint64_t& residentBytes) override;
+  void evict(uint64_t resource) override;
+  uint64_t getPlaceholder() const override { return m_placeholder; }
+
+private:
+  Renderer* m_renderer;
+  uint32_t m_placeholder;
+};
+
+} // namespace plaster
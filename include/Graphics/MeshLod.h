@@ -0,0 +1,123 @@
+#pragma once
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace plaster {
+
+// Each level aims for MESH_LOD_REDUCTION of the previous one's triangles. The
+// chain stops at MESH_LOD_MAX_LEVELS, under MESH_LOD_MIN_TRIANGLES, or when
+// simplification stalls (open borders and seams are never collapsed).
+static const uint32_t MESH_LOD_MAX_LEVELS = 8;
+static const uint32_t MESH_LOD_MIN_TRIANGLES = 64;
+static const float MESH_LOD_REDUCTION = 0.5f;
+
+// A range of MeshLodData::indices. Error is how far, in mesh units, the
+// level's surface strays from the original one, measured from every removed
+// vertex; it never decreases down the chain and is 0 for level 0, the
+// original mesh.
+struct MeshLodLevel {
+  uint32_t firstIndex;
+  uint32_t indexCount;
+  float error;
+};
+static_assert(sizeof(MeshLodLevel) == 12, "MeshLodLevel is stored as is in LOD blobs");
+
+// Every level indexes the original vertices, so a chain shares one vertex buffer
+struct MeshLodData {
+  std::vector<MeshLodLevel> levels;
+  std::vector<uint32_t> indices;
+};
+
+// Builds a chain of simplified index lists with quadric error metrics
+// (Garland and Heckbert): edges are collapsed cheapest first, each onto
+// whichever of its endpoints the two endpoints' accumulated plane quadrics
+// place nearer the original surface. Vertices never move, so the levels need
+// no vertex data of their own. Collapses that would flip a triangle or make
+// the surface non-manifold are skipped. Offline work, several seconds per
+// million triangles.
+//
+// Positions are three floats every positionStride bytes, as for buildMeshlets().
+MeshLodData buildMeshLods(const float* positions, size_t positionStride, uint32_t vertexCount,
+                          const uint32_t* indices, uint32_t indexCount);
+
+struct LodSettings {
+  // Largest error, in pixels, a level may show on screen
+  float pixelError = 1.0f;
+  // A level is only coarsened once the coarser one's error is this fraction
+  // below pixelError, so an object sitting at a switching distance does not
+  // flicker between two levels
+  float hysteresis = 0.25f;
+  // Never coarser than this level; 0 draws everything at full detail
+  uint32_t maxLevel = MESH_LOD_MAX_LEVELS - 1;
+};
+
+// Frame totals since the last resetStats()
+struct LodStats {
+  uint32_t selections = 0;
+  uint32_t switches = 0;
+  uint64_t triangles = 0;
+  uint64_t fullDetailTriangles = 0;
+};
+
+// Picks a level of a LOD chain per instance from its projected error, and
+// hands back the draw batcher mesh registered for that level, so each level
+// batches and instances like any other mesh.
+//
+// Errors are projected at the distance from the camera to the nearest point
+// of the mesh's bounding sphere, so a large object up close keeps its detail.
+class LodSelector {
+public:
+  LodSelector();
+
+  // levelMeshes are draw batcher mesh ids; errors as in MeshLodLevel
+  uint32_t addMesh(const uint32_t* levelMeshes, const float* errors, const uint32_t* triangleCounts,
+                   uint32_t levelCount, const glm::vec3& center, float radius);
+  // Holds the level an instance last used, for hysteresis
+  uint32_t addInstance(uint32_t mesh);
+
+  // viewportHeight in pixels of the rendered image
+  void setCamera(const glm::mat4& view, const glm::mat4& projection, float viewportHeight);
+
+  // The level for an instance drawn with transform this frame
+  uint32_t selectLevel(uint32_t instance, const glm::mat4& transform);
+  // Draw batcher mesh of selectLevel()'s result
+  uint32_t select(uint32_t instance, const glm::mat4& transform);
+
+  LodSettings& getSettings() { return m_settings; }
+  const LodStats& getStats() const { return m_stats; }
+  void resetStats() { m_stats = LodStats(); }
+
+private:
+  struct Level {
+    uint32_t mesh;
+    float error;
+    uint32_t triangleCount;
+  };
+
+  struct LodMesh {
+    uint32_t firstLevel;
+    uint32_t levelCount;
+    glm::vec3 center;
+    float radius;
+  };
+
+  struct Instance {
+    uint32_t mesh;
+    uint32_t level;   // NO_LEVEL until first selected
+  };
+
+  static const uint32_t NO_LEVEL = UINT32_MAX;
+
+  std::vector<Level> m_levels;
+  std::vector<LodMesh> m_meshes;
+  std::vector<Instance> m_instances;
+  LodSettings m_settings;
+  LodStats m_stats;
+  glm::vec3 m_cameraPosition;
+  float m_pixelsPerUnit;   // at distance 1
+};
+
+} // namespace plaster
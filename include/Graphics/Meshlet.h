@@ -0,0 +1,52 @@
+#pragma once
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace plaster {
+
+// Limits of one cluster. 124 triangles keeps a meshlet's 372 index bytes a
+// multiple of four with room to spare, and 64 vertices lets a local index fit
+// in a byte and one culling workgroup emit a whole meshlet.
+static const uint32_t MESHLET_MAX_VERTICES = 64;
+static const uint32_t MESHLET_MAX_TRIANGLES = 124;
+
+// Mirrors Meshlet in shaders/meshlet.glsl (std430). The cone holds every
+// triangle normal of the meshlet: it faces away from the camera entirely when
+// dot(center - camera, coneAxis) >= coneCutoff * length(center - camera) + radius.
+// A cutoff of 1 never passes, for meshlets too curved to cull.
+struct Meshlet {
+  glm::vec3 center;
+  float radius;
+  glm::vec3 coneAxis;
+  float coneCutoff;
+  uint32_t vertexOffset;      // into MeshletData::vertices
+  uint32_t triangleOffset;    // in bytes, into MeshletData::triangles
+  uint32_t vertexCount;
+  uint32_t triangleCount;
+};
+static_assert(sizeof(Meshlet) == 48, "Meshlet must match shaders/meshlet.glsl");
+
+struct MeshletData {
+  std::vector<Meshlet> meshlets;
+  // Mesh vertex indices referenced by each meshlet
+  std::vector<uint32_t> vertices;
+  // Three local vertex indices per triangle, padded to a multiple of four bytes
+  std::vector<uint8_t> triangles;
+};
+
+// Splits an indexed triangle list into meshlets. Greedy: each meshlet grows
+// from a seed triangle by repeatedly taking the adjacent triangle that adds
+// the fewest new vertices, nearest the meshlet's centre on ties, so meshlets
+// come out compact and their bounds and cones tight. Offline work, well under
+// a second per million triangles.
+//
+// Positions are three floats every positionStride bytes, so Vertex arrays and
+// mesh blobs (see MeshBlobHeader) can be passed as they are; this keeps the
+// packer free of the Vulkan headers Mesh.h pulls in.
+MeshletData buildMeshlets(const float* positions, size_t positionStride, uint32_t vertexCount,
+                          const uint32_t* indices, uint32_t indexCount);
+
+} // namespace plaster
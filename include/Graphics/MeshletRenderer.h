@@ -0,0 +1,196 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <glm/glm.hpp>
+#include "Graphics/PipelineManager.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace plaster {
+
+class VulkanContext;
+class DeletionQueue;
+class DescriptorAllocator;
+class UniformRing;
+
+struct MeshletCullSettings {
+  bool frustum = true;
+  bool cone = true;
+  bool occlusion = true;
+};
+
+// Counted by the culling pass, read back MAX_FRAMES_IN_FLIGHT frames late
+struct MeshletCullStats {
+  uint32_t visibleClusters = 0;
+  uint32_t visibleTriangles = 0;
+  uint32_t frustumCulled = 0;
+  uint32_t coneCulled = 0;
+  uint32_t occlusionCulled = 0;
+};
+
+// Draws meshes split into meshlets (see Graphics/Meshlet.h) with a single
+// indexed indirect draw. A compute pass tests every meshlet of every instance
+// against the frustum, its normal cone and a depth pyramid, and writes the
+// triangles of the survivors into one index buffer; the vertex shader pulls
+// vertices from storage buffers, so no mesh shader support is needed.
+//
+// The pyramid is built from the scene depth after the scene pass and tested
+// against in the next frame with that frame's camera, so something that only
+// just came out from behind a moving occluder shows up a frame late.
+//
+// All meshes share one set of storage buffers, filled by the caller (see
+// Renderer::uploadMeshletMesh()). Instances and transforms are only read by
+// update(), so they can change at any time on the main thread.
+class MeshletRenderer {
+public:
+  // Capacities: vertices of all meshes, meshlets of all meshes (with room for
+  // their vertex references and triangles at full size) and indices drawn per frame
+  MeshletRenderer(VulkanContext* vulkanContext, PipelineManager* pipelineManager, DeletionQueue* deletionQueue,
+                  UniformRing* uniformRing, uint32_t framesInFlight, uint32_t scenePass, uint32_t vertexCapacity,
+                  uint32_t meshletCapacity, uint32_t indexCapacity);
+  ~MeshletRenderer();
+
+  MeshletRenderer(const MeshletRenderer&) = delete;
+  MeshletRenderer& operator=(const MeshletRenderer&) = delete;
+
+  // Byte offsets of a mesh's data in the shared buffers
+  struct UploadOffsets {
+    VkDeviceSize vertices;
+    VkDeviceSize meshlets;
+    VkDeviceSize meshletVertices;
+    VkDeviceSize triangles;
+  };
+
+  // Reserves room for a mesh for the caller to copy in at getUploadOffsets().
+  // Throws when a buffer is full.
+  uint32_t addMesh(uint32_t vertexCount, uint32_t meshletCount, uint32_t meshletVertexCount,
+                   uint32_t triangleByteCount);
+  UploadOffsets getUploadOffsets(uint32_t mesh) const;
+  VkBuffer getVertexBuffer() const { return m_vertices.buffer; }
+  VkBuffer getMeshletBuffer() const { return m_meshlets.buffer; }
+  VkBuffer getMeshletVertexBuffer() const { return m_meshletVertices.buffer; }
+  VkBuffer getTriangleBuffer() const { return m_triangles.buffer; }
+
+  uint32_t addInstance(uint32_t mesh, const glm::mat4& transform);
+  void setTransform(uint32_t instance, const glm::mat4& transform);
+  // Set 1 of mesh.frag (the albedo texture) and the base color pushed with
+  // it, shared by every instance. Nothing is drawn until there is one.
+  void setMaterial(VkDescriptorSet descriptorSet, const glm::vec4& baseColor);
+
+  // Rebuilds the depth pyramid for new scene targets; extent is their allocated size
+  void resize(VkImageView sceneDepth, VkExtent2D extent);
+
+  // On the main thread once per frame, after the uniform ring's beginFrame()
+  // and once the frame's fence has been waited on
+  void update(uint32_t frameIndex, const glm::mat4& viewProjection, const glm::vec3& cameraPosition,
+              VkExtent2D renderExtent);
+  // Culling, outside any render pass and before the scene pass
+  void record(VkCommandBuffer commandBuffer, uint32_t frameIndex, DescriptorAllocator* descriptorAllocator);
+  // Inside the scene pass; lightSet is ClusteredLighting's shading set, bound at lightOffset
+  void draw(VkCommandBuffer commandBuffer, DescriptorAllocator* descriptorAllocator, VkDescriptorSet frameSet,
+            uint32_t frameOffset, VkDescriptorSet lightSet, uint32_t lightOffset);
+  // After the scene pass, with the scene depth in SHADER_READ_ONLY_OPTIMAL and its writes visible to compute
+  void recordDepthPyramid(VkCommandBuffer commandBuffer, DescriptorAllocator* descriptorAllocator);
+
+  MeshletCullSettings& getSettings() { return m_settings; }
+  const MeshletCullStats& getStats() const { return m_stats; }
+  uint32_t getInstanceCount() const { return static_cast<uint32_t>(m_instances.size()); }
+
+private:
+  struct StorageBuffer {
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize size = 0;
+  };
+
+  struct MeshletMesh {
+    uint32_t firstVertex;
+    uint32_t firstMeshlet;
+    uint32_t meshletCount;
+    uint32_t firstMeshletVertex;
+    uint32_t firstTriangleByte;
+  };
+
+  // Mirrors MeshletInstance in shaders/meshlet.glsl
+  struct Instance {
+    glm::mat4 model;
+    uint32_t firstMeshlet;
+    uint32_t meshletCount;
+    uint32_t firstVertex;
+    uint32_t firstMeshletVertex;
+    uint32_t firstTriangleByte;
+    float scale;
+    uint32_t coneCulling;
+    uint32_t padding;
+  };
+
+  struct Readback {
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    const void* mapped = nullptr;
+    bool written = false;
+  };
+
+  VulkanContext* m_vulkanContext;
+  PipelineManager* m_pipelineManager;
+  DeletionQueue* m_deletionQueue;
+  UniformRing* m_uniformRing;
+  PipelineHandle m_cullPipeline;
+  PipelineHandle m_drawPipeline;
+  PipelineHandle m_pyramidPipeline;
+  VkSampler m_pointSampler;
+  MeshletCullSettings m_settings;
+  MeshletCullStats m_stats;
+
+  StorageBuffer m_vertices;
+  StorageBuffer m_meshlets;
+  StorageBuffer m_meshletVertices;
+  StorageBuffer m_triangles;
+  StorageBuffer m_state;          // counters and the indirect draw
+  StorageBuffer m_clusters;       // visible (instance, meshlet) pairs
+  StorageBuffer m_indices;
+  uint32_t m_vertexCapacity;
+  uint32_t m_meshletCapacity;
+  uint32_t m_indexCapacity;
+  uint32_t m_verticesUsed;
+  uint32_t m_meshletsUsed;
+  uint32_t m_meshletVerticesUsed;
+  uint32_t m_triangleBytesUsed;
+  std::vector<Readback> m_readbacks;   // per frame in flight
+
+  std::vector<MeshletMesh> m_meshes;
+  std::vector<Instance> m_instances;
+  VkDescriptorSet m_material;
+  glm::vec4 m_baseColor;
+
+  // R32F, half the scene target's size, with a full mip chain in GENERAL
+  VkImageView m_sceneDepth;
+  VkImage m_pyramidImage;
+  VkDeviceMemory m_pyramidMemory;
+  VkImageView m_pyramidView;
+  std::vector<VkImageView> m_pyramidLevelViews;
+  uint32_t m_pyramidLevels;
+  bool m_pyramidInitialized;   // moved out of UNDEFINED by a recorded frame
+  bool m_pyramidBuilt;         // by the last recorded frame, for the current targets
+  glm::mat4 m_pyramidViewProjection;
+  VkExtent2D m_pyramidSourceExtent;
+
+  // Written by update() for the next record(), draw() and recordDepthPyramid()
+  bool m_active;
+  bool m_transitionPyramid;
+  bool m_buildPyramid;
+  uint32_t m_maxMeshletCount;
+  uint32_t m_instanceOffset;
+  uint32_t m_instanceSize;
+  uint32_t m_constantsOffset;
+  VkDescriptorSet m_drawMaterial;
+  glm::vec4 m_drawBaseColor;
+  VkExtent2D m_renderExtent;
+
+  static const uint32_t CLUSTER_SET = 2;
+
+  StorageBuffer createStorageBuffer(VkDeviceSize size, VkBufferUsageFlags usage, const char* name);
+  void releasePyramid();
+};
+
+} // namespace plaster
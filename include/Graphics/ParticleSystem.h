@@ -0,0 +1,128 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <glm/glm.hpp>
+#include "Graphics/PipelineManager.h"
+#include "Graphics/DescriptorAllocator.h"
+
+#include <cstdint>
+#include <initializer_list>
+
+namespace plaster {
+
+class VulkanContext;
+class DeletionQueue;
+
+struct ParticleEmitterSettings {
+  bool enabled = false;
+  glm::vec3 position = glm::vec3(0.0f);
+  float radius = 0.1f;                                 // particles start anywhere in this sphere
+  glm::vec3 direction = glm::vec3(0.0f, 1.0f, 0.0f);
+  float spread = 0.5f;                                 // half angle of the emission cone, radians
+  float rate = 100000.0f;                              // particles per second
+  float minSpeed = 2.0f;
+  float maxSpeed = 5.0f;
+  float minLifetime = 1.0f;                            // seconds
+  float maxLifetime = 3.0f;
+  glm::vec3 gravity = glm::vec3(0.0f, -9.81f, 0.0f);
+  float drag = 0.2f;                                   // fraction of the velocity lost per second
+  float size = 0.02f;                                  // quad half extent in world units
+  glm::vec4 startColor = glm::vec4(4.0f, 2.0f, 0.5f, 1.0f);   // HDR, so the brightest ones bloom
+  glm::vec4 endColor = glm::vec4(1.0f, 0.2f, 0.05f, 0.0f);
+};
+
+// One emitter simulated entirely in compute. A fixed pool of particles sits
+// in device local storage buffers next to a dead list of free slots, two
+// alive lists that swap roles every frame and a buffer of atomic counters
+// and indirect arguments. Every frame:
+//   - a single invocation caps the requested emission at the dead count and
+//     writes the emit and update dispatch sizes
+//   - emit pops free slots off the dead list onto the current alive list
+//   - update integrates, pushes expired particles back onto the dead list and
+//     compacts survivors onto the other alive list with a depth sort key
+//   - a second single invocation sizes the sort and the draw from the survivors
+//   - a bitonic sort orders the keys back to front for alpha blending
+// Every dispatch after the first and the draw take their sizes from that
+// buffer, so the CPU neither waits on nor reads back anything.
+//
+// Like PostProcess, settings are read while recording: change them only
+// after Renderer::waitForRenderThread().
+class ParticleSystem {
+public:
+  // scenePass is the pipeline manager id of the pass draw() is recorded in
+  ParticleSystem(VulkanContext* vulkanContext, PipelineManager* pipelineManager, DeletionQueue* deletionQueue,
+                 uint32_t scenePass, uint32_t capacity);
+  ~ParticleSystem();
+
+  ParticleSystem(const ParticleSystem&) = delete;
+  ParticleSystem& operator=(const ParticleSystem&) = delete;
+
+  // On the main thread once per frame, before the frame is recorded. The
+  // system sits out frames while disabled or while its pipelines compile,
+  // and the particles carry on where they were afterwards.
+  void update(float deltaTime);
+
+  // Outside any render pass and before draw(); set 0 is the frame constants at frameOffset
+  void record(VkCommandBuffer commandBuffer, DescriptorAllocator* descriptorAllocator, VkDescriptorSet frameSet,
+              uint32_t frameOffset);
+  // Inside the scene pass, with depth testing against the opaque geometry
+  void draw(VkCommandBuffer commandBuffer, DescriptorAllocator* descriptorAllocator, VkDescriptorSet frameSet,
+            uint32_t frameOffset);
+
+  // Kills every particle at the start of the next simulated frame
+  void reset() { m_resetPending = true; }
+
+  ParticleEmitterSettings& getSettings() { return m_settings; }
+  uint32_t getCapacity() const { return m_capacity; }
+  // Capacity rounded up to a power of two, the size of the sorting network
+  uint32_t getSortCapacity() const { return m_sortCapacity; }
+
+private:
+  struct StorageBuffer {
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize size = 0;
+  };
+
+  VulkanContext* m_vulkanContext;
+  PipelineManager* m_pipelineManager;
+  DeletionQueue* m_deletionQueue;
+  ParticleEmitterSettings m_settings;
+  uint32_t m_capacity;
+  uint32_t m_sortCapacity;
+
+  PipelineHandle m_resetPipeline;
+  PipelineHandle m_beginPipeline;
+  PipelineHandle m_emitPipeline;
+  PipelineHandle m_updatePipeline;
+  PipelineHandle m_finishPipeline;
+  PipelineHandle m_sortLocalPipeline;
+  PipelineHandle m_sortStepPipeline;
+  PipelineHandle m_sortMergePipeline;
+  PipelineHandle m_drawPipeline;
+
+  StorageBuffer m_particles;
+  StorageBuffer m_deadList;
+  StorageBuffer m_aliveLists;   // both lists back to back, capacity entries each
+  StorageBuffer m_state;        // counters and indirect arguments
+  StorageBuffer m_sortKeys;
+
+  // Written by update() for the next record() and draw()
+  bool m_active;
+  bool m_reset;
+  bool m_resetPending;
+  uint32_t m_current;
+  uint32_t m_emitCount;
+  uint32_t m_seed;
+  float m_deltaTime;
+  float m_emitRemainder;
+
+  static const uint32_t SORT_BLOCK = 512;   // see shaders/particle.glsl
+  static const uint32_t PARTICLE_SET = 1;
+
+  StorageBuffer createStorageBuffer(VkDeviceSize size, VkBufferUsageFlags usage, const char* name);
+  bool isReady() const;
+  void bind(VkCommandBuffer commandBuffer, DescriptorAllocator* descriptorAllocator, PipelineHandle pipeline,
+            std::initializer_list<DescriptorBinding> bindings, const void* pushConstants, uint32_t pushSize);
+};
+
+} // namespace plaster
@@ -0,0 +1,173 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include "Graphics/ShaderCache.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace plaster {
+
+class VulkanContext;
+class JobSystem;
+class DeletionQueue;
+
+enum class VertexLayout : uint32_t {
+  None,   // vertices generated in the shader
+  Mesh    // Vertex + per-instance InstanceData, see getMeshBindingDescriptions()
+};
+
+enum class BlendMode : uint32_t {
+  Opaque,
+  Alpha,
+  Additive
+};
+
+// Render passes are referred to by id so pipeline descs can be written to
+// the precompile list and matched again in a later session
+struct GraphicsPipelineDesc {
+  ShaderDesc vertex;
+  ShaderDesc fragment;
+  uint32_t renderPass = 0;
+  uint32_t subpass = 0;
+  VertexLayout vertexLayout = VertexLayout::Mesh;
+  VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+  VkCullModeFlags cullMode = VK_CULL_MODE_BACK_BIT;
+  BlendMode blend = BlendMode::Opaque;
+  bool depthTest = false;
+  bool depthWrite = false;
+};
+
+struct ComputePipelineDesc {
+  ShaderDesc compute;
+};
+
+struct PipelineHandle {
+  uint32_t index = UINT32_MAX;
+
+  bool isValid() const { return index != UINT32_MAX; }
+};
+
+// Creates pipelines on job system workers so no frame ever waits on the
+// driver compiler. Layouts are built from shader reflection at request time
+// and are usable immediately; the pipeline itself shows up once its job is
+// done, and until then graphics draws can use a generic fallback pipeline
+// compiled per render pass. All compiles share one VkPipelineCache that is
+// saved to disk on shutdown, and every desc requested in a session is
+// written to a precompile list so the next launch can warm them up front.
+// Shader hot reloads recompile only the pipelines using the changed shaders.
+class PipelineManager {
+public:
+  PipelineManager(VulkanContext* vulkanContext, JobSystem* jobSystem, ShaderCache* shaderCache,
+                  DeletionQueue* deletionQueue, const std::string& cacheDirectory);
+  ~PipelineManager();
+
+  PipelineManager(const PipelineManager&) = delete;
+  PipelineManager& operator=(const PipelineManager&) = delete;
+
+  // Also compiles the fallback pipeline for the pass, synchronously. Pipelines
+  // get a blend state for each of the subpass' color attachments.
+  void registerRenderPass(uint32_t id, VkRenderPass renderPass, uint32_t colorAttachmentCount = 1);
+  // Same for a pass recorded with dynamic rendering, described by its attachment formats
+  void registerRenderingFormats(uint32_t id, const std::vector<VkFormat>& colorFormats, VkFormat depthFormat);
+
+  // Queues every pipeline recorded by a previous session whose pass is registered
+  void warmUp();
+
+  // Identical descs return the same handle. Throws if a shader fails to compile.
+  PipelineHandle requestGraphics(const GraphicsPipelineDesc& desc);
+  PipelineHandle requestCompute(const ComputePipelineDesc& desc);
+
+  bool isReady(PipelineHandle handle) const;
+  // VK_NULL_HANDLE until compiled
+  VkPipeline getPipeline(PipelineHandle handle) const;
+  // The compiled pipeline, else the pass's fallback (graphics with a Mesh layout only)
+  VkPipeline resolve(PipelineHandle handle) const;
+  VkPipelineLayout getLayout(PipelineHandle handle) const;
+  // Same, along with the layout of whichever pipeline it returned
+  VkPipeline resolve(PipelineHandle handle, VkPipelineLayout& layout) const;
+  VkDescriptorSetLayout getSetLayout(PipelineHandle handle, uint32_t set) const;
+  // Shared with every pipeline whose set has exactly these bindings
+  VkDescriptorSetLayout getSetLayout(const std::vector<VkDescriptorSetLayoutBinding>& bindings);
+  // Size 0 when the pipeline has no push constants
+  VkPushConstantRange getPushConstantRange(PipelineHandle handle) const;
+
+  // Swaps in pipelines rebuilt after a shader reload; the ones they replaced go to the deletion queue
+  void update();
+  // Blocks until no compile job is running
+  void waitIdle();
+
+  VkPipelineCache getPipelineCache() const { return m_pipelineCache; }
+  uint32_t getPendingCount() const { return m_pendingJobs.load(); }
+  uint32_t getPipelineCount() const { return static_cast<uint32_t>(m_pipelines.size()); }
+
+private:
+  struct Pipeline {
+    bool compute = false;
+    GraphicsPipelineDesc graphics;
+    ComputePipelineDesc computeDesc;
+    ShaderHandle shaders[2];
+    VkPipelineLayout layout = VK_NULL_HANDLE;
+    std::vector<VkDescriptorSetLayout> setLayouts;
+    std::atomic<VkPipeline> pipeline{VK_NULL_HANDLE};
+
+    // Rebuild after a shader reload, swapped in by update()
+    std::atomic<VkPipeline> replacement{VK_NULL_HANDLE};
+    VkPipelineLayout replacementLayout = VK_NULL_HANDLE;
+    std::vector<VkDescriptorSetLayout> replacementSetLayouts;
+  };
+
+  // Either a render pass object or, with dynamic rendering, the attachment formats
+  struct RenderPass {
+    VkRenderPass renderPass = VK_NULL_HANDLE;
+    uint32_t colorAttachmentCount = 0;
+    std::vector<VkFormat> colorFormats;
+    VkFormat depthFormat = VK_FORMAT_UNDEFINED;
+    VkPipeline fallback = VK_NULL_HANDLE;
+    VkPipelineLayout fallbackLayout = VK_NULL_HANDLE;
+  };
+
+  VulkanContext* m_vulkanContext;
+  JobSystem* m_jobSystem;
+  ShaderCache* m_shaderCache;
+  DeletionQueue* m_deletionQueue;
+  std::string m_cacheDirectory;
+
+  VkPipelineCache m_pipelineCache;
+  std::vector<std::unique_ptr<Pipeline>> m_pipelines;
+  std::unordered_map<uint64_t, uint32_t> m_pipelineLookup;
+  std::unordered_map<uint32_t, RenderPass> m_renderPasses;
+
+  // Shared by all pipelines, destroyed with the manager
+  std::unordered_map<uint64_t, VkDescriptorSetLayout> m_setLayoutCache;
+  std::unordered_map<uint64_t, VkPipelineLayout> m_pipelineLayoutCache;
+  std::unordered_map<VkPipelineLayout, VkPushConstantRange> m_pushConstantRanges;
+
+  std::vector<std::string> m_precompileList;
+  std::vector<std::string> m_recorded;
+
+  std::atomic<uint32_t> m_pendingJobs;
+  std::mutex m_mutex;   // only for waiting on m_pendingJobs
+  std::condition_variable m_idleCondition;
+
+  void buildLayout(const std::vector<const ShaderReflection*>& stages, VkPipelineLayout& layout,
+                   std::vector<VkDescriptorSetLayout>& setLayouts);
+  void buildFallback(uint32_t id, RenderPass& pass);
+  void schedule(uint32_t index, bool replace);
+  VkPipeline createGraphics(const GraphicsPipelineDesc& desc, const RenderPass& pass, VkShaderModule vertex,
+                            VkShaderModule fragment, VkPipelineLayout layout) const;
+  VkPipeline createCompute(const ComputePipelineDesc& desc, VkShaderModule module, VkPipelineLayout layout) const;
+  void onShadersReloaded(const std::vector<ShaderHandle>& shaders);
+
+  void loadPipelineCache();
+  void savePipelineCache() const;
+  void loadPrecompileList();
+  void savePrecompileList() const;
+};
+
+} // namespace plaster
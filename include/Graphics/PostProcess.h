@@ -0,0 +1,97 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include "Graphics/PipelineManager.h"
+#include "Graphics/DescriptorAllocator.h"
+
+#include <cstdint>
+#include <initializer_list>
+#include <vector>
+
+namespace plaster {
+
+class VulkanContext;
+class DeletionQueue;
+
+struct PostProcessSettings {
+  float exposure = 1.0f;
+  bool bloom = true;
+  float bloomThreshold = 1.0f;    // scene luminance where bloom starts
+  float bloomKnee = 0.5f;         // width of the soft transition below the threshold
+  float bloomIntensity = 0.05f;
+  float bloomRadius = 1.0f;       // upsample tent size, in texels of the smaller level
+};
+
+// Compute chain from the HDR scene color to an LDR image at the same internal
+// resolution: bloom prefilter and downsample into a half resolution mip
+// pyramid (shared-memory tiles), upsample back to level 0, then exposure,
+// ACES tonemapping and sRGB encoding. composite() draws the result onto the
+// swapchain with a bilinear fullscreen triangle, which is where a reduced
+// internal resolution gets upscaled.
+//
+// Everything is allocated for the scene target's full size, and each frame
+// only processes the renderExtent it was actually rendered at, so changing
+// the render scale within that size costs no allocation.
+class PostProcess {
+public:
+  // presentPass is the pipeline manager id of the swapchain pass composite() is recorded in
+  PostProcess(VulkanContext* vulkanContext, PipelineManager* pipelineManager, DeletionQueue* deletionQueue,
+              uint32_t presentPass, bool srgbPresent);
+  ~PostProcess();
+
+  PostProcess(const PostProcess&) = delete;
+  PostProcess& operator=(const PostProcess&) = delete;
+
+  // Rebuilds the pyramid and output for a new scene color target; the old ones
+  // go to the deletion queue
+  void resize(VkImageView sceneColor, VkExtent2D extent);
+
+  // sceneColor must be in SHADER_READ_ONLY_OPTIMAL with its writes made visible to compute.
+  // Leaves the output readable by fragment shaders. renderExtent is the used top-left
+  // part of the scene target, at most the extent passed to resize().
+  void record(VkCommandBuffer commandBuffer, DescriptorAllocator* descriptorAllocator, VkExtent2D renderExtent);
+  // Inside the present pass, with the viewport covering the swapchain
+  void composite(VkCommandBuffer commandBuffer, DescriptorAllocator* descriptorAllocator, VkExtent2D renderExtent);
+
+  PostProcessSettings& getSettings() { return m_settings; }
+  uint32_t getBloomLevels() const { return m_bloomLevels; }
+
+private:
+  VulkanContext* m_vulkanContext;
+  PipelineManager* m_pipelineManager;
+  DeletionQueue* m_deletionQueue;
+  bool m_srgbPresent;
+  PostProcessSettings m_settings;
+
+  PipelineHandle m_prefilterPipeline;
+  PipelineHandle m_downsamplePipeline;
+  PipelineHandle m_upsamplePipeline;
+  PipelineHandle m_tonemapPipeline;
+  PipelineHandle m_compositePipeline;
+  VkSampler m_linearSampler;
+
+  VkImageView m_sceneColor;
+  VkExtent2D m_extent;
+
+  // Half resolution, one storage view per level and one sampled view of all levels
+  VkImage m_bloomImage;
+  VkDeviceMemory m_bloomMemory;
+  VkImageView m_bloomView;
+  std::vector<VkImageView> m_bloomLevelViews;
+  uint32_t m_bloomLevels;
+
+  // RGBA8 holding sRGB encoded values: written through a UNORM view, read
+  // through an sRGB one when the swapchain encodes on write
+  VkImage m_outputImage;
+  VkDeviceMemory m_outputMemory;
+  VkImageView m_outputStorageView;
+  VkImageView m_outputSampledView;
+
+  static const uint32_t MAX_BLOOM_LEVELS = 6;
+
+  void releaseTargets();
+  void dispatch(VkCommandBuffer commandBuffer, DescriptorAllocator* descriptorAllocator, PipelineHandle pipeline,
+                std::initializer_list<DescriptorBinding> bindings, const void* pushConstants, uint32_t pushSize,
+                VkExtent2D size);
+};
+
+} // namespace plaster
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace plaster {
+
+// A single thread that runs one frame's recording and submission at a time,
+// handed over by the main thread so it can go on to the next frame.
+// run() waits for the previous job first; an exception thrown by a job is
+// rethrown by the next wait() or run() on the calling thread.
+class RenderThread {
+public:
+  RenderThread();
+  // Finishes the current job; its exception, if any, is dropped
+  ~RenderThread();
+
+  RenderThread(const RenderThread&) = delete;
+  RenderThread& operator=(const RenderThread&) = delete;
+
+  void run(std::function<void()> job);
+  // Blocks until the current job has finished. Cheap when there is none.
+  void wait();
+
+private:
+  std::thread m_thread;
+  std::mutex m_mutex;
+  std::condition_variable m_condition;
+  std::function<void()> m_job;
+  std::exception_ptr m_error;
+  bool m_busy;
+  bool m_stopping;
+
+  void threadLoop();
+};
+
+} // namespace plaster
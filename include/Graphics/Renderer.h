@@ -1,28 +1,185 @@
 #pragma once
 #include <vulkan/vulkan.h>
+#include <glm/glm.hpp>
 #include <vector>
+#include <chrono>
 #include <cstdint>
 #include <memory>
 
+#include "Graphics/DynamicResolution.h"
+#include "Core/FrameArena.h"
+
 namespace plaster {
 
 class Window;
 class VulkanContext;
 class ImGuiManager;
+class DescriptorAllocator;
+class DrawBatcher;
+class TextureStreamer;
+class ShaderCache;
+class PipelineManager;
+class PostProcess;
+class ParticleSystem;
+class SkinningPass;
+class MeshletRenderer;
+class LodSelector;
+class ClusteredLighting;
+class ShadowCascades;
+class DeletionQueue;
+class UniformRing;
+class RenderThread;
+class JobSystem;
+struct MeshData;
+struct SkinnedMeshData;
+struct MeshletData;
+struct Meshlet;
+struct MeshLodData;
+struct MeshLodLevel;
+struct Vertex;
 
+enum class RenderPath {
+  RenderPass,         // VkRenderPass with one VkFramebuffer per swapchain image
+  DynamicRendering    // vkCmdBeginRendering with synchronization2 barriers, needs Vulkan 1.3
+};
+
+struct FrameTimings {
+  float cpuRecordMs = 0.0f;   // command recording through queue submission, on the render thread
+  float gpuMs = 0.0f;         // between the first and last timestamp of the frame, 0 if unsupported
+  float renderScale = 1.0f;   // the scene was rendered at this fraction of the swapchain size
+};
+
+// Mirrors FrameConstants in shaders/common.glsl (std140)
+struct FrameConstants {
+  glm::mat4 view;
+  glm::mat4 projection;
+  glm::mat4 viewProjection;
+  glm::vec4 cameraPosition;
+  glm::vec4 time;        // seconds since start, seconds since last frame, frame number
+  glm::vec4 viewport;    // scene size in pixels and its reciprocal
+};
 
 class Renderer {
 public:
-  Renderer(Window* window, VulkanContext* vulkanContext);
+  static const int MAX_FRAMES_IN_FLIGHT = 2;
+  // Pipeline manager ids: the HDR scene pass (color and depth, at the internal
+  // resolution), the swapchain pass that composites it and draws ImGui, and
+  // the depth-only pass drawing into the shadow atlas
+  static const uint32_t SCENE_RENDER_PASS = 0;
+  static const uint32_t PRESENT_RENDER_PASS = 1;
+  static const uint32_t SHADOW_RENDER_PASS = 2;
+
+  // Falls back to RenderPath::RenderPass when the device lacks dynamic rendering
+  Renderer(Window* window, VulkanContext* vulkanContext, JobSystem* jobSystem,
+           RenderPath preferredPath = RenderPath::DynamicRendering);
   ~Renderer();
   
+  // Builds the UI and prepares the frame, then hands recording, submission and
+  // presentation to the render thread and returns while that is still running
   void render();
+  void waitIdle();
+  // Blocks until the render thread has submitted the last frame. Needed before
+  // changing anything recording reads from outside render() (registering with
+  // the DrawBatcher, PostProcess or ParticleSystem settings); the Renderer's own
+  // setters call it.
+  void waitForRenderThread();
+  // Rebuilds the swapchain and everything sized to it; render() calls this on resize
+  void recreateSwapchain();
+
+  RenderPath getRenderPath() const { return m_renderPath; }
+  // Timings of the most recently completed frame
+  const FrameTimings& getFrameTimings() const { return m_frameTimings; }
   ImGuiManager* getImGuiManager() { return m_imguiManager.get(); }
+  DescriptorAllocator* getDescriptorAllocator() { return m_descriptorAllocator.get(); }
+  DrawBatcher* getDrawBatcher() { return m_drawBatcher.get(); }
+  TextureStreamer* getTextureStreamer() { return m_textureStreamer.get(); }
+  ShaderCache* getShaderCache() { return m_shaderCache.get(); }
+  PipelineManager* getPipelineManager() { return m_pipelineManager.get(); }
+  DeletionQueue* getDeletionQueue() { return m_deletionQueue.get(); }
+  PostProcess* getPostProcess() { return m_postProcess.get(); }
+  ParticleSystem* getParticleSystem() { return m_particleSystem.get(); }
+  UniformRing* getUniformRing() { return m_uniformRing.get(); }
+  SkinningPass* getSkinningPass() { return m_skinningPass.get(); }
+  MeshletRenderer* getMeshletRenderer() { return m_meshletRenderer.get(); }
+  LodSelector* getLodSelector() { return m_lodSelector.get(); }
+  ClusteredLighting* getLighting() { return m_lighting.get(); }
+  ShadowCascades* getShadows() { return m_shadows.get(); }
+
+  // Written into this frame's FrameConstants by render(); LOD selection uses
+  // it right away, so set it before selecting this frame's levels
+  void setCamera(const glm::mat4& view, const glm::mat4& projection);
+
+  // Internal resolution as a fraction of the swapchain, clamped to
+  // [0.25, max render scale]. Only changes the rendered area of the scene
+  // targets, so it is free to call every frame; the dynamic resolution
+  // controller does when it is enabled.
+  void setRenderScale(float scale);
+  float getRenderScale() const { return m_renderScale; }
+  // Size the scene targets are allocated for, clamped to [0.25, 2]; they are
+  // rebuilt at the start of the next frame
+  void setMaxRenderScale(float scale);
+  float getMaxRenderScale() const { return m_maxRenderScale; }
+  VkExtent2D getSceneExtent() const { return m_sceneExtent; }
+  DynamicResolution& getDynamicResolution() { return m_dynamicResolution; }
+
+  // Uploads into device-local buffers and registers the mesh with the draw
+  // batcher. The upload functions throw on a mesh without vertices or indices.
+  uint32_t uploadMesh(const MeshData& mesh);
+  // Same, from memory that is already in GPU layout (e.g. a mapped archive blob)
+  uint32_t uploadMesh(const Vertex* vertices, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount);
+  // Frees a mesh from uploadMesh(); its id must not be submitted again. The
+  // buffers go through the deletion queue, so frames in flight can still draw it.
+  void releaseMesh(uint32_t mesh);
+  // Copies the source vertices into the skinning pass and uploads the indices;
+  // returns the skinning pass's mesh id
+  uint32_t uploadSkinnedMesh(const SkinnedMeshData& mesh);
+  // An instance of a skinned mesh posed by the palette at paletteOffset (see
+  // Animator); returns the draw batcher mesh id to submit it with
+  uint32_t addSkinnedInstance(uint32_t skinnedMesh, uint32_t paletteOffset);
+  // Uploads a mesh with its LOD chain (see buildMeshLods()) and registers each
+  // level with the draw batcher; returns the LOD selector's mesh id. Per
+  // frame, submit the draw batcher mesh LodSelector::select() returns.
+  uint32_t uploadLodMesh(const MeshData& mesh, const MeshLodData& lods);
+  // Same, from memory that is already in GPU layout (e.g. mapped archive blobs)
+  uint32_t uploadLodMesh(const Vertex* vertices, uint32_t vertexCount, const MeshLodLevel* levels,
+                         uint32_t levelCount, const uint32_t* indices, uint32_t indexCount);
+  // Copies a mesh and its meshlets (see buildMeshlets()) into the meshlet
+  // renderer's shared buffers; returns the meshlet renderer's mesh id
+  uint32_t uploadMeshletMesh(const MeshData& mesh, const MeshletData& meshlets);
+  // Same, from memory that is already in GPU layout (e.g. mapped archive blobs)
+  uint32_t uploadMeshletMesh(const Vertex* vertices, uint32_t vertexCount, const Meshlet* meshlets,
+                             uint32_t meshletCount, const uint32_t* meshletVertices, uint32_t meshletVertexCount,
+                             const uint8_t* triangles, uint32_t triangleByteCount);
+  // Drawn every frame from then on, culled per meshlet
+  uint32_t addMeshletInstance(uint32_t meshletMesh, const glm::mat4& transform);
 
 private:
   VulkanContext* m_vulkanContext;
   Window* m_window;
+  std::unique_ptr<DeletionQueue> m_deletionQueue;   // first, so it is destroyed after everything releasing to it
   std::unique_ptr<ImGuiManager> m_imguiManager;
+  std::unique_ptr<DescriptorAllocator> m_descriptorAllocator;
+  std::unique_ptr<DrawBatcher> m_drawBatcher;
+  std::unique_ptr<TextureStreamer> m_textureStreamer;
+  std::unique_ptr<ShaderCache> m_shaderCache;
+  std::unique_ptr<PipelineManager> m_pipelineManager;
+  std::unique_ptr<PostProcess> m_postProcess;
+  std::unique_ptr<ParticleSystem> m_particleSystem;
+  std::unique_ptr<UniformRing> m_uniformRing;
+  std::unique_ptr<SkinningPass> m_skinningPass;
+  std::unique_ptr<MeshletRenderer> m_meshletRenderer;
+  std::unique_ptr<LodSelector> m_lodSelector;
+  std::unique_ptr<ShadowCascades> m_shadows;
+  std::unique_ptr<ClusteredLighting> m_lighting;
+  std::unique_ptr<RenderThread> m_renderThread;
+
+  struct MeshAllocation {
+    VkBuffer vertexBuffer;
+    VkDeviceMemory vertexMemory;
+    VkBuffer indexBuffer;
+    VkDeviceMemory indexMemory;
+  };
+  std::vector<MeshAllocation> m_meshAllocations;
 
   // Swapchain
   VkSwapchainKHR m_swapchain;
@@ -31,10 +188,32 @@ private:
   VkFormat m_swapchainImageFormat;
   VkExtent2D m_swapchainExtent;
 
-  // Render pass and framebuffers
+  // Render pass and framebuffers, only used on RenderPath::RenderPass
+  RenderPath m_renderPath;
   VkRenderPass m_renderPass;
   std::vector<VkFramebuffer> m_framebuffers;
 
+  // HDR scene color and depth, allocated at m_maxRenderScale times the
+  // swapchain size and rendered at m_renderScale (m_sceneExtent)
+  float m_renderScale;
+  float m_maxRenderScale;
+  bool m_sceneTargetsDirty;
+  VkExtent2D m_sceneExtent;
+  VkExtent2D m_sceneTargetExtent;
+  DynamicResolution m_dynamicResolution;
+  std::vector<float> m_frameRenderScales;
+  VkFormat m_sceneColorFormat;
+  VkFormat m_sceneDepthFormat;
+  VkImage m_sceneColorImage;
+  VkDeviceMemory m_sceneColorMemory;
+  VkImageView m_sceneColorView;
+  VkImage m_sceneDepthImage;
+  VkDeviceMemory m_sceneDepthMemory;
+  VkImageView m_sceneDepthView;
+  VkRenderPass m_sceneRenderPass;
+  VkFramebuffer m_sceneFramebuffer;
+  VkRenderPass m_shadowRenderPass;   // render pass path only, like m_sceneRenderPass
+
   // Command buffers
   VkCommandPool m_commandPool;
   std::vector<VkCommandBuffer> m_commandBuffers;
@@ -44,21 +223,60 @@ private:
   std::vector<VkSemaphore> m_renderFinishedSemaphores;
   std::vector<VkFence> m_inFlightFences;
   uint32_t m_currentFrame;
-  static const int MAX_FRAMES_IN_FLIGHT = 2;
+  uint64_t m_frameNumber;
+
+  // Two timestamps per frame in flight
+  VkQueryPool m_timestampPool;
+  float m_timestampPeriod;
+  uint64_t m_timestampMask;
+  std::vector<bool> m_timestampsWritten;
+  FrameTimings m_frameTimings;
+
+  // Per-frame shader constants, bound from the uniform ring through one set at a dynamic offset
+  glm::mat4 m_view;
+  glm::mat4 m_projection;
+  VkDescriptorSet m_frameSet;
+  uint32_t m_frameConstantsOffset;
+  std::chrono::steady_clock::time_point m_startTime;
+  std::chrono::steady_clock::time_point m_lastFrameTime;
+  float m_frameDeltaTime;
+
+  // Written by the render thread, read after waitForRenderThread()
+  bool m_swapchainOutOfDate;
+  float m_recordMs;
 
   // Setup functions
-  void createSwapchain();
+  void createSwapchain(VkSwapchainKHR oldSwapchain = VK_NULL_HANDLE);
   void createImageViews();
   void createRenderPass();
   void createFramebuffers();
+  void chooseSceneFormats();
+  void createSceneRenderPass();
+  void createShadowRenderPass();
+  void createSceneTargets();
+  void releaseSceneTargets();
+  void rebuildSceneTargets();
   void createCommandPool();
   void createCommandBuffers();
   void createSyncObjects();
+  void createTimestampPool();
   
   // Helper functions
-  void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex);
-  VkSurfaceFormatKHR chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats);
-  VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes);
+  void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t frameIndex, uint32_t imageIndex);
+  // Runs on the render thread
+  void submitFrame(uint32_t frameIndex, uint32_t imageIndex);
+  // False when the frame recorded no timestamps
+  bool readTimestamps(uint32_t frame);
+  void updateSceneExtent();
+  void writeFrameConstants();
+  // Plots of every registered metric, see Core/Metrics.h
+  void drawMetricsPanel();
+  void uploadToDeviceLocal(const void* data, VkDeviceSize size, VkBufferUsageFlags usage,
+                           VkBuffer& buffer, VkDeviceMemory& memory);
+  // Through a staging buffer, waiting for the copy; buffer needs TRANSFER_DST usage. Does nothing for size 0.
+  void copyToBuffer(const void* data, VkDeviceSize size, VkBuffer buffer, VkDeviceSize offset);
+  VkSurfaceFormatKHR chooseSwapSurfaceFormat(const FrameVector<VkSurfaceFormatKHR>& availableFormats);
+  VkPresentModeKHR chooseSwapPresentMode(const FrameVector<VkPresentModeKHR>& availablePresentModes);
   VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities);
 };
 
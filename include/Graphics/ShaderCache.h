@@ -0,0 +1,127 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include "Graphics/SpirvReflection.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace plaster {
+
+class VulkanContext;
+class DeletionQueue;
+
+enum class ShaderStage {
+  Vertex,
+  Fragment,
+  Compute
+};
+
+struct ShaderDesc {
+  std::string path;                   // relative to the shader directory; .hlsl goes through dxc
+  ShaderStage stage = ShaderStage::Vertex;
+  std::vector<std::string> defines;   // "NAME" or "NAME=VALUE"
+  std::string entryPoint = "main";
+};
+
+struct ShaderHandle {
+  uint32_t index = UINT32_MAX;
+
+  bool isValid() const { return index != UINT32_MAX; }
+};
+
+// Compiles GLSL (glslc) and HLSL (dxc) to SPIR-V through the SDK compilers.
+// Results are cached on disk under a hash of the compiler version, the
+// command line, and the contents of the source and every file it includes,
+// so unchanged shaders are never recompiled across runs. With hot reload on,
+// a background thread watches those files, recompiles whatever changed, and
+// update() swaps the new modules in and reports which shaders were replaced.
+// Compiler paths can be overridden with PLASTER_GLSLC and PLASTER_DXC.
+class ShaderCache {
+public:
+  ShaderCache(VulkanContext* vulkanContext, DeletionQueue* deletionQueue, const std::string& shaderDirectory,
+              const std::string& cacheDirectory);
+  ~ShaderCache();
+
+  ShaderCache(const ShaderCache&) = delete;
+  ShaderCache& operator=(const ShaderCache&) = delete;
+
+  // Compiles on a cache miss; throws with the compiler output on failure.
+  // Loading the same desc twice returns the same handle.
+  ShaderHandle load(const ShaderDesc& desc);
+
+  VkShaderModule getModule(ShaderHandle handle) const { return m_shaders[handle.index].module; }
+  const ShaderReflection& getReflection(ShaderHandle handle) const { return m_shaders[handle.index].reflection; }
+  const std::vector<uint32_t>& getSpirv(ShaderHandle handle) const { return m_shaders[handle.index].spirv; }
+  const ShaderDesc& getDesc(ShaderHandle handle) const { return m_shaders[handle.index].desc; }
+
+  // Called from update() with every shader replaced since the last call.
+  // Replaced modules go to the deletion queue, so they stay valid for the rest of the frame.
+  using ReloadCallback = std::function<void(const std::vector<ShaderHandle>&)>;
+  void setReloadCallback(ReloadCallback callback) { m_reloadCallback = std::move(callback); }
+
+  void setHotReload(bool enabled);
+  void update();
+
+  uint32_t getCompileCount() const { return m_compileCount; }
+  uint32_t getCacheHitCount() const { return m_cacheHitCount; }
+
+private:
+  struct CompiledShader {
+    std::vector<uint32_t> spirv;
+    ShaderReflection reflection;
+    std::vector<std::filesystem::path> dependencies;   // source first, then includes
+    std::filesystem::file_time_type newestWrite;
+  };
+
+  struct Shader {
+    ShaderDesc desc;
+    uint64_t descHash = 0;
+    VkShaderModule module = VK_NULL_HANDLE;
+    std::vector<uint32_t> spirv;
+    ShaderReflection reflection;
+    std::vector<std::filesystem::path> dependencies;
+    std::filesystem::file_time_type newestWrite;
+  };
+
+  struct Reloaded {
+    uint32_t index;
+    CompiledShader compiled;
+  };
+
+  VulkanContext* m_vulkanContext;
+  DeletionQueue* m_deletionQueue;
+  std::filesystem::path m_shaderDirectory;
+  std::filesystem::path m_cacheDirectory;
+  std::vector<Shader> m_shaders;
+  ReloadCallback m_reloadCallback;
+
+  std::string m_compilerVersions[2];   // glslc, dxc
+  std::once_flag m_versionOnce[2];
+
+  // Guards m_shaders' dependency lists and m_reloaded against the watcher
+  std::mutex m_mutex;
+  std::condition_variable m_condition;
+  std::thread m_watcher;
+  bool m_watching;
+  std::vector<Reloaded> m_reloaded;
+
+  std::atomic<uint32_t> m_compileCount;
+  std::atomic<uint32_t> m_cacheHitCount;
+
+  bool compile(const ShaderDesc& desc, CompiledShader& result, std::string& error);
+  bool collectSources(const std::filesystem::path& file, std::vector<std::filesystem::path>& files,
+                      std::string& error) const;
+  const std::string& getCompilerVersion(bool hlsl);
+  std::string buildArguments(const ShaderDesc& desc, bool hlsl) const;
+  VkShaderModule createModule(const std::vector<uint32_t>& spirv) const;
+  void watcherLoop();
+};
+
+} // namespace plaster
@@ -0,0 +1,232 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <glm/glm.hpp>
+#include "Graphics/Mesh.h"
+#include "Graphics/PipelineManager.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace plaster {
+
+class VulkanContext;
+class DeletionQueue;
+class DrawBatcher;
+
+// Cascades of the sun's shadow map, tiled two by two in one atlas. Mirrored
+// in shaders/lighting.glsl.
+static const uint32_t SHADOW_CASCADE_COUNT = 4;
+
+struct ShadowSettings {
+  bool enabled = true;
+  // View depth the last cascade ends at
+  float maxDistance = 150.0f;
+  // Blend of logarithmic (1) and uniform (0) split distances
+  float splitLambda = 0.75f;
+  // How far toward the sun, past a cascade's bounds, casters still throw shadows into it
+  float casterDistance = 200.0f;
+  // Receiver offsets against acne: along the normal in texels of the
+  // receiving cascade, and toward the sun in world units
+  float normalOffset = 1.5f;
+  float depthBias = 0.05f;
+  // Cascades past the first two update on alternating frames
+  bool alternateDistant = true;
+  // Static casters are kept in a cache and only redrawn where something
+  // changed; off, every update draws every caster
+  bool cacheStatic = true;
+};
+
+// Totals of the last update()
+struct ShadowStats {
+  uint32_t casterCount = 0;
+  uint32_t cascadesUpdated = 0;
+  uint32_t fullRenders = 0;             // cascades whose static casters were all redrawn
+  uint32_t staticRegions = 0;           // revealed strips and dirty rectangles redrawn
+  uint64_t staticTexels = 0;            // covered by those
+  uint32_t staticInstances = 0;         // static casters drawn, once per region
+  uint32_t dynamicInstances = 0;
+  uint32_t drawCalls = 0;
+};
+
+// What a cascade was last rendered with, for sampling
+struct ShadowCascade {
+  glm::mat4 atlasMatrix = glm::mat4(1.0f);   // world space to atlas uv and depth
+  float splitDepth = 0.0f;                   // view depth the cascade ends at
+  float texelSize = 0.0f;                    // in world units
+  float depthRange = 1.0f;                   // world units spanned by depth 0 to 1
+};
+
+// Cascaded shadow maps for the sun. The view frustum up to maxDistance is
+// split into SHADOW_CASCADE_COUNT slices and each gets an orthographic map
+// around the slice's bounding sphere. The sphere's size only changes with the
+// projection, and the map's origin is snapped to whole texels in light space,
+// so the maps don't shimmer as the camera moves or turns.
+//
+// Casters are static or dynamic. A second atlas caches what the static
+// casters alone draw between updates: when the camera moves, the cached
+// map is copied over shifted by the whole texels the origin moved and only
+// the strips that came into view are drawn, and moving a static caster only
+// redraws the rectangles around where it was and where it is. Depth is
+// snapped coarsely toward the sun as well; crossing a step redraws the
+// cascade. Each update then copies the cached map into the sampled atlas and
+// draws the dynamic casters on top. A cascade with neither static changes nor
+// dynamic casters is left alone.
+//
+// The first two cascades update every frame, the others on alternating
+// frames, and every cascade is sampled with the matrix it was last rendered
+// with. Casters and settings are only read by update(), so they can change
+// at any time on the main thread.
+class ShadowCascades {
+public:
+  // renderPass is the pipeline manager id of a depth-only pass with depthFormat
+  // (a VkRenderPass with a loaded and stored attachment in
+  // DEPTH_STENCIL_ATTACHMENT_OPTIMAL on the render pass path, VK_NULL_HANDLE
+  // for dynamic rendering). atlasSize is the atlas' width and height.
+  ShadowCascades(VulkanContext* vulkanContext, PipelineManager* pipelineManager, DeletionQueue* deletionQueue,
+                 DrawBatcher* drawBatcher, uint32_t framesInFlight, uint32_t renderPass,
+                 VkRenderPass vkRenderPass, VkFormat depthFormat, uint32_t atlasSize);
+  ~ShadowCascades();
+
+  ShadowCascades(const ShadowCascades&) = delete;
+  ShadowCascades& operator=(const ShadowCascades&) = delete;
+
+  // mesh is a draw batcher mesh id; center and radius bound it in its own space
+  uint32_t addCaster(uint32_t mesh, const glm::mat4& transform, const glm::vec3& center, float radius,
+                     bool isStatic);
+  void setTransform(uint32_t caster, const glm::mat4& transform);
+  // Its id is handed out again by a later addCaster()
+  void removeCaster(uint32_t caster);
+
+  // On the main thread once per frame, once the frame's fence has been
+  // waited on. sunDirection points toward the sun.
+  void update(uint32_t frameIndex, const glm::mat4& view, const glm::mat4& projection,
+              const glm::vec3& sunDirection);
+  // Outside any render pass and before the scene pass; leaves the atlas
+  // ready for fragment shaders to sample
+  void record(VkCommandBuffer commandBuffer, uint32_t frameIndex);
+
+  // False until every cascade has been rendered
+  bool isReady() const;
+  const ShadowCascade& getCascade(uint32_t cascade) const { return m_cascades[cascade].sampled; }
+  VkImageView getAtlasView() const { return m_atlasView; }
+  // Compares against the atlas with linear filtering
+  VkSampler getSampler() const { return m_sampler; }
+  uint32_t getAtlasSize() const { return m_atlasSize; }
+
+  ShadowSettings& getSettings() { return m_settings; }
+  const ShadowSettings& getSettings() const { return m_settings; }
+  const ShadowStats& getStats() const { return m_stats; }
+
+private:
+  struct Caster {
+    uint32_t mesh;
+    glm::mat4 transform;
+    glm::vec3 center;   // own space
+    float radius;
+    glm::vec4 sphere;   // world space
+    bool isStatic;
+    bool active;
+  };
+
+  // Inclusive-exclusive rectangle in the pixels of a cascade's tile
+  struct Rect {
+    int32_t x0, y0, x1, y1;
+  };
+
+  struct Cascade {
+    ShadowCascade sampled;
+    glm::mat4 viewProjection;    // light clip space, as last rendered
+    // Light space placement of the cached static map, in texels and depth steps
+    int64_t originX = 0;
+    int64_t originY = 0;
+    int64_t depthStep = 0;
+    float radius = 0.0f;
+    float depthMin = 0.0f;       // light view depths mapped to 0 and 1
+    float depthMax = 1.0f;
+    bool rendered = false;       // the live tile holds a complete map
+    bool cached = false;         // the static tile matches the origin above
+    bool hadDynamic = false;     // the live tile holds dynamic casters
+    std::vector<glm::vec4> dirty;   // world space spheres whose static casters need redrawing
+  };
+
+  struct Draw {
+    GpuMesh mesh;
+    uint32_t firstInstance;
+    uint32_t instanceCount;
+  };
+
+  // Drawn within one cascade's tile, scissored to rect; cleared first for static casters
+  struct Region {
+    uint32_t cascade;
+    VkRect2D rect;
+    bool clear;
+    uint32_t firstDraw;
+    uint32_t drawCount;
+  };
+
+  struct InstanceBuffer {
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    InstanceData* mapped = nullptr;
+    uint32_t capacity = 0;
+  };
+
+  VulkanContext* m_vulkanContext;
+  PipelineManager* m_pipelineManager;
+  DeletionQueue* m_deletionQueue;
+  DrawBatcher* m_drawBatcher;
+  PipelineHandle m_pipeline;
+  VkRenderPass m_renderPass;
+  VkFormat m_depthFormat;
+  uint32_t m_atlasSize;
+  uint32_t m_tileSize;
+  ShadowSettings m_settings;
+  ShadowStats m_stats;
+
+  std::vector<Caster> m_casters;
+  std::vector<uint32_t> m_freeCasters;
+
+  VkImage m_atlas;              // sampled: cached static casters plus dynamic ones
+  VkDeviceMemory m_atlasMemory;
+  VkImageView m_atlasView;
+  VkImage m_staticAtlas;        // static casters only
+  VkDeviceMemory m_staticMemory;
+  VkFramebuffer m_framebuffer;  // render pass path only
+  VkSampler m_sampler;
+  bool m_atlasInitialized;
+  bool m_staticInitialized;
+
+  Cascade m_cascades[SHADOW_CASCADE_COUNT];
+  glm::vec3 m_sunDirection;
+  glm::mat4 m_lightView;
+  float m_casterDistance;
+  uint64_t m_frame;
+  std::vector<InstanceBuffer> m_instanceBuffers;   // per frame in flight
+
+  // Written by update() for the next record()
+  std::vector<Draw> m_draws;
+  std::vector<Region> m_staticRegions;
+  std::vector<Region> m_dynamicRegions;
+  std::vector<VkImageCopy> m_restoreCopies;   // static atlas to atlas
+  std::vector<VkImageCopy> m_storeCopies;     // atlas to static atlas
+  bool m_record;
+
+  // Scratch for update()
+  std::vector<uint32_t> m_visible;
+  std::vector<InstanceData> m_instances;
+  std::vector<Rect> m_casterRects;   // per caster, in the cascade being updated
+
+  void invalidate(const glm::vec4& sphere);
+  // Places the cascade around the sphere and queues what has to be redrawn
+  void updateCascade(uint32_t index, const glm::vec3& center, float radius, float splitDepth);
+  // Casters of one kind overlapping rect, appended as draws batched by mesh
+  void addRegion(std::vector<Region>& regions, uint32_t cascade, const Rect& rect, bool clear, bool isStatic);
+  // Tile pixels a world space sphere covers; empty outside the cascade's depth range
+  Rect casterRect(const Cascade& cascade, const glm::vec4& sphere) const;
+  void ensureInstanceCapacity(InstanceBuffer& buffer, uint32_t count);
+  void drawRegions(VkCommandBuffer commandBuffer, const std::vector<Region>& regions, VkBuffer instanceBuffer);
+  void beginPass(VkCommandBuffer commandBuffer);
+  void endPass(VkCommandBuffer commandBuffer);
+};
+
+} // namespace plaster
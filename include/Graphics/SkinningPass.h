@@ -0,0 +1,108 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include "Graphics/Mesh.h"
+#include "Graphics/PipelineManager.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace plaster {
+
+class VulkanContext;
+class DeletionQueue;
+class DescriptorAllocator;
+class UniformRing;
+struct SkinningMatrix;
+
+// Skins every animated instance in one compute dispatch. Source vertices of
+// all skinned meshes share one storage buffer; each instance owns a range of
+// a shared output buffer in the regular Vertex layout, which the draw batcher
+// and every later pass read like any other vertex buffer. The palettes of
+// all characters and a table of instances are streamed through the uniform
+// ring each frame, so nothing is uploaded through staging after setup.
+//
+// Like ParticleSystem, meshes and instances are read while recording: add
+// them only after Renderer::waitForRenderThread().
+class SkinningPass {
+public:
+  // Capacities are in vertices
+  SkinningPass(VulkanContext* vulkanContext, PipelineManager* pipelineManager, DeletionQueue* deletionQueue,
+               UniformRing* uniformRing, uint32_t sourceCapacity, uint32_t outputCapacity);
+  ~SkinningPass();
+
+  SkinningPass(const SkinningPass&) = delete;
+  SkinningPass& operator=(const SkinningPass&) = delete;
+
+  // Reserves vertexCount source vertices for the caller to copy in at
+  // getSourceOffset(). Throws when the source buffer is full.
+  uint32_t addMesh(uint32_t vertexCount, VkBuffer indexBuffer, uint32_t indexCount);
+  VkBuffer getSourceBuffer() const { return m_source.buffer; }
+  VkDeviceSize getSourceOffset(uint32_t mesh) const { return m_meshes[mesh].firstVertex * sizeof(SkinnedVertex); }
+
+  // Reserves an output range skinned with the palette starting at joint
+  // paletteOffset (see Animator). Register the returned mesh with the draw
+  // batcher to draw it. Throws when the output buffer is full.
+  GpuMesh addInstance(uint32_t mesh, uint32_t paletteOffset);
+
+  // Joint palettes the next update() copies; they only have to stay valid until then
+  void setPalettes(const SkinningMatrix* palettes, uint32_t count);
+  // On the main thread once per frame, after the uniform ring's beginFrame()
+  void update();
+  // Outside any render pass, before anything draws the skinned vertices
+  void record(VkCommandBuffer commandBuffer, DescriptorAllocator* descriptorAllocator);
+
+  VkBuffer getOutputBuffer() const { return m_output.buffer; }
+  uint32_t getInstanceCount() const { return static_cast<uint32_t>(m_instances.size()); }
+
+private:
+  struct StorageBuffer {
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize size = 0;
+  };
+
+  struct SkinnedMesh {
+    uint32_t firstVertex;
+    uint32_t vertexCount;
+    VkBuffer indexBuffer;
+    uint32_t indexCount;
+  };
+
+  // Mirrors Instance in shaders/skinning.comp
+  struct Instance {
+    uint32_t firstSource;
+    uint32_t vertexCount;
+    uint32_t firstOutput;
+    uint32_t firstJoint;
+  };
+
+  VulkanContext* m_vulkanContext;
+  PipelineManager* m_pipelineManager;
+  DeletionQueue* m_deletionQueue;
+  UniformRing* m_uniformRing;
+  PipelineHandle m_pipeline;
+
+  StorageBuffer m_source;
+  StorageBuffer m_output;
+  uint32_t m_sourceCapacity;
+  uint32_t m_outputCapacity;
+  uint32_t m_sourceUsed;
+  uint32_t m_outputUsed;
+  uint32_t m_maxVertexCount;
+
+  std::vector<SkinnedMesh> m_meshes;
+  std::vector<Instance> m_instances;
+  const SkinningMatrix* m_palettes;
+  uint32_t m_paletteCount;
+
+  // Written by update() for the next record()
+  bool m_active;
+  uint32_t m_paletteOffset;
+  uint32_t m_paletteSize;
+  uint32_t m_instanceOffset;
+  uint32_t m_instanceSize;
+
+  StorageBuffer createStorageBuffer(VkDeviceSize size, VkBufferUsageFlags usage, const char* name);
+};
+
+} // namespace plaster
@@ -0,0 +1,34 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace plaster {
+
+struct ShaderResourceBinding {
+  uint32_t set = 0;
+  uint32_t binding = 0;
+  VkDescriptorType type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+  uint32_t count = 1;          // 0 for runtime-sized arrays
+  VkShaderStageFlags stages = 0;
+};
+
+struct ShaderReflection {
+  VkShaderStageFlagBits stage = VK_SHADER_STAGE_VERTEX_BIT;
+  std::vector<ShaderResourceBinding> bindings;
+  uint32_t pushConstantSize = 0;
+  uint32_t localSize[3] = {1, 1, 1};   // compute only
+};
+
+// Minimal SPIR-V parser: pulls the entry stage, descriptor bindings, push
+// constant block size and compute local size out of a module. Enough to
+// build set and pipeline layouts without a dependency on SPIRV-Cross.
+// Uniform blocks are reported as UNIFORM_BUFFER_DYNAMIC, see UniformRing.
+bool reflectSpirv(const uint32_t* words, size_t wordCount, ShaderReflection& reflection);
+
+// Union of the bindings of several stages for one set, sorted by binding
+std::vector<VkDescriptorSetLayoutBinding> mergeSetBindings(const std::vector<const ShaderReflection*>& stages,
+                                                           uint32_t set);
+
+} // namespace plaster
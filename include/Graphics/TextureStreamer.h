@@ -0,0 +1,131 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <cstdint>
+#include <string>
+
+namespace plaster {
+
+class VulkanContext;
+class DeletionQueue;
+class AssetArchive;
+struct ArchiveEntry;
+
+struct TextureHandle {
+  uint32_t index = UINT32_MAX;
+
+  bool isValid() const { return index != UINT32_MAX; }
+};
+
+struct TextureStreamingStats {
+  uint32_t textureCount = 0;
+  uint32_t pendingPromotions = 0;
+  VkDeviceSize residentBytes = 0;
+  VkDeviceSize budgetBytes = 0;
+  VkDeviceSize uploadedBytes = 0;
+};
+
+// Streams textures mip by mip. Only the mip tail is loaded up front, so a
+// texture can be sampled right away. Higher mips are added one level at a
+// time as requestMip() asks for them (residency is request-driven only), and
+// dropped again under memory pressure. Each texture's image holds only the resident levels:
+// promoting or demoting allocates a new image, copies the shared levels on
+// the GPU, and hands the old image to the deletion queue. Uploads use a
+// dedicated staging ring and command buffers on the graphics queue, submitted
+// from update() ahead of the frame, so the frame's fence covers them too.
+class TextureStreamer {
+public:
+  TextureStreamer(VulkanContext* vulkanContext, DeletionQueue* deletionQueue, uint32_t framesInFlight,
+                  VkDeviceSize budget);
+  ~TextureStreamer();
+
+  TextureStreamer(const TextureStreamer&) = delete;
+  TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+  // The archive must outlive the texture; uncompressed entries are read in place
+  TextureHandle load(const AssetArchive& archive, const std::string& path);
+  void release(TextureHandle handle);
+
+  // Desired detail for this frame; the finest request per frame wins
+  void requestMip(TextureHandle handle, uint32_t mip);
+
+  // Call once per frame, before recording; uploads go out on the next free slot
+  void update(uint64_t frameNumber);
+
+  VkImageView getImageView(TextureHandle handle) const;
+  VkSampler getSampler() const { return m_sampler; }
+  uint32_t getResidentMip(TextureHandle handle) const;
+
+  static const uint32_t MAX_TEXTURES = 4096;
+
+  void setBudget(VkDeviceSize bytes) { m_budget = bytes; }
+  TextureStreamingStats getStats() const;
+
+private:
+  struct Texture {
+    const AssetArchive* archive = nullptr;
+    const ArchiveEntry* entry = nullptr;
+    std::vector<uint8_t> decompressed;   // only for compressed archive entries
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t mipCount = 0;
+    uint32_t mipTail = 0;                // first level of the always-resident tail
+
+    VkImage image = VK_NULL_HANDLE;
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkImageView view = VK_NULL_HANDLE;
+    VkDeviceSize memorySize = 0;
+    uint32_t residentMip = UINT32_MAX;   // UINT32_MAX until the tail is uploaded
+
+    uint32_t desiredMip = 0;
+    uint32_t requestedThisFrame = UINT32_MAX;
+    uint64_t lastRequestFrame = 0;
+    bool alive = false;
+  };
+
+  struct UploadSlot {
+    VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+    VkFence fence = VK_NULL_HANDLE;
+  };
+
+  VulkanContext* m_vulkanContext;
+  DeletionQueue* m_deletionQueue;
+  VkDeviceSize m_budget;
+  VkDeviceSize m_residentBytes;
+  VkDeviceSize m_uploadedBytes;
+  uint64_t m_frameNumber;
+
+  std::vector<Texture> m_textures;
+  std::vector<uint32_t> m_freeSlots;
+
+  VkCommandPool m_commandPool;
+  std::vector<UploadSlot> m_uploadSlots;
+  uint32_t m_currentSlot;
+  bool m_recording;
+  VkBuffer m_stagingBuffer;
+  VkDeviceMemory m_stagingMemory;
+  uint8_t* m_stagingMapped;
+  VkDeviceSize m_stagingOffset;
+
+  VkSampler m_sampler;
+  VkImage m_placeholderImage;
+  VkDeviceMemory m_placeholderMemory;
+  VkImageView m_placeholderView;
+
+  static const VkDeviceSize STAGING_SLOT_SIZE = 16ull * 1024 * 1024;
+  static const uint32_t MIP_TAIL_DIMENSION = 64;
+  static const uint32_t DEMOTE_AFTER_FRAMES = 120;
+  static const uint32_t MAX_RESIDENCY_CHANGES_PER_FRAME = 16;
+
+  const uint8_t* getMipData(const Texture& texture, uint32_t mip, VkDeviceSize& size) const;
+  VkExtent2D getMipExtent(const Texture& texture, uint32_t mip) const;
+  bool changeResidency(VkCommandBuffer commandBuffer, Texture& texture, uint32_t newResidentMip);
+  bool stageMip(const Texture& texture, uint32_t mip, VkDeviceSize& stagingOffset);
+  VkDeviceSize getStagingSize(const Texture& texture, uint32_t firstMip, uint32_t endMip) const;
+  void createImage(const Texture& texture, uint32_t baseMip, VkImage& image, VkDeviceMemory& memory,
+                   VkImageView& view, VkDeviceSize& memorySize);
+  void createPlaceholder();
+};
+
+} // namespace plaster
@@ -0,0 +1,67 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <cstring>
+
+namespace plaster {
+
+class VulkanContext;
+
+struct UniformAllocation {
+  void* data = nullptr;
+  uint32_t offset = 0;   // from the start of the buffer, usable as a dynamic offset
+};
+
+// One persistently mapped buffer split into a region per frame in flight,
+// for uniform and storage data rewritten every frame. allocate() bumps
+// through the current frame's region at the device's offset alignment.
+// Uniform blocks are bound through a descriptor set written once with
+// UNIFORM_BUFFER_DYNAMIC and the block's size as its range, so using new
+// data costs only a dynamic offset. On memory that isn't host coherent,
+// flush() publishes everything written since the last flush with a single
+// vkFlushMappedMemoryRanges; it has to run before the frame is submitted.
+//
+// Small data that changes per draw belongs in push constants instead.
+class UniformRing {
+public:
+  // frameSize is rounded up to the offset and flush alignments
+  UniformRing(VulkanContext* vulkanContext, uint32_t framesInFlight, VkDeviceSize frameSize);
+  ~UniformRing();
+
+  UniformRing(const UniformRing&) = delete;
+  UniformRing& operator=(const UniformRing&) = delete;
+
+  // Once the fence of frameIndex has been waited on
+  void beginFrame(uint32_t frameIndex);
+
+  // Valid until the same frame index comes around again. Throws when the frame's region is full.
+  UniformAllocation allocate(VkDeviceSize size);
+  template <typename T>
+  uint32_t push(const T& value) {
+    UniformAllocation allocation = allocate(sizeof(T));
+    std::memcpy(allocation.data, &value, sizeof(T));
+    return allocation.offset;
+  }
+
+  void flush();
+
+  VkBuffer getBuffer() const { return m_buffer; }
+  VkDeviceSize getFrameSize() const { return m_frameSize; }
+  VkDeviceSize getUsed() const { return m_head; }
+  bool isCoherent() const { return m_coherent; }
+
+private:
+  VulkanContext* m_vulkanContext;
+  VkBuffer m_buffer;
+  VkDeviceMemory m_memory;
+  char* m_mapped;
+  bool m_coherent;
+  VkDeviceSize m_alignment;
+  VkDeviceSize m_atomSize;
+  VkDeviceSize m_frameSize;
+  VkDeviceSize m_frameStart;
+  VkDeviceSize m_head;      // relative to m_frameStart
+  VkDeviceSize m_flushed;   // relative to m_frameStart
+};
+
+} // namespace plaster
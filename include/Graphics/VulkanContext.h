@@ -1,11 +1,46 @@
 #pragma once
 #include <vulkan/vulkan.h>
 #include <cstdint>
+#include <string>
 
 namespace plaster {
 
 class Window;
 
+// What the selected device has enabled; every optional feature the engine
+// knows about is turned on when the device offers it
+struct DeviceCapabilities {
+  std::string deviceName;
+  VkPhysicalDeviceType deviceType = VK_PHYSICAL_DEVICE_TYPE_OTHER;
+  uint32_t apiVersion = VK_API_VERSION_1_0;   // negotiated with the loader, at most 1.3
+  VkDeviceSize deviceLocalMemory = 0;
+
+  bool dynamicRendering = false;       // together with synchronization2 (1.3)
+  bool descriptorIndexing = false;     // runtime arrays, partially bound, update after bind (1.2)
+  bool timelineSemaphore = false;      // 1.2
+  bool drawIndirectCount = false;      // 1.2
+  bool shaderDrawParameters = false;   // 1.1
+  bool memoryBudget = false;           // VK_EXT_memory_budget
+  bool samplerAnisotropy = false;
+  bool multiDrawIndirect = false;
+
+  float timestampPeriod = 0.0f;
+  float maxSamplerAnisotropy = 1.0f;
+  uint32_t maxPushConstantsSize = 128;
+  VkDeviceSize minUniformBufferOffsetAlignment = 256;
+  VkDeviceSize minStorageBufferOffsetAlignment = 256;
+  VkDeviceSize nonCoherentAtomSize = 256;
+  uint32_t maxUniformBufferRange = 16384;
+};
+
+// Picks the highest scoring GPU (discrete over integrated over software,
+// then VRAM and optional features), or the one named by PLASTER_GPU, which
+// takes either an index into the logged device list or part of its name.
+//
+// Builds with PLASTER_VULKAN_DEBUG also load the Khronos validation layer
+// when it is installed and route its messages to the log. PLASTER_VALIDATION
+// tunes it: "0" turns it off, "sync" adds synchronization validation and
+// "verbose" logs info messages too (e.g. PLASTER_VALIDATION=sync,verbose).
 class VulkanContext {
 public:
   VulkanContext(Window* window);
@@ -17,6 +52,20 @@ public:
   VkSurfaceKHR getSurface() const { return m_surface; }
   VkQueue getGraphicsQueue() const { return m_graphicsQueue; }
   uint32_t getGraphicsQueueFamily() const { return m_graphicsQueueFamily; }
+  uint32_t getApiVersion() const { return m_capabilities.apiVersion; }
+  const DeviceCapabilities& getCapabilities() const { return m_capabilities; }
+  bool isValidationEnabled() const { return m_validationEnabled; }
+
+  VkDeviceSize getDeviceLocalMemorySize() const;
+  // What the driver says this process can still use, minus other processes' usage;
+  // the heap size when VK_EXT_memory_budget is missing
+  VkDeviceSize getDeviceLocalBudget() const;
+  uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
+  void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
+                    VkBuffer& buffer, VkDeviceMemory& memory) const;
+  // Dedicated allocation, for render targets and other long-lived images
+  void createImage(const VkImageCreateInfo& imageInfo, VkMemoryPropertyFlags properties,
+                   VkImage& image, VkDeviceMemory& memory) const;
 private:
   VkInstance m_instance;
   VkPhysicalDevice m_physicalDevice;
@@ -24,6 +73,10 @@ private:
   VkSurfaceKHR m_surface;
   VkQueue m_graphicsQueue;
   uint32_t m_graphicsQueueFamily;
+  uint32_t m_instanceVersion;
+  DeviceCapabilities m_capabilities;
+  VkDebugUtilsMessengerEXT m_debugMessenger;
+  bool m_validationEnabled;
   Window* m_window;
 
   void createInstance();
@@ -0,0 +1,91 @@
+#pragma once
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <string>
+#include <type_traits>
+
+// Vulkan debugging aids, all but the handle conversions gated on
+// PLASTER_VULKAN_DEBUG (set for Debug builds by CMake, see the
+// PLASTER_VULKAN_DEBUG option). Without it the macros below expand to
+// nothing, so names and labels are never even built, and PLASTER_VK_CHECK
+// still makes the call but ignores the result.
+//
+//   PLASTER_VK_CHECK(vkCreateFence(...));                  throws on failure
+//   PLASTER_VK_NAME(device, VK_OBJECT_TYPE_FENCE, fence, "Frame fence");
+//   PLASTER_VK_LABEL(commandBuffer, "Shadows");            until end of scope
+
+namespace plaster {
+namespace vkdebug {
+
+// Any handle as the 64 bits Vulkan identifies objects by, and back; available
+// in every build. Non-dispatchable handles are integers on 32-bit builds.
+template <typename T>
+uint64_t handleBits(T handle) {
+  if constexpr (std::is_pointer_v<T>) {
+    return static_cast<uint64_t>(reinterpret_cast<uintptr_t>(handle));
+  } else {
+    return static_cast<uint64_t>(handle);
+  }
+}
+
+template <typename T>
+T fromBits(uint64_t bits) {
+  if constexpr (std::is_pointer_v<T>) {
+    return reinterpret_cast<T>(static_cast<uintptr_t>(bits));
+  } else {
+    return static_cast<T>(bits);
+  }
+}
+
+#ifdef PLASTER_VULKAN_DEBUG
+
+// Throws std::runtime_error naming the call and its location unless result is VK_SUCCESS
+// or one of the non-error codes (VK_SUBOPTIMAL_KHR, VK_TIMEOUT, ...)
+void check(VkResult result, const char* expression, const char* file, int line);
+
+// Resolves the VK_EXT_debug_utils entry points; until then naming and labels do nothing
+void loadFunctions(VkInstance instance);
+
+// Severity filter is warning and up unless verbose; messages go to the "vulkan" log channel
+VkDebugUtilsMessengerCreateInfoEXT messengerCreateInfo(bool verbose);
+VkDebugUtilsMessengerEXT createMessenger(VkInstance instance, bool verbose);
+void destroyMessenger(VkInstance instance, VkDebugUtilsMessengerEXT messenger);
+
+void setObjectName(VkDevice device, VkObjectType type, uint64_t handle, const std::string& name);
+void beginLabel(VkCommandBuffer commandBuffer, const std::string& name);
+void endLabel(VkCommandBuffer commandBuffer);
+
+class ScopedLabel {
+public:
+  ScopedLabel(VkCommandBuffer commandBuffer, const std::string& name) : m_commandBuffer(commandBuffer) {
+    beginLabel(commandBuffer, name);
+  }
+  ~ScopedLabel() { endLabel(m_commandBuffer); }
+
+  ScopedLabel(const ScopedLabel&) = delete;
+  ScopedLabel& operator=(const ScopedLabel&) = delete;
+
+private:
+  VkCommandBuffer m_commandBuffer;
+};
+
+#endif
+
+} // namespace vkdebug
+} // namespace plaster
+
+#define PLASTER_VK_CONCAT_INNER(a, b) a##b
+#define PLASTER_VK_CONCAT(a, b) PLASTER_VK_CONCAT_INNER(a, b)
+
+#ifdef PLASTER_VULKAN_DEBUG
+#define PLASTER_VK_CHECK(expr) ::plaster::vkdebug::check((expr), #expr, __FILE__, __LINE__)
+#define PLASTER_VK_NAME(device, type, handle, name) \
+  ::plaster::vkdebug::setObjectName((device), (type), ::plaster::vkdebug::handleBits(handle), (name))
+#define PLASTER_VK_LABEL(commandBuffer, name) \
+  ::plaster::vkdebug::ScopedLabel PLASTER_VK_CONCAT(vkDebugLabel, __LINE__)((commandBuffer), (name))
+#else
+#define PLASTER_VK_CHECK(expr) static_cast<void>(expr)
+#define PLASTER_VK_NAME(device, type, handle, name) static_cast<void>(0)
+#define PLASTER_VK_LABEL(commandBuffer, name) static_cast<void>(0)
+#endif
@@ -0,0 +1,83 @@
+#pragma once
+#include "Scene/Bounds.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace plaster {
+
+class JobSystem;
+
+struct BodyPair {
+  uint32_t bodyA;   // the lower id
+  uint32_t bodyB;
+
+  uint64_t getKey() const { return (static_cast<uint64_t>(bodyA) << 32) | bodyB; }
+};
+
+// Sweep and prune. Bounds are kept sorted by their minimum along one axis,
+// the one the bodies are most spread out on, in structure of arrays form, so
+// each body only has to be tested against the run of bodies that start
+// before it ends on that axis, four at a time with SSE. Between steps bodies
+// barely move, so the order is repaired with an insertion sort that costs
+// little more than a pass over the arrays.
+//
+// The sweep is split over the job system. Pairs of two static proxies are
+// never reported.
+class SweepAndPrune {
+public:
+  explicit SweepAndPrune(JobSystem* jobSystem);
+
+  SweepAndPrune(const SweepAndPrune&) = delete;
+  SweepAndPrune& operator=(const SweepAndPrune&) = delete;
+
+  void add(uint32_t id, const Aabb& bounds, bool isStatic);
+  void remove(uint32_t id);
+  // Takes effect at the next findPairs(). Safe to call for different ids from
+  // several threads at once.
+  void setBounds(uint32_t id, const Aabb& bounds) { m_bounds[id] = bounds; }
+
+  // Sorts and replaces pairs with every overlapping one, ordered by getKey()
+  void findPairs(std::vector<BodyPair>& pairs);
+
+  uint32_t getProxyCount() const { return static_cast<uint32_t>(m_order.size()); }
+  uint32_t getAxis() const { return m_axis; }
+  // Elements moved by the last insertion sort; a full sort counts as 0
+  uint32_t getLastSwapCount() const { return m_lastSwapCount; }
+
+private:
+  struct SortKey {
+    float min;
+    uint32_t id;
+  };
+
+  JobSystem* m_jobSystem;
+  std::vector<Aabb> m_bounds;               // by id
+  std::vector<uint8_t> m_static;            // by id
+  std::vector<uint8_t> m_present;           // by id
+  std::vector<SortKey> m_order;             // sorted by min along m_axis
+  uint32_t m_axis;
+  uint32_t m_addedSinceSort;
+  bool m_removedSinceSort;
+  uint32_t m_lastSwapCount;
+
+  // The sorted bounds, padded with SIMD_PADDING entries that overlap nothing
+  std::vector<float> m_sweepMin;
+  std::vector<float> m_sweepMax;
+  std::vector<float> m_minA;                // the two other axes
+  std::vector<float> m_maxA;
+  std::vector<float> m_minB;
+  std::vector<float> m_maxB;
+  std::vector<uint8_t> m_sortedStatic;
+  std::vector<std::vector<BodyPair>> m_batchPairs;
+
+  static const uint32_t SIMD_PADDING = 4;
+  static const uint32_t SWEEP_BATCH = 256;
+
+  void removeStale();
+  void chooseAxis();
+  void sortOrder();
+  void sweep(uint32_t begin, uint32_t end, std::vector<BodyPair>& pairs) const;
+};
+
+} // namespace plaster
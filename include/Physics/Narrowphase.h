@@ -0,0 +1,44 @@
+#pragma once
+#include "Physics/RigidBody.h"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+
+namespace plaster {
+
+struct ContactPoint {
+  glm::vec3 position;         // world space, halfway between the surfaces
+  glm::vec3 localAnchorA;     // position in body A's frame, to match points between steps
+  float separation;           // negative while penetrating
+  // Accumulated by the solver and carried over to the next step's matching point
+  float normalImpulse;
+};
+
+static const uint32_t MAX_CONTACT_POINTS = 4;
+
+struct ContactManifold {
+  uint32_t bodyA;
+  uint32_t bodyB;
+  glm::vec3 normal;           // from A towards B
+  uint32_t pointCount;
+  ContactPoint points[MAX_CONTACT_POINTS];
+  // Friction acts on the manifold as a whole, at the middle of its points
+  float tangentImpulse[2];
+  float twistImpulse;
+
+  uint64_t getKey() const { return (static_cast<uint64_t>(bodyA) << 32) | bodyB; }
+};
+
+// Writes the contact points of two shapes closer than margin to each other,
+// with no impulses yet, and returns whether there were any. Boxes get up to
+// four points from clipping one face against the other, so stacks rest
+// flat. Pure function of the two bodies; safe from any thread.
+bool collide(const RigidBody& a, const RigidBody& b, float margin, ContactManifold& manifold);
+
+// Copies the impulses of points in previous that are close to one of
+// current's, and the friction impulses if any point matched, so the solver
+// starts from last step's answer
+void matchContacts(const ContactManifold& previous, ContactManifold& current);
+
+} // namespace plaster
@@ -0,0 +1,103 @@
+#pragma once
+#include "Physics/Broadphase.h"
+#include "Physics/Narrowphase.h"
+#include "Physics/RigidBody.h"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace plaster {
+
+class JobSystem;
+
+struct PhysicsStepStats {
+  double broadphaseMs = 0.0;
+  double narrowphaseMs = 0.0;
+  double solverMs = 0.0;      // island building, solving and integration
+  uint32_t pairCount = 0;
+  uint32_t contactCount = 0;  // manifolds with at least one point
+  uint32_t islandCount = 0;
+  uint32_t largestIsland = 0; // in bodies
+  uint32_t awakeBodyCount = 0;
+};
+
+// Rigid bodies of boxes and spheres. A step finds overlapping bounds with
+// sweep and prune, generates contacts for the pairs in parallel batches,
+// splits the awake bodies into islands connected by contacts and solves
+// the islands in parallel with sequential impulses, warm started from the
+// last step. Islands that stay still long enough go to sleep and cost
+// nothing until something touches them.
+//
+// A single pile where everything touches is one island and solves on one
+// thread. Meant to be stepped at a fixed rate (see Application::run()).
+class PhysicsWorld {
+public:
+  explicit PhysicsWorld(JobSystem* jobSystem);
+
+  PhysicsWorld(const PhysicsWorld&) = delete;
+  PhysicsWorld& operator=(const PhysicsWorld&) = delete;
+
+  // Returns the body id, stable until it is destroyed
+  uint32_t createBody(const BodyDesc& desc);
+  void destroyBody(uint32_t body);
+
+  const RigidBody& getBody(uint32_t body) const { return m_bodies[body]; }
+  glm::mat4 getTransform(uint32_t body) const;
+  // These wake the body
+  void setTransform(uint32_t body, const glm::vec3& position, const glm::quat& orientation);
+  void setVelocity(uint32_t body, const glm::vec3& linear, const glm::vec3& angular);
+  void applyImpulse(uint32_t body, const glm::vec3& impulse, const glm::vec3& point);
+
+  void setGravity(const glm::vec3& gravity) { m_gravity = gravity; }
+  const glm::vec3& getGravity() const { return m_gravity; }
+
+  void step(float timeStep);
+
+  uint32_t getBodyCount() const { return m_bodyCount; }
+  // Manifolds of the last step, each with at least one point
+  const std::vector<ContactManifold>& getContacts() const { return m_manifolds; }
+  const PhysicsStepStats& getLastStepStats() const { return m_stats; }
+
+private:
+  struct Island {
+    uint32_t bodyBegin;         // into m_islandBodies
+    uint32_t bodyCount;
+    uint32_t manifoldBegin;     // into m_islandManifolds
+    uint32_t manifoldCount;
+  };
+
+  JobSystem* m_jobSystem;
+  SweepAndPrune m_broadphase;
+  std::vector<RigidBody> m_bodies;
+  std::vector<uint32_t> m_freeBodies;
+  uint32_t m_bodyCount;
+  glm::vec3 m_gravity;
+
+  std::vector<BodyPair> m_pairs;
+  std::vector<ContactManifold> m_pairManifolds;       // one per pair, many empty
+  std::vector<ContactManifold> m_manifolds;           // sorted by key
+  std::vector<ContactManifold> m_previousManifolds;
+
+  std::vector<uint32_t> m_islandParents;              // union-find over body ids
+  std::vector<uint32_t> m_islandIndices;              // body id -> island
+  std::vector<uint32_t> m_islandBodies;
+  std::vector<uint32_t> m_islandManifolds;
+  std::vector<Island> m_islands;
+  std::vector<uint32_t> m_solverIndices;              // body id -> index within its island's solve
+
+  PhysicsStepStats m_stats;
+
+  static const uint32_t VELOCITY_ITERATIONS = 8;
+  static const uint32_t PAIRS_PER_JOB = 64;
+  static const uint32_t ISLANDS_PER_JOB = 16;
+
+  void findContacts();
+  void buildIslands();
+  void solveIsland(const Island& island, float timeStep);
+  uint32_t findIslandRoot(uint32_t body);
+  void wake(RigidBody& body);
+};
+
+} // namespace plaster
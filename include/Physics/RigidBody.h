@@ -0,0 +1,64 @@
+#pragma once
+#include "Scene/Bounds.h"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <cstdint>
+
+namespace plaster {
+
+enum class ShapeType : uint8_t { Sphere, Box };
+
+struct CollisionShape {
+  ShapeType type = ShapeType::Box;
+  glm::vec3 halfExtents = glm::vec3(0.5f);   // boxes
+  float radius = 0.5f;                        // spheres
+
+  static CollisionShape sphere(float radius);
+  static CollisionShape box(const glm::vec3& halfExtents);
+};
+
+// Static bodies never move. Kinematic ones move at the velocity they are
+// given and push dynamic ones without being pushed back.
+enum class BodyType : uint8_t { Static, Kinematic, Dynamic };
+
+struct BodyDesc {
+  BodyType type = BodyType::Dynamic;
+  CollisionShape shape;
+  glm::vec3 position = glm::vec3(0.0f);
+  glm::quat orientation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+  glm::vec3 linearVelocity = glm::vec3(0.0f);
+  glm::vec3 angularVelocity = glm::vec3(0.0f);
+  float mass = 1.0f;          // dynamic bodies only
+  float friction = 0.5f;
+  float restitution = 0.0f;
+  uint32_t userData = 0;
+};
+
+struct RigidBody {
+  glm::vec3 position;
+  glm::quat orientation;
+  glm::vec3 linearVelocity;
+  glm::vec3 angularVelocity;
+  glm::mat3 inverseInertiaWorld;
+  glm::vec3 inverseInertiaLocal;
+  float inverseMass;          // 0 unless dynamic
+  float friction;
+  float restitution;
+  float sleepTime;            // how long the body has been slow enough to sleep
+  CollisionShape shape;
+  BodyType type;
+  bool awake;
+  bool alive;                 // false while the slot is on the free list
+  uint32_t userData;
+
+  bool isDynamic() const { return type == BodyType::Dynamic; }
+  // Moving this step: awake dynamic bodies and every kinematic one
+  bool isActive() const { return type == BodyType::Kinematic || (type == BodyType::Dynamic && awake); }
+
+  Aabb computeBounds() const;
+  void updateInertia();
+};
+
+} // namespace plaster
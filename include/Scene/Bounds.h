@@ -0,0 +1,80 @@
+#pragma once
+#include <glm/glm.hpp>
+
+#include <cfloat>
+
+namespace plaster {
+
+// Axis aligned box; default constructed it is empty (min above max) and
+// merging anything into it yields that thing
+struct Aabb {
+  glm::vec3 min = glm::vec3(FLT_MAX);
+  glm::vec3 max = glm::vec3(-FLT_MAX);
+
+  Aabb() = default;
+  Aabb(const glm::vec3& minimum, const glm::vec3& maximum) : min(minimum), max(maximum) {}
+
+  static Aabb fromCenter(const glm::vec3& center, const glm::vec3& halfExtent) {
+    return Aabb(center - halfExtent, center + halfExtent);
+  }
+  static Aabb merge(const Aabb& a, const Aabb& b) { return Aabb(glm::min(a.min, b.min), glm::max(a.max, b.max)); }
+
+  bool isEmpty() const { return min.x > max.x || min.y > max.y || min.z > max.z; }
+  glm::vec3 getCenter() const { return (min + max) * 0.5f; }
+  glm::vec3 getHalfExtent() const { return (max - min) * 0.5f; }
+  // The cost measure of the BVH: a random ray hits a box in proportion to it
+  float getSurfaceArea() const {
+    glm::vec3 size = max - min;
+    return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+  }
+
+  bool contains(const Aabb& other) const {
+    return min.x <= other.min.x && min.y <= other.min.y && min.z <= other.min.z && max.x >= other.max.x &&
+           max.y >= other.max.y && max.z >= other.max.z;
+  }
+  bool overlaps(const Aabb& other) const {
+    return min.x <= other.max.x && min.y <= other.max.y && min.z <= other.max.z && max.x >= other.min.x &&
+           max.y >= other.min.y && max.z >= other.min.z;
+  }
+  Aabb expanded(float margin) const { return Aabb(min - glm::vec3(margin), max + glm::vec3(margin)); }
+
+  // Bounds of this box after an affine transform
+  Aabb transformed(const glm::mat4& transform) const;
+};
+
+// Six inward facing planes (xyz normal, w distance) with normalized normals,
+// so a plane's dot product with a point is its signed distance
+struct Frustum {
+  glm::vec4 planes[6];
+
+  // Vulkan clip space, depth 0 to 1: left, right, bottom, top, near, far
+  static Frustum fromViewProjection(const glm::mat4& viewProjection);
+
+  bool intersectsSphere(const glm::vec3& center, float radius) const {
+    for (const glm::vec4& plane : planes) {
+      if (glm::dot(glm::vec3(plane), center) + plane.w < -radius) {
+        return false;
+      }
+    }
+    return true;
+  }
+};
+
+struct Ray {
+  glm::vec3 origin = glm::vec3(0.0f);
+  glm::vec3 direction = glm::vec3(0.0f, 0.0f, -1.0f);   // need not be normalized; distances are in its units
+  float maxDistance = FLT_MAX;
+};
+
+// Slab test. inverseDirection is 1 / ray.direction per component. On a hit
+// within maxDistance, distance is where the ray enters the box (0 when it
+// starts inside).
+bool intersectRay(const Ray& ray, const glm::vec3& inverseDirection, const Aabb& box, float maxDistance,
+                  float& distance);
+
+// World space ray through a pixel (origin top left) for mouse picking, e.g.
+// from Input::GetMousePosition(). Assumes Vulkan clip space: depth 0 to 1 and
+// y pointing down the screen. The direction is normalized.
+Ray makePickRay(const glm::vec2& pixel, const glm::vec2& viewportSize, const glm::mat4& viewProjection);
+
+} // namespace plaster
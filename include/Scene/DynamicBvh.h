@@ -0,0 +1,114 @@
+#pragma once
+#include "Scene/Bounds.h"
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace plaster {
+
+class JobSystem;
+
+struct RayHit {
+  uint32_t proxy;      // DynamicBvh::NULL_NODE on a miss
+  uint32_t userData;
+  float distance;
+};
+
+// Exact test for whatever a proxy stands for: the distance along the ray,
+// or a negative value for a miss. Without one, a proxy's bounds are its shape.
+using RaycastFilter = std::function<float(uint32_t userData, const Ray& ray)>;
+
+// Dynamic AABB tree in the manner of Box2D's b2DynamicTree. Leaves hold
+// proxies with fat bounds (the tight bounds grown by a margin and the
+// predicted motion), so most moves don't touch the tree at all. Inserts
+// pick a sibling by surface area cost and rotate nodes on the way back up
+// to keep the tree shallow without full rebuilds.
+//
+// Queries are const and may run from any number of threads at once, as
+// long as nothing modifies the tree meanwhile. Not thread-safe otherwise.
+class DynamicBvh {
+public:
+  static const uint32_t NULL_NODE = 0xffffffffu;
+
+  // margin: how far the tight bounds may move before a proxy is reinserted;
+  // displacementScale: how many times a move's displacement the fat bounds
+  // are extended by in its direction
+  explicit DynamicBvh(float margin = 0.1f, float displacementScale = 4.0f);
+
+  DynamicBvh(const DynamicBvh&) = delete;
+  DynamicBvh& operator=(const DynamicBvh&) = delete;
+
+  // Returns the proxy id, stable until it is destroyed
+  uint32_t createProxy(const Aabb& bounds, uint32_t userData);
+  void destroyProxy(uint32_t proxy);
+  // Reinserts the proxy when bounds leave its fat bounds and returns whether it did
+  bool moveProxy(uint32_t proxy, const Aabb& bounds, const glm::vec3& displacement = glm::vec3(0.0f));
+  // For many proxies moving at once: leaves that escaped their fat bounds
+  // grow in place and every changed node is refit once, bottom up, instead of
+  // each proxy being removed and reinserted. Cheaper per proxy, but the tree
+  // loses quality that optimize() wins back over the following frames.
+  void moveProxies(const uint32_t* proxies, const Aabb* bounds, uint32_t count);
+  // Reinserts up to count leaves, continuing from where the last call stopped
+  void optimize(uint32_t count);
+  void clear();
+
+  uint32_t getUserData(uint32_t proxy) const { return m_nodes[proxy].userData; }
+  const Aabb& getBounds(uint32_t proxy) const { return m_nodes[proxy].tightBounds; }
+  const Aabb& getFatBounds(uint32_t proxy) const { return m_nodes[proxy].bounds; }
+  uint32_t getProxyCount() const { return m_proxyCount; }
+  uint32_t getHeight() const { return m_root == NULL_NODE ? 0 : m_nodes[m_root].height; }
+  // Summed surface area of the internal nodes over the root's; lower is a better tree
+  float getAreaRatio() const;
+
+  // Appends the proxies whose tight bounds overlap
+  void queryOverlaps(const Aabb& bounds, std::vector<uint32_t>& proxies) const;
+  void querySphere(const glm::vec3& center, float radius, std::vector<uint32_t>& proxies) const;
+  // Closest hit within ray.maxDistance
+  bool raycast(const Ray& ray, RayHit& hit, const RaycastFilter& filter = nullptr) const;
+  // Traverses four rays at a time, testing each node against all four at
+  // once with SSE. Pays off most for coherent rays (neighbouring pixels,
+  // shadow rays towards one light); order rays so neighbours share packets.
+  // Packets are spread over the job system when one is given.
+  void raycastBatch(const Ray* rays, RayHit* hits, uint32_t count, JobSystem* jobSystem = nullptr,
+                    const RaycastFilter& filter = nullptr) const;
+
+private:
+  struct Node {
+    Aabb bounds;        // fat for leaves, the union of the children otherwise
+    Aabb tightBounds;   // leaves only
+    uint32_t parent;    // the next free node while on the free list
+    uint32_t child1;    // NULL_NODE for leaves
+    uint32_t child2;
+    uint32_t userData;
+    int32_t height;     // 0 for leaves, -1 while free
+    bool dirty;         // waiting for moveProxies() to refit it
+
+    bool isLeaf() const { return child1 == NULL_NODE; }
+  };
+
+  std::vector<Node> m_nodes;
+  uint32_t m_root;
+  uint32_t m_freeList;
+  uint32_t m_proxyCount;
+  uint32_t m_optimizeCursor;
+  float m_margin;
+  float m_displacementScale;
+  std::vector<uint32_t> m_dirtyNodes;
+
+  static const uint32_t PACKET_SIZE = 4;
+  static const uint32_t PACKETS_PER_JOB = 64;
+
+  uint32_t allocateNode();
+  void freeNode(uint32_t node);
+  void insertLeaf(uint32_t leaf);
+  void removeLeaf(uint32_t leaf);
+  // Refits bounds and heights from node up to the root, rotating where it pays off
+  void refitAncestors(uint32_t node);
+  void rotate(uint32_t node);
+  void updateNode(uint32_t node);
+  Aabb fatten(const Aabb& bounds, const glm::vec3& displacement) const;
+  void raycastPacket(const Ray* rays, RayHit* hits, uint32_t count, const RaycastFilter& filter) const;
+};
+
+} // namespace plaster
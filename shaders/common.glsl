@@ -0,0 +1,12 @@
+// Shared declarations for engine shaders
+
+// Written once per frame into the uniform ring, see Renderer's FrameConstants.
+// Set 0 is reserved for it in every pipeline drawn by DrawBatcher.
+layout(set = 0, binding = 0) uniform FrameConstants {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 cameraPosition;
+    vec4 time;          // seconds since start, seconds since last frame, frame number
+    vec4 viewport;      // scene size in pixels and its reciprocal
+} frame;
@@ -0,0 +1,19 @@
+#version 450
+
+// Upscales the used part of the tonemapped image to the swapchain with
+// bilinear filtering
+
+layout(set = 0, binding = 0) uniform sampler2D image;
+
+layout(push_constant) uniform Params {
+    vec2 uvScale;   // used fraction of the image
+    vec2 uvMax;     // last used texel centre, so filtering never reads past it
+} params;
+
+layout(location = 0) in vec2 inUV;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    outColor = texture(image, min(inUV * params.uvScale, params.uvMax));
+}
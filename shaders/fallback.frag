@@ -0,0 +1,10 @@
+#version 450
+
+layout(location = 0) in vec3 inNormal;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    float shade = max(dot(normalize(inNormal), normalize(vec3(0.4, 1.0, 0.3))), 0.0) * 0.5 + 0.3;
+    outColor = vec4(vec3(shade), 1.0);
+}
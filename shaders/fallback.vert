@@ -0,0 +1,18 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+// Drawn while a material's own pipeline is still compiling. Uses only the
+// mesh vertex layout and the frame constants so it fits any material.
+
+#include "common.glsl"
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inNormal;
+layout(location = 3) in mat4 inModel;
+
+layout(location = 0) out vec3 outNormal;
+
+void main() {
+    outNormal = mat3(inModel) * inNormal;
+    gl_Position = frame.viewProjection * inModel * vec4(inPosition, 1.0);
+}
@@ -0,0 +1,143 @@
+// Shared declarations for clustered lighting, see ClusteredLighting. The
+// constants sit at LIGHT_SET, set 3 when shading (see ClusteredLighting::
+// SHADING_SET) and set 0 in the binning pass, which defines it first.
+
+#ifndef LIGHT_SET
+#define LIGHT_SET 3
+#endif
+
+// Mirror LIGHT_CLUSTERS_* in Graphics/ClusteredLighting.h
+const uint LIGHT_CLUSTERS_X = 16;
+const uint LIGHT_CLUSTERS_Y = 9;
+const uint LIGHT_CLUSTERS_Z = 24;
+const uint LIGHT_CLUSTER_COUNT = LIGHT_CLUSTERS_X * LIGHT_CLUSTERS_Y * LIGHT_CLUSTERS_Z;
+
+// Mirrors SHADOW_CASCADE_COUNT in Graphics/ShadowCascades.h; cascade i is
+// tile (i % 2, i / 2) of the atlas
+const uint SHADOW_CASCADE_COUNT = 4;
+
+// Mirrors GpuLight in ClusteredLighting.cpp (std430)
+struct Light {
+    vec4 positionRange;     // world space position, range
+    vec4 color;             // times intensity; w: 1 for spot lights
+    vec4 direction;         // normalized; w: cosine of the outer angle
+    vec4 spot;              // x: 1 / (cosine of the inner angle - that of the outer one)
+};
+
+// Mirrors LightConstants in ClusteredLighting.cpp (std140)
+layout(set = LIGHT_SET, binding = 0) uniform LightConstants {
+    mat4 inverseProjection;
+    vec4 sunDirection;      // toward the sun, world space
+    vec4 sunColor;
+    vec4 ambientColor;
+    vec4 depthSlicing;      // near and far depth, then slice = log(depth) * z - w
+    uint lightCount;
+    uint maxClusterLights;
+    uint maxIndices;
+    float heatmapScale;     // 0 when the heatmap is off
+    mat4 shadowMatrices[SHADOW_CASCADE_COUNT];   // world space to atlas uv and depth
+    vec4 shadowSplits;      // view depth each cascade ends at
+    vec4 shadowTexelSizes;  // world units
+    vec4 shadowDepthBias;   // in each cascade's depth
+    vec4 shadowParams;      // x: 1 when shadows are on, y: normal offset in texels, z: atlas texel, w: tile, in uv
+} lighting;
+
+// Cluster of a view depth (positive in front of the camera) at a position in
+// [0, 1] across the screen; LIGHT_CLUSTER_COUNT past farDepth
+uint findCluster(vec2 screen, float depth) {
+    if (depth >= lighting.depthSlicing.y) {
+        return LIGHT_CLUSTER_COUNT;
+    }
+    uint slice = uint(clamp(log(max(depth, 1e-6)) * lighting.depthSlicing.z - lighting.depthSlicing.w, 0.0,
+                            float(LIGHT_CLUSTERS_Z - 1)));
+    uvec2 tile = min(uvec2(screen * vec2(LIGHT_CLUSTERS_X, LIGHT_CLUSTERS_Y)),
+                     uvec2(LIGHT_CLUSTERS_X - 1, LIGHT_CLUSTERS_Y - 1));
+    return (slice * LIGHT_CLUSTERS_Y + tile.y) * LIGHT_CLUSTERS_X + tile.x;
+}
+
+#ifndef LIGHT_BINNING
+layout(set = LIGHT_SET, binding = 1) readonly buffer Lights { Light lights[]; };
+layout(set = LIGHT_SET, binding = 2) readonly buffer LightClusters { uvec2 clusters[]; };   // first index, light count
+layout(set = LIGHT_SET, binding = 3) readonly buffer LightIndices { uint lightIndices[]; };
+layout(set = LIGHT_SET, binding = 4) uniform sampler2DShadow shadowAtlas;
+
+// Fraction of the sun reaching a point, from the first cascade that covers
+// it: 3x3 filtered comparisons, offset along the normal by the cascade's
+// texels against acne. Unshadowed past the last cascade.
+float sunShadow(vec3 worldPosition, vec3 normal, float viewDepth) {
+    if (lighting.shadowParams.x == 0.0) {
+        return 1.0;
+    }
+    float texel = lighting.shadowParams.z;
+    float tile = lighting.shadowParams.w;
+    for (uint i = 0u; i < SHADOW_CASCADE_COUNT; ++i) {
+        if (viewDepth > lighting.shadowSplits[i]) {
+            continue;
+        }
+        vec3 position = worldPosition + normal * (lighting.shadowParams.y * lighting.shadowTexelSizes[i]);
+        vec3 projected = (lighting.shadowMatrices[i] * vec4(position, 1.0)).xyz;
+        // Cascades drawn on alternating frames may lag the camera; keep the
+        // taps inside the tile and fall through to the next cascade if not
+        vec2 tileMin = vec2(float(i % 2u), float(i / 2u)) * tile + 2.0 * texel;
+        vec2 tileMax = tileMin + tile - 4.0 * texel;
+        if (any(lessThan(projected.xy, tileMin)) || any(greaterThan(projected.xy, tileMax)) || projected.z > 1.0) {
+            continue;
+        }
+        float depth = projected.z - lighting.shadowDepthBias[i];
+        float lit = 0.0;
+        for (int y = -1; y <= 1; ++y) {
+            for (int x = -1; x <= 1; ++x) {
+                lit += textureLod(shadowAtlas, vec3(projected.xy + vec2(x, y) * texel, depth), 0.0);
+            }
+        }
+        return lit / 9.0;
+    }
+    return 1.0;
+}
+
+// Smooth inverse square falloff reaching zero at the range
+float distanceAttenuation(float distanceSquared, float range) {
+    float ratio = distanceSquared / (range * range);
+    float window = clamp(1.0 - ratio * ratio, 0.0, 1.0);
+    return window * window / max(distanceSquared, 1e-4);
+}
+
+// Diffuse lighting: ambient, the shadowed sun and every light of the pixel's cluster
+vec3 shadeDiffuse(vec3 worldPosition, vec3 normal, float viewDepth, vec2 screen, out uint clusterLights) {
+    float sun = max(dot(normal, lighting.sunDirection.xyz), 0.0);
+    if (sun > 0.0) {
+        sun *= sunShadow(worldPosition, normal, viewDepth);
+    }
+    vec3 result = lighting.ambientColor.rgb + lighting.sunColor.rgb * sun;
+
+    clusterLights = 0u;
+    uint cluster = findCluster(screen, viewDepth);
+    if (cluster >= LIGHT_CLUSTER_COUNT) {
+        return result;
+    }
+    uvec2 range = clusters[cluster];
+    clusterLights = range.y;
+    for (uint i = 0; i < range.y; ++i) {
+        Light light = lights[lightIndices[range.x + i]];
+        vec3 toLight = light.positionRange.xyz - worldPosition;
+        float distanceSquared = dot(toLight, toLight);
+        vec3 direction = toLight * inversesqrt(max(distanceSquared, 1e-8));
+        float attenuation = distanceAttenuation(distanceSquared, light.positionRange.w);
+        if (light.color.w != 0.0) {
+            float cone = clamp((dot(-direction, light.direction.xyz) - light.direction.w) * light.spot.x, 0.0, 1.0);
+            attenuation *= cone * cone;
+        }
+        result += light.color.rgb * (attenuation * max(dot(normal, direction), 0.0));
+    }
+    return result;
+}
+
+// Black for no lights, then blue through green to red at heatmapScale
+vec3 heatmapColor(uint count) {
+    if (count == 0u) {
+        return vec3(0.0);
+    }
+    float t = clamp(float(count) / lighting.heatmapScale, 0.0, 1.0);
+    return clamp(vec3(1.5) - abs(4.0 * t - vec3(3.0, 2.0, 1.0)), 0.0, 1.0);
+}
+#endif
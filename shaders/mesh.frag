@@ -0,0 +1,32 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+#include "common.glsl"
+#include "lighting.glsl"
+
+layout(set = 1, binding = 0) uniform sampler2D albedoTexture;
+
+// Pushed by DrawBatcher whenever the material changes
+layout(push_constant) uniform MaterialConstants {
+    vec4 baseColor;
+} material;
+
+layout(location = 0) in vec3 inWorldPosition;
+layout(location = 1) in vec3 inNormal;
+layout(location = 2) in vec2 inUV;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    vec3 normal = normalize(inNormal);
+    float viewDepth = -(frame.view * vec4(inWorldPosition, 1.0)).z;
+    uint clusterLights;
+    vec3 diffuse = shadeDiffuse(inWorldPosition, normal, viewDepth, gl_FragCoord.xy * frame.viewport.zw,
+                                clusterLights);
+
+    vec4 albedo = texture(albedoTexture, inUV) * material.baseColor;
+    outColor = vec4(albedo.rgb * diffuse, albedo.a);
+    if (lighting.heatmapScale > 0.0) {
+        outColor.rgb = mix(outColor.rgb, heatmapColor(clusterLights), 0.6);
+    }
+}
@@ -0,0 +1,24 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+#include "common.glsl"
+
+// Per vertex
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inNormal;
+layout(location = 2) in vec2 inUV;
+
+// Per instance, see getMeshAttributeDescriptions()
+layout(location = 3) in mat4 inModel;
+
+layout(location = 0) out vec3 outWorldPosition;
+layout(location = 1) out vec3 outNormal;
+layout(location = 2) out vec2 outUV;
+
+void main() {
+    vec4 worldPosition = inModel * vec4(inPosition, 1.0);
+    outWorldPosition = worldPosition.xyz;
+    outNormal = mat3(inModel) * inNormal;
+    outUV = inUV;
+    gl_Position = frame.viewProjection * worldPosition;
+}
@@ -0,0 +1,43 @@
+// Shared declarations for meshlet culling and drawing, see MeshletRenderer
+
+// Mirrors Meshlet in Graphics/Meshlet.h (std430)
+struct Meshlet {
+    vec4 sphere;        // bounding sphere in mesh space: center, radius
+    vec4 cone;          // normal cone: axis, cutoff (1 when it never culls)
+    uvec4 ranges;       // vertex offset, triangle byte offset, vertex count, triangle count
+};
+
+// Mirrors Instance in MeshletRenderer.h. Offsets are where the mesh's data
+// starts in each shared buffer; a meshlet's own offsets are relative to them.
+struct MeshletInstance {
+    mat4 model;
+    uint firstMeshlet;
+    uint meshletCount;
+    uint firstVertex;
+    uint firstMeshletVertex;
+    uint firstTriangleByte;
+    float scale;            // largest axis scale, for the bounding spheres
+    uint coneCulling;       // 0 when the transform does not preserve normal cones
+    uint padding;
+};
+
+// Counters and the indirect draw in one buffer. Mirrors MeshletState in
+// MeshletRenderer.cpp (std430).
+struct MeshletState {
+    uint indexCount;        // VkDrawIndexedIndirectCommand
+    uint instanceCount;
+    uint firstIndex;
+    int vertexOffset;
+    uint firstInstance;
+    uint clusterCount;      // entries of the visible cluster list
+    uint frustumCulled;
+    uint coneCulled;
+    uint occlusionCulled;
+    uint padding[3];
+};
+
+// Each visible cluster's indices are slot * MESHLET_MAX_VERTICES + local vertex,
+// so the vertex shader finds its meshlet without any other per-vertex data
+const uint MESHLET_MAX_VERTICES = 64;
+const uint MESHLET_MAX_TRIANGLES = 124;
+const uint MESHLET_SLOT_SHIFT = 6;
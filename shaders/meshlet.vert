@@ -0,0 +1,43 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+#include "common.glsl"
+#include "meshlet.glsl"
+
+// Draws the clusters meshlet_cull.comp kept, pulling vertices from storage
+// buffers: an index names a slot of the visible cluster list and a vertex of
+// that meshlet. Outputs match mesh.vert, so mesh.frag shades them. Set 1 is
+// the material and set 3 the clustered lights, as for every DrawBatcher
+// pipeline.
+
+layout(set = 2, binding = 0) readonly buffer Instances { MeshletInstance instances[]; };
+layout(set = 2, binding = 1) readonly buffer Meshlets { Meshlet meshlets[]; };
+layout(set = 2, binding = 2) readonly buffer MeshletVertices { uint meshletVertices[]; };
+// Vertex: position, normal, uv (8 floats)
+layout(set = 2, binding = 3) readonly buffer Vertices { float vertices[]; };
+layout(set = 2, binding = 4) readonly buffer Clusters { uvec2 clusters[]; };
+
+layout(location = 0) out vec3 outWorldPosition;
+layout(location = 1) out vec3 outNormal;
+layout(location = 2) out vec2 outUV;
+
+const uint VERTEX_STRIDE = 8;
+
+void main() {
+    uvec2 cluster = clusters[uint(gl_VertexIndex) >> MESHLET_SLOT_SHIFT];
+    MeshletInstance instance = instances[cluster.x];
+    Meshlet meshlet = meshlets[instance.firstMeshlet + cluster.y];
+    uint local = uint(gl_VertexIndex) & (MESHLET_MAX_VERTICES - 1);
+    uint vertex = instance.firstVertex +
+                  meshletVertices[instance.firstMeshletVertex + meshlet.ranges.x + local];
+
+    uint base = vertex * VERTEX_STRIDE;
+    vec3 position = vec3(vertices[base], vertices[base + 1], vertices[base + 2]);
+    vec3 normal = vec3(vertices[base + 3], vertices[base + 4], vertices[base + 5]);
+
+    vec4 worldPosition = instance.model * vec4(position, 1.0);
+    outWorldPosition = worldPosition.xyz;
+    outNormal = mat3(instance.model) * normal;
+    outUV = vec2(vertices[base + 6], vertices[base + 7]);
+    gl_Position = frame.viewProjection * worldPosition;
+}
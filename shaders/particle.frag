@@ -0,0 +1,15 @@
+#version 450
+
+layout(location = 0) in vec4 inColor;
+layout(location = 1) in vec2 inCorner;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    // Round, fading out towards the edge
+    float falloff = 1.0 - dot(inCorner, inCorner);
+    if (falloff <= 0.0) {
+        discard;
+    }
+    outColor = vec4(inColor.rgb, inColor.a * falloff);
+}
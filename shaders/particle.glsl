@@ -0,0 +1,43 @@
+// Shared declarations for the GPU particle passes, see ParticleSystem
+
+// Set 1 holds the particle buffers; set 0 is the frame constants as everywhere else
+struct Particle {
+    vec3 position;
+    float life;         // seconds left, expired at 0
+    vec3 velocity;
+    float lifetime;     // seconds it was emitted with
+};
+
+// Counters and indirect arguments in one buffer, so the indirect dispatches
+// and the draw read what the passes before them wrote without a CPU round trip.
+// Mirrors ParticleState in ParticleSystem.cpp (std430).
+struct ParticleState {
+    uint aliveCount[2];   // entries in each alive list
+    uint deadCount;       // free slots on the dead list
+    uint emitCount;       // emitted this frame, at most deadCount
+    uint sortCount;       // drawCount rounded up to a power of two
+    uint drawCount;       // survivors of this frame's update
+    uint padding[2];
+    uvec4 emitArgs;       // VkDispatchIndirectCommand
+    uvec4 updateArgs;
+    uvec4 sortArgs;
+    uvec4 drawArgs;       // VkDrawIndirectCommand
+};
+
+// Elements sorted by one workgroup in shared memory, see particle_sort.comp
+const uint SORT_BLOCK = 512;
+
+#ifdef PARTICLE_SIMULATION
+layout(push_constant) uniform Params {
+    vec4 emitterPosition;   // w: radius of the sphere particles start in
+    vec4 emitterDirection;  // w: cosine of the emission cone's half angle
+    vec4 gravity;           // w: fraction of the velocity lost per second
+    vec2 speed;             // min, max
+    vec2 lifetime;          // min, max
+    uint emitCount;         // requested this frame
+    uint seed;
+    uint current;           // alive list read this frame; survivors go to the other
+    uint capacity;
+    float deltaTime;
+} params;
+#endif
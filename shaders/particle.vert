@@ -0,0 +1,36 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+#include "common.glsl"
+#include "particle.glsl"
+
+// Camera facing quads, six vertices per particle in sorted order, no vertex input
+
+layout(set = 1, binding = 0) readonly buffer Particles { Particle particles[]; };
+layout(set = 1, binding = 4) readonly buffer SortKeys { uvec2 sortKeys[]; };
+
+layout(push_constant) uniform Params {
+    vec4 startColor;
+    vec4 endColor;
+    float size;       // half extent in world units
+} params;
+
+layout(location = 0) out vec4 outColor;
+layout(location = 1) out vec2 outCorner;
+
+const vec2 corners[6] = vec2[](vec2(-1.0, -1.0), vec2(1.0, -1.0), vec2(1.0, 1.0),
+                               vec2(-1.0, -1.0), vec2(1.0, 1.0), vec2(-1.0, 1.0));
+
+void main() {
+    Particle particle = particles[sortKeys[gl_VertexIndex / 6].y];
+    vec2 corner = corners[gl_VertexIndex % 6];
+
+    // The view matrix' rows are the camera axes in world space
+    vec3 right = vec3(frame.view[0][0], frame.view[1][0], frame.view[2][0]);
+    vec3 up = vec3(frame.view[0][1], frame.view[1][1], frame.view[2][1]);
+    vec3 position = particle.position + (corner.x * right + corner.y * up) * params.size;
+
+    outColor = mix(params.startColor, params.endColor, 1.0 - particle.life / particle.lifetime);
+    outCorner = corner;
+    gl_Position = frame.viewProjection * vec4(position, 1.0);
+}
@@ -0,0 +1,5 @@
+#version 450
+
+// Depth only
+void main() {
+}
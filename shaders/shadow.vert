@@ -0,0 +1,15 @@
+#version 450
+
+// Depth of shadow casters into one cascade of the shadow atlas, see ShadowCascades
+layout(push_constant) uniform ShadowConstants {
+    mat4 viewProjection;    // light clip space of the cascade
+} shadow;
+
+layout(location = 0) in vec3 inPosition;
+
+// Per instance, see getMeshAttributeDescriptions()
+layout(location = 3) in mat4 inModel;
+
+void main() {
+    gl_Position = shadow.viewProjection * (inModel * vec4(inPosition, 1.0));
+}
@@ -0,0 +1,274 @@
+#include "Animation/AnimationClip.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+namespace plaster {
+
+namespace {
+
+const uint32_t MAX_FRAMES = 65536;
+const float QUANTIZED_RANGE = 0.70710678f;   // the three smallest components of a unit quaternion lie within +-1/sqrt(2)
+const float QUANTIZED_MAX = 32767.0f;        // 15 bits
+
+float component(const glm::quat& rotation, uint32_t index) {
+    switch (index) {
+    case 0:
+        return rotation.x;
+    case 1:
+        return rotation.y;
+    case 2:
+        return rotation.z;
+    default:
+        return rotation.w;
+    }
+}
+
+// Normalized lerp the way the sampler does it, so the reduction measures the error it will actually see
+glm::quat nlerp(const glm::quat& a, const glm::quat& b, float t) {
+    float sign = glm::dot(a, b) < 0.0f ? -1.0f : 1.0f;
+    glm::quat blended(a.w + (b.w * sign - a.w) * t, a.x + (b.x * sign - a.x) * t, a.y + (b.y * sign - a.y) * t,
+                      a.z + (b.z * sign - a.z) * t);
+    return glm::normalize(blended);
+}
+
+float rotationError(const glm::quat& a, const glm::quat& b) {
+    float sign = glm::dot(a, b) < 0.0f ? -1.0f : 1.0f;
+    float error = 0.0f;
+    for (uint32_t i = 0; i < 4; ++i) {
+        error = std::max(error, std::fabs(component(a, i) - component(b, i) * sign));
+    }
+    return error;
+}
+
+float vectorError(const glm::vec3& a, const glm::vec3& b) {
+    glm::vec3 difference = glm::abs(a - b);
+    return std::max(difference.x, std::max(difference.y, difference.z));
+}
+
+// Frames to keep as keys: the first, the last and, scanning forward, the
+// frame before the first one that interpolating from the previous key would
+// miss. keyed are the values as they will be stored, reference the exact ones.
+template <typename Value, typename Lerp, typename Error>
+std::vector<uint32_t> reduceKeys(const std::vector<Value>& keyed, const std::vector<Value>& reference,
+                                 float tolerance, Lerp lerp, Error error) {
+    uint32_t frameCount = static_cast<uint32_t>(keyed.size());
+    std::vector<uint32_t> keys = {0};
+    uint32_t anchor = 0;
+    for (uint32_t end = 2; end < frameCount; ++end) {
+        for (uint32_t frame = anchor + 1; frame < end; ++frame) {
+            float t = static_cast<float>(frame - anchor) / static_cast<float>(end - anchor);
+            if (error(lerp(keyed[anchor], keyed[end], t), reference[frame]) > tolerance) {
+                anchor = end - 1;
+                keys.push_back(anchor);
+                break;
+            }
+        }
+    }
+    if (frameCount > 1) {
+        keys.push_back(frameCount - 1);
+    }
+    return keys;
+}
+
+// The keys around position within one curve and the weight of the second
+void findKeys(const uint16_t* frames, uint32_t keyCount, float position, uint32_t& first, uint32_t& second,
+              float& weight) {
+    const uint16_t* end = frames + keyCount;
+    const uint16_t* next = std::upper_bound(frames, end, position,
+                                            [](float value, uint16_t frame) { return value < frame; });
+    if (next == end) {
+        first = second = keyCount - 1;
+        weight = 0.0f;
+        return;
+    }
+    // The first key is always frame 0, so next is never the first
+    second = static_cast<uint32_t>(next - frames);
+    first = second - 1;
+    weight = (position - frames[first]) / static_cast<float>(frames[second] - frames[first]);
+}
+
+void setRotation(SoaTransform& transform, uint32_t lane, const glm::quat& rotation) {
+    transform.rotation[0][lane] = rotation.x;
+    transform.rotation[1][lane] = rotation.y;
+    transform.rotation[2][lane] = rotation.z;
+    transform.rotation[3][lane] = rotation.w;
+}
+
+void setVector(glm::vec4* channel, uint32_t lane, const glm::vec3& value) {
+    channel[0][lane] = value.x;
+    channel[1][lane] = value.y;
+    channel[2][lane] = value.z;
+}
+
+} // namespace
+
+AnimationClip::AnimationClip()
+    : m_sampleRate(30.0f), m_duration(0.0f), m_frameCount(0), m_jointCount(0) {}
+
+AnimationClip AnimationClip::compress(const RawAnimationClip& raw, const ClipCompressionSettings& settings) {
+    if (raw.frameCount == 0 || raw.frameCount > MAX_FRAMES) {
+        throw std::runtime_error("Animation clips need 1 to " + std::to_string(MAX_FRAMES) + " frames, got " +
+                                 std::to_string(raw.frameCount));
+    }
+    if (raw.samples.size() != static_cast<size_t>(raw.frameCount) * raw.jointCount || raw.sampleRate <= 0.0f) {
+        throw std::runtime_error("Animation clip samples don't match its frame and joint counts");
+    }
+
+    AnimationClip clip;
+    clip.m_sampleRate = raw.sampleRate;
+    clip.m_duration = (raw.frameCount - 1) / raw.sampleRate;
+    clip.m_frameCount = raw.frameCount;
+    clip.m_jointCount = raw.jointCount;
+
+    auto lerpVector = [](const glm::vec3& a, const glm::vec3& b, float t) { return glm::mix(a, b, t); };
+
+    std::vector<glm::quat> rotations(raw.frameCount);
+    std::vector<glm::quat> quantizedRotations(raw.frameCount);
+    std::vector<QuantizedRotation> packedRotations(raw.frameCount);
+    std::vector<glm::vec3> translations(raw.frameCount);
+    std::vector<glm::vec3> scales(raw.frameCount);
+    for (uint32_t joint = 0; joint < raw.jointCount; ++joint) {
+        for (uint32_t frame = 0; frame < raw.frameCount; ++frame) {
+            const JointTransform& sample = raw.samples[static_cast<size_t>(frame) * raw.jointCount + joint];
+            rotations[frame] = glm::normalize(sample.rotation);
+            packedRotations[frame] = quantize(rotations[frame]);
+            quantizedRotations[frame] = dequantize(packedRotations[frame]);
+            translations[frame] = sample.translation;
+            scales[frame] = sample.scale;
+        }
+
+        // Rotation keys are chosen by their quantized values, so the tolerance covers both losses
+        std::vector<uint32_t> keys = reduceKeys(quantizedRotations, rotations, settings.rotationTolerance, nlerp,
+                                                rotationError);
+        clip.m_rotationCurves.push_back({static_cast<uint32_t>(clip.m_rotations.size()),
+                                         static_cast<uint32_t>(keys.size())});
+        for (uint32_t frame : keys) {
+            clip.m_rotationFrames.push_back(static_cast<uint16_t>(frame));
+            clip.m_rotations.push_back(packedRotations[frame]);
+        }
+
+        keys = reduceKeys(translations, translations, settings.translationTolerance, lerpVector, vectorError);
+        clip.m_translationCurves.push_back({static_cast<uint32_t>(clip.m_translations.size()),
+                                            static_cast<uint32_t>(keys.size())});
+        for (uint32_t frame : keys) {
+            clip.m_translationFrames.push_back(static_cast<uint16_t>(frame));
+            clip.m_translations.push_back(translations[frame]);
+        }
+
+        keys = reduceKeys(scales, scales, settings.scaleTolerance, lerpVector, vectorError);
+        clip.m_scaleCurves.push_back({static_cast<uint32_t>(clip.m_scales.size()),
+                                      static_cast<uint32_t>(keys.size())});
+        for (uint32_t frame : keys) {
+            clip.m_scaleFrames.push_back(static_cast<uint16_t>(frame));
+            clip.m_scales.push_back(scales[frame]);
+        }
+    }
+    return clip;
+}
+
+void AnimationClip::sample(float time, bool loop, SoaTransform* pose) const {
+    if (loop && m_duration > 0.0f) {
+        time = std::fmod(time, m_duration);
+        if (time < 0.0f) {
+            time += m_duration;
+        }
+    }
+    float position = std::min(std::max(time * m_sampleRate, 0.0f), static_cast<float>(m_frameCount - 1));
+
+    uint32_t laneCount = (m_jointCount + 3) / 4;
+    for (uint32_t lane = 0; lane < laneCount; ++lane) {
+        // Decode the keys on either side joint by joint, then interpolate the whole lane at once
+        SoaTransform first = SoaTransform::identity();
+        SoaTransform second = first;
+        glm::vec4 rotationWeight(0.0f);
+        glm::vec4 translationWeight(0.0f);
+        glm::vec4 scaleWeight(0.0f);
+
+        for (uint32_t i = 0; i < 4 && lane * 4 + i < m_jointCount; ++i) {
+            uint32_t joint = lane * 4 + i;
+            uint32_t a, b;
+
+            const Curve& rotation = m_rotationCurves[joint];
+            findKeys(&m_rotationFrames[rotation.firstKey], rotation.keyCount, position, a, b, rotationWeight[i]);
+            setRotation(first, i, dequantize(m_rotations[rotation.firstKey + a]));
+            setRotation(second, i, dequantize(m_rotations[rotation.firstKey + b]));
+
+            const Curve& translation = m_translationCurves[joint];
+            findKeys(&m_translationFrames[translation.firstKey], translation.keyCount, position, a, b,
+                     translationWeight[i]);
+            setVector(first.translation, i, m_translations[translation.firstKey + a]);
+            setVector(second.translation, i, m_translations[translation.firstKey + b]);
+
+            const Curve& scale = m_scaleCurves[joint];
+            findKeys(&m_scaleFrames[scale.firstKey], scale.keyCount, position, a, b, scaleWeight[i]);
+            setVector(first.scale, i, m_scales[scale.firstKey + a]);
+            setVector(second.scale, i, m_scales[scale.firstKey + b]);
+        }
+
+        pose[lane] = blendTransforms(first, second, rotationWeight, translationWeight, scaleWeight);
+    }
+}
+
+uint32_t AnimationClip::getKeyCount() const {
+    return static_cast<uint32_t>(m_rotations.size() + m_translations.size() + m_scales.size());
+}
+
+size_t AnimationClip::getCompressedSize() const {
+    size_t curves = (m_rotationCurves.size() + m_translationCurves.size() + m_scaleCurves.size()) * sizeof(Curve);
+    size_t frames = (m_rotationFrames.size() + m_translationFrames.size() + m_scaleFrames.size()) * sizeof(uint16_t);
+    return curves + frames + m_rotations.size() * sizeof(QuantizedRotation) +
+           (m_translations.size() + m_scales.size()) * sizeof(glm::vec3);
+}
+
+AnimationClip::QuantizedRotation AnimationClip::quantize(const glm::quat& rotation) {
+    uint32_t largest = 0;
+    for (uint32_t i = 1; i < 4; ++i) {
+        if (std::fabs(component(rotation, i)) > std::fabs(component(rotation, largest))) {
+            largest = i;
+        }
+    }
+    // Keeping the dropped component positive lets it be rebuilt without a sign bit
+    float sign = component(rotation, largest) < 0.0f ? -1.0f : 1.0f;
+
+    uint64_t packed = largest;
+    for (uint32_t i = 0; i < 4; ++i) {
+        if (i == largest) {
+            continue;
+        }
+        float normalized = (component(rotation, i) * sign / QUANTIZED_RANGE) * 0.5f + 0.5f;
+        float clamped = std::min(std::max(normalized, 0.0f), 1.0f);
+        packed = (packed << 15) | static_cast<uint64_t>(std::lround(clamped * QUANTIZED_MAX));
+    }
+
+    QuantizedRotation quantized;
+    quantized.words[0] = static_cast<uint16_t>(packed >> 32);
+    quantized.words[1] = static_cast<uint16_t>(packed >> 16);
+    quantized.words[2] = static_cast<uint16_t>(packed);
+    return quantized;
+}
+
+glm::quat AnimationClip::dequantize(const QuantizedRotation& rotation) {
+    uint64_t packed = (static_cast<uint64_t>(rotation.words[0]) << 32) |
+                      (static_cast<uint64_t>(rotation.words[1]) << 16) | rotation.words[2];
+    uint32_t largest = static_cast<uint32_t>(packed >> 45) & 3;
+
+    float components[4];
+    float sumSquares = 0.0f;
+    uint32_t shift = 30;
+    for (uint32_t i = 0; i < 4; ++i) {
+        if (i == largest) {
+            continue;
+        }
+        float normalized = static_cast<float>((packed >> shift) & 0x7fff) / QUANTIZED_MAX;
+        components[i] = (normalized * 2.0f - 1.0f) * QUANTIZED_RANGE;
+        sumSquares += components[i] * components[i];
+        shift -= 15;
+    }
+    components[largest] = std::sqrt(std::max(1.0f - sumSquares, 0.0f));
+    return glm::quat(components[3], components[0], components[1], components[2]);
+}
+
+} // namespace plaster
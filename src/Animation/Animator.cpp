@@ -0,0 +1,74 @@
+#include "Animation/Animator.h"
+#include "Core/JobSystem.h"
+#include "Core/FrameArena.h"
+#include "Core/Metrics.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace plaster {
+
+Animator::Animator(JobSystem* jobSystem)
+    : m_jobSystem(jobSystem) {}
+
+uint32_t Animator::addCharacter(const Skeleton* skeleton, const AnimationClip* clip) {
+    AnimatedCharacter character;
+    character.skeleton = skeleton;
+    character.clip = clip;
+
+    uint32_t id = static_cast<uint32_t>(m_characters.size());
+    m_characters.push_back(character);
+    m_paletteOffsets.push_back(static_cast<uint32_t>(m_palettes.size()));
+
+    // Bind pose until the first update
+    std::vector<glm::mat4> model(skeleton->getJointCount());
+    std::vector<SoaTransform> pose(skeleton->getLaneCount());
+    setBindPose(*skeleton, pose.data());
+    localToModel(*skeleton, pose.data(), model.data());
+    m_palettes.resize(m_palettes.size() + skeleton->getJointCount());
+    buildPalette(*skeleton, model.data(), &m_palettes[m_paletteOffsets[id]]);
+    return id;
+}
+
+void Animator::update(float deltaTime) {
+    static Histogram& updateTime = Metrics::histogram("animation.update_us");
+    static Gauge& jointCount = Metrics::gauge("animation.joints");
+    ScopedTimer timer(updateTime);
+    jointCount.set(static_cast<double>(m_palettes.size()));
+
+    // Characters write disjoint ranges of the palette array, so batches need no synchronization
+    m_jobSystem->parallelFor(getCharacterCount(), CHARACTERS_PER_JOB, [this, deltaTime](uint32_t begin, uint32_t end) {
+        for (uint32_t id = begin; id < end; ++id) {
+            updateCharacter(m_characters[id], deltaTime, &m_palettes[m_paletteOffsets[id]]);
+        }
+    });
+}
+
+void Animator::updateCharacter(AnimatedCharacter& character, float deltaTime, SkinningMatrix* palette) const {
+    const Skeleton& skeleton = *character.skeleton;
+    uint32_t laneCount = skeleton.getLaneCount();
+
+    // Scratch from this worker's frame arena
+    FrameVector<SoaTransform> pose(laneCount);
+    FrameVector<glm::mat4> model(skeleton.getJointCount());
+
+    float duration = character.clip->getDuration();
+    if (duration > 0.0f) {
+        character.phase += deltaTime * character.speed / duration;
+        character.phase = character.loop ? character.phase - std::floor(character.phase)
+                                         : std::min(std::max(character.phase, 0.0f), 1.0f);
+    }
+    character.clip->sample(character.phase * duration, character.loop, pose.data());
+
+    if (character.blendClip && character.blendWeight > 0.0f) {
+        FrameVector<SoaTransform> blendPose(laneCount);
+        character.blendClip->sample(character.phase * character.blendClip->getDuration(), character.loop,
+                                    blendPose.data());
+        blendPoses(pose.data(), blendPose.data(), std::min(character.blendWeight, 1.0f), pose.data(), laneCount);
+    }
+
+    localToModel(skeleton, pose.data(), model.data());
+    buildPalette(skeleton, model.data(), palette);
+}
+
+} // namespace plaster
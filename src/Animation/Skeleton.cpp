@@ -0,0 +1,135 @@
+#include "Animation/Skeleton.h"
+
+namespace plaster {
+
+SoaTransform SoaTransform::identity() {
+    SoaTransform transform;
+    transform.rotation[0] = transform.rotation[1] = transform.rotation[2] = glm::vec4(0.0f);
+    transform.rotation[3] = glm::vec4(1.0f);
+    for (uint32_t i = 0; i < 3; ++i) {
+        transform.translation[i] = glm::vec4(0.0f);
+        transform.scale[i] = glm::vec4(1.0f);
+    }
+    return transform;
+}
+
+void SoaTransform::set(uint32_t lane, const JointTransform& transform) {
+    rotation[0][lane] = transform.rotation.x;
+    rotation[1][lane] = transform.rotation.y;
+    rotation[2][lane] = transform.rotation.z;
+    rotation[3][lane] = transform.rotation.w;
+    for (uint32_t i = 0; i < 3; ++i) {
+        translation[i][lane] = transform.translation[i];
+        scale[i][lane] = transform.scale[i];
+    }
+}
+
+JointTransform SoaTransform::get(uint32_t lane) const {
+    JointTransform transform;
+    transform.rotation = glm::quat(rotation[3][lane], rotation[0][lane], rotation[1][lane], rotation[2][lane]);
+    for (uint32_t i = 0; i < 3; ++i) {
+        transform.translation[i] = translation[i][lane];
+        transform.scale[i] = scale[i][lane];
+    }
+    return transform;
+}
+
+void setBindPose(const Skeleton& skeleton, SoaTransform* pose) {
+    uint32_t jointCount = skeleton.getJointCount();
+    for (uint32_t lane = 0; lane < skeleton.getLaneCount(); ++lane) {
+        pose[lane] = SoaTransform::identity();
+        for (uint32_t i = 0; i < 4 && lane * 4 + i < jointCount; ++i) {
+            pose[lane].set(i, skeleton.bindPose[lane * 4 + i]);
+        }
+    }
+}
+
+SoaTransform blendTransforms(const SoaTransform& a, const SoaTransform& b, const glm::vec4& rotationWeight,
+                             const glm::vec4& translationWeight, const glm::vec4& scaleWeight) {
+    SoaTransform out;
+    for (uint32_t i = 0; i < 3; ++i) {
+        out.translation[i] = glm::mix(a.translation[i], b.translation[i], translationWeight);
+        out.scale[i] = glm::mix(a.scale[i], b.scale[i], scaleWeight);
+    }
+
+    // q and -q are the same rotation; flip b where the two are more than 90
+    // degrees apart so the blend takes the shorter way round
+    glm::vec4 cosine = a.rotation[0] * b.rotation[0] + a.rotation[1] * b.rotation[1] +
+                       a.rotation[2] * b.rotation[2] + a.rotation[3] * b.rotation[3];
+    glm::vec4 sign(cosine.x < 0.0f ? -1.0f : 1.0f, cosine.y < 0.0f ? -1.0f : 1.0f,
+                   cosine.z < 0.0f ? -1.0f : 1.0f, cosine.w < 0.0f ? -1.0f : 1.0f);
+    glm::vec4 weight = rotationWeight * sign;
+    glm::vec4 keep = glm::vec4(1.0f) - rotationWeight;
+    for (uint32_t i = 0; i < 4; ++i) {
+        out.rotation[i] = a.rotation[i] * keep + b.rotation[i] * weight;
+    }
+    glm::vec4 lengthSquared = out.rotation[0] * out.rotation[0] + out.rotation[1] * out.rotation[1] +
+                              out.rotation[2] * out.rotation[2] + out.rotation[3] * out.rotation[3];
+    glm::vec4 inverseLength = glm::inversesqrt(lengthSquared);
+    for (uint32_t i = 0; i < 4; ++i) {
+        out.rotation[i] *= inverseLength;
+    }
+    return out;
+}
+
+void blendPoses(const SoaTransform* a, const SoaTransform* b, float weight, SoaTransform* out, uint32_t laneCount) {
+    glm::vec4 weights(weight);
+    for (uint32_t lane = 0; lane < laneCount; ++lane) {
+        out[lane] = blendTransforms(a[lane], b[lane], weights, weights, weights);
+    }
+}
+
+void localToModel(const Skeleton& skeleton, const SoaTransform* pose, glm::mat4* model) {
+    uint32_t jointCount = skeleton.getJointCount();
+    for (uint32_t lane = 0; lane < skeleton.getLaneCount(); ++lane) {
+        const SoaTransform& transform = pose[lane];
+        const glm::vec4& x = transform.rotation[0];
+        const glm::vec4& y = transform.rotation[1];
+        const glm::vec4& z = transform.rotation[2];
+        const glm::vec4& w = transform.rotation[3];
+
+        glm::vec4 xx = x * x, yy = y * y, zz = z * z;
+        glm::vec4 xy = x * y, xz = x * z, yz = y * z;
+        glm::vec4 wx = w * x, wy = w * y, wz = w * z;
+        glm::vec4 one(1.0f);
+
+        // Rotation matrix columns scaled per axis, each element for four joints
+        glm::vec4 columns[3][3] = {
+            {(one - 2.0f * (yy + zz)) * transform.scale[0], 2.0f * (xy + wz) * transform.scale[0],
+             2.0f * (xz - wy) * transform.scale[0]},
+            {2.0f * (xy - wz) * transform.scale[1], (one - 2.0f * (xx + zz)) * transform.scale[1],
+             2.0f * (yz + wx) * transform.scale[1]},
+            {2.0f * (xz + wy) * transform.scale[2], 2.0f * (yz - wx) * transform.scale[2],
+             (one - 2.0f * (xx + yy)) * transform.scale[2]},
+        };
+
+        for (uint32_t i = 0; i < 4 && lane * 4 + i < jointCount; ++i) {
+            glm::mat4& local = model[lane * 4 + i];
+            for (uint32_t column = 0; column < 3; ++column) {
+                local[column] = glm::vec4(columns[column][0][i], columns[column][1][i], columns[column][2][i], 0.0f);
+            }
+            local[3] = glm::vec4(transform.translation[0][i], transform.translation[1][i],
+                                 transform.translation[2][i], 1.0f);
+        }
+    }
+
+    // Parents come first, so theirs are already in model space
+    for (uint32_t joint = 0; joint < jointCount; ++joint) {
+        int32_t parent = skeleton.parents[joint];
+        if (parent >= 0) {
+            model[joint] = model[parent] * model[joint];
+        }
+    }
+}
+
+void buildPalette(const Skeleton& skeleton, const glm::mat4* model, SkinningMatrix* palette) {
+    for (uint32_t joint = 0; joint < skeleton.getJointCount(); ++joint) {
+        glm::mat4 skinning = model[joint] * skeleton.inverseBindMatrices[joint];
+        for (uint32_t row = 0; row < 3; ++row) {
+            palette[joint].rows[row] = glm::vec4(skinning[0][row], skinning[1][row], skinning[2][row],
+                                                 skinning[3][row]);
+        }
+    }
+}
+
+} // namespace plaster
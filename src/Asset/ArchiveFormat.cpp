@@ -0,0 +1,33 @@
+#include "Asset/ArchiveFormat.h"
+#include "Core/Hash.h"
+
+#include <cctype>
+
+namespace plaster {
+
+std::string normalizeAssetPath(const std::string& path) {
+    std::string normalized;
+    normalized.reserve(path.size());
+
+    for (char c : path) {
+        if (c == '\\') {
+            c = '/';
+        }
+        // Collapse repeated separators and drop a leading "./"
+        if (c == '/' && (normalized.empty() || normalized.back() == '/')) {
+            continue;
+        }
+        normalized.push_back(static_cast<char>(std::tolower(static_cast<unsigned char>(c))));
+    }
+
+    if (normalized.compare(0, 2, "./") == 0) {
+        normalized.erase(0, 2);
+    }
+    return normalized;
+}
+
+uint64_t hashAssetPath(const std::string& path) {
+    return hashString(normalizeAssetPath(path));
+}
+
+} // namespace plaster
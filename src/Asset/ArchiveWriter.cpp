@@ -0,0 +1,137 @@
+#include "Asset/ArchiveWriter.h"
+#include "Asset/Compression.h"
+#include "Core/Hash.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+namespace plaster {
+
+namespace {
+
+uint64_t alignUp(uint64_t value, uint64_t alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+} // namespace
+
+void ArchiveWriter::add(const std::string& path, std::vector<uint8_t> data, Compression compression) {
+    PendingEntry entry;
+    entry.path = normalizeAssetPath(path);
+    entry.pathHash = hashString(entry.path);
+    entry.data = std::move(data);
+    entry.compression = isCompressionSupported(compression) ? compression : Compression::None;
+
+    for (const auto& existing : m_entries) {
+        if (existing.pathHash == entry.pathHash) {
+            throw std::runtime_error("Asset path hash collision: " + existing.path + " / " + entry.path);
+        }
+    }
+
+    m_entries.push_back(std::move(entry));
+}
+
+void ArchiveWriter::write(const std::string& outputPath) const {
+    std::vector<const PendingEntry*> sorted;
+    sorted.reserve(m_entries.size());
+    for (const auto& entry : m_entries) {
+        sorted.push_back(&entry);
+    }
+    std::sort(sorted.begin(), sorted.end(), [](const PendingEntry* a, const PendingEntry* b) {
+        return a->pathHash < b->pathHash;
+    });
+
+    std::vector<ArchiveEntry> toc(sorted.size());
+    std::vector<std::vector<uint8_t>> blobs(sorted.size());
+    std::string stringTable;
+
+    for (size_t i = 0; i < sorted.size(); ++i) {
+        blobs[i] = encode(*sorted[i], toc[i]);
+        toc[i].nameOffset = static_cast<uint32_t>(stringTable.size());
+        stringTable += sorted[i]->path;
+        stringTable.push_back('\0');
+    }
+
+    ArchiveHeader header{};
+    header.magic = ARCHIVE_MAGIC;
+    header.version = ARCHIVE_VERSION;
+    header.entryCount = static_cast<uint32_t>(toc.size());
+    header.tocOffset = sizeof(ArchiveHeader);
+    header.stringTableOffset = header.tocOffset + toc.size() * sizeof(ArchiveEntry);
+    header.stringTableSize = stringTable.size();
+
+    uint64_t offset = alignUp(header.stringTableOffset + header.stringTableSize, ARCHIVE_ALIGNMENT);
+    for (size_t i = 0; i < toc.size(); ++i) {
+        toc[i].offset = offset;
+        offset = alignUp(offset + toc[i].storedSize, ARCHIVE_ALIGNMENT);
+    }
+    header.fileSize = toc.empty() ? header.stringTableOffset + header.stringTableSize
+                                  : toc.back().offset + toc.back().storedSize;
+
+    std::ofstream file(outputPath, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        throw std::runtime_error("Failed to open archive for writing: " + outputPath);
+    }
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(toc.data()), toc.size() * sizeof(ArchiveEntry));
+    file.write(stringTable.data(), stringTable.size());
+
+    const char padding[ARCHIVE_ALIGNMENT] = {};
+    uint64_t position = header.stringTableOffset + header.stringTableSize;
+    for (size_t i = 0; i < toc.size(); ++i) {
+        file.write(padding, static_cast<std::streamsize>(toc[i].offset - position));
+        file.write(reinterpret_cast<const char*>(blobs[i].data()), blobs[i].size());
+        position = toc[i].offset + toc[i].storedSize;
+    }
+
+    if (!file) {
+        throw std::runtime_error("Failed to write archive: " + outputPath);
+    }
+}
+
+std::vector<uint8_t> ArchiveWriter::encode(const PendingEntry& entry, ArchiveEntry& tocEntry) {
+    tocEntry = {};
+    tocEntry.pathHash = entry.pathHash;
+    tocEntry.size = entry.data.size();
+    tocEntry.checksum = xxHash64(entry.data.data(), entry.data.size());
+    tocEntry.compression = Compression::None;
+
+    if (entry.compression != Compression::None && !entry.data.empty()) {
+        uint32_t chunkCount = static_cast<uint32_t>((entry.data.size() + ARCHIVE_CHUNK_SIZE - 1) / ARCHIVE_CHUNK_SIZE);
+        std::vector<ArchiveChunk> chunks(chunkCount);
+        std::vector<uint8_t> blob(chunkCount * sizeof(ArchiveChunk));
+
+        for (uint32_t i = 0; i < chunkCount; ++i) {
+            size_t begin = static_cast<size_t>(i) * ARCHIVE_CHUNK_SIZE;
+            size_t size = std::min<size_t>(ARCHIVE_CHUNK_SIZE, entry.data.size() - begin);
+
+            chunks[i].offset = blob.size();
+            chunks[i].size = static_cast<uint32_t>(size);
+
+            size_t written = compressChunk(entry.compression, entry.data.data() + begin, size, blob);
+            if (written == 0) {
+                // Incompressible chunk, store it raw
+                blob.insert(blob.end(), entry.data.begin() + begin, entry.data.begin() + begin + size);
+                written = size;
+            }
+            chunks[i].storedSize = static_cast<uint32_t>(written);
+        }
+
+        // Only keep the compressed form if it actually saves space overall
+        if (blob.size() < entry.data.size()) {
+            std::memcpy(blob.data(), chunks.data(), chunks.size() * sizeof(ArchiveChunk));
+            tocEntry.compression = entry.compression;
+            tocEntry.chunkCount = chunkCount;
+            tocEntry.storedSize = blob.size();
+            return blob;
+        }
+    }
+
+    tocEntry.storedSize = entry.data.size();
+    return entry.data;
+}
+
+} // namespace plaster
@@ -0,0 +1,261 @@
+#include "Asset/AssetArchive.h"
+#include "Asset/Compression.h"
+#include "Core/Hash.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace plaster {
+
+namespace {
+
+// offset + size <= limit, without wrapping on corrupt values
+bool fits(uint64_t offset, uint64_t size, uint64_t limit) {
+    return size <= limit && offset <= limit - size;
+}
+
+} // namespace
+
+AssetArchive::AssetArchive(const std::string& path)
+    : m_path(path), m_data(nullptr), m_size(0), m_header(nullptr), m_entries(nullptr),
+#ifdef _WIN32
+      m_fileHandle(INVALID_HANDLE_VALUE), m_mappingHandle(nullptr) {
+#else
+      m_fileDescriptor(-1) {
+#endif
+    mapFile();
+    try {
+        validate();
+    } catch (...) {
+        unmapFile();
+        throw;
+    }
+}
+
+AssetArchive::~AssetArchive() {
+    unmapFile();
+}
+
+const ArchiveEntry* AssetArchive::find(const std::string& path) const {
+    return find(hashAssetPath(path));
+}
+
+const ArchiveEntry* AssetArchive::find(uint64_t pathHash) const {
+    const ArchiveEntry* begin = m_entries;
+    const ArchiveEntry* end = m_entries + m_header->entryCount;
+
+    const ArchiveEntry* it = std::lower_bound(begin, end, pathHash,
+                                              [](const ArchiveEntry& entry, uint64_t hash) {
+                                                  return entry.pathHash < hash;
+                                              });
+    if (it != end && it->pathHash == pathHash) {
+        return it;
+    }
+    return nullptr;
+}
+
+AssetView AssetArchive::view(const ArchiveEntry& entry) const {
+    if (entry.compression != Compression::None) {
+        return {};
+    }
+    return {m_data + entry.offset, static_cast<size_t>(entry.size)};
+}
+
+bool AssetArchive::read(const ArchiveEntry& entry, void* dst) const {
+    return decode(entry, m_data + entry.offset, dst);
+}
+
+bool AssetArchive::decode(const ArchiveEntry& entry, const uint8_t* blob, void* dst) {
+    if (entry.compression == Compression::None) {
+        std::memcpy(dst, blob, static_cast<size_t>(entry.size));
+        return true;
+    }
+
+    if (!isCompressionSupported(entry.compression)) {
+        return false;
+    }
+
+    // validate() has checked the chunk table against the blob; this only
+    // guards dst against an entry that did not come from a validated archive
+    const ArchiveChunk* chunks = reinterpret_cast<const ArchiveChunk*>(blob);
+    uint8_t* out = static_cast<uint8_t*>(dst);
+    uint64_t written = 0;
+
+    for (uint32_t i = 0; i < entry.chunkCount; ++i) {
+        const ArchiveChunk& chunk = chunks[i];
+        if (!fits(written, chunk.size, entry.size) || !fits(chunk.offset, chunk.storedSize, entry.storedSize)) {
+            return false;
+        }
+        const uint8_t* src = blob + chunk.offset;
+
+        if (chunk.storedSize == chunk.size) {
+            std::memcpy(out, src, chunk.size);
+        } else if (!decompressChunk(entry.compression, src, chunk.storedSize, out, chunk.size)) {
+            return false;
+        }
+        out += chunk.size;
+        written += chunk.size;
+    }
+    return written == entry.size;
+}
+
+bool AssetArchive::verify(const ArchiveEntry& entry) const {
+    if (entry.compression == Compression::None) {
+        return xxHash64(m_data + entry.offset, static_cast<size_t>(entry.size)) == entry.checksum;
+    }
+
+    std::vector<uint8_t> scratch(static_cast<size_t>(entry.size));
+    return read(entry, scratch.data()) && xxHash64(scratch.data(), scratch.size()) == entry.checksum;
+}
+
+void AssetArchive::prefetch(const ArchiveEntry& entry) const {
+#ifdef _WIN32
+    WIN32_MEMORY_RANGE_ENTRY range;
+    range.VirtualAddress = const_cast<uint8_t*>(m_data + entry.offset);
+    range.NumberOfBytes = static_cast<SIZE_T>(entry.storedSize);
+    PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#else
+    madvise(const_cast<uint8_t*>(m_data + entry.offset), static_cast<size_t>(entry.storedSize), MADV_WILLNEED);
+#endif
+}
+
+const char* AssetArchive::getName(const ArchiveEntry& entry) const {
+    return reinterpret_cast<const char*>(m_data + m_header->stringTableOffset + entry.nameOffset);
+}
+
+void AssetArchive::mapFile() {
+#ifdef _WIN32
+    HANDLE file = CreateFileA(m_path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        throw std::runtime_error("Failed to open asset archive: " + m_path);
+    }
+    m_fileHandle = file;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize)) {
+        unmapFile();
+        throw std::runtime_error("Failed to open asset archive: " + m_path);
+    }
+    m_size = static_cast<size_t>(fileSize.QuadPart);
+
+    m_mappingHandle = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!m_mappingHandle) {
+        unmapFile();
+        throw std::runtime_error("Failed to map asset archive: " + m_path);
+    }
+
+    m_data = static_cast<const uint8_t*>(MapViewOfFile(m_mappingHandle, FILE_MAP_READ, 0, 0, 0));
+#else
+    m_fileDescriptor = open(m_path.c_str(), O_RDONLY);
+    if (m_fileDescriptor < 0) {
+        throw std::runtime_error("Failed to open asset archive: " + m_path);
+    }
+
+    struct stat fileStat;
+    if (fstat(m_fileDescriptor, &fileStat) != 0) {
+        unmapFile();
+        throw std::runtime_error("Failed to open asset archive: " + m_path);
+    }
+    m_size = static_cast<size_t>(fileStat.st_size);
+
+    void* mapping = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, m_fileDescriptor, 0);
+    m_data = mapping == MAP_FAILED ? nullptr : static_cast<const uint8_t*>(mapping);
+#endif
+
+    if (!m_data) {
+        unmapFile();
+        throw std::runtime_error("Failed to map asset archive: " + m_path);
+    }
+}
+
+void AssetArchive::unmapFile() {
+#ifdef _WIN32
+    if (m_data) {
+        UnmapViewOfFile(m_data);
+    }
+    if (m_mappingHandle) {
+        CloseHandle(m_mappingHandle);
+    }
+    if (m_fileHandle != INVALID_HANDLE_VALUE) {
+        CloseHandle(m_fileHandle);
+    }
+    m_mappingHandle = nullptr;
+    m_fileHandle = INVALID_HANDLE_VALUE;
+#else
+    if (m_data) {
+        munmap(const_cast<uint8_t*>(m_data), m_size);
+    }
+    if (m_fileDescriptor >= 0) {
+        close(m_fileDescriptor);
+    }
+    m_fileDescriptor = -1;
+#endif
+    m_data = nullptr;
+    m_header = nullptr;
+    m_entries = nullptr;
+}
+
+void AssetArchive::validate() {
+    if (m_size < sizeof(ArchiveHeader)) {
+        throw std::runtime_error("Asset archive is truncated: " + m_path);
+    }
+
+    m_header = reinterpret_cast<const ArchiveHeader*>(m_data);
+    if (m_header->magic != ARCHIVE_MAGIC || m_header->version != ARCHIVE_VERSION) {
+        throw std::runtime_error("Not a compatible asset archive: " + m_path);
+    }
+    if (m_header->fileSize != m_size ||
+        !fits(m_header->tocOffset, uint64_t(m_header->entryCount) * sizeof(ArchiveEntry), m_size) ||
+        !fits(m_header->stringTableOffset, m_header->stringTableSize, m_size)) {
+        throw std::runtime_error("Asset archive is corrupt: " + m_path);
+    }
+
+    m_entries = reinterpret_cast<const ArchiveEntry*>(m_data + m_header->tocOffset);
+
+    for (uint32_t i = 0; i < m_header->entryCount; ++i) {
+        const ArchiveEntry& entry = m_entries[i];
+        if (entry.offset % ARCHIVE_ALIGNMENT != 0 || !fits(entry.offset, entry.storedSize, m_size) ||
+            entry.nameOffset >= m_header->stringTableSize) {
+            throw std::runtime_error("Asset archive is corrupt: " + m_path);
+        }
+
+        // view() and decode() copy size bytes, so raw entries must store exactly that
+        if (entry.compression == Compression::None) {
+            if (entry.size != entry.storedSize) {
+                throw std::runtime_error("Asset archive is corrupt: " + m_path);
+            }
+            continue;
+        }
+
+        // Every chunk inside the blob, and together filling exactly size bytes
+        if (uint64_t(entry.chunkCount) * sizeof(ArchiveChunk) > entry.storedSize) {
+            throw std::runtime_error("Asset archive is corrupt: " + m_path);
+        }
+        const ArchiveChunk* chunks = reinterpret_cast<const ArchiveChunk*>(m_data + entry.offset);
+        uint64_t size = 0;
+        for (uint32_t j = 0; j < entry.chunkCount; ++j) {
+            if (!fits(chunks[j].offset, chunks[j].storedSize, entry.storedSize)) {
+                throw std::runtime_error("Asset archive is corrupt: " + m_path);
+            }
+            size += chunks[j].size;
+        }
+        if (size != entry.size) {
+            throw std::runtime_error("Asset archive is corrupt: " + m_path);
+        }
+    }
+}
+
+} // namespace plaster
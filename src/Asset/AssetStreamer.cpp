@@ -0,0 +1,535 @@
+#include "Asset/AssetStreamer.h"
+#include "Asset/AssetArchive.h"
+#include "Core/Hash.h"
+#include "Core/JobSystem.h"
+#include "Core/Log.h"
+#include "Core/ObjectPool.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#ifdef PLASTER_HAS_IO_URING
+#include <liburing.h>
+#endif
+
+namespace plaster {
+
+namespace {
+
+#ifdef _WIN32
+using NativeFile = HANDLE;
+const NativeFile INVALID_NATIVE_FILE = INVALID_HANDLE_VALUE;
+#else
+using NativeFile = int;
+const NativeFile INVALID_NATIVE_FILE = -1;
+#endif
+
+NativeFile openForReading(const std::string& path) {
+#ifdef _WIN32
+    return CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                       FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, nullptr);
+#else
+    return open(path.c_str(), O_RDONLY);
+#endif
+}
+
+void closeFile(NativeFile file) {
+    if (file == INVALID_NATIVE_FILE) {
+        return;
+    }
+#ifdef _WIN32
+    CloseHandle(file);
+#else
+    close(file);
+#endif
+}
+
+// Blocking positional read, used when io_uring is not available
+bool readAt(NativeFile file, uint64_t offset, uint8_t* dst, size_t size) {
+    while (size > 0) {
+#ifdef _WIN32
+        OVERLAPPED overlapped{};
+        overlapped.Offset = static_cast<DWORD>(offset);
+        overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+        DWORD chunk = static_cast<DWORD>(std::min<size_t>(size, 1u << 30));
+        DWORD bytesRead = 0;
+        if (!ReadFile(file, dst, chunk, &bytesRead, &overlapped) || bytesRead == 0) {
+            return false;
+        }
+#else
+        ssize_t bytesRead = pread(file, dst, size, static_cast<off_t>(offset));
+        if (bytesRead <= 0) {
+            return false;
+        }
+#endif
+        offset += static_cast<uint64_t>(bytesRead);
+        dst += bytesRead;
+        size -= static_cast<size_t>(bytesRead);
+    }
+    return true;
+}
+
+} // namespace
+
+float computeStreamingPriority(float screenCoverage, float distance) {
+    // Coverage dominates; distance breaks ties between equally small objects
+    return std::max(screenCoverage, 0.0f) * 1000.0f + 1.0f / (1.0f + std::max(distance, 0.0f));
+}
+
+struct AssetStreamer::MountedArchive {
+    std::unique_ptr<AssetArchive> archive;
+    NativeFile file = INVALID_NATIVE_FILE;
+
+    ~MountedArchive() { closeFile(file); }
+};
+
+struct AssetStreamer::IoBackend {
+    struct Read {
+        uint32_t asset;
+        NativeFile file;
+        uint64_t offset;
+        std::vector<uint8_t> buffer;
+        size_t completed;
+    };
+
+    static const uint32_t QUEUE_DEPTH = 32;
+
+    // Only touched by the IO thread
+    ObjectPool<Read, QUEUE_DEPTH> readPool;
+    std::vector<Read*> finished;
+    uint32_t inFlight = 0;
+
+#ifdef PLASTER_HAS_IO_URING
+    io_uring ring;
+    bool useUring = false;
+
+    IoBackend() {
+        // Fails on old kernels or when io_uring is blocked by seccomp
+        useUring = io_uring_queue_init(QUEUE_DEPTH, &ring, 0) == 0;
+    }
+
+    ~IoBackend() {
+        if (useUring) {
+            io_uring_queue_exit(&ring);
+        }
+    }
+
+    void submitUring(Read* read) {
+        io_uring_sqe* sqe = io_uring_get_sqe(&ring);
+        io_uring_prep_read(sqe, read->file, read->buffer.data() + read->completed,
+                           static_cast<unsigned>(read->buffer.size() - read->completed),
+                           read->offset + read->completed);
+        io_uring_sqe_set_data(sqe, read);
+    }
+#endif
+
+    bool hasCapacity() const { return inFlight < QUEUE_DEPTH; }
+
+    void submit(Read* read) {
+#ifdef PLASTER_HAS_IO_URING
+        if (useUring) {
+            submitUring(read);
+            ++inFlight;
+            return;
+        }
+#endif
+        bool success = readAt(read->file, read->offset, read->buffer.data(), read->buffer.size());
+        read->completed = success ? read->buffer.size() : 0;
+        finished.push_back(read);
+        ++inFlight;
+    }
+
+    void flush() {
+#ifdef PLASTER_HAS_IO_URING
+        if (useUring) {
+            io_uring_submit(&ring);
+        }
+#endif
+    }
+
+    // Blocks until at least one read has finished, then replaces result with all
+    // finished reads; the caller hands them back to readPool
+    void reap(std::vector<Read*>& result) {
+#ifdef PLASTER_HAS_IO_URING
+        if (useUring && inFlight > 0) {
+            io_uring_cqe* cqe = nullptr;
+            io_uring_wait_cqe(&ring, &cqe);
+
+            bool resubmitted = false;
+            while (cqe) {
+                Read* read = static_cast<Read*>(io_uring_cqe_get_data(cqe));
+                int result = cqe->res;
+                io_uring_cqe_seen(&ring, cqe);
+
+                if (result > 0 && read->completed + static_cast<size_t>(result) < read->buffer.size()) {
+                    // Short read, queue the remainder
+                    read->completed += static_cast<size_t>(result);
+                    submitUring(read);
+                    resubmitted = true;
+                } else {
+                    if (result > 0) {
+                        read->completed += static_cast<size_t>(result);
+                    }
+                    finished.push_back(read);
+                }
+
+                cqe = nullptr;
+                io_uring_peek_cqe(&ring, &cqe);
+            }
+
+            if (resubmitted) {
+                io_uring_submit(&ring);
+            }
+        }
+#endif
+        result.clear();
+        result.swap(finished);
+        inFlight -= static_cast<uint32_t>(result.size());
+    }
+};
+
+AssetStreamer::AssetStreamer(JobSystem* jobSystem, uint64_t vramBudget, uint32_t framesInFlight)
+    : m_jobSystem(jobSystem), m_io(std::make_unique<IoBackend>()), m_stopping(false),
+      m_decodesInFlight(0), m_bytesRead(0), m_sequence(0), m_frameNumber(0),
+      m_vramBudget(vramBudget), m_residentBytes(0), m_uploadBytesPerFrame(32ull * 1024 * 1024),
+      m_framesInFlight(framesInFlight), m_evictions(0) {
+    m_ioThread = std::thread(&AssetStreamer::ioThreadLoop, this);
+}
+
+AssetStreamer::~AssetStreamer() {
+    stopWorkers();
+
+    // The loaders may already be gone, so don't evict through them here
+    if (!m_lru.empty()) {
+        logError("assets", "AssetStreamer destroyed with " + std::to_string(m_lru.size()) +
+                           " resident assets, call shutdown() first");
+    }
+}
+
+void AssetStreamer::mountArchive(const std::string& path) {
+    auto mounted = std::make_unique<MountedArchive>();
+    mounted->archive = std::make_unique<AssetArchive>(path);
+    mounted->file = openForReading(path);
+    if (mounted->file == INVALID_NATIVE_FILE) {
+        throw std::runtime_error("Failed to open asset archive for streaming: " + path);
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_archives.push_back(std::move(mounted));
+}
+
+AssetHandle AssetStreamer::request(const std::string& path, AssetLoader* loader, float priority) {
+    uint64_t pathHash = hashAssetPath(path);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    Asset asset{};
+    asset.path = path;
+    asset.loader = loader;
+    asset.archive = UINT32_MAX;
+    asset.entry = nullptr;
+    asset.state = AssetState::Failed;
+    asset.resident = false;
+    asset.priority = priority;
+    asset.lruPosition = m_lru.end();
+
+    for (size_t i = m_archives.size(); i-- > 0;) {
+        if (const ArchiveEntry* entry = m_archives[i]->archive->find(pathHash)) {
+            asset.archive = static_cast<uint32_t>(i);
+            asset.entry = entry;
+            asset.state = AssetState::Unloaded;
+            break;
+        }
+    }
+
+    AssetHandle handle;
+    handle.index = static_cast<uint32_t>(m_assets.size());
+    m_assets.push_back(std::move(asset));
+
+    if (m_assets.back().state == AssetState::Unloaded) {
+        enqueueLocked(handle.index);
+    }
+    return handle;
+}
+
+void AssetStreamer::setPriority(AssetHandle handle, float priority) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    Asset& asset = m_assets[handle.index];
+    if (asset.priority == priority) {
+        return;
+    }
+    asset.priority = priority;
+
+    // Re-push with the new priority; the stale queue entry is skipped when popped
+    if (asset.state == AssetState::Queued) {
+        enqueueLocked(handle.index);
+    }
+}
+
+uint64_t AssetStreamer::resolve(AssetHandle handle) {
+    Asset& asset = m_assets[handle.index];
+    asset.lastUsedFrame = m_frameNumber;
+
+    if (asset.resident) {
+        m_lru.splice(m_lru.begin(), m_lru, asset.lruPosition);
+        return asset.resource;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (asset.state == AssetState::Unloaded) {
+        enqueueLocked(handle.index);
+    }
+    return asset.loader->getPlaceholder();
+}
+
+AssetState AssetStreamer::getState(AssetHandle handle) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_assets[handle.index].state;
+}
+
+void AssetStreamer::update(uint64_t frameNumber) {
+    m_frameNumber = frameNumber;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (auto& decoded : m_decoded) {
+            decoded.priority = m_assets[decoded.asset].priority;
+            m_pendingUploads.push_back(std::move(decoded));
+        }
+        m_decoded.clear();
+    }
+
+    // Most important uploads first, capped so a burst of completions can't cause a hitch
+    std::sort(m_pendingUploads.begin(), m_pendingUploads.end(),
+              [](const DecodedAsset& a, const DecodedAsset& b) { return a.priority > b.priority; });
+
+    uint64_t uploadedBytes = 0;
+    size_t uploadedCount = 0;
+    for (auto& decoded : m_pendingUploads) {
+        if (uploadedCount > 0 && uploadedBytes + decoded.data.size() > m_uploadBytesPerFrame) {
+            break;
+        }
+
+        Asset& asset = m_assets[decoded.asset];
+        uint64_t residentBytes = 0;
+        asset.resource = asset.loader->upload(decoded.data, residentBytes);
+        asset.residentBytes = residentBytes;
+        asset.lastUsedFrame = frameNumber;
+        m_lru.push_front(decoded.asset);
+        asset.lruPosition = m_lru.begin();
+        m_residentBytes += residentBytes;
+
+        asset.resident = true;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            asset.state = AssetState::Resident;
+        }
+
+        uploadedBytes += decoded.data.size();
+        ++uploadedCount;
+    }
+    m_pendingUploads.erase(m_pendingUploads.begin(), m_pendingUploads.begin() + uploadedCount);
+
+    enforceBudget();
+}
+
+void AssetStreamer::evictAll() {
+    while (!m_lru.empty()) {
+        evictAsset(m_lru.back());
+    }
+}
+
+void AssetStreamer::shutdown() {
+    stopWorkers();
+    evictAll();
+}
+
+StreamingStats AssetStreamer::getStats() const {
+    StreamingStats stats;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (const auto& asset : m_assets) {
+        if (asset.state == AssetState::Queued) {
+            ++stats.queued;
+        } else if (asset.state == AssetState::Loading || asset.state == AssetState::Decoded) {
+            ++stats.loading;
+        } else if (asset.state == AssetState::Resident) {
+            ++stats.resident;
+        }
+    }
+    stats.residentBytes = m_residentBytes;
+    stats.budgetBytes = m_vramBudget;
+    stats.bytesRead = m_bytesRead.load();
+    stats.evictions = m_evictions;
+    return stats;
+}
+
+void AssetStreamer::stopWorkers() {
+    if (!m_ioThread.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_condition.notify_all();
+    m_ioThread.join();
+
+    // Decode jobs hold a pointer back to us
+    while (m_decodesInFlight.load() > 0) {
+        std::this_thread::yield();
+    }
+}
+
+void AssetStreamer::enqueueLocked(uint32_t asset) {
+    m_assets[asset].state = AssetState::Queued;
+    m_assets[asset].requestSequence = ++m_sequence;
+    m_readQueue.push({m_assets[asset].priority, m_sequence, asset});
+    m_condition.notify_one();
+}
+
+bool AssetStreamer::popReadLocked(uint32_t& asset, uint32_t& archive, uint64_t& offset, uint64_t& size) {
+    while (!m_readQueue.empty()) {
+        ReadRequest request = m_readQueue.top();
+        m_readQueue.pop();
+
+        Asset& candidate = m_assets[request.asset];
+        if (candidate.state != AssetState::Queued || candidate.requestSequence != request.sequence) {
+            continue;
+        }
+
+        candidate.state = AssetState::Loading;
+        asset = request.asset;
+        archive = candidate.archive;
+        offset = candidate.entry->offset;
+        size = candidate.entry->storedSize;
+        return true;
+    }
+    return false;
+}
+
+void AssetStreamer::ioThreadLoop() {
+    // Swapped with IoBackend::finished, so neither reallocates once warmed up
+    std::vector<IoBackend::Read*> finished;
+
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            if (m_io->inFlight == 0) {
+                m_condition.wait(lock, [this] { return m_stopping || !m_readQueue.empty(); });
+            }
+            if (m_stopping) {
+                break;
+            }
+
+            uint32_t asset, archive;
+            uint64_t offset, size;
+            while (m_io->hasCapacity() && popReadLocked(asset, archive, offset, size)) {
+                IoBackend::Read* read = m_io->readPool.create();
+                read->asset = asset;
+                read->file = m_archives[archive]->file;
+                read->offset = offset;
+                read->buffer.resize(static_cast<size_t>(size));
+                read->completed = 0;
+
+                // pread happens inline, so don't hold the lock over it
+                lock.unlock();
+                m_io->submit(read);
+                lock.lock();
+            }
+        }
+
+        m_io->flush();
+
+        m_io->reap(finished);
+        for (IoBackend::Read* read : finished) {
+            bool success = read->completed == read->buffer.size();
+            m_bytesRead.fetch_add(read->completed);
+            onReadComplete(read->asset, std::move(read->buffer), success);
+            m_io->readPool.destroy(read);
+        }
+    }
+
+    // Drain outstanding reads so the kernel isn't writing into freed buffers
+    while (m_io->inFlight > 0) {
+        m_io->reap(finished);
+        for (IoBackend::Read* read : finished) {
+            m_io->readPool.destroy(read);
+        }
+    }
+}
+
+void AssetStreamer::onReadComplete(uint32_t asset, std::vector<uint8_t> stored, bool success) {
+    const ArchiveEntry* entry;
+    AssetLoader* loader;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!success) {
+            m_assets[asset].state = AssetState::Failed;
+            return;
+        }
+        entry = m_assets[asset].entry;
+        loader = m_assets[asset].loader;
+    }
+
+    m_decodesInFlight.fetch_add(1);
+    auto storedData = std::make_shared<std::vector<uint8_t>>(std::move(stored));
+
+    m_jobSystem->schedule([this, asset, entry, loader, storedData]() {
+        std::vector<uint8_t> data(static_cast<size_t>(entry->size));
+        bool ok = AssetArchive::decode(*entry, storedData->data(), data.data()) &&
+                  xxHash64(data.data(), data.size()) == entry->checksum &&
+                  loader->decode(data);
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (ok) {
+                m_assets[asset].state = AssetState::Decoded;
+                m_decoded.push_back({asset, 0.0f, std::move(data)});
+            } else {
+                m_assets[asset].state = AssetState::Failed;
+            }
+        }
+        m_decodesInFlight.fetch_sub(1);
+    });
+}
+
+void AssetStreamer::evictAsset(uint32_t index) {
+    Asset& asset = m_assets[index];
+
+    asset.loader->evict(asset.resource);
+    m_residentBytes -= asset.residentBytes;
+    m_lru.erase(asset.lruPosition);
+    asset.lruPosition = m_lru.end();
+    asset.resource = 0;
+    asset.residentBytes = 0;
+    asset.resident = false;
+    ++m_evictions;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    asset.state = AssetState::Unloaded;
+}
+
+void AssetStreamer::enforceBudget() {
+    while (m_residentBytes > m_vramBudget && !m_lru.empty()) {
+        uint32_t victim = m_lru.back();
+
+        // Anything touched within the last framesInFlight frames may still be read by the GPU
+        if (m_assets[victim].lastUsedFrame + m_framesInFlight > m_frameNumber) {
+            break;
+        }
+        evictAsset(victim);
+    }
+}
+
+} // namespace plaster
@@ -0,0 +1,93 @@
+#include "Asset/Compression.h"
+
+#ifdef PLASTER_HAS_LZ4
+#include <lz4.h>
+#endif
+#ifdef PLASTER_HAS_ZSTD
+#include <zstd.h>
+#endif
+
+namespace plaster {
+
+bool isCompressionSupported(Compression compression) {
+    switch (compression) {
+    case Compression::None:
+        return true;
+    case Compression::LZ4:
+#ifdef PLASTER_HAS_LZ4
+        return true;
+#else
+        return false;
+#endif
+    case Compression::Zstd:
+#ifdef PLASTER_HAS_ZSTD
+        return true;
+#else
+        return false;
+#endif
+    }
+    return false;
+}
+
+size_t compressChunk(Compression compression, const void* src, size_t srcSize, std::vector<uint8_t>& dst) {
+    (void)src;
+    size_t start = dst.size();
+    size_t written = 0;
+
+    switch (compression) {
+#ifdef PLASTER_HAS_LZ4
+    case Compression::LZ4: {
+        int bound = LZ4_compressBound(static_cast<int>(srcSize));
+        dst.resize(start + bound);
+        int result = LZ4_compress_default(static_cast<const char*>(src), reinterpret_cast<char*>(dst.data() + start),
+                                          static_cast<int>(srcSize), bound);
+        written = result > 0 ? static_cast<size_t>(result) : 0;
+        break;
+    }
+#endif
+#ifdef PLASTER_HAS_ZSTD
+    case Compression::Zstd: {
+        size_t bound = ZSTD_compressBound(srcSize);
+        dst.resize(start + bound);
+        size_t result = ZSTD_compress(dst.data() + start, bound, src, srcSize, 19);
+        written = ZSTD_isError(result) ? 0 : result;
+        break;
+    }
+#endif
+    default:
+        break;
+    }
+
+    if (written == 0 || written >= srcSize) {
+        dst.resize(start);
+        return 0;
+    }
+    dst.resize(start + written);
+    return written;
+}
+
+bool decompressChunk(Compression compression, const void* src, size_t srcSize, void* dst, size_t dstSize) {
+    (void)src;
+    (void)srcSize;
+    (void)dst;
+    (void)dstSize;
+    switch (compression) {
+#ifdef PLASTER_HAS_LZ4
+    case Compression::LZ4: {
+        int result = LZ4_decompress_safe(static_cast<const char*>(src), static_cast<char*>(dst),
+                                         static_cast<int>(srcSize), static_cast<int>(dstSize));
+        return result == static_cast<int>(dstSize);
+    }
+#endif
+#ifdef PLASTER_HAS_ZSTD
+    case Compression::Zstd: {
+        size_t result = ZSTD_decompress(dst, dstSize, src, srcSize);
+        return !ZSTD_isError(result) && result == dstSize;
+    }
+#endif
+    default:
+        return false;
+    }
+}
+
+} // namespace plaster
@@ -3,28 +3,127 @@
 #include "Core/Input.h"
 #include "Graphics/VulkanContext.h"
 #include "Graphics/Renderer.h"
+#include "Graphics/SkinningPass.h"
+#include "Graphics/MeshLoader.h"
+#include "Core/JobSystem.h"
+#include "Core/Log.h"
+#include "Core/Metrics.h"
+#include "Asset/AssetStreamer.h"
+#include "Animation/Animator.h"
+#include "Physics/PhysicsWorld.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <exception>
+#include <filesystem>
 
 namespace plaster {
 
+namespace {
+
+std::atomic<bool> g_metricsDumpRequested{false};
+
+const float PHYSICS_TIME_STEP = 1.0f / 60.0f;
+// A slow frame drops time beyond this rather than making the next frame slower still
+const uint32_t MAX_PHYSICS_STEPS = 4;
+
+#ifndef _WIN32
+void requestMetricsDump(int) {
+    g_metricsDumpRequested.store(true, std::memory_order_relaxed);
+}
+#endif
+
+} // namespace
+
 Application::Application()
-    : m_window(nullptr), m_vulkanContext(nullptr), m_renderer(nullptr) {
+    : m_window(nullptr), m_vulkanContext(nullptr), m_renderer(nullptr),
+      m_jobSystem(nullptr), m_assetStreamer(nullptr), m_meshLoader(nullptr), m_animator(nullptr),
+      m_physicsWorld(nullptr), m_frameNumber(0), m_physicsTime(0.0f) {
     
     m_window = new Window(2560, 1440, "PlasterEngine");
     m_vulkanContext = new VulkanContext(m_window);
-    m_renderer = new Renderer(m_window, m_vulkanContext);
+    m_jobSystem = new JobSystem();
+    m_renderer = new Renderer(m_window, m_vulkanContext, m_jobSystem);
+
+    // Leave headroom for render targets and driver allocations
+    uint64_t vramBudget = m_vulkanContext->getDeviceLocalBudget() / 10 * 6;
+    m_assetStreamer = new AssetStreamer(m_jobSystem, vramBudget, Renderer::MAX_FRAMES_IN_FLIGHT);
+    if (std::filesystem::exists("assets.ppak")) {
+        m_assetStreamer->mountArchive("assets.ppak");
+    }
+    m_meshLoader = new MeshLoader(m_renderer);
+    m_animator = new Animator(m_jobSystem);
+    m_physicsWorld = new PhysicsWorld(m_jobSystem);
+
+    // PLASTER_METRICS=<path>.json|.csv writes every metric on exit and, outside
+    // Windows, whenever the process receives SIGUSR1
+    if (const char* metricsPath = std::getenv("PLASTER_METRICS")) {
+        m_metricsPath = metricsPath;
+#ifndef _WIN32
+        std::signal(SIGUSR1, requestMetricsDump);
+#endif
+    }
 }
 
 Application::~Application() {
+    // Streamed resources may still be referenced by frames in flight
+    m_renderer->waitIdle();
+    m_assetStreamer->shutdown();
+    writeMetrics();
+    delete m_physicsWorld;
+    delete m_animator;
+    delete m_assetStreamer;
+    delete m_meshLoader;
     delete m_renderer;
+    delete m_jobSystem;
     delete m_vulkanContext;
     delete m_window;
 }
 
 void Application::run() {
+    auto lastFrameTime = std::chrono::steady_clock::now();
     while (!m_window->shouldClose()) {
         m_window->pollEvents();
         Input::Update();
+        m_assetStreamer->update(++m_frameNumber);
+
+        auto now = std::chrono::steady_clock::now();
+        float deltaTime = std::chrono::duration<float>(now - lastFrameTime).count();
+        lastFrameTime = now;
+
+        // Fixed steps keep the simulation stable and the same at any frame rate
+        m_physicsTime = std::min(m_physicsTime + deltaTime, PHYSICS_TIME_STEP * MAX_PHYSICS_STEPS);
+        while (m_physicsTime >= PHYSICS_TIME_STEP) {
+            m_physicsWorld->step(PHYSICS_TIME_STEP);
+            m_physicsTime -= PHYSICS_TIME_STEP;
+        }
+
+        // Poses are evaluated on the workers while the render thread is still
+        // recording the previous frame, which already has its palettes
+        m_animator->update(deltaTime);
+        const std::vector<SkinningMatrix>& palettes = m_animator->getPalettes();
+        m_renderer->getSkinningPass()->setPalettes(palettes.data(), static_cast<uint32_t>(palettes.size()));
         m_renderer->render();
+
+        if (g_metricsDumpRequested.exchange(false, std::memory_order_relaxed)) {
+            writeMetrics();
+        }
+    }
+}
+
+void Application::writeMetrics() {
+    if (m_metricsPath.empty()) {
+        return;
+    }
+    // Diagnostics only; a bad path shouldn't take the application down
+    try {
+        Metrics::write(m_metricsPath);
+        logInfo("metrics", "Wrote " + m_metricsPath);
+    } catch (const std::exception& e) {
+        logError("metrics", e.what());
     }
 }
 
@@ -0,0 +1,157 @@
+#include "Core/FrameArena.h"
+#include "Core/Metrics.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+
+namespace plaster {
+
+LinearArena::LinearArena(size_t chunkSize)
+    : m_chunkSize(chunkSize), m_current(0), m_offset(0), m_used(0), m_peak(0), m_capacity(0) {
+}
+
+LinearArena::~LinearArena() {
+    for (const Chunk& chunk : m_chunks) {
+        std::free(chunk.data);
+    }
+}
+
+void* LinearArena::allocate(size_t size, size_t alignment) {
+    for (;;) {
+        if (m_current < m_chunks.size()) {
+            Chunk& chunk = m_chunks[m_current];
+            uintptr_t base = reinterpret_cast<uintptr_t>(chunk.data);
+            size_t aligned = ((base + m_offset + alignment - 1) & ~(alignment - 1)) - base;
+            if (aligned + size <= chunk.size) {
+                m_used += aligned + size - m_offset;
+                m_peak = std::max(m_peak, m_used);
+                m_offset = aligned + size;
+                return chunk.data + aligned;
+            }
+
+            // The rest of this chunk is wasted until the next reset
+            m_used += chunk.size - m_offset;
+            ++m_current;
+            m_offset = 0;
+            if (m_current < m_chunks.size() && m_chunks[m_current].size >= size + alignment) {
+                continue;
+            }
+        }
+
+        // Inserted at the current position, so a chunk grown for a large request is
+        // tried first again after the reset
+        Chunk chunk;
+        chunk.size = std::max(m_chunkSize, size + alignment);
+        chunk.data = static_cast<char*>(std::malloc(chunk.size));
+        if (!chunk.data) {
+            throw std::bad_alloc();
+        }
+        m_chunks.insert(m_chunks.begin() + std::min<size_t>(m_current, m_chunks.size()), chunk);
+        m_capacity += chunk.size;
+        static Counter& chunkAllocations = Metrics::counter("memory.arena_chunk_allocations");
+        chunkAllocations.add();
+    }
+}
+
+void LinearArena::reset() {
+    m_current = 0;
+    m_offset = 0;
+    m_used = 0;
+}
+
+namespace {
+
+struct ThreadArenas;
+
+struct Registry {
+    std::mutex mutex;
+    std::vector<ThreadArenas*> threads;
+};
+
+Registry& getRegistry() {
+    static Registry registry;
+    return registry;
+}
+
+std::atomic<uint64_t> g_frameNumber{0};
+std::atomic<uint32_t> g_framesInFlight{1};
+
+struct ThreadArenas {
+    LinearArena arenas[FrameArena::MAX_FRAMES_IN_FLIGHT];
+    uint64_t frames[FrameArena::MAX_FRAMES_IN_FLIGHT] = {};
+
+    // Published on each reset for getStats(), which runs on another thread
+    std::atomic<size_t> lastUsed{0};
+    std::atomic<size_t> peak{0};
+    std::atomic<size_t> capacity{0};
+    std::atomic<uint32_t> chunkCount{0};
+
+    ThreadArenas() {
+        Registry& registry = getRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        registry.threads.push_back(this);
+    }
+
+    ~ThreadArenas() {
+        Registry& registry = getRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        registry.threads.erase(std::find(registry.threads.begin(), registry.threads.end(), this));
+    }
+};
+
+thread_local ThreadArenas t_arenas;
+
+} // namespace
+
+void FrameArena::beginFrame(uint64_t frameNumber, uint32_t framesInFlight) {
+    if (framesInFlight == 0 || framesInFlight > MAX_FRAMES_IN_FLIGHT) {
+        throw std::runtime_error("FrameArena supports 1 to 4 frames in flight");
+    }
+    g_framesInFlight.store(framesInFlight, std::memory_order_relaxed);
+    g_frameNumber.store(frameNumber, std::memory_order_release);
+}
+
+LinearArena& FrameArena::get() {
+    uint64_t frameNumber = g_frameNumber.load(std::memory_order_acquire);
+    uint32_t slot = static_cast<uint32_t>(frameNumber % g_framesInFlight.load(std::memory_order_relaxed));
+
+    ThreadArenas& arenas = t_arenas;
+    LinearArena& arena = arenas.arenas[slot];
+    if (arenas.frames[slot] != frameNumber) {
+        arenas.frames[slot] = frameNumber;
+        arenas.lastUsed.store(arena.getUsed(), std::memory_order_relaxed);
+        arenas.peak.store(arena.getPeak(), std::memory_order_relaxed);
+        arena.reset();
+
+        size_t capacity = 0;
+        uint32_t chunkCount = 0;
+        for (const LinearArena& each : arenas.arenas) {
+            capacity += each.getCapacity();
+            chunkCount += each.getChunkCount();
+        }
+        arenas.capacity.store(capacity, std::memory_order_relaxed);
+        arenas.chunkCount.store(chunkCount, std::memory_order_relaxed);
+    }
+    return arena;
+}
+
+FrameArenaStats FrameArena::getStats() {
+    FrameArenaStats stats;
+    Registry& registry = getRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    for (const ThreadArenas* arenas : registry.threads) {
+        ++stats.threadCount;
+        stats.usedBytes += arenas->lastUsed.load(std::memory_order_relaxed);
+        stats.peakBytes += arenas->peak.load(std::memory_order_relaxed);
+        stats.capacityBytes += arenas->capacity.load(std::memory_order_relaxed);
+        stats.chunkCount += arenas->chunkCount.load(std::memory_order_relaxed);
+    }
+    return stats;
+}
+
+} // namespace plaster
@@ -0,0 +1,115 @@
+#include "Core/JobSystem.h"
+
+#include <algorithm>
+#include <memory>
+
+namespace plaster {
+
+JobSystem::JobSystem(uint32_t workerCount)
+    : m_stopping(false) {
+    if (workerCount == 0) {
+        // Leave one core for the main thread
+        uint32_t hardwareThreads = std::thread::hardware_concurrency();
+        workerCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+    }
+
+    m_workers.reserve(workerCount);
+    for (uint32_t i = 0; i < workerCount; ++i) {
+        m_workers.emplace_back(&JobSystem::workerLoop, this);
+    }
+}
+
+JobSystem::~JobSystem() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_condition.notify_all();
+
+    for (auto& worker : m_workers) {
+        worker.join();
+    }
+}
+
+void JobSystem::schedule(std::function<void()> job) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_jobs.push_back(std::move(job));
+    }
+    m_condition.notify_one();
+}
+
+void JobSystem::parallelFor(uint32_t count, uint32_t batchSize,
+                            const std::function<void(uint32_t begin, uint32_t end)>& fn) {
+    if (count == 0) {
+        return;
+    }
+    batchSize = std::max(1u, batchSize);
+    uint32_t batchCount = (count + batchSize - 1) / batchSize;
+
+    if (batchCount == 1) {
+        fn(0, count);
+        return;
+    }
+
+    struct Shared {
+        std::atomic<uint32_t> nextBatch{0};
+        std::atomic<uint32_t> finishedBatches{0};
+    };
+    auto shared = std::make_shared<Shared>();
+
+    auto runBatches = [shared, batchCount, batchSize, count, &fn]() {
+        uint32_t batch;
+        while ((batch = shared->nextBatch.fetch_add(1)) < batchCount) {
+            uint32_t begin = batch * batchSize;
+            fn(begin, std::min(begin + batchSize, count));
+            shared->finishedBatches.fetch_add(1, std::memory_order_release);
+        }
+    };
+
+    uint32_t helpers = std::min(getWorkerCount(), batchCount - 1);
+    for (uint32_t i = 0; i < helpers; ++i) {
+        schedule(runBatches);
+    }
+
+    runBatches();
+
+    // Help with unrelated jobs rather than spinning while stragglers finish
+    while (shared->finishedBatches.load(std::memory_order_acquire) < batchCount) {
+        if (!runPendingJob()) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+void JobSystem::workerLoop() {
+    for (;;) {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_condition.wait(lock, [this] { return m_stopping || !m_jobs.empty(); });
+            if (m_stopping && m_jobs.empty()) {
+                return;
+            }
+            job = std::move(m_jobs.front());
+            m_jobs.pop_front();
+        }
+        job();
+    }
+}
+
+bool JobSystem::runPendingJob() {
+    std::function<void()> job;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_jobs.empty()) {
+            return false;
+        }
+        job = std::move(m_jobs.front());
+        m_jobs.pop_front();
+    }
+    job();
+    return true;
+}
+
+} // namespace plaster
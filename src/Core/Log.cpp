@@ -0,0 +1,40 @@
+#include "Core/Log.h"
+
+#include <atomic>
+#include <iostream>
+#include <mutex>
+
+namespace plaster {
+
+namespace {
+
+std::mutex s_logMutex;
+std::atomic<LogLevel> s_minimumLevel{LogLevel::Info};
+
+const char* levelName(LogLevel level) {
+    switch (level) {
+    case LogLevel::Verbose: return "verbose";
+    case LogLevel::Info: return "info";
+    case LogLevel::Warning: return "warning";
+    case LogLevel::Error: return "error";
+    }
+    return "";
+}
+
+} // namespace
+
+void logMessage(LogLevel level, const char* channel, const std::string& message) {
+    if (level < s_minimumLevel.load(std::memory_order_relaxed)) {
+        return;
+    }
+
+    std::ostream& stream = level >= LogLevel::Warning ? std::cerr : std::cout;
+    std::lock_guard<std::mutex> lock(s_logMutex);
+    stream << '[' << channel << "] " << levelName(level) << ": " << message << std::endl;
+}
+
+void setLogLevel(LogLevel minimum) {
+    s_minimumLevel.store(minimum, std::memory_order_relaxed);
+}
+
+} // namespace plaster
@@ -0,0 +1,355 @@
+#include "Core/Metrics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace plaster {
+
+namespace {
+
+const uint32_t SUB_BUCKETS = 1u << Histogram::SUB_BUCKET_BITS;
+
+uint32_t highestBit(uint64_t value) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanReverse64(&index, value);
+    return static_cast<uint32_t>(index);
+#else
+    return 63 - static_cast<uint32_t>(__builtin_clzll(value));
+#endif
+}
+
+struct Entry {
+    std::string name;
+    std::string unit;
+    MetricType type;
+    std::unique_ptr<Counter> counter;
+    std::unique_ptr<Gauge> gauge;
+    std::unique_ptr<Histogram> histogram;
+
+    std::vector<float> history;
+    uint32_t historyCount = 0;
+    uint32_t historyOffset = 0;
+
+    // State as of the previous collect()
+    uint64_t previousTotal = 0;
+    std::vector<uint64_t> previousBuckets;
+    std::vector<uint64_t> buckets;
+
+    double value = 0.0;
+    double mean = 0.0;
+    double p50 = 0.0;
+    double p90 = 0.0;
+    double p99 = 0.0;
+    double max = 0.0;
+
+    void push(float sample) {
+        if (historyCount < Metrics::HISTORY_LENGTH) {
+            history[historyCount++] = sample;
+        } else {
+            history[historyOffset] = sample;
+            historyOffset = (historyOffset + 1) % Metrics::HISTORY_LENGTH;
+        }
+    }
+};
+
+struct Registry {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<Entry>> entries;
+    std::unordered_map<std::string, Entry*> byName;
+    uint64_t collectCount = 0;
+};
+
+Registry& getRegistry() {
+    static Registry registry;
+    return registry;
+}
+
+Entry& findOrAdd(const std::string& name, const std::string& unit, MetricType type) {
+    Registry& registry = getRegistry();
+    auto it = registry.byName.find(name);
+    if (it != registry.byName.end()) {
+        if (it->second->type != type) {
+            throw std::runtime_error("Metric registered twice with different types: " + name);
+        }
+        return *it->second;
+    }
+
+    auto entry = std::make_unique<Entry>();
+    entry->name = name;
+    entry->unit = unit;
+    entry->type = type;
+    entry->history.resize(Metrics::HISTORY_LENGTH);
+    switch (type) {
+    case MetricType::Counter:
+        entry->counter = std::make_unique<Counter>();
+        break;
+    case MetricType::Gauge:
+        entry->gauge = std::make_unique<Gauge>();
+        break;
+    case MetricType::Histogram:
+        entry->histogram = std::make_unique<Histogram>();
+        entry->previousBuckets.resize(Histogram::BUCKET_COUNT);
+        entry->buckets.resize(Histogram::BUCKET_COUNT);
+        break;
+    }
+    registry.byName[name] = entry.get();
+    registry.entries.push_back(std::move(entry));
+    return *registry.entries.back();
+}
+
+const char* typeName(MetricType type) {
+    switch (type) {
+    case MetricType::Counter:
+        return "counter";
+    case MetricType::Gauge:
+        return "gauge";
+    case MetricType::Histogram:
+        return "histogram";
+    }
+    return "";
+}
+
+// Metric names are code identifiers, but keep the output valid regardless
+std::string jsonString(const std::string& text) {
+    std::string quoted = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            quoted += '\\';
+        }
+        quoted += static_cast<unsigned char>(c) < 0x20 ? ' ' : c;
+    }
+    return quoted + "\"";
+}
+
+// JSON has no NaN or infinity
+double finite(double value) {
+    return std::isfinite(value) ? value : 0.0;
+}
+
+std::ofstream openForWriting(const std::string& path) {
+    std::ofstream file(path, std::ios::trunc);
+    if (!file) {
+        throw std::runtime_error("Failed to open metrics file for writing: " + path);
+    }
+    return file;
+}
+
+} // namespace
+
+Histogram::Histogram()
+    : m_count(0), m_sum(0), m_max(0) {
+    for (std::atomic<uint64_t>& bucket : m_buckets) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+}
+
+void Histogram::record(uint64_t value) {
+    m_buckets[bucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+    m_count.fetch_add(1, std::memory_order_relaxed);
+    m_sum.fetch_add(value, std::memory_order_relaxed);
+
+    uint64_t max = m_max.load(std::memory_order_relaxed);
+    while (value > max && !m_max.compare_exchange_weak(max, value, std::memory_order_relaxed)) {
+    }
+}
+
+void Histogram::copyBuckets(uint64_t* counts) const {
+    for (uint32_t i = 0; i < BUCKET_COUNT; ++i) {
+        counts[i] = m_buckets[i].load(std::memory_order_relaxed);
+    }
+}
+
+uint32_t Histogram::bucketIndex(uint64_t value) {
+    if (value < SUB_BUCKETS) {
+        return static_cast<uint32_t>(value);
+    }
+    uint32_t bit = std::min(highestBit(value), MAX_VALUE_BITS - 1);
+    uint32_t shift = bit - SUB_BUCKET_BITS;
+    uint32_t subBucket = std::min(static_cast<uint32_t>(value >> shift), 2 * SUB_BUCKETS - 1) - SUB_BUCKETS;
+    return (shift + 1) * SUB_BUCKETS + subBucket;
+}
+
+uint64_t Histogram::bucketValue(uint32_t index) {
+    if (index < SUB_BUCKETS) {
+        return index;
+    }
+    uint32_t shift = index / SUB_BUCKETS - 1;
+    uint64_t lowest = static_cast<uint64_t>(SUB_BUCKETS + index % SUB_BUCKETS) << shift;
+    return lowest + (uint64_t(1) << shift) - 1;
+}
+
+uint64_t Histogram::percentile(const uint64_t* counts, double fraction) {
+    uint64_t total = 0;
+    for (uint32_t i = 0; i < BUCKET_COUNT; ++i) {
+        total += counts[i];
+    }
+    if (total == 0) {
+        return 0;
+    }
+
+    uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(fraction * total)));
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < BUCKET_COUNT; ++i) {
+        seen += counts[i];
+        if (seen >= rank) {
+            return bucketValue(i);
+        }
+    }
+    return bucketValue(BUCKET_COUNT - 1);
+}
+
+Counter& Metrics::counter(const std::string& name, const std::string& unit) {
+    std::lock_guard<std::mutex> lock(getRegistry().mutex);
+    return *findOrAdd(name, unit, MetricType::Counter).counter;
+}
+
+Gauge& Metrics::gauge(const std::string& name, const std::string& unit) {
+    std::lock_guard<std::mutex> lock(getRegistry().mutex);
+    return *findOrAdd(name, unit, MetricType::Gauge).gauge;
+}
+
+Histogram& Metrics::histogram(const std::string& name, const std::string& unit) {
+    std::lock_guard<std::mutex> lock(getRegistry().mutex);
+    return *findOrAdd(name, unit, MetricType::Histogram).histogram;
+}
+
+void Metrics::collect() {
+    Registry& registry = getRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    ++registry.collectCount;
+
+    for (const std::unique_ptr<Entry>& entry : registry.entries) {
+        switch (entry->type) {
+        case MetricType::Counter: {
+            uint64_t total = entry->counter->get();
+            entry->push(static_cast<float>(total - entry->previousTotal));
+            entry->previousTotal = total;
+            entry->value = static_cast<double>(total);
+            break;
+        }
+        case MetricType::Gauge:
+            entry->value = entry->gauge->get();
+            entry->push(static_cast<float>(entry->value));
+            break;
+        case MetricType::Histogram: {
+            const Histogram& histogram = *entry->histogram;
+            uint64_t count = histogram.getCount();
+            if (count == entry->previousTotal) {
+                entry->push(0.0f);
+                break;
+            }
+
+            // The difference from the previous copy is this frame's samples
+            histogram.copyBuckets(entry->buckets.data());
+            for (uint32_t i = 0; i < Histogram::BUCKET_COUNT; ++i) {
+                std::swap(entry->previousBuckets[i], entry->buckets[i]);
+                entry->buckets[i] = entry->previousBuckets[i] - entry->buckets[i];
+            }
+            entry->push(static_cast<float>(Histogram::percentile(entry->buckets.data(), 0.99)));
+
+            const uint64_t* buckets = entry->previousBuckets.data();
+            entry->value = static_cast<double>(count);
+            entry->mean = static_cast<double>(histogram.getSum()) / count;
+            // Bucket bounds can overshoot the largest sample
+            entry->max = static_cast<double>(histogram.getMax());
+            entry->p50 = std::min(static_cast<double>(Histogram::percentile(buckets, 0.50)), entry->max);
+            entry->p90 = std::min(static_cast<double>(Histogram::percentile(buckets, 0.90)), entry->max);
+            entry->p99 = std::min(static_cast<double>(Histogram::percentile(buckets, 0.99)), entry->max);
+            entry->previousTotal = count;
+            break;
+        }
+        }
+    }
+}
+
+uint64_t Metrics::getCollectCount() {
+    Registry& registry = getRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    return registry.collectCount;
+}
+
+void Metrics::forEach(const std::function<void(const MetricSnapshot&)>& fn) {
+    Registry& registry = getRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    for (const std::unique_ptr<Entry>& entry : registry.entries) {
+        MetricSnapshot snapshot;
+        snapshot.name = &entry->name;
+        snapshot.unit = &entry->unit;
+        snapshot.type = entry->type;
+        snapshot.value = entry->value;
+        snapshot.mean = entry->mean;
+        snapshot.p50 = entry->p50;
+        snapshot.p90 = entry->p90;
+        snapshot.p99 = entry->p99;
+        snapshot.max = entry->max;
+        snapshot.history = entry->history.data();
+        snapshot.historyCount = entry->historyCount;
+        snapshot.historyOffset = entry->historyOffset;
+        fn(snapshot);
+    }
+}
+
+void Metrics::writeCsv(const std::string& path) {
+    std::ofstream file = openForWriting(path);
+    file << "name,type,unit,value,mean,p50,p90,p99,max\n";
+    forEach([&file](const MetricSnapshot& metric) {
+        file << *metric.name << ',' << typeName(metric.type) << ',' << *metric.unit << ',' << metric.value;
+        if (metric.type == MetricType::Histogram) {
+            file << ',' << metric.mean << ',' << metric.p50 << ',' << metric.p90 << ',' << metric.p99 << ','
+                 << metric.max;
+        } else {
+            file << ",,,,,";
+        }
+        file << '\n';
+    });
+    if (!file) {
+        throw std::runtime_error("Failed to write metrics: " + path);
+    }
+}
+
+void Metrics::writeJson(const std::string& path) {
+    std::ofstream file = openForWriting(path);
+    file << "{\n  \"frames\": " << getCollectCount() << ",\n  \"metrics\": [";
+    bool first = true;
+    forEach([&file, &first](const MetricSnapshot& metric) {
+        file << (first ? "\n" : ",\n") << "    {\"name\": " << jsonString(*metric.name)
+             << ", \"type\": \"" << typeName(metric.type) << "\", \"unit\": " << jsonString(*metric.unit)
+             << ", \"value\": " << finite(metric.value);
+        if (metric.type == MetricType::Histogram) {
+            file << ", \"mean\": " << finite(metric.mean) << ", \"p50\": " << metric.p50 << ", \"p90\": "
+                 << metric.p90 << ", \"p99\": " << metric.p99 << ", \"max\": " << metric.max;
+        }
+        file << ", \"history\": [";
+        for (uint32_t i = 0; i < metric.historyCount; ++i) {
+            file << (i ? ", " : "")
+                 << finite(metric.history[(metric.historyOffset + i) % Metrics::HISTORY_LENGTH]);
+        }
+        file << "]}";
+        first = false;
+    });
+    file << "\n  ]\n}\n";
+    if (!file) {
+        throw std::runtime_error("Failed to write metrics: " + path);
+    }
+}
+
+void Metrics::write(const std::string& path) {
+    if (path.size() >= 4 && path.compare(path.size() - 4, 4, ".csv") == 0) {
+        writeCsv(path);
+    } else {
+        writeJson(path);
+    }
+}
+
+} // namespace plaster
@@ -31,6 +31,14 @@ Window::Window(uint32_t width, uint32_t height, const std::string& title)
         throw std::runtime_error("Failed to create GLFW window");
     }
     
+    glfwSetWindowUserPointer(m_window, this);
+    glfwSetFramebufferSizeCallback(m_window, FramebufferSizeCallback);
+
+    int framebufferWidth, framebufferHeight;
+    glfwGetFramebufferSize(m_window, &framebufferWidth, &framebufferHeight);
+    m_width = static_cast<uint32_t>(framebufferWidth);
+    m_height = static_cast<uint32_t>(framebufferHeight);
+
     Input::Init(m_window);
 }
 
@@ -53,6 +61,17 @@ void Window::waitEvents() {
     glfwWaitEvents();
 }
 
+void Window::setSize(uint32_t width, uint32_t height) {
+    glfwSetWindowSize(m_window, static_cast<int>(width), static_cast<int>(height));
+}
+
+void Window::FramebufferSizeCallback(GLFWwindow* window, int width, int height) {
+    Window* self = static_cast<Window*>(glfwGetWindowUserPointer(window));
+    self->m_width = static_cast<uint32_t>(width);
+    self->m_height = static_cast<uint32_t>(height);
+    self->m_resized = true;
+}
+
 void Window::toggleFullscreen() {
     m_isFullscreen = !m_isFullscreen;
     
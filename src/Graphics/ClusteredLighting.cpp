@@ -0,0 +1,340 @@
+#include "Graphics/ClusteredLighting.h"
+#include "Graphics/VulkanContext.h"
+#include "Graphics/DeletionQueue.h"
+#include "Graphics/DescriptorAllocator.h"
+#include "Graphics/UniformRing.h"
+#include "Graphics/ShadowCascades.h"
+#include "Graphics/VulkanDebug.h"
+#include "Scene/Bounds.h"
+#include "Core/Metrics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace plaster {
+
+namespace {
+
+const uint32_t GROUP_SIZE = 64;   // clusters per workgroup, see shaders/light_cluster.comp
+
+// Mirrors Light in shaders/lighting.glsl (std430)
+struct GpuLight {
+    glm::vec4 positionRange;   // world space
+    glm::vec4 color;           // times intensity; w: 1 for spot lights
+    glm::vec4 direction;       // normalized; w: cosine of the outer angle
+    glm::vec4 spot;            // x: 1 / (cosine of the inner angle - that of the outer one)
+};
+
+// Mirrors LightConstants in shaders/lighting.glsl (std140)
+struct LightConstants {
+    glm::mat4 inverseProjection;
+    glm::vec4 sunDirection;
+    glm::vec4 sunColor;
+    glm::vec4 ambientColor;
+    glm::vec4 depthSlicing;
+    uint32_t lightCount;
+    uint32_t maxClusterLights;
+    uint32_t maxIndices;
+    float heatmapScale;
+    glm::mat4 shadowMatrices[SHADOW_CASCADE_COUNT];
+    glm::vec4 shadowSplits;
+    glm::vec4 shadowTexelSizes;
+    glm::vec4 shadowDepthBias;
+    glm::vec4 shadowParams;
+};
+
+// Mirrors ClusterState in shaders/light_cluster.comp (std430)
+struct ClusterState {
+    uint32_t indexCount;
+    uint32_t occupiedClusters;
+    uint32_t maxClusterLights;
+    uint32_t overflowedClusters;
+};
+
+void bufferBarrier(VkCommandBuffer commandBuffer, VkPipelineStageFlags srcStage, VkAccessFlags srcAccess,
+                   VkPipelineStageFlags dstStage, VkAccessFlags dstAccess) {
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = srcAccess;
+    barrier.dstAccessMask = dstAccess;
+    vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+// Smallest sphere around a light's lit volume: the whole range for point
+// lights, for spot lights the cone capped at the range
+glm::vec4 boundingSphere(const Light& light, const glm::vec3& direction, float cosOuter) {
+    if (light.type == LightType::Point) {
+        return glm::vec4(light.position, light.range);
+    }
+    float sinOuter = std::sqrt(std::max(0.0f, 1.0f - cosOuter * cosOuter));
+    if (cosOuter < 0.70710678f) {
+        // Wider than 90 degrees: the cap's rim circle dominates
+        return glm::vec4(light.position + direction * (light.range * cosOuter), light.range * sinOuter);
+    }
+    // Narrow: the sphere through the apex and the rim
+    float radius = light.range / (2.0f * cosOuter);
+    return glm::vec4(light.position + direction * radius, radius);
+}
+
+} // namespace
+
+ClusteredLighting::ClusteredLighting(VulkanContext* vulkanContext, PipelineManager* pipelineManager,
+                                     DeletionQueue* deletionQueue, UniformRing* uniformRing,
+                                     const ShadowCascades* shadows, uint32_t framesInFlight, uint32_t lightCapacity,
+                                     uint32_t indexCapacity)
+    : m_vulkanContext(vulkanContext), m_pipelineManager(pipelineManager), m_deletionQueue(deletionQueue),
+      m_uniformRing(uniformRing), m_shadows(shadows), m_lightCapacity(lightCapacity), m_indexCapacity(indexCapacity), m_bin(false),
+      m_constantsOffset(0), m_lightsOffset(0), m_boundsOffset(0), m_visibleCount(0),
+      m_shadingLayout(VK_NULL_HANDLE), m_shadingSet(VK_NULL_HANDLE) {
+    ComputePipelineDesc bin;
+    bin.compute.path = "light_cluster.comp";
+    bin.compute.stage = ShaderStage::Compute;
+    m_binPipeline = m_pipelineManager->requestCompute(bin);
+
+    // Laid out as reflection lays out SHADING_SET of mesh.frag, so the set is
+    // compatible with every pipeline shading with it
+    std::vector<VkDescriptorSetLayoutBinding> bindings(5);
+    for (uint32_t i = 0; i < 5; ++i) {
+        bindings[i].binding = i;
+        bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    }
+    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    bindings[0].stageFlags = VK_SHADER_STAGE_ALL;
+    bindings[4].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    m_shadingLayout = m_pipelineManager->getSetLayout(bindings);
+
+    m_state = createStorageBuffer(sizeof(ClusterState),
+                                  VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                  "Light cluster state");
+    m_clusters = createStorageBuffer(sizeof(uint32_t) * 2 * LIGHT_CLUSTER_COUNT, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                     "Light clusters");
+    m_indices = createStorageBuffer(sizeof(uint32_t) * static_cast<VkDeviceSize>(m_indexCapacity), 0,
+                                    "Light cluster indices");
+
+    VkDevice device = m_vulkanContext->getDevice();
+    m_readbacks.resize(framesInFlight);
+    for (Readback& readback : m_readbacks) {
+        m_vulkanContext->createBuffer(sizeof(ClusterState), VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                      readback.buffer, readback.memory);
+        void* mapped = nullptr;
+        PLASTER_VK_CHECK(vkMapMemory(device, readback.memory, 0, sizeof(ClusterState), 0, &mapped));
+        readback.mapped = mapped;
+    }
+}
+
+ClusteredLighting::~ClusteredLighting() {
+    m_deletionQueue->release(m_state.buffer, m_state.memory);
+    m_deletionQueue->release(m_clusters.buffer, m_clusters.memory);
+    m_deletionQueue->release(m_indices.buffer, m_indices.memory);
+    for (Readback& readback : m_readbacks) {
+        // Freeing the memory unmaps it
+        m_deletionQueue->release(readback.buffer, readback.memory);
+    }
+}
+
+ClusteredLighting::StorageBuffer ClusteredLighting::createStorageBuffer(VkDeviceSize size, VkBufferUsageFlags usage,
+                                                                        const char* name) {
+    StorageBuffer result;
+    result.size = size;
+    m_vulkanContext->createBuffer(size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | usage,
+                                  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, result.buffer, result.memory);
+    PLASTER_VK_NAME(m_vulkanContext->getDevice(), VK_OBJECT_TYPE_BUFFER, result.buffer, name);
+    (void)name;   // only debug builds name objects
+    return result;
+}
+
+uint32_t ClusteredLighting::addLight(const Light& light) {
+    if (!m_freeLights.empty()) {
+        uint32_t id = m_freeLights.back();
+        m_freeLights.pop_back();
+        m_lights[id] = light;
+        m_lightActive[id] = true;
+        return id;
+    }
+    m_lights.push_back(light);
+    m_lightActive.push_back(true);
+    return static_cast<uint32_t>(m_lights.size() - 1);
+}
+
+void ClusteredLighting::setLight(uint32_t light, const Light& value) {
+    m_lights[light] = value;
+}
+
+void ClusteredLighting::removeLight(uint32_t light) {
+    if (m_lightActive[light]) {
+        m_lightActive[light] = false;
+        m_freeLights.push_back(light);
+    }
+}
+
+void ClusteredLighting::update(uint32_t frameIndex, const glm::mat4& view, const glm::mat4& projection) {
+    // The fence of this frame index has been waited on, so its copy has landed
+    Readback& readback = m_readbacks[frameIndex];
+    if (readback.written) {
+        ClusterState state;
+        std::memcpy(&state, readback.mapped, sizeof(state));
+        m_stats.lightIndices = std::min(state.indexCount, m_indexCapacity);
+        m_stats.occupiedClusters = state.occupiedClusters;
+        m_stats.maxClusterLights = state.maxClusterLights;
+        m_stats.overflowedClusters = state.overflowedClusters;
+        readback.written = false;
+
+        static Gauge& lightIndices = Metrics::gauge("lighting.cluster_light_indices");
+        static Gauge& overflowedClusters = Metrics::gauge("lighting.overflowed_clusters");
+        lightIndices.set(static_cast<double>(m_stats.lightIndices));
+        overflowedClusters.set(static_cast<double>(m_stats.overflowedClusters));
+    }
+
+    float nearDepth = std::max(m_settings.nearDepth, 1e-3f);
+    float farDepth = std::max(m_settings.farDepth, nearDepth * 1.01f);
+
+    // Frustum culled and packed straight into the ring: shading data in world
+    // space, bounding spheres in view space for binning. Room is reserved for
+    // every active light, and never none, so the descriptors always have a range.
+    uint32_t activeCount = static_cast<uint32_t>(m_lights.size() - m_freeLights.size());
+    uint32_t reserved = std::max(std::min(activeCount, m_lightCapacity), 1u);
+    UniformAllocation lightAllocation = m_uniformRing->allocate(sizeof(GpuLight) * reserved);
+    UniformAllocation boundsAllocation = m_uniformRing->allocate(sizeof(glm::vec4) * reserved);
+    GpuLight* lights = static_cast<GpuLight*>(lightAllocation.data);
+    glm::vec4* bounds = static_cast<glm::vec4*>(boundsAllocation.data);
+    m_lightsOffset = lightAllocation.offset;
+    m_boundsOffset = boundsAllocation.offset;
+
+    Frustum frustum = Frustum::fromViewProjection(projection * view);
+    m_visibleCount = 0;
+    for (size_t i = 0; i < m_lights.size() && m_visibleCount < reserved; ++i) {
+        const Light& light = m_lights[i];
+        if (!m_lightActive[i] || light.range <= 0.0f) {
+            continue;
+        }
+
+        glm::vec3 direction = glm::length(light.direction) > 0.0f ? glm::normalize(light.direction)
+                                                                  : glm::vec3(0.0f, -1.0f, 0.0f);
+        float outerAngle = std::clamp(light.outerAngle, 1e-3f, 3.1415926f);
+        float innerAngle = std::clamp(light.innerAngle, 0.0f, outerAngle);
+        float cosOuter = std::cos(outerAngle);
+        float cosInner = std::cos(innerAngle);
+
+        glm::vec4 sphere = boundingSphere(light, direction, cosOuter);
+        if (!frustum.intersectsSphere(glm::vec3(sphere), sphere.w)) {
+            continue;
+        }
+        glm::vec3 viewCenter = glm::vec3(view * glm::vec4(glm::vec3(sphere), 1.0f));
+        if (-viewCenter.z - sphere.w >= farDepth) {
+            continue;
+        }
+
+        GpuLight packed;
+        packed.positionRange = glm::vec4(light.position, light.range);
+        packed.color = glm::vec4(light.color * light.intensity, light.type == LightType::Spot ? 1.0f : 0.0f);
+        packed.direction = glm::vec4(direction, cosOuter);
+        packed.spot = glm::vec4(1.0f / std::max(cosInner - cosOuter, 1e-4f), 0.0f, 0.0f, 0.0f);
+        lights[m_visibleCount] = packed;
+        bounds[m_visibleCount] = glm::vec4(viewCenter, sphere.w);
+        ++m_visibleCount;
+    }
+    m_stats.lightCount = activeCount;
+    m_stats.visibleLights = m_visibleCount;
+
+    LightConstants constants{};
+    constants.inverseProjection = glm::inverse(projection);
+    glm::vec3 sunDirection = glm::length(m_settings.sunDirection) > 0.0f ? glm::normalize(m_settings.sunDirection)
+                                                                         : glm::vec3(0.0f, 1.0f, 0.0f);
+    constants.sunDirection = glm::vec4(sunDirection, 0.0f);
+    constants.sunColor = glm::vec4(m_settings.sunColor, 0.0f);
+    constants.ambientColor = glm::vec4(m_settings.ambientColor, 0.0f);
+    // slice = log(depth) * scale - bias, so slice 0 starts at nearDepth and the last ends at farDepth
+    float sliceScale = LIGHT_CLUSTERS_Z / std::log(farDepth / nearDepth);
+    constants.depthSlicing = glm::vec4(nearDepth, farDepth, sliceScale, std::log(nearDepth) * sliceScale);
+    constants.lightCount = m_visibleCount;
+    constants.maxClusterLights = std::max(m_settings.maxClusterLights, 1u);
+    constants.maxIndices = m_indexCapacity;
+    constants.heatmapScale = m_settings.heatmap ? std::max(m_settings.heatmapScale, 1.0f) : 0.0f;
+
+    // Off until every cascade has been drawn once
+    const ShadowSettings& shadowSettings = m_shadows->getSettings();
+    for (uint32_t i = 0; i < SHADOW_CASCADE_COUNT; ++i) {
+        const ShadowCascade& cascade = m_shadows->getCascade(i);
+        constants.shadowMatrices[i] = cascade.atlasMatrix;
+        constants.shadowSplits[i] = cascade.splitDepth;
+        constants.shadowTexelSizes[i] = cascade.texelSize;
+        constants.shadowDepthBias[i] = shadowSettings.depthBias / cascade.depthRange;
+    }
+    float atlasTexel = 1.0f / static_cast<float>(m_shadows->getAtlasSize());
+    constants.shadowParams = glm::vec4(m_shadows->isReady() ? 1.0f : 0.0f, shadowSettings.normalOffset, atlasTexel,
+                                       0.5f);
+    m_constantsOffset = m_uniformRing->push(constants);
+
+    m_bin = m_visibleCount > 0 && m_pipelineManager->isReady(m_binPipeline);
+    readback.written = m_bin;
+    if (!m_bin) {
+        m_stats.lightIndices = 0;
+        m_stats.occupiedClusters = 0;
+        m_stats.maxClusterLights = 0;
+        m_stats.overflowedClusters = 0;
+    }
+}
+
+void ClusteredLighting::record(VkCommandBuffer commandBuffer, uint32_t frameIndex,
+                               DescriptorAllocator* descriptorAllocator) {
+    PLASTER_VK_LABEL(commandBuffer, "Light binning");
+    VkBuffer ring = m_uniformRing->getBuffer();
+    VkDeviceSize lightBytes = sizeof(GpuLight) * std::max(m_visibleCount, 1u);
+
+    // The previous frame's shading and readback copy still read what this rewrites
+    bufferBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                  VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0);
+
+    if (m_bin) {
+        ClusterState reset{};
+        vkCmdUpdateBuffer(commandBuffer, m_state.buffer, 0, sizeof(reset), &reset);
+        bufferBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+                      VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+        VkDescriptorSet set = descriptorAllocator->allocate(
+            m_pipelineManager->getSetLayout(m_binPipeline, 0),
+            {DescriptorBinding::buffer(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, ring, 0, sizeof(LightConstants)),
+             DescriptorBinding::buffer(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, ring, m_boundsOffset,
+                                       sizeof(glm::vec4) * m_visibleCount),
+             DescriptorBinding::buffer(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, m_state.buffer, 0, m_state.size),
+             DescriptorBinding::buffer(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, m_clusters.buffer, 0, m_clusters.size),
+             DescriptorBinding::buffer(4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, m_indices.buffer, 0, m_indices.size)});
+
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                          m_pipelineManager->getPipeline(m_binPipeline));
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                                m_pipelineManager->getLayout(m_binPipeline), 0, 1, &set, 1, &m_constantsOffset);
+        vkCmdDispatch(commandBuffer, (LIGHT_CLUSTER_COUNT + GROUP_SIZE - 1) / GROUP_SIZE, 1, 1);
+
+        bufferBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+                      VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+                      VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT);
+
+        // Counters for getStats(), read once this frame's fence comes around again
+        VkBufferCopy copy{};
+        copy.size = sizeof(ClusterState);
+        vkCmdCopyBuffer(commandBuffer, m_state.buffer, m_readbacks[frameIndex].buffer, 1, &copy);
+        bufferBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+                      VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_READ_BIT);
+    } else {
+        // Nothing to bin, or the pass is still compiling: every cluster is empty
+        vkCmdFillBuffer(commandBuffer, m_clusters.buffer, 0, VK_WHOLE_SIZE, 0);
+        bufferBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+                      VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+    }
+
+    m_shadingSet = descriptorAllocator->allocate(
+        m_shadingLayout,
+        {DescriptorBinding::buffer(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, ring, 0, sizeof(LightConstants)),
+         DescriptorBinding::buffer(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, ring, m_lightsOffset, lightBytes),
+         DescriptorBinding::buffer(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, m_clusters.buffer, 0, m_clusters.size),
+         DescriptorBinding::buffer(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, m_indices.buffer, 0, m_indices.size),
+         DescriptorBinding::image(4, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, m_shadows->getAtlasView(),
+                                  m_shadows->getSampler(), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)});
+}
+
+} // namespace plaster
@@ -0,0 +1,123 @@
+#include "Graphics/DeletionQueue.h"
+#include "Graphics/VulkanContext.h"
+#include "Graphics/VulkanDebug.h"
+
+namespace plaster {
+
+DeletionQueue::DeletionQueue(VulkanContext* vulkanContext) : m_vulkanContext(vulkanContext), m_frameNumber(0) {
+}
+
+DeletionQueue::~DeletionQueue() {
+    flush();
+}
+
+void DeletionQueue::beginFrame(uint64_t frameNumber) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_frameNumber = frameNumber;
+}
+
+void DeletionQueue::collect(uint64_t completedFrame) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    while (!m_entries.empty() && m_entries.front().frameNumber <= completedFrame) {
+        destroy(m_entries.front());
+        m_entries.pop_front();
+    }
+}
+
+void DeletionQueue::flush() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (const Entry& entry : m_entries) {
+        destroy(entry);
+    }
+    m_entries.clear();
+}
+
+size_t DeletionQueue::getPendingCount() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_entries.size();
+}
+
+void DeletionQueue::release(VkBuffer buffer) {
+    push(VK_OBJECT_TYPE_BUFFER, vkdebug::handleBits(buffer));
+}
+
+void DeletionQueue::release(VkImage image) {
+    push(VK_OBJECT_TYPE_IMAGE, vkdebug::handleBits(image));
+}
+
+void DeletionQueue::release(VkImageView view) {
+    push(VK_OBJECT_TYPE_IMAGE_VIEW, vkdebug::handleBits(view));
+}
+
+void DeletionQueue::release(VkDeviceMemory memory) {
+    push(VK_OBJECT_TYPE_DEVICE_MEMORY, vkdebug::handleBits(memory));
+}
+
+void DeletionQueue::release(VkPipeline pipeline) {
+    push(VK_OBJECT_TYPE_PIPELINE, vkdebug::handleBits(pipeline));
+}
+
+void DeletionQueue::release(VkShaderModule module) {
+    push(VK_OBJECT_TYPE_SHADER_MODULE, vkdebug::handleBits(module));
+}
+
+void DeletionQueue::release(VkFramebuffer framebuffer) {
+    push(VK_OBJECT_TYPE_FRAMEBUFFER, vkdebug::handleBits(framebuffer));
+}
+
+void DeletionQueue::release(VkSampler sampler) {
+    push(VK_OBJECT_TYPE_SAMPLER, vkdebug::handleBits(sampler));
+}
+
+void DeletionQueue::release(VkImage image, VkDeviceMemory memory, VkImageView view) {
+    release(view);
+    release(image);
+    release(memory);
+}
+
+void DeletionQueue::release(VkBuffer buffer, VkDeviceMemory memory) {
+    release(buffer);
+    release(memory);
+}
+
+void DeletionQueue::push(VkObjectType type, uint64_t handle) {
+    if (handle == 0) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_entries.push_back({type, handle, m_frameNumber});
+}
+
+void DeletionQueue::destroy(const Entry& entry) {
+    VkDevice device = m_vulkanContext->getDevice();
+    switch (entry.type) {
+        case VK_OBJECT_TYPE_BUFFER:
+            vkDestroyBuffer(device, vkdebug::fromBits<VkBuffer>(entry.handle), nullptr);
+            break;
+        case VK_OBJECT_TYPE_IMAGE:
+            vkDestroyImage(device, vkdebug::fromBits<VkImage>(entry.handle), nullptr);
+            break;
+        case VK_OBJECT_TYPE_IMAGE_VIEW:
+            vkDestroyImageView(device, vkdebug::fromBits<VkImageView>(entry.handle), nullptr);
+            break;
+        case VK_OBJECT_TYPE_DEVICE_MEMORY:
+            vkFreeMemory(device, vkdebug::fromBits<VkDeviceMemory>(entry.handle), nullptr);
+            break;
+        case VK_OBJECT_TYPE_PIPELINE:
+            vkDestroyPipeline(device, vkdebug::fromBits<VkPipeline>(entry.handle), nullptr);
+            break;
+        case VK_OBJECT_TYPE_SHADER_MODULE:
+            vkDestroyShaderModule(device, vkdebug::fromBits<VkShaderModule>(entry.handle), nullptr);
+            break;
+        case VK_OBJECT_TYPE_FRAMEBUFFER:
+            vkDestroyFramebuffer(device, vkdebug::fromBits<VkFramebuffer>(entry.handle), nullptr);
+            break;
+        case VK_OBJECT_TYPE_SAMPLER:
+            vkDestroySampler(device, vkdebug::fromBits<VkSampler>(entry.handle), nullptr);
+            break;
+        default:
+            break;
+    }
+}
+
+} // namespace plaster
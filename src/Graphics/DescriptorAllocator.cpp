@@ -0,0 +1,255 @@
+#include "Graphics/DescriptorAllocator.h"
+#include "Graphics/VulkanContext.h"
+#include "Core/Hash.h"
+#include "Core/FrameArena.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace plaster {
+
+namespace {
+
+struct PoolSizeRatio {
+    VkDescriptorType type;
+    float ratio;
+};
+
+// Sizes per set; pools are sized as maxSets * ratio for each type
+const PoolSizeRatio POOL_RATIOS[] = {
+    {VK_DESCRIPTOR_TYPE_SAMPLER, 0.5f},
+    {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4.0f},
+    {VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 4.0f},
+    {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1.0f},
+    {VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER, 0.5f},
+    {VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER, 0.5f},
+    {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2.0f},
+    {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2.0f},
+    {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1.0f},
+    {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1.0f},
+    {VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 0.5f}
+};
+
+bool isImageDescriptor(VkDescriptorType type) {
+    return type == VK_DESCRIPTOR_TYPE_SAMPLER ||
+           type == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER ||
+           type == VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE ||
+           type == VK_DESCRIPTOR_TYPE_STORAGE_IMAGE ||
+           type == VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+}
+
+} // namespace
+
+DescriptorBinding DescriptorBinding::buffer(uint32_t binding, VkDescriptorType type, VkBuffer buffer,
+                                            VkDeviceSize offset, VkDeviceSize range) {
+    DescriptorBinding result;
+    result.binding = binding;
+    result.type = type;
+    result.bufferInfo.buffer = buffer;
+    result.bufferInfo.offset = offset;
+    result.bufferInfo.range = range;
+    return result;
+}
+
+DescriptorBinding DescriptorBinding::image(uint32_t binding, VkDescriptorType type, VkImageView view,
+                                           VkSampler sampler, VkImageLayout layout) {
+    DescriptorBinding result;
+    result.binding = binding;
+    result.type = type;
+    result.imageInfo.imageView = view;
+    result.imageInfo.sampler = sampler;
+    result.imageInfo.imageLayout = layout;
+    return result;
+}
+
+DescriptorAllocator::DescriptorAllocator(VulkanContext* vulkanContext, uint32_t framesInFlight)
+    : m_vulkanContext(vulkanContext), m_frameChains(framesInFlight),
+      m_currentFrame(0), m_frameSetCount(0) {
+    for (auto& chain : m_frameChains) {
+        chain.setsPerPool = INITIAL_SETS_PER_POOL;
+    }
+    m_immutableChain.setsPerPool = INITIAL_SETS_PER_POOL;
+}
+
+DescriptorAllocator::~DescriptorAllocator() {
+    for (auto& chain : m_frameChains) {
+        destroyChain(chain);
+    }
+    destroyChain(m_immutableChain);
+}
+
+void DescriptorAllocator::beginFrame(uint32_t frameIndex) {
+    m_currentFrame = frameIndex;
+    m_frameSetCount = 0;
+    resetChain(m_frameChains[frameIndex]);
+}
+
+VkDescriptorSet DescriptorAllocator::allocate(VkDescriptorSetLayout layout) {
+    ++m_frameSetCount;
+    return allocateFromChain(m_frameChains[m_currentFrame], layout);
+}
+
+VkDescriptorSet DescriptorAllocator::allocate(VkDescriptorSetLayout layout, const DescriptorBinding* bindings,
+                                              uint32_t count) {
+    VkDescriptorSet set = allocate(layout);
+    writeSet(set, bindings, count);
+    return set;
+}
+
+VkDescriptorSet DescriptorAllocator::getImmutable(VkDescriptorSetLayout layout,
+                                                  const std::vector<DescriptorBinding>& bindings) {
+    uint64_t key = hashBindings(layout, bindings);
+
+    auto it = m_immutableSets.find(key);
+    if (it != m_immutableSets.end()) {
+        return it->second;
+    }
+
+    VkDescriptorSet set = allocateFromChain(m_immutableChain, layout);
+    writeSet(set, bindings.data(), static_cast<uint32_t>(bindings.size()));
+    m_immutableSets.emplace(key, set);
+    return set;
+}
+
+void DescriptorAllocator::clearImmutableCache() {
+    m_immutableSets.clear();
+    resetChain(m_immutableChain);
+}
+
+uint32_t DescriptorAllocator::getPoolCount() const {
+    size_t count = m_immutableChain.usedPools.size() + m_immutableChain.freePools.size();
+    for (const auto& chain : m_frameChains) {
+        count += chain.usedPools.size() + chain.freePools.size();
+    }
+    return static_cast<uint32_t>(count);
+}
+
+VkDescriptorSet DescriptorAllocator::allocateFromChain(PoolChain& chain, VkDescriptorSetLayout layout) {
+    VkDevice device = m_vulkanContext->getDevice();
+
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &layout;
+
+    // First try the current pool, then grab a fresh one if it is exhausted
+    for (int attempt = 0; attempt < 2; ++attempt) {
+        if (chain.current == VK_NULL_HANDLE) {
+            if (!chain.freePools.empty()) {
+                chain.current = chain.freePools.back();
+                chain.freePools.pop_back();
+            } else {
+                chain.current = createPool(chain.setsPerPool);
+                chain.setsPerPool = std::min(chain.setsPerPool * 2, MAX_SETS_PER_POOL);
+            }
+            chain.usedPools.push_back(chain.current);
+        }
+
+        allocInfo.descriptorPool = chain.current;
+
+        VkDescriptorSet set = VK_NULL_HANDLE;
+        VkResult result = vkAllocateDescriptorSets(device, &allocInfo, &set);
+        if (result == VK_SUCCESS) {
+            return set;
+        }
+        if (result != VK_ERROR_OUT_OF_POOL_MEMORY && result != VK_ERROR_FRAGMENTED_POOL) {
+            break;
+        }
+        chain.current = VK_NULL_HANDLE;
+    }
+
+    throw std::runtime_error("Failed to allocate descriptor set");
+}
+
+VkDescriptorPool DescriptorAllocator::createPool(uint32_t maxSets) {
+    std::vector<VkDescriptorPoolSize> poolSizes;
+    poolSizes.reserve(std::size(POOL_RATIOS));
+    for (const auto& ratio : POOL_RATIOS) {
+        uint32_t count = std::max(1u, static_cast<uint32_t>(ratio.ratio * maxSets));
+        poolSizes.push_back({ratio.type, count});
+    }
+
+    // No FREE_DESCRIPTOR_SET_BIT: sets are only ever released by resetting the whole pool
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.flags = 0;
+    poolInfo.maxSets = maxSets;
+    poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+    poolInfo.pPoolSizes = poolSizes.data();
+
+    VkDescriptorPool pool = VK_NULL_HANDLE;
+    if (vkCreateDescriptorPool(m_vulkanContext->getDevice(), &poolInfo, nullptr, &pool) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create descriptor pool");
+    }
+    return pool;
+}
+
+void DescriptorAllocator::resetChain(PoolChain& chain) {
+    VkDevice device = m_vulkanContext->getDevice();
+
+    for (auto pool : chain.usedPools) {
+        vkResetDescriptorPool(device, pool, 0);
+        chain.freePools.push_back(pool);
+    }
+    chain.usedPools.clear();
+    chain.current = VK_NULL_HANDLE;
+}
+
+void DescriptorAllocator::destroyChain(PoolChain& chain) {
+    VkDevice device = m_vulkanContext->getDevice();
+
+    for (auto pool : chain.usedPools) {
+        vkDestroyDescriptorPool(device, pool, nullptr);
+    }
+    for (auto pool : chain.freePools) {
+        vkDestroyDescriptorPool(device, pool, nullptr);
+    }
+    chain.usedPools.clear();
+    chain.freePools.clear();
+    chain.current = VK_NULL_HANDLE;
+}
+
+void DescriptorAllocator::writeSet(VkDescriptorSet set, const DescriptorBinding* bindings, uint32_t count) {
+    FrameVector<VkWriteDescriptorSet> writes(count);
+
+    for (uint32_t i = 0; i < count; ++i) {
+        const DescriptorBinding& binding = bindings[i];
+
+        VkWriteDescriptorSet& write = writes[i];
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstSet = set;
+        write.dstBinding = binding.binding;
+        write.dstArrayElement = 0;
+        write.descriptorCount = 1;
+        write.descriptorType = binding.type;
+        if (isImageDescriptor(binding.type)) {
+            write.pImageInfo = &binding.imageInfo;
+        } else {
+            write.pBufferInfo = &binding.bufferInfo;
+        }
+    }
+
+    vkUpdateDescriptorSets(m_vulkanContext->getDevice(), static_cast<uint32_t>(writes.size()),
+                           writes.data(), 0, nullptr);
+}
+
+uint64_t DescriptorAllocator::hashBindings(VkDescriptorSetLayout layout,
+                                           const std::vector<DescriptorBinding>& bindings) {
+    uint64_t hash = hashValue(layout);
+    for (const auto& binding : bindings) {
+        hash = hashValue(binding.binding, hash);
+        hash = hashValue(binding.type, hash);
+        if (isImageDescriptor(binding.type)) {
+            hash = hashValue(binding.imageInfo.imageView, hash);
+            hash = hashValue(binding.imageInfo.sampler, hash);
+            hash = hashValue(binding.imageInfo.imageLayout, hash);
+        } else {
+            hash = hashValue(binding.bufferInfo.buffer, hash);
+            hash = hashValue(binding.bufferInfo.offset, hash);
+            hash = hashValue(binding.bufferInfo.range, hash);
+        }
+    }
+    return hash;
+}
+
+} // namespace plaster
@@ -0,0 +1,297 @@
+#include "Graphics/DrawBatcher.h"
+#include "Graphics/VulkanContext.h"
+#include "Core/Metrics.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace plaster {
+
+DrawBatcher::DrawBatcher(VulkanContext* vulkanContext, uint32_t framesInFlight)
+    : m_vulkanContext(vulkanContext), m_instanceBuffers(framesInFlight), m_submittedCount(0) {
+}
+
+DrawBatcher::~DrawBatcher() {
+    for (auto& buffer : m_instanceBuffers) {
+        destroyInstanceBuffer(buffer);
+    }
+}
+
+uint32_t DrawBatcher::registerPipeline(VkPipeline pipeline, VkPipelineLayout layout) {
+    if (m_pipelines.size() >= (1u << PIPELINE_BITS)) {
+        throw std::runtime_error("Too many pipelines registered with DrawBatcher");
+    }
+    m_pipelines.push_back({pipeline, layout, nullptr, PipelineHandle()});
+    return static_cast<uint32_t>(m_pipelines.size() - 1);
+}
+
+uint32_t DrawBatcher::registerPipeline(const PipelineManager* manager, PipelineHandle handle) {
+    if (m_pipelines.size() >= (1u << PIPELINE_BITS)) {
+        throw std::runtime_error("Too many pipelines registered with DrawBatcher");
+    }
+    m_pipelines.push_back({VK_NULL_HANDLE, VK_NULL_HANDLE, manager, handle});
+    return static_cast<uint32_t>(m_pipelines.size() - 1);
+}
+
+uint32_t DrawBatcher::registerMaterial(uint32_t pipeline, VkDescriptorSet descriptorSet,
+                                       const glm::vec4& baseColor) {
+    if (m_materials.size() >= (1u << MATERIAL_BITS)) {
+        throw std::runtime_error("Too many materials registered with DrawBatcher");
+    }
+    m_materials.push_back({pipeline, descriptorSet, {baseColor}});
+    return static_cast<uint32_t>(m_materials.size() - 1);
+}
+
+uint32_t DrawBatcher::registerMesh(const GpuMesh& mesh) {
+    if (!m_freeMeshes.empty()) {
+        uint32_t id = m_freeMeshes.back();
+        m_freeMeshes.pop_back();
+        m_meshes[id] = mesh;
+        return id;
+    }
+    if (m_meshes.size() >= (1u << MESH_BITS)) {
+        throw std::runtime_error("Too many meshes registered with DrawBatcher");
+    }
+    m_meshes.push_back(mesh);
+    return static_cast<uint32_t>(m_meshes.size() - 1);
+}
+
+void DrawBatcher::releaseMesh(uint32_t mesh) {
+    m_meshes[mesh] = GpuMesh();
+    m_freeMeshes.push_back(mesh);
+}
+
+uint64_t DrawBatcher::makeSortKey(uint32_t pipeline, uint32_t material, uint32_t mesh) {
+    return (static_cast<uint64_t>(pipeline) << (MATERIAL_BITS + MESH_BITS)) |
+           (static_cast<uint64_t>(material) << MESH_BITS) |
+           static_cast<uint64_t>(mesh);
+}
+
+void DrawBatcher::submit(uint32_t mesh, uint32_t material, const glm::mat4& transform) {
+    uint32_t pipeline = m_materials[material].pipeline;
+    m_items.push_back({makeSortKey(pipeline, material, mesh), transform});
+}
+
+void DrawBatcher::build(uint32_t frameIndex) {
+    m_batches.clear();
+    m_submittedCount = static_cast<uint32_t>(m_items.size());
+
+    if (m_items.empty()) {
+        return;
+    }
+
+    radixSort();
+
+    InstanceBuffer& instanceBuffer = m_instanceBuffers[frameIndex];
+    ensureInstanceCapacity(instanceBuffer, m_submittedCount);
+
+    const uint64_t meshMask = (1ull << MESH_BITS) - 1;
+    const uint64_t materialMask = (1ull << MATERIAL_BITS) - 1;
+
+    uint64_t runKey = ~0ull;
+    for (uint32_t i = 0; i < m_submittedCount; ++i) {
+        const DrawItem& item = m_items[m_order[i]];
+        instanceBuffer.mapped[i].model = item.transform;
+
+        if (item.sortKey != runKey) {
+            runKey = item.sortKey;
+
+            DrawBatch batch;
+            batch.pipeline = static_cast<uint32_t>(runKey >> (MATERIAL_BITS + MESH_BITS));
+            batch.material = static_cast<uint32_t>((runKey >> MESH_BITS) & materialMask);
+            batch.mesh = static_cast<uint32_t>(runKey & meshMask);
+            batch.firstInstance = i;
+            batch.instanceCount = 0;
+            m_batches.push_back(batch);
+        }
+        ++m_batches.back().instanceCount;
+    }
+
+    static Counter& drawCalls = Metrics::counter("renderer.draw_calls");
+    static Counter& instances = Metrics::counter("renderer.instances");
+    static Counter& instanceBytes = Metrics::counter("upload.instance_bytes", "bytes");
+    drawCalls.add(m_batches.size());
+    instances.add(m_submittedCount);
+    instanceBytes.add(m_submittedCount * sizeof(InstanceData));
+
+    m_items.clear();
+}
+
+void DrawBatcher::record(VkCommandBuffer commandBuffer, uint32_t frameIndex, VkDescriptorSet frameSet,
+                         uint32_t frameOffset, VkDescriptorSet lightSet, uint32_t lightOffset) const {
+    if (m_batches.empty()) {
+        return;
+    }
+
+    VkBuffer instanceBuffer = m_instanceBuffers[frameIndex].buffer;
+    uint32_t boundPipeline = UINT32_MAX;
+    uint32_t boundMaterial = UINT32_MAX;
+    uint32_t boundMesh = UINT32_MAX;
+    VkBuffer boundVertexBuffer = VK_NULL_HANDLE;
+    VkBuffer boundIndexBuffer = VK_NULL_HANDLE;
+
+    VkPipelineLayout boundLayout = VK_NULL_HANDLE;
+    bool skipPipeline = false;
+    bool bindMaterials = true;
+    bool bindLights = false;
+    VkShaderStageFlags materialConstantStages = 0;
+
+    for (const DrawBatch& batch : m_batches) {
+        if (batch.pipeline != boundPipeline) {
+            const Pipeline& pipeline = m_pipelines[batch.pipeline];
+            VkPipeline resolved = pipeline.pipeline;
+            boundLayout = pipeline.layout;
+            bindMaterials = true;
+            bindLights = false;
+            materialConstantStages = 0;
+            if (pipeline.manager) {
+                resolved = pipeline.manager->resolve(pipeline.handle, boundLayout);
+                // The fallback has neither a material set nor push constants
+                bindMaterials = boundLayout == pipeline.manager->getLayout(pipeline.handle);
+                bindLights = bindMaterials && lightSet != VK_NULL_HANDLE &&
+                             pipeline.manager->getSetLayout(pipeline.handle, LIGHT_SET) != VK_NULL_HANDLE;
+                VkPushConstantRange range = pipeline.manager->getPushConstantRange(pipeline.handle);
+                if (range.size >= sizeof(MaterialConstants)) {
+                    materialConstantStages = range.stageFlags;
+                }
+            }
+
+            // Neither compiled nor covered by a fallback yet
+            skipPipeline = resolved == VK_NULL_HANDLE;
+            if (!skipPipeline) {
+                vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, resolved);
+                // Rebound per pipeline, as layouts that differ in push constants disturb it
+                if (frameSet != VK_NULL_HANDLE) {
+                    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, boundLayout,
+                                            FRAME_SET, 1, &frameSet, 1, &frameOffset);
+                }
+                if (bindLights) {
+                    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, boundLayout,
+                                            LIGHT_SET, 1, &lightSet, 1, &lightOffset);
+                }
+            }
+            boundPipeline = batch.pipeline;
+            boundMaterial = UINT32_MAX;
+        }
+        if (skipPipeline) {
+            continue;
+        }
+
+        if (batch.material != boundMaterial && bindMaterials) {
+            const Material& material = m_materials[batch.material];
+            if (material.descriptorSet != VK_NULL_HANDLE) {
+                vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, boundLayout,
+                                        MATERIAL_SET, 1, &material.descriptorSet, 0, nullptr);
+            }
+            if (materialConstantStages) {
+                vkCmdPushConstants(commandBuffer, boundLayout, materialConstantStages, 0,
+                                   sizeof(MaterialConstants), &material.constants);
+            }
+            boundMaterial = batch.material;
+        }
+
+        const GpuMesh& mesh = m_meshes[batch.mesh];
+        if (batch.mesh != boundMesh) {
+            // Merged static batches share buffers, so only rebind when the buffer itself changes
+            if (mesh.vertexBuffer != boundVertexBuffer) {
+                VkBuffer buffers[] = {mesh.vertexBuffer, instanceBuffer};
+                VkDeviceSize offsets[] = {0, 0};
+                vkCmdBindVertexBuffers(commandBuffer, 0, 2, buffers, offsets);
+                boundVertexBuffer = mesh.vertexBuffer;
+            }
+            if (mesh.indexBuffer != boundIndexBuffer) {
+                vkCmdBindIndexBuffer(commandBuffer, mesh.indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+                boundIndexBuffer = mesh.indexBuffer;
+            }
+            boundMesh = batch.mesh;
+        }
+
+        vkCmdDrawIndexed(commandBuffer, mesh.indexCount, batch.instanceCount,
+                         mesh.firstIndex, mesh.vertexOffset, batch.firstInstance);
+    }
+}
+
+void DrawBatcher::radixSort() {
+    const uint32_t count = static_cast<uint32_t>(m_items.size());
+
+    m_keys.resize(count);
+    m_keyScratch.resize(count);
+    m_order.resize(count);
+    m_orderScratch.resize(count);
+
+    for (uint32_t i = 0; i < count; ++i) {
+        m_keys[i] = m_items[i].sortKey;
+        m_order[i] = i;
+    }
+
+    // LSD radix sort, 8 bits per pass. Passes where every key shares the same
+    // byte are skipped, which is the common case for the high pipeline bits.
+    for (uint32_t shift = 0; shift < 64; shift += 8) {
+        uint32_t histogram[256] = {};
+        for (uint32_t i = 0; i < count; ++i) {
+            ++histogram[(m_keys[i] >> shift) & 0xff];
+        }
+
+        if (histogram[(m_keys[0] >> shift) & 0xff] == count) {
+            continue;
+        }
+
+        uint32_t offset = 0;
+        for (uint32_t bucket = 0; bucket < 256; ++bucket) {
+            uint32_t bucketCount = histogram[bucket];
+            histogram[bucket] = offset;
+            offset += bucketCount;
+        }
+
+        for (uint32_t i = 0; i < count; ++i) {
+            uint32_t destination = histogram[(m_keys[i] >> shift) & 0xff]++;
+            m_keyScratch[destination] = m_keys[i];
+            m_orderScratch[destination] = m_order[i];
+        }
+
+        m_keys.swap(m_keyScratch);
+        m_order.swap(m_orderScratch);
+    }
+}
+
+void DrawBatcher::ensureInstanceCapacity(InstanceBuffer& buffer, uint32_t count) {
+    if (buffer.capacity >= count) {
+        return;
+    }
+
+    // The frame that owned this buffer has retired, so it can be replaced in place
+    destroyInstanceBuffer(buffer);
+
+    uint32_t capacity = std::max(256u, buffer.capacity);
+    while (capacity < count) {
+        capacity *= 2;
+    }
+
+    m_vulkanContext->createBuffer(capacity * sizeof(InstanceData),
+                                  VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                                  VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                  buffer.buffer, buffer.memory);
+
+    void* mapped = nullptr;
+    vkMapMemory(m_vulkanContext->getDevice(), buffer.memory, 0, VK_WHOLE_SIZE, 0, &mapped);
+    buffer.mapped = static_cast<InstanceData*>(mapped);
+    buffer.capacity = capacity;
+}
+
+void DrawBatcher::destroyInstanceBuffer(InstanceBuffer& buffer) {
+    VkDevice device = m_vulkanContext->getDevice();
+
+    if (buffer.memory) {
+        vkUnmapMemory(device, buffer.memory);
+        vkFreeMemory(device, buffer.memory, nullptr);
+    }
+    if (buffer.buffer) {
+        vkDestroyBuffer(device, buffer.buffer, nullptr);
+    }
+    buffer.buffer = VK_NULL_HANDLE;
+    buffer.memory = VK_NULL_HANDLE;
+    buffer.mapped = nullptr;
+}
+
+} // namespace plaster
@@ -0,0 +1,68 @@
+#include "Graphics/DynamicResolution.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace plaster {
+
+namespace {
+
+// Scales are quantized so the render area only changes by whole steps
+const float SCALE_STEP = 1.0f / 64.0f;
+
+// Weight of a new sample in the cost average
+const float COST_SMOOTHING = 0.2f;
+
+} // namespace
+
+DynamicResolution::DynamicResolution() : m_costPerArea(0.0f), m_smoothedMs(0.0f), m_settleCounter(0) {
+}
+
+void DynamicResolution::reset() {
+    m_costPerArea = 0.0f;
+    m_smoothedMs = 0.0f;
+    m_settleCounter = 0;
+}
+
+float DynamicResolution::update(float gpuMs, float frameScale, float currentScale) {
+    if (!m_settings.enabled || gpuMs <= 0.0f || frameScale <= 0.0f) {
+        return currentScale;
+    }
+
+    float cost = gpuMs / (frameScale * frameScale);
+    if (m_costPerArea == 0.0f) {
+        m_costPerArea = cost;
+        m_smoothedMs = gpuMs;
+    } else {
+        m_costPerArea += (cost - m_costPerArea) * COST_SMOOTHING;
+        m_smoothedMs += (gpuMs - m_smoothedMs) * COST_SMOOTHING;
+    }
+
+    // Timings lag the recorded frames by the frames in flight, so after a change the
+    // next few samples still describe the old scale and would make it overshoot
+    if (m_settleCounter > 0) {
+        --m_settleCounter;
+        return currentScale;
+    }
+
+    float minScale = m_settings.minScale;
+    float maxScale = std::max(m_settings.maxScale, minScale);
+    float budget = m_settings.targetMs * m_settings.headroom;
+    float ideal = std::clamp(std::sqrt(budget / std::max(m_costPerArea, 1e-3f)), minScale, maxScale);
+
+    // Dead band around the ideal, then at least one step towards it
+    float error = ideal - currentScale;
+    if (std::fabs(error) < 2.0f * SCALE_STEP) {
+        return currentScale;
+    }
+    float gain = error < 0.0f ? m_settings.decreaseGain : m_settings.increaseGain;
+    float delta = std::max(std::round(std::fabs(error) * gain / SCALE_STEP), 1.0f) * SCALE_STEP;
+    float scale = std::clamp(currentScale + std::copysign(delta, error), minScale, maxScale);
+
+    if (scale != currentScale) {
+        m_settleCounter = m_settings.settleFrames;
+    }
+    return scale;
+}
+
+} // namespace plaster
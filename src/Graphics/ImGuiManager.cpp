@@ -1,17 +1,40 @@
 #include "Graphics/ImGuiManager.h"
 #include "Graphics/VulkanContext.h"
+#include "Graphics/VulkanDebug.h"
 #include "Core/Window.h"
 
 #include "imgui.h"
 #include "imgui_impl_vulkan.h"
 #include "imgui_impl_glfw.h"
 
+#include <cstring>
 #include <vector>
 
 namespace plaster {
 
-ImGuiManager::ImGuiManager(Window* window, VulkanContext* vulkanContext, VkRenderPass renderPass)
-    : m_window(window), m_vulkanContext(vulkanContext), m_imguiDescriptorPool(VK_NULL_HANDLE) {
+namespace {
+
+#ifdef PLASTER_VULKAN_DEBUG
+void checkImGuiResult(VkResult result) {
+    PLASTER_VK_CHECK(result);
+}
+#endif
+
+// ImVector's assignment frees and reallocates; resize() keeps the capacity
+template <typename T>
+void copyInto(ImVector<T>& destination, const ImVector<T>& source) {
+    destination.resize(source.Size);
+    if (source.Size > 0) {
+        std::memcpy(destination.Data, source.Data, source.size_in_bytes());
+    }
+}
+
+} // namespace
+
+ImGuiManager::ImGuiManager(Window* window, VulkanContext* vulkanContext, VkRenderPass renderPass,
+                           VkFormat colorFormat, uint32_t framesInFlight, VkPipelineCache pipelineCache)
+    : m_window(window), m_vulkanContext(vulkanContext), m_imguiDescriptorPool(VK_NULL_HANDLE),
+      m_colorFormat(colorFormat), m_snapshots(framesInFlight) {
     
   // Setup ImGui context
   IMGUI_CHECKVERSION();
@@ -47,25 +70,42 @@ ImGuiManager::ImGuiManager(Window* window, VulkanContext* vulkanContext, VkRende
   poolInfo.poolSizeCount = static_cast<uint32_t>(std::size(poolSizes));
   poolInfo.pPoolSizes = poolSizes;
 
-  vkCreateDescriptorPool(m_vulkanContext->getDevice(), &poolInfo, nullptr, &m_imguiDescriptorPool);
+  PLASTER_VK_CHECK(vkCreateDescriptorPool(m_vulkanContext->getDevice(), &poolInfo, nullptr, &m_imguiDescriptorPool));
+  PLASTER_VK_NAME(m_vulkanContext->getDevice(), VK_OBJECT_TYPE_DESCRIPTOR_POOL, m_imguiDescriptorPool,
+                  "ImGui descriptors");
 
   // Initialize ImGui Vulkan backend
   ImGui_ImplVulkan_InitInfo initInfo{};
+  initInfo.ApiVersion = m_vulkanContext->getApiVersion();
   initInfo.Instance = m_vulkanContext->getInstance();
   initInfo.PhysicalDevice = m_vulkanContext->getPhysicalDevice();
   initInfo.Device = m_vulkanContext->getDevice();
   initInfo.QueueFamily = m_vulkanContext->getGraphicsQueueFamily();
   initInfo.Queue = m_vulkanContext->getGraphicsQueue();
   initInfo.DescriptorPool = m_imguiDescriptorPool;
+  initInfo.PipelineCache = pipelineCache;
   initInfo.MinImageCount = 2;
-  initInfo.ImageCount = 2;
+  // The backend keeps a vertex and index buffer per image count and cycles through them
+  initInfo.ImageCount = framesInFlight;
+#ifdef PLASTER_VULKAN_DEBUG
+  initInfo.CheckVkResultFn = checkImGuiResult;
+#else
   initInfo.CheckVkResultFn = nullptr;
-  initInfo.PipelineInfoMain.RenderPass = renderPass;
+#endif
+  if (renderPass) {
+    initInfo.PipelineInfoMain.RenderPass = renderPass;
+  } else {
+    initInfo.UseDynamicRendering = true;
+    initInfo.PipelineInfoMain.PipelineRenderingCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+    initInfo.PipelineInfoMain.PipelineRenderingCreateInfo.colorAttachmentCount = 1;
+    initInfo.PipelineInfoMain.PipelineRenderingCreateInfo.pColorAttachmentFormats = &m_colorFormat;
+  }
 
   ImGui_ImplVulkan_Init(&initInfo);
 }
 
 ImGuiManager::~ImGuiManager() {
+    m_snapshots.clear();
     ImGui_ImplVulkan_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
@@ -81,10 +121,59 @@ void ImGuiManager::newFrame() {
     ImGui::NewFrame();
 }
 
-void ImGuiManager::render(VkCommandBuffer commandBuffer) {
+void ImGuiManager::endFrame(uint32_t frameIndex) {
     ImGui::Render();
-    ImDrawData* drawData = ImGui::GetDrawData();
-    ImGui_ImplVulkan_RenderDrawData(drawData, commandBuffer);
+    const ImDrawData* source = ImGui::GetDrawData();
+    DrawDataSnapshot& snapshot = m_snapshots[frameIndex];
+    ImDrawData& drawData = snapshot.drawData;
+
+    drawData.Valid = source->Valid;
+    drawData.CmdListsCount = source->CmdListsCount;
+    drawData.TotalIdxCount = source->TotalIdxCount;
+    drawData.TotalVtxCount = source->TotalVtxCount;
+    drawData.DisplayPos = source->DisplayPos;
+    drawData.DisplaySize = source->DisplaySize;
+    drawData.FramebufferScale = source->FramebufferScale;
+    drawData.OwnerViewport = source->OwnerViewport;
+    // Texture requests are handled by updateTextures(), never while recording
+    drawData.Textures = nullptr;
+
+    while (snapshot.drawLists.size() < static_cast<size_t>(source->CmdListsCount)) {
+        snapshot.drawLists.push_back(std::make_unique<ImDrawList>(nullptr));
+    }
+    drawData.CmdLists.resize(source->CmdListsCount);
+    for (int i = 0; i < source->CmdListsCount; ++i) {
+        const ImDrawList* sourceList = source->CmdLists[i];
+        ImDrawList* drawList = snapshot.drawLists[i].get();
+        copyInto(drawList->CmdBuffer, sourceList->CmdBuffer);
+        copyInto(drawList->IdxBuffer, sourceList->IdxBuffer);
+        copyInto(drawList->VtxBuffer, sourceList->VtxBuffer);
+        drawList->Flags = sourceList->Flags;
+        drawData.CmdLists[i] = drawList;
+    }
+}
+
+void ImGuiManager::updateTextures(uint32_t frameIndex) {
+    for (ImTextureData* texture : ImGui::GetPlatformIO().Textures) {
+        if (texture->Status != ImTextureStatus_OK) {
+            ImGui_ImplVulkan_UpdateTexture(texture);
+        }
+    }
+
+    // Commands refer to ImTextureData, which the next frame's UI may change while
+    // this snapshot is recorded; the backend only needs the descriptor set
+    for (ImDrawList* drawList : m_snapshots[frameIndex].drawData.CmdLists) {
+        for (ImDrawCmd& command : drawList->CmdBuffer) {
+            command.TexRef = ImTextureRef(command.GetTexID());
+        }
+    }
+}
+
+void ImGuiManager::render(VkCommandBuffer commandBuffer, uint32_t frameIndex) {
+    ImDrawData& drawData = m_snapshots[frameIndex].drawData;
+    if (drawData.Valid) {
+        ImGui_ImplVulkan_RenderDrawData(&drawData, commandBuffer);
+    }
 }
 
 void ImGuiManager::setTheme() {
@@ -0,0 +1,88 @@
+#include "Graphics/Mesh.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+
+namespace plaster {
+
+std::array<VkVertexInputBindingDescription, 2> getMeshBindingDescriptions() {
+    std::array<VkVertexInputBindingDescription, 2> bindings{};
+
+    bindings[0].binding = 0;
+    bindings[0].stride = sizeof(Vertex);
+    bindings[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+    bindings[1].binding = 1;
+    bindings[1].stride = sizeof(InstanceData);
+    bindings[1].inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+
+    return bindings;
+}
+
+std::array<VkVertexInputAttributeDescription, 7> getMeshAttributeDescriptions() {
+    std::array<VkVertexInputAttributeDescription, 7> attributes{};
+
+    attributes[0] = {0, 0, VK_FORMAT_R32G32B32_SFLOAT, static_cast<uint32_t>(offsetof(Vertex, position))};
+    attributes[1] = {1, 0, VK_FORMAT_R32G32B32_SFLOAT, static_cast<uint32_t>(offsetof(Vertex, normal))};
+    attributes[2] = {2, 0, VK_FORMAT_R32G32_SFLOAT, static_cast<uint32_t>(offsetof(Vertex, uv))};
+
+    // mat4 model matrix takes one location per column
+    for (uint32_t column = 0; column < 4; ++column) {
+        attributes[3 + column] = {3 + column, 1, VK_FORMAT_R32G32B32A32_SFLOAT,
+                                  static_cast<uint32_t>(column * sizeof(glm::vec4))};
+    }
+
+    return attributes;
+}
+
+std::vector<StaticBatch> mergeStaticGeometry(const std::vector<StaticMeshInstance>& instances) {
+    std::vector<const StaticMeshInstance*> sorted;
+    sorted.reserve(instances.size());
+    for (const auto& instance : instances) {
+        if (instance.mesh) {
+            sorted.push_back(&instance);
+        }
+    }
+
+    std::stable_sort(sorted.begin(), sorted.end(),
+                     [](const StaticMeshInstance* a, const StaticMeshInstance* b) {
+                         return a->material < b->material;
+                     });
+
+    std::vector<StaticBatch> batches;
+
+    for (const StaticMeshInstance* instance : sorted) {
+        if (batches.empty() || batches.back().material != instance->material) {
+            batches.push_back({});
+            batches.back().material = instance->material;
+        }
+
+        MeshData& merged = batches.back().mesh;
+        const MeshData& source = *instance->mesh;
+
+        if (merged.vertices.size() + source.vertices.size() > UINT32_MAX) {
+            throw std::runtime_error("Static batch exceeds 32-bit index range");
+        }
+
+        uint32_t baseVertex = static_cast<uint32_t>(merged.vertices.size());
+        glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(instance->transform)));
+
+        merged.vertices.reserve(merged.vertices.size() + source.vertices.size());
+        for (const Vertex& vertex : source.vertices) {
+            Vertex baked = vertex;
+            baked.position = glm::vec3(instance->transform * glm::vec4(vertex.position, 1.0f));
+            baked.normal = glm::normalize(normalMatrix * vertex.normal);
+            merged.vertices.push_back(baked);
+        }
+
+        merged.indices.reserve(merged.indices.size() + source.indices.size());
+        for (uint32_t index : source.indices) {
+            merged.indices.push_back(baseVertex + index);
+        }
+    }
+
+    return batches;
+}
+
+} // namespace plaster
@@ -0,0 +1,63 @@
+#include "Graphics/MeshLoader.h"
+#include "Graphics/Renderer.h"
+#include "Graphics/Mesh.h"
+#include "Asset/ArchiveFormat.h"
+
+#include <cstring>
+
+namespace plaster {
+
+MeshLoader::MeshLoader(Renderer* renderer) : m_renderer(renderer) {
+    Vertex vertex{};
+    uint32_t indices[3] = {0, 0, 0};
+    m_placeholder = m_renderer->uploadMesh(&vertex, 1, indices, 3);
+}
+
+MeshLoader::~MeshLoader() {
+    m_renderer->releaseMesh(m_placeholder);
+}
+
+bool MeshLoader::decode(std::vector<uint8_t>& data) {
+    if (data.size() < sizeof(MeshBlobHeader)) {
+        return false;
+    }
+    MeshBlobHeader header;
+    std::memcpy(&header, data.data(), sizeof(header));
+    if (header.magic != MESH_BLOB_MAGIC || header.vertexStride != sizeof(Vertex) ||
+        header.vertexCount == 0 || header.indexCount == 0) {
+        return false;
+    }
+    uint64_t vertexBytes = uint64_t(header.vertexCount) * sizeof(Vertex);
+    uint64_t indexBytes = uint64_t(header.indexCount) * sizeof(uint32_t);
+    if (data.size() != sizeof(MeshBlobHeader) + vertexBytes + indexBytes) {
+        return false;
+    }
+
+    // On the worker, so a bad index never reaches the GPU
+    const uint8_t* indices = data.data() + sizeof(MeshBlobHeader) + vertexBytes;
+    for (uint32_t i = 0; i < header.indexCount; ++i) {
+        uint32_t index;
+        std::memcpy(&index, indices + i * sizeof(uint32_t), sizeof(index));
+        if (index >= header.vertexCount) {
+            return false;
+        }
+    }
+    return true;
+}
+
+uint64_t MeshLoader::upload(const std::vector<uint8_t>& data, uint64_t& residentBytes) {
+    MeshBlobHeader header;
+    std::memcpy(&header, data.data(), sizeof(header));
+    const uint8_t* vertices = data.data() + sizeof(MeshBlobHeader);
+    const uint8_t* indices = vertices + header.vertexCount * sizeof(Vertex);
+
+    residentBytes = data.size() - sizeof(MeshBlobHeader);
+    return m_renderer->uploadMesh(reinterpret_cast<const Vertex*>(vertices), header.vertexCount,
+                                  reinterpret_cast<const uint32_t*>(indices), header.indexCount);
+}
+
+void MeshLoader::evict(uint64_t resource) {
+    m_renderer->releaseMesh(static_cast<uint32_t>(resource));
+}
+
+} // namespace plaster
@@ -0,0 +1,493 @@
+#include "Graphics/MeshLod.h"
+
+#include <algorithm>
+#include <cmath>
+#include <queue>
+#include <stdexcept>
+
+namespace plaster {
+
+namespace {
+
+// Strided view of the caller's positions
+struct Positions {
+    const uint8_t* base;
+    size_t stride;
+
+    glm::vec3 operator[](uint32_t vertex) const {
+        const float* position = reinterpret_cast<const float*>(base + vertex * stride);
+        return glm::vec3(position[0], position[1], position[2]);
+    }
+};
+
+// Sum of squared distances to a set of planes, each weighted by the area of
+// the triangle it came from. Doubles, as the terms of a large mesh cancel badly.
+struct Quadric {
+    double xx, xy, xz, xw, yy, yz, yw, zz, zw, ww;
+    double weight;
+
+    void addPlane(const glm::vec3& normal, float distance, double area) {
+        double x = normal.x, y = normal.y, z = normal.z, w = distance;
+        xx += area * x * x; xy += area * x * y; xz += area * x * z; xw += area * x * w;
+        yy += area * y * y; yz += area * y * z; yw += area * y * w;
+        zz += area * z * z; zw += area * z * w;
+        ww += area * w * w;
+        weight += area;
+    }
+
+    void add(const Quadric& other) {
+        xx += other.xx; xy += other.xy; xz += other.xz; xw += other.xw;
+        yy += other.yy; yz += other.yz; yw += other.yw;
+        zz += other.zz; zw += other.zw;
+        ww += other.ww;
+        weight += other.weight;
+    }
+
+    double evaluate(const glm::vec3& point) const {
+        double x = point.x, y = point.y, z = point.z;
+        double result = xx * x * x + 2.0 * xy * x * y + 2.0 * xz * x * z + 2.0 * xw * x +
+                        yy * y * y + 2.0 * yz * y * z + 2.0 * yw * y +
+                        zz * z * z + 2.0 * zw * z + ww;
+        return std::max(result, 0.0);
+    }
+};
+
+// Mean squared distance from point to the planes of both quadrics
+double collapseCost(const Quadric& a, const Quadric& b, const glm::vec3& point) {
+    double weight = a.weight + b.weight;
+    return weight > 0.0 ? (a.evaluate(point) + b.evaluate(point)) / weight : 0.0;
+}
+
+float pointTriangleDistance(const glm::vec3& p, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c) {
+    // Closest point by Voronoi region, Ericson, Real-Time Collision Detection 5.1.5
+    glm::vec3 ab = b - a;
+    glm::vec3 ac = c - a;
+    glm::vec3 ap = p - a;
+    float d1 = glm::dot(ab, ap);
+    float d2 = glm::dot(ac, ap);
+    if (d1 <= 0.0f && d2 <= 0.0f) {
+        return glm::length(ap);
+    }
+    glm::vec3 bp = p - b;
+    float d3 = glm::dot(ab, bp);
+    float d4 = glm::dot(ac, bp);
+    if (d3 >= 0.0f && d4 <= d3) {
+        return glm::length(bp);
+    }
+    float vc = d1 * d4 - d3 * d2;
+    if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) {
+        return glm::length(p - (a + ab * (d1 / (d1 - d3))));
+    }
+    glm::vec3 cp = p - c;
+    float d5 = glm::dot(ab, cp);
+    float d6 = glm::dot(ac, cp);
+    if (d6 >= 0.0f && d5 <= d6) {
+        return glm::length(cp);
+    }
+    float vb = d5 * d2 - d1 * d6;
+    if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) {
+        return glm::length(p - (a + ac * (d2 / (d2 - d6))));
+    }
+    float va = d3 * d6 - d5 * d4;
+    if (va <= 0.0f && d4 - d3 >= 0.0f && d5 - d6 >= 0.0f) {
+        return glm::length(p - (b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)))));
+    }
+    float scale = 1.0f / (va + vb + vc);
+    return glm::length(p - (a + ab * (vb * scale) + ac * (vc * scale)));
+}
+
+struct Collapse {
+    double cost;
+    uint32_t from;
+    uint32_t to;
+    uint32_t fromVersion;
+    uint32_t toVersion;
+
+    bool operator>(const Collapse& other) const { return cost > other.cost; }
+};
+
+class Simplifier {
+public:
+    Simplifier(const Positions& positions, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount);
+
+    // Collapses edges until at most targetTriangles are left or nothing can go
+    void run(uint32_t targetTriangles);
+
+    uint32_t getTriangleCount() const { return m_triangleCount; }
+    // Largest distance from a removed vertex to the triangles within two
+    // edges of the vertex it ended up merged into, or floor if that is
+    // larger. Quadric costs average over planes and run several times lower,
+    // too optimistic to pick levels by.
+    float measureError(float floor);
+    void appendIndices(std::vector<uint32_t>& output) const;
+
+private:
+    Positions m_positions;
+    std::vector<uint32_t> m_indices;        // three per triangle, rewritten by collapses
+    std::vector<uint8_t> m_alive;           // per triangle
+    std::vector<std::vector<uint32_t>> m_vertexTriangles;
+    std::vector<Quadric> m_quadrics;
+    std::vector<uint32_t> m_versions;       // bumped whenever a vertex's edges change cost
+    std::vector<uint8_t> m_locked;          // on an open border or a non-manifold edge
+    std::vector<uint32_t> m_collapsedInto;  // itself while the vertex is in the mesh
+    std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> m_queue;
+    std::vector<uint32_t> m_fromNeighbours;
+    std::vector<uint32_t> m_toNeighbours;
+    uint32_t m_triangleCount;
+
+    bool contains(uint32_t triangle, uint32_t vertex) const {
+        const uint32_t* corners = &m_indices[triangle * 3];
+        return corners[0] == vertex || corners[1] == vertex || corners[2] == vertex;
+    }
+    void gatherNeighbours(uint32_t vertex, std::vector<uint32_t>& neighbours) const;
+    void pushEdge(uint32_t a, uint32_t b);
+    bool isValid(uint32_t from, uint32_t to);
+    void collapse(uint32_t from, uint32_t to);
+};
+
+Simplifier::Simplifier(const Positions& positions, uint32_t vertexCount, const uint32_t* indices,
+                       uint32_t indexCount)
+    : m_positions(positions), m_indices(indices, indices + indexCount), m_alive(indexCount / 3, 1),
+      m_vertexTriangles(vertexCount), m_quadrics(vertexCount, Quadric{}), m_versions(vertexCount, 0),
+      m_locked(vertexCount, 0), m_collapsedInto(vertexCount), m_triangleCount(0) {
+    for (uint32_t vertex = 0; vertex < vertexCount; ++vertex) {
+        m_collapsedInto[vertex] = vertex;
+    }
+    uint32_t triangleCount = indexCount / 3;
+    std::vector<uint64_t> edges;
+    edges.reserve(indexCount);
+    for (uint32_t triangle = 0; triangle < triangleCount; ++triangle) {
+        const uint32_t* corners = &m_indices[triangle * 3];
+        if (corners[0] == corners[1] || corners[1] == corners[2] || corners[0] == corners[2]) {
+            m_alive[triangle] = 0;
+            continue;
+        }
+        ++m_triangleCount;
+        glm::vec3 a = m_positions[corners[0]];
+        glm::vec3 normal = glm::cross(m_positions[corners[1]] - a, m_positions[corners[2]] - a);
+        float length = glm::length(normal);
+        for (uint32_t k = 0; k < 3; ++k) {
+            m_vertexTriangles[corners[k]].push_back(triangle);
+            uint32_t u = corners[k];
+            uint32_t v = corners[(k + 1) % 3];
+            edges.push_back(static_cast<uint64_t>(std::min(u, v)) << 32 | std::max(u, v));
+        }
+        if (length > 0.0f) {
+            normal /= length;
+            Quadric plane{};
+            plane.addPlane(normal, -glm::dot(normal, a), 0.5 * length);
+            for (uint32_t k = 0; k < 3; ++k) {
+                m_quadrics[corners[k]].add(plane);
+            }
+        }
+    }
+
+    // An edge used by one triangle is an open border (or a seam, where
+    // vertices are split for their attributes); more than two is non-manifold
+    std::sort(edges.begin(), edges.end());
+    for (size_t i = 0; i < edges.size();) {
+        size_t end = i + 1;
+        while (end < edges.size() && edges[end] == edges[i]) {
+            ++end;
+        }
+        if (end - i != 2) {
+            m_locked[static_cast<uint32_t>(edges[i] >> 32)] = 1;
+            m_locked[static_cast<uint32_t>(edges[i])] = 1;
+        }
+        i = end;
+    }
+    edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+    for (uint64_t edge : edges) {
+        pushEdge(static_cast<uint32_t>(edge >> 32), static_cast<uint32_t>(edge));
+    }
+}
+
+void Simplifier::gatherNeighbours(uint32_t vertex, std::vector<uint32_t>& neighbours) const {
+    neighbours.clear();
+    for (uint32_t triangle : m_vertexTriangles[vertex]) {
+        if (!m_alive[triangle]) {
+            continue;
+        }
+        for (uint32_t k = 0; k < 3; ++k) {
+            uint32_t corner = m_indices[triangle * 3 + k];
+            if (corner != vertex && std::find(neighbours.begin(), neighbours.end(), corner) == neighbours.end()) {
+                neighbours.push_back(corner);
+            }
+        }
+    }
+}
+
+void Simplifier::pushEdge(uint32_t a, uint32_t b) {
+    // Onto whichever endpoint is cheaper; a locked vertex may only be collapsed onto
+    Collapse best{0.0, UINT32_MAX, UINT32_MAX, 0, 0};
+    if (!m_locked[a]) {
+        best = {collapseCost(m_quadrics[a], m_quadrics[b], m_positions[b]), a, b, m_versions[a], m_versions[b]};
+    }
+    if (!m_locked[b]) {
+        double cost = collapseCost(m_quadrics[a], m_quadrics[b], m_positions[a]);
+        if (best.from == UINT32_MAX || cost < best.cost) {
+            best = {cost, b, a, m_versions[b], m_versions[a]};
+        }
+    }
+    if (best.from != UINT32_MAX) {
+        m_queue.push(best);
+    }
+}
+
+bool Simplifier::isValid(uint32_t from, uint32_t to) {
+    // Link condition: an interior edge has exactly two vertices opposite it.
+    // More shared neighbours and the collapse would pinch the surface.
+    gatherNeighbours(from, m_fromNeighbours);
+    gatherNeighbours(to, m_toNeighbours);
+    uint32_t shared = 0;
+    for (uint32_t neighbour : m_fromNeighbours) {
+        shared += std::find(m_toNeighbours.begin(), m_toNeighbours.end(), neighbour) != m_toNeighbours.end() ? 1 : 0;
+    }
+    if (shared != 2) {
+        return false;
+    }
+
+    // No triangle that survives may flip or fold over
+    glm::vec3 target = m_positions[to];
+    for (uint32_t triangle : m_vertexTriangles[from]) {
+        if (!m_alive[triangle] || contains(triangle, to)) {
+            continue;
+        }
+        glm::vec3 before[3];
+        glm::vec3 after[3];
+        for (uint32_t k = 0; k < 3; ++k) {
+            uint32_t corner = m_indices[triangle * 3 + k];
+            before[k] = m_positions[corner];
+            after[k] = corner == from ? target : before[k];
+        }
+        glm::vec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+        glm::vec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+        float lengths = glm::length(normalBefore) * glm::length(normalAfter);
+        if (lengths <= 0.0f || glm::dot(normalBefore, normalAfter) < 0.2f * lengths) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void Simplifier::collapse(uint32_t from, uint32_t to) {
+    std::vector<uint32_t>& target = m_vertexTriangles[to];
+    for (uint32_t triangle : m_vertexTriangles[from]) {
+        if (!m_alive[triangle]) {
+            continue;
+        }
+        if (contains(triangle, to)) {
+            m_alive[triangle] = 0;
+            --m_triangleCount;
+            continue;
+        }
+        uint32_t* corners = &m_indices[triangle * 3];
+        for (uint32_t k = 0; k < 3; ++k) {
+            corners[k] = corners[k] == from ? to : corners[k];
+        }
+        target.push_back(triangle);
+    }
+    target.erase(std::remove_if(target.begin(), target.end(), [this](uint32_t t) { return !m_alive[t]; }),
+                 target.end());
+    std::vector<uint32_t>().swap(m_vertexTriangles[from]);
+
+    m_quadrics[to].add(m_quadrics[from]);
+    m_collapsedInto[from] = to;
+    ++m_versions[from];
+    ++m_versions[to];
+
+    // Every edge around the merged vertex changed cost
+    gatherNeighbours(to, m_toNeighbours);
+    for (uint32_t neighbour : m_toNeighbours) {
+        pushEdge(neighbour, to);
+    }
+}
+
+void Simplifier::run(uint32_t targetTriangles) {
+    while (m_triangleCount > targetTriangles && !m_queue.empty()) {
+        Collapse next = m_queue.top();
+        m_queue.pop();
+        // Stale: an endpoint has collapsed or changed since this was queued
+        if (next.fromVersion != m_versions[next.from] || next.toVersion != m_versions[next.to]) {
+            continue;
+        }
+        if (!isValid(next.from, next.to)) {
+            continue;
+        }
+        collapse(next.from, next.to);
+    }
+}
+
+float Simplifier::measureError(float floor) {
+    float error = floor;
+    for (uint32_t vertex = 0; vertex < m_collapsedInto.size(); ++vertex) {
+        uint32_t root = vertex;
+        while (m_collapsedInto[root] != root) {
+            root = m_collapsedInto[root];
+        }
+        // Path compression, so later levels walk short chains
+        for (uint32_t step = vertex; m_collapsedInto[step] != root;) {
+            uint32_t next = m_collapsedInto[step];
+            m_collapsedInto[step] = root;
+            step = next;
+        }
+        if (root == vertex) {
+            continue;
+        }
+        // Nearest triangles first; the search ends as soon as one is within
+        // the error found so far, as the vertex cannot raise it any more
+        glm::vec3 position = m_positions[vertex];
+        float nearest = INFINITY;
+        auto measure = [&](uint32_t around) {
+            for (uint32_t triangle : m_vertexTriangles[around]) {
+                const uint32_t* corners = &m_indices[triangle * 3];
+                if (m_alive[triangle]) {
+                    nearest = std::min(nearest, pointTriangleDistance(position, m_positions[corners[0]],
+                                                                      m_positions[corners[1]],
+                                                                      m_positions[corners[2]]));
+                }
+            }
+            return nearest <= error;
+        };
+        if (!measure(root)) {
+            gatherNeighbours(root, m_toNeighbours);
+            for (uint32_t neighbour : m_toNeighbours) {
+                if (measure(neighbour)) {
+                    break;
+                }
+            }
+        }
+        error = std::max(error, nearest);
+    }
+    return error;
+}
+
+void Simplifier::appendIndices(std::vector<uint32_t>& output) const {
+    for (size_t triangle = 0; triangle < m_alive.size(); ++triangle) {
+        if (m_alive[triangle]) {
+            output.insert(output.end(), &m_indices[triangle * 3], &m_indices[triangle * 3] + 3);
+        }
+    }
+}
+
+} // namespace
+
+MeshLodData buildMeshLods(const float* positions, size_t positionStride, uint32_t vertexCount,
+                          const uint32_t* indices, uint32_t indexCount) {
+    if (indexCount % 3 != 0) {
+        throw std::runtime_error("Mesh LODs need a triangle list");
+    }
+    for (uint32_t i = 0; i < indexCount; ++i) {
+        if (indices[i] >= vertexCount) {
+            throw std::runtime_error("Mesh index out of range while building LODs");
+        }
+    }
+
+    MeshLodData data;
+    data.indices.assign(indices, indices + indexCount);
+    data.levels.push_back({0, indexCount, 0.0f});
+
+    Simplifier simplifier(Positions{reinterpret_cast<const uint8_t*>(positions), positionStride}, vertexCount,
+                          indices, indexCount);
+    // Each level carries on from the last, against quadrics of the original surface
+    uint32_t previous = simplifier.getTriangleCount();
+    while (data.levels.size() < MESH_LOD_MAX_LEVELS && previous > MESH_LOD_MIN_TRIANGLES) {
+        uint32_t target = std::max(static_cast<uint32_t>(previous * MESH_LOD_REDUCTION), MESH_LOD_MIN_TRIANGLES);
+        simplifier.run(target);
+        uint32_t reached = simplifier.getTriangleCount();
+        // Stalled on locked vertices and rejected collapses: not worth a level
+        if (reached > previous - previous / 10) {
+            break;
+        }
+        MeshLodLevel level;
+        level.firstIndex = static_cast<uint32_t>(data.indices.size());
+        level.indexCount = reached * 3;
+        level.error = simplifier.measureError(data.levels.back().error);
+        simplifier.appendIndices(data.indices);
+        data.levels.push_back(level);
+        previous = reached;
+    }
+    return data;
+}
+
+LodSelector::LodSelector() : m_cameraPosition(0.0f), m_pixelsPerUnit(0.0f) {
+}
+
+uint32_t LodSelector::addMesh(const uint32_t* levelMeshes, const float* errors, const uint32_t* triangleCounts,
+                              uint32_t levelCount, const glm::vec3& center, float radius) {
+    if (levelCount == 0) {
+        throw std::runtime_error("A LOD mesh needs at least one level");
+    }
+    LodMesh mesh;
+    mesh.firstLevel = static_cast<uint32_t>(m_levels.size());
+    mesh.levelCount = levelCount;
+    mesh.center = center;
+    mesh.radius = radius;
+    for (uint32_t level = 0; level < levelCount; ++level) {
+        m_levels.push_back({levelMeshes[level], errors[level], triangleCounts[level]});
+    }
+    m_meshes.push_back(mesh);
+    return static_cast<uint32_t>(m_meshes.size() - 1);
+}
+
+uint32_t LodSelector::addInstance(uint32_t mesh) {
+    m_instances.push_back({mesh, NO_LEVEL});
+    return static_cast<uint32_t>(m_instances.size() - 1);
+}
+
+void LodSelector::setCamera(const glm::mat4& view, const glm::mat4& projection, float viewportHeight) {
+    m_cameraPosition = glm::vec3(glm::inverse(view)[3]);
+    // A length at distance 1 covers projection[1][1] / 2 of the viewport's height
+    m_pixelsPerUnit = std::abs(projection[1][1]) * 0.5f * viewportHeight;
+}
+
+uint32_t LodSelector::selectLevel(uint32_t instance, const glm::mat4& transform) {
+    Instance& state = m_instances[instance];
+    const LodMesh& mesh = m_meshes[state.mesh];
+    const Level* levels = &m_levels[mesh.firstLevel];
+
+    float scale = std::max(glm::length(glm::vec3(transform[0])),
+                           std::max(glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2]))));
+    glm::vec3 center = glm::vec3(transform * glm::vec4(mesh.center, 1.0f));
+    float distance = glm::length(center - m_cameraPosition) - mesh.radius * scale;
+    // Inside the bounds everything is at full detail
+    float pixelsPerError = distance > 0.0f ? m_pixelsPerUnit * scale / distance : INFINITY;
+
+    uint32_t maxLevel = std::min(mesh.levelCount - 1, m_settings.maxLevel);
+    auto coarsest = [&](float pixelError) {
+        uint32_t level = 0;
+        while (level < maxLevel && levels[level + 1].error * pixelsPerError <= pixelError) {
+            ++level;
+        }
+        return level;
+    };
+    uint32_t refined = coarsest(m_settings.pixelError);
+    uint32_t coarsened = coarsest(m_settings.pixelError * (1.0f - m_settings.hysteresis));
+
+    // Refine as soon as the current level shows too much error; coarsen only
+    // once the coarser level is comfortably under the limit. A first
+    // selection has nothing to hold on to.
+    uint32_t level = refined;
+    if (state.level != NO_LEVEL) {
+        level = std::min(state.level, maxLevel);
+        if (refined < level) {
+            level = refined;
+        } else if (coarsened > level) {
+            level = coarsened;
+        }
+    }
+
+    ++m_stats.selections;
+    m_stats.switches += state.level != NO_LEVEL && level != state.level ? 1 : 0;
+    m_stats.triangles += levels[level].triangleCount;
+    m_stats.fullDetailTriangles += levels[0].triangleCount;
+    state.level = level;
+    return level;
+}
+
+uint32_t LodSelector::select(uint32_t instance, const glm::mat4& transform) {
+    uint32_t level = selectLevel(instance, transform);
+    return m_levels[m_meshes[m_instances[instance].mesh].firstLevel + level].mesh;
+}
+
+} // namespace plaster
@@ -0,0 +1,225 @@
+#include "Graphics/Meshlet.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <stdexcept>
+
+namespace plaster {
+
+namespace {
+
+const uint8_t UNASSIGNED = 0xff;
+
+// Strided view of the caller's positions
+struct Positions {
+    const uint8_t* base;
+    size_t stride;
+
+    glm::vec3 operator[](uint32_t vertex) const {
+        const float* position = reinterpret_cast<const float*>(base + vertex * stride);
+        return glm::vec3(position[0], position[1], position[2]);
+    }
+};
+
+glm::vec3 triangleCentroid(const Positions& positions, const uint32_t* triangle) {
+    return (positions[triangle[0]] + positions[triangle[1]] + positions[triangle[2]]) * (1.0f / 3.0f);
+}
+
+void computeBounds(const Positions& positions, const MeshletData& data, Meshlet& meshlet) {
+    glm::vec3 lower(FLT_MAX);
+    glm::vec3 upper(-FLT_MAX);
+    for (uint32_t i = 0; i < meshlet.vertexCount; ++i) {
+        glm::vec3 position = positions[data.vertices[meshlet.vertexOffset + i]];
+        lower = glm::min(lower, position);
+        upper = glm::max(upper, position);
+    }
+    meshlet.center = (lower + upper) * 0.5f;
+    float radiusSquared = 0.0f;
+    for (uint32_t i = 0; i < meshlet.vertexCount; ++i) {
+        glm::vec3 offset = positions[data.vertices[meshlet.vertexOffset + i]] - meshlet.center;
+        radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+    }
+    meshlet.radius = std::sqrt(radiusSquared);
+
+    // The axis averages the unit normals; the cutoff comes from the one furthest from it
+    glm::vec3 normals[MESHLET_MAX_TRIANGLES];
+    uint32_t normalCount = 0;
+    glm::vec3 axis(0.0f);
+    for (uint32_t i = 0; i < meshlet.triangleCount; ++i) {
+        const uint8_t* local = &data.triangles[meshlet.triangleOffset + i * 3];
+        glm::vec3 a = positions[data.vertices[meshlet.vertexOffset + local[0]]];
+        glm::vec3 b = positions[data.vertices[meshlet.vertexOffset + local[1]]];
+        glm::vec3 c = positions[data.vertices[meshlet.vertexOffset + local[2]]];
+        glm::vec3 normal = glm::cross(b - a, c - a);
+        float length = glm::length(normal);
+        // Degenerate triangles are never visible, so they constrain nothing
+        if (length > 0.0f) {
+            normals[normalCount] = normal / length;
+            axis += normals[normalCount];
+            ++normalCount;
+        }
+    }
+
+    meshlet.coneAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+    meshlet.coneCutoff = 1.0f;
+    float axisLength = glm::length(axis);
+    if (normalCount == 0 || axisLength < 1e-6f) {
+        return;
+    }
+    axis /= axisLength;
+    float minDot = 1.0f;
+    for (uint32_t i = 0; i < normalCount; ++i) {
+        minDot = std::min(minDot, glm::dot(normals[i], axis));
+    }
+    meshlet.coneAxis = axis;
+    // Past about 84 degrees the cone would almost never cull anything
+    if (minDot > 0.1f) {
+        meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+    }
+}
+
+} // namespace
+
+MeshletData buildMeshlets(const float* positions, size_t positionStride, uint32_t vertexCount,
+                          const uint32_t* indices, uint32_t indexCount) {
+    if (indexCount % 3 != 0) {
+        throw std::runtime_error("Meshlets need a triangle list");
+    }
+    uint32_t triangleCount = indexCount / 3;
+    Positions vertexPositions{reinterpret_cast<const uint8_t*>(positions), positionStride};
+
+    // Triangles around each vertex
+    std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+    for (uint32_t i = 0; i < indexCount; ++i) {
+        if (indices[i] >= vertexCount) {
+            throw std::runtime_error("Mesh index out of range while building meshlets");
+        }
+        ++adjacencyOffsets[indices[i] + 1];
+    }
+    for (uint32_t i = 0; i < vertexCount; ++i) {
+        adjacencyOffsets[i + 1] += adjacencyOffsets[i];
+    }
+    std::vector<uint32_t> adjacency(indexCount);
+    std::vector<uint32_t> cursor(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+    for (uint32_t i = 0; i < indexCount; ++i) {
+        adjacency[cursor[indices[i]]++] = i / 3;
+    }
+
+    MeshletData data;
+    data.meshlets.reserve(triangleCount / MESHLET_MAX_TRIANGLES + 1);
+    data.vertices.reserve(vertexCount + vertexCount / 4);
+    data.triangles.reserve(indexCount + 4);
+
+    std::vector<uint8_t> emitted(triangleCount, 0);
+    std::vector<uint8_t> localIndex(vertexCount, UNASSIGNED);
+    std::vector<uint32_t> candidates;
+    Meshlet current{};
+    glm::vec3 centroidSum(0.0f);
+    uint32_t nextSeed = 0;
+    uint32_t remaining = triangleCount;
+
+    auto newVertexCount = [&](uint32_t triangle) {
+        const uint32_t* corners = &indices[triangle * 3];
+        return static_cast<uint32_t>(localIndex[corners[0]] == UNASSIGNED) +
+               static_cast<uint32_t>(localIndex[corners[1]] == UNASSIGNED) +
+               static_cast<uint32_t>(localIndex[corners[2]] == UNASSIGNED);
+    };
+
+    auto flush = [&]() {
+        if (current.triangleCount == 0) {
+            return;
+        }
+        computeBounds(vertexPositions, data, current);
+        for (uint32_t i = 0; i < current.vertexCount; ++i) {
+            localIndex[data.vertices[current.vertexOffset + i]] = UNASSIGNED;
+        }
+        data.meshlets.push_back(current);
+        current = Meshlet{};
+        current.vertexOffset = static_cast<uint32_t>(data.vertices.size());
+        current.triangleOffset = static_cast<uint32_t>(data.triangles.size());
+        candidates.clear();
+        centroidSum = glm::vec3(0.0f);
+    };
+
+    auto emit = [&](uint32_t triangle) {
+        const uint32_t* corners = &indices[triangle * 3];
+        for (uint32_t k = 0; k < 3; ++k) {
+            uint32_t vertex = corners[k];
+            if (localIndex[vertex] == UNASSIGNED) {
+                localIndex[vertex] = static_cast<uint8_t>(current.vertexCount++);
+                data.vertices.push_back(vertex);
+                for (uint32_t a = adjacencyOffsets[vertex]; a < adjacencyOffsets[vertex + 1]; ++a) {
+                    if (!emitted[adjacency[a]]) {
+                        candidates.push_back(adjacency[a]);
+                    }
+                }
+            }
+            data.triangles.push_back(localIndex[vertex]);
+        }
+        emitted[triangle] = 1;
+        ++current.triangleCount;
+        --remaining;
+        centroidSum += triangleCentroid(vertexPositions, corners);
+    };
+
+    while (remaining > 0) {
+        uint32_t best = UINT32_MAX;
+        uint32_t bestNew = 4;
+        float bestDistance = FLT_MAX;
+        glm::vec3 centre = centroidSum / static_cast<float>(std::max(current.triangleCount, 1u));
+
+        // Drops candidates emitted since they were added while scoring the rest
+        size_t live = 0;
+        for (uint32_t candidate : candidates) {
+            if (emitted[candidate]) {
+                continue;
+            }
+            candidates[live++] = candidate;
+            uint32_t added = newVertexCount(candidate);
+            if (current.vertexCount + added > MESHLET_MAX_VERTICES || added > bestNew) {
+                continue;
+            }
+            glm::vec3 offset = triangleCentroid(vertexPositions, &indices[candidate * 3]) - centre;
+            float distance = glm::dot(offset, offset);
+            if (added < bestNew || distance < bestDistance) {
+                best = candidate;
+                bestNew = added;
+                bestDistance = distance;
+            }
+        }
+        candidates.resize(live);
+
+        if (best == UINT32_MAX) {
+            // Neighbours left that no longer fit: the meshlet is full
+            if (!candidates.empty()) {
+                flush();
+                continue;
+            }
+            // The connected piece is used up. Small pieces (foliage cards,
+            // debris) share a meshlet rather than each getting a mostly empty one.
+            if (current.triangleCount >= MESHLET_MAX_TRIANGLES / 4) {
+                flush();
+            }
+            while (emitted[nextSeed]) {
+                ++nextSeed;
+            }
+            best = nextSeed;
+            if (current.vertexCount + newVertexCount(best) > MESHLET_MAX_VERTICES) {
+                flush();
+            }
+        }
+
+        emit(best);
+        if (current.triangleCount == MESHLET_MAX_TRIANGLES) {
+            flush();
+        }
+    }
+    flush();
+
+    // Shaders read the triangle bytes as whole words
+    data.triangles.resize((data.triangles.size() + 3) & ~size_t(3), 0);
+    return data;
+}
+
+} // namespace plaster
@@ -0,0 +1,537 @@
+#include "Graphics/MeshletRenderer.h"
+#include "Graphics/Meshlet.h"
+#include "Graphics/Mesh.h"
+#include "Graphics/VulkanContext.h"
+#include "Graphics/DeletionQueue.h"
+#include "Graphics/DescriptorAllocator.h"
+#include "Graphics/UniformRing.h"
+#include "Graphics/VulkanDebug.h"
+#include "Scene/Bounds.h"
+#include "Core/Metrics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+namespace plaster {
+
+namespace {
+
+const uint32_t GROUP_SIZE = 64;   // meshlets per workgroup, see shaders/meshlet_cull.comp
+
+const uint32_t CULL_FRUSTUM = 1;
+const uint32_t CULL_CONE = 2;
+const uint32_t CULL_OCCLUSION = 4;
+
+// Mirrors MeshletState in shaders/meshlet.glsl (std430)
+struct MeshletState {
+    VkDrawIndexedIndirectCommand draw;
+    uint32_t clusterCount;
+    uint32_t frustumCulled;
+    uint32_t coneCulled;
+    uint32_t occlusionCulled;
+    uint32_t padding[3];
+};
+
+// Mirrors CullConstants in shaders/meshlet_cull.comp (std140)
+struct CullConstants {
+    glm::vec4 frustumPlanes[6];
+    glm::vec4 cameraPosition;
+    glm::mat4 occlusionViewProjection;
+    float pyramidSize[2];
+    uint32_t pyramidLevels;
+    uint32_t flags;
+    uint32_t instanceCount;
+    uint32_t maxClusters;
+    uint32_t maxIndices;
+    uint32_t padding;
+};
+
+struct PyramidConstants {
+    int32_t sourceSize[2];
+    int32_t destinationSize[2];
+};
+
+void bufferBarrier(VkCommandBuffer commandBuffer, VkPipelineStageFlags srcStage, VkAccessFlags srcAccess,
+                   VkPipelineStageFlags dstStage, VkAccessFlags dstAccess) {
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = srcAccess;
+    barrier.dstAccessMask = dstAccess;
+    vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+void imageBarrier(VkCommandBuffer commandBuffer, VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout,
+                  VkPipelineStageFlags srcStage, VkAccessFlags srcAccess,
+                  VkPipelineStageFlags dstStage, VkAccessFlags dstAccess) {
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = srcAccess;
+    barrier.dstAccessMask = dstAccess;
+    barrier.oldLayout = oldLayout;
+    barrier.newLayout = newLayout;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, VK_REMAINING_MIP_LEVELS, 0, 1};
+    vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+VkImageView createView(VkDevice device, VkImage image, uint32_t baseMip, uint32_t levelCount) {
+    VkImageViewCreateInfo viewInfo{};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = image;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = VK_FORMAT_R32_SFLOAT;
+    viewInfo.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, baseMip, levelCount, 0, 1};
+
+    VkImageView view;
+    PLASTER_VK_CHECK(vkCreateImageView(device, &viewInfo, nullptr, &view));
+    return view;
+}
+
+// Level 0 is half the scene depth, the last level a single texel
+VkExtent2D pyramidLevelExtent(VkExtent2D depthExtent, uint32_t level) {
+    return {std::max(1u, (depthExtent.width >> 1) >> level), std::max(1u, (depthExtent.height >> 1) >> level)};
+}
+
+} // namespace
+
+MeshletRenderer::MeshletRenderer(VulkanContext* vulkanContext, PipelineManager* pipelineManager,
+                                 DeletionQueue* deletionQueue, UniformRing* uniformRing, uint32_t framesInFlight,
+                                 uint32_t scenePass, uint32_t vertexCapacity, uint32_t meshletCapacity,
+                                 uint32_t indexCapacity)
+    : m_vulkanContext(vulkanContext), m_pipelineManager(pipelineManager), m_deletionQueue(deletionQueue),
+      m_uniformRing(uniformRing), m_pointSampler(VK_NULL_HANDLE), m_vertexCapacity(vertexCapacity),
+      m_meshletCapacity(meshletCapacity), m_indexCapacity(indexCapacity), m_verticesUsed(0), m_meshletsUsed(0),
+      m_meshletVerticesUsed(0), m_triangleBytesUsed(0), m_material(VK_NULL_HANDLE), m_baseColor(1.0f),
+      m_sceneDepth(VK_NULL_HANDLE), m_pyramidImage(VK_NULL_HANDLE), m_pyramidMemory(VK_NULL_HANDLE),
+      m_pyramidView(VK_NULL_HANDLE), m_pyramidLevels(0), m_pyramidInitialized(false), m_pyramidBuilt(false),
+      m_pyramidViewProjection(1.0f), m_pyramidSourceExtent({0, 0}), m_active(false), m_transitionPyramid(false),
+      m_buildPyramid(false), m_maxMeshletCount(0), m_instanceOffset(0), m_instanceSize(0), m_constantsOffset(0),
+      m_drawMaterial(VK_NULL_HANDLE), m_drawBaseColor(1.0f), m_renderExtent({0, 0}) {
+    ComputePipelineDesc cull;
+    cull.compute.path = "meshlet_cull.comp";
+    cull.compute.stage = ShaderStage::Compute;
+    m_cullPipeline = m_pipelineManager->requestCompute(cull);
+
+    ComputePipelineDesc pyramid;
+    pyramid.compute.path = "depth_pyramid.comp";
+    pyramid.compute.stage = ShaderStage::Compute;
+    m_pyramidPipeline = m_pipelineManager->requestCompute(pyramid);
+
+    GraphicsPipelineDesc draw;
+    draw.vertex.path = "meshlet.vert";
+    draw.vertex.stage = ShaderStage::Vertex;
+    draw.fragment.path = "mesh.frag";
+    draw.fragment.stage = ShaderStage::Fragment;
+    draw.renderPass = scenePass;
+    draw.vertexLayout = VertexLayout::None;
+    draw.cullMode = VK_CULL_MODE_BACK_BIT;
+    draw.depthTest = true;
+    draw.depthWrite = true;
+    m_drawPipeline = m_pipelineManager->requestGraphics(draw);
+
+    // Meshlet vertex references and triangles are sized for full meshlets
+    m_vertices = createStorageBuffer(sizeof(Vertex) * static_cast<VkDeviceSize>(m_vertexCapacity),
+                                     VK_BUFFER_USAGE_TRANSFER_DST_BIT, "Meshlet mesh vertices");
+    m_meshlets = createStorageBuffer(sizeof(Meshlet) * static_cast<VkDeviceSize>(m_meshletCapacity),
+                                     VK_BUFFER_USAGE_TRANSFER_DST_BIT, "Meshlets");
+    m_meshletVertices = createStorageBuffer(sizeof(uint32_t) * MESHLET_MAX_VERTICES *
+                                                static_cast<VkDeviceSize>(m_meshletCapacity),
+                                            VK_BUFFER_USAGE_TRANSFER_DST_BIT, "Meshlet vertex references");
+    m_triangles = createStorageBuffer(3 * MESHLET_MAX_TRIANGLES * static_cast<VkDeviceSize>(m_meshletCapacity),
+                                      VK_BUFFER_USAGE_TRANSFER_DST_BIT, "Meshlet triangles");
+    m_state = createStorageBuffer(sizeof(MeshletState),
+                                  VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+                                      VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                  "Meshlet cull state");
+    // A visible cluster per meshlet at most, so culling never runs out of
+    // slots before the meshlet buffer itself is full
+    m_clusters = createStorageBuffer(sizeof(uint32_t) * 2 * static_cast<VkDeviceSize>(m_meshletCapacity), 0,
+                                     "Visible meshlets");
+    m_indices = createStorageBuffer(sizeof(uint32_t) * static_cast<VkDeviceSize>(m_indexCapacity),
+                                    VK_BUFFER_USAGE_INDEX_BUFFER_BIT, "Meshlet indices");
+
+    VkDevice device = m_vulkanContext->getDevice();
+    m_readbacks.resize(framesInFlight);
+    for (Readback& readback : m_readbacks) {
+        m_vulkanContext->createBuffer(sizeof(MeshletState), VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                      readback.buffer, readback.memory);
+        void* mapped = nullptr;
+        PLASTER_VK_CHECK(vkMapMemory(device, readback.memory, 0, sizeof(MeshletState), 0, &mapped));
+        readback.mapped = mapped;
+    }
+
+    VkSamplerCreateInfo samplerInfo{};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_NEAREST;
+    samplerInfo.minFilter = VK_FILTER_NEAREST;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+    PLASTER_VK_CHECK(vkCreateSampler(device, &samplerInfo, nullptr, &m_pointSampler));
+}
+
+MeshletRenderer::~MeshletRenderer() {
+    releasePyramid();
+    m_deletionQueue->release(m_vertices.buffer, m_vertices.memory);
+    m_deletionQueue->release(m_meshlets.buffer, m_meshlets.memory);
+    m_deletionQueue->release(m_meshletVertices.buffer, m_meshletVertices.memory);
+    m_deletionQueue->release(m_triangles.buffer, m_triangles.memory);
+    m_deletionQueue->release(m_state.buffer, m_state.memory);
+    m_deletionQueue->release(m_clusters.buffer, m_clusters.memory);
+    m_deletionQueue->release(m_indices.buffer, m_indices.memory);
+    for (Readback& readback : m_readbacks) {
+        // Freeing the memory unmaps it
+        m_deletionQueue->release(readback.buffer, readback.memory);
+    }
+    m_deletionQueue->release(m_pointSampler);
+}
+
+MeshletRenderer::StorageBuffer MeshletRenderer::createStorageBuffer(VkDeviceSize size, VkBufferUsageFlags usage,
+                                                                    const char* name) {
+    StorageBuffer result;
+    result.size = size;
+    m_vulkanContext->createBuffer(size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | usage,
+                                  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, result.buffer, result.memory);
+    PLASTER_VK_NAME(m_vulkanContext->getDevice(), VK_OBJECT_TYPE_BUFFER, result.buffer, name);
+    (void)name;   // only debug builds name objects
+    return result;
+}
+
+uint32_t MeshletRenderer::addMesh(uint32_t vertexCount, uint32_t meshletCount, uint32_t meshletVertexCount,
+                                  uint32_t triangleByteCount) {
+    if (vertexCount > m_vertexCapacity - m_verticesUsed) {
+        throw std::runtime_error("Meshlet vertex buffer is full (" + std::to_string(m_vertexCapacity) +
+                                 " vertices)");
+    }
+    if (meshletCount > m_meshletCapacity - m_meshletsUsed ||
+        meshletVertexCount > m_meshletCapacity * MESHLET_MAX_VERTICES - m_meshletVerticesUsed ||
+        triangleByteCount > m_meshletCapacity * 3 * MESHLET_MAX_TRIANGLES - m_triangleBytesUsed) {
+        throw std::runtime_error("Meshlet buffers are full (" + std::to_string(m_meshletCapacity) + " meshlets)");
+    }
+    MeshletMesh mesh;
+    mesh.firstVertex = m_verticesUsed;
+    mesh.firstMeshlet = m_meshletsUsed;
+    mesh.meshletCount = meshletCount;
+    mesh.firstMeshletVertex = m_meshletVerticesUsed;
+    mesh.firstTriangleByte = m_triangleBytesUsed;
+    m_verticesUsed += vertexCount;
+    m_meshletsUsed += meshletCount;
+    m_meshletVerticesUsed += meshletVertexCount;
+    // Keeps every mesh's triangles word aligned, as the shaders read them in words
+    m_triangleBytesUsed += (triangleByteCount + 3) & ~3u;
+    m_meshes.push_back(mesh);
+    return static_cast<uint32_t>(m_meshes.size() - 1);
+}
+
+MeshletRenderer::UploadOffsets MeshletRenderer::getUploadOffsets(uint32_t mesh) const {
+    const MeshletMesh& source = m_meshes[mesh];
+    UploadOffsets offsets;
+    offsets.vertices = source.firstVertex * sizeof(Vertex);
+    offsets.meshlets = source.firstMeshlet * sizeof(Meshlet);
+    offsets.meshletVertices = source.firstMeshletVertex * sizeof(uint32_t);
+    offsets.triangles = source.firstTriangleByte;
+    return offsets;
+}
+
+uint32_t MeshletRenderer::addInstance(uint32_t mesh, const glm::mat4& transform) {
+    const MeshletMesh& source = m_meshes[mesh];
+    Instance instance{};
+    instance.firstMeshlet = source.firstMeshlet;
+    instance.meshletCount = source.meshletCount;
+    instance.firstVertex = source.firstVertex;
+    instance.firstMeshletVertex = source.firstMeshletVertex;
+    instance.firstTriangleByte = source.firstTriangleByte;
+    m_instances.push_back(instance);
+    uint32_t id = static_cast<uint32_t>(m_instances.size() - 1);
+    setTransform(id, transform);
+    return id;
+}
+
+void MeshletRenderer::setTransform(uint32_t instance, const glm::mat4& transform) {
+    Instance& target = m_instances[instance];
+    target.model = transform;
+
+    glm::vec3 scales(glm::length(glm::vec3(transform[0])), glm::length(glm::vec3(transform[1])),
+                     glm::length(glm::vec3(transform[2])));
+    float largest = std::max(scales.x, std::max(scales.y, scales.z));
+    float smallest = std::min(scales.x, std::min(scales.y, scales.z));
+    target.scale = largest;
+    // Non-uniform scale bends normals away from the cone, and mirroring flips
+    // which side of a triangle is its front
+    bool uniform = largest - smallest <= largest * 1e-3f;
+    target.coneCulling = uniform && glm::determinant(glm::mat3(transform)) > 0.0f ? 1 : 0;
+}
+
+void MeshletRenderer::setMaterial(VkDescriptorSet descriptorSet, const glm::vec4& baseColor) {
+    m_material = descriptorSet;
+    m_baseColor = baseColor;
+}
+
+void MeshletRenderer::releasePyramid() {
+    for (VkImageView view : m_pyramidLevelViews) {
+        m_deletionQueue->release(view);
+    }
+    m_pyramidLevelViews.clear();
+    m_deletionQueue->release(m_pyramidImage, m_pyramidMemory, m_pyramidView);
+    m_pyramidImage = VK_NULL_HANDLE;
+    m_pyramidView = VK_NULL_HANDLE;
+}
+
+void MeshletRenderer::resize(VkImageView sceneDepth, VkExtent2D extent) {
+    releasePyramid();
+    VkDevice device = m_vulkanContext->getDevice();
+    m_sceneDepth = sceneDepth;
+
+    VkExtent2D baseExtent = pyramidLevelExtent(extent, 0);
+    m_pyramidLevels = 1;
+    while (std::max(baseExtent.width, baseExtent.height) >> m_pyramidLevels) {
+        ++m_pyramidLevels;
+    }
+
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.format = VK_FORMAT_R32_SFLOAT;
+    imageInfo.extent = {baseExtent.width, baseExtent.height, 1};
+    imageInfo.mipLevels = m_pyramidLevels;
+    imageInfo.arrayLayers = 1;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    m_vulkanContext->createImage(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_pyramidImage, m_pyramidMemory);
+    PLASTER_VK_NAME(device, VK_OBJECT_TYPE_IMAGE, m_pyramidImage, "Depth pyramid");
+
+    m_pyramidView = createView(device, m_pyramidImage, 0, m_pyramidLevels);
+    for (uint32_t level = 0; level < m_pyramidLevels; ++level) {
+        m_pyramidLevelViews.push_back(createView(device, m_pyramidImage, level, 1));
+    }
+    m_pyramidInitialized = false;
+    m_pyramidBuilt = false;
+}
+
+void MeshletRenderer::update(uint32_t frameIndex, const glm::mat4& viewProjection, const glm::vec3& cameraPosition,
+                             VkExtent2D renderExtent) {
+    // The fence of this frame index has been waited on, so its copy has landed
+    Readback& readback = m_readbacks[frameIndex];
+    if (readback.written) {
+        MeshletState state;
+        std::memcpy(&state, readback.mapped, sizeof(state));
+        m_stats.visibleClusters = state.clusterCount;
+        m_stats.visibleTriangles = state.draw.indexCount / 3;
+        m_stats.frustumCulled = state.frustumCulled;
+        m_stats.coneCulled = state.coneCulled;
+        m_stats.occlusionCulled = state.occlusionCulled;
+        readback.written = false;
+
+        static Gauge& visibleClusters = Metrics::gauge("meshlets.visible_clusters");
+        static Gauge& visibleTriangles = Metrics::gauge("meshlets.visible_triangles");
+        static Gauge& occlusionCulled = Metrics::gauge("meshlets.occlusion_culled");
+        visibleClusters.set(static_cast<double>(m_stats.visibleClusters));
+        visibleTriangles.set(static_cast<double>(m_stats.visibleTriangles));
+        occlusionCulled.set(static_cast<double>(m_stats.occlusionCulled));
+    }
+
+    m_active = !m_instances.empty() && m_material != VK_NULL_HANDLE && m_pyramidImage != VK_NULL_HANDLE &&
+               m_pipelineManager->isReady(m_cullPipeline) && m_pipelineManager->isReady(m_drawPipeline) &&
+               m_pipelineManager->isReady(m_pyramidPipeline);
+    if (!m_active) {
+        // Whatever was built is about to go stale
+        m_pyramidBuilt = false;
+        return;
+    }
+
+    CullConstants constants{};
+    Frustum frustum = Frustum::fromViewProjection(viewProjection);
+    std::copy(std::begin(frustum.planes), std::end(frustum.planes), constants.frustumPlanes);
+    constants.cameraPosition = glm::vec4(cameraPosition, 1.0f);
+    constants.occlusionViewProjection = m_pyramidViewProjection;
+    VkExtent2D pyramidExtent = pyramidLevelExtent(m_pyramidSourceExtent, 0);
+    constants.pyramidSize[0] = static_cast<float>(pyramidExtent.width);
+    constants.pyramidSize[1] = static_cast<float>(pyramidExtent.height);
+    constants.pyramidLevels = m_pyramidLevels;
+    constants.flags = (m_settings.frustum ? CULL_FRUSTUM : 0) | (m_settings.cone ? CULL_CONE : 0) |
+                      (m_settings.occlusion && m_pyramidBuilt ? CULL_OCCLUSION : 0);
+    constants.instanceCount = static_cast<uint32_t>(m_instances.size());
+    constants.maxClusters = m_meshletCapacity;
+    constants.maxIndices = m_indexCapacity;
+    m_constantsOffset = m_uniformRing->push(constants);
+
+    m_instanceSize = static_cast<uint32_t>(m_instances.size() * sizeof(Instance));
+    UniformAllocation instances = m_uniformRing->allocate(m_instanceSize);
+    std::memcpy(instances.data, m_instances.data(), m_instanceSize);
+    m_instanceOffset = instances.offset;
+
+    m_maxMeshletCount = 0;
+    for (const Instance& instance : m_instances) {
+        m_maxMeshletCount = std::max(m_maxMeshletCount, instance.meshletCount);
+    }
+    m_drawMaterial = m_material;
+    m_drawBaseColor = m_baseColor;
+    m_renderExtent = renderExtent;
+
+    // This frame's pyramid is what the next frame tests against
+    m_transitionPyramid = !m_pyramidInitialized;
+    m_pyramidInitialized = true;
+    m_buildPyramid = m_settings.occlusion;
+    m_pyramidBuilt = m_buildPyramid;
+    m_pyramidViewProjection = viewProjection;
+    m_pyramidSourceExtent = renderExtent;
+    readback.written = true;
+}
+
+void MeshletRenderer::record(VkCommandBuffer commandBuffer, uint32_t frameIndex,
+                             DescriptorAllocator* descriptorAllocator) {
+    if (!m_active) {
+        return;
+    }
+    PLASTER_VK_LABEL(commandBuffer, "Meshlet culling");
+
+    if (m_transitionPyramid) {
+        // Never built for these targets; the culling descriptor still names it
+        imageBarrier(commandBuffer, m_pyramidImage, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
+                     VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0);
+    }
+
+    // The previous frame's draw and readback copy still read what this rewrites
+    bufferBarrier(commandBuffer,
+                  VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT |
+                      VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+                  0, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0);
+
+    MeshletState reset{};
+    reset.draw.instanceCount = 1;
+    vkCmdUpdateBuffer(commandBuffer, m_state.buffer, 0, sizeof(reset), &reset);
+    bufferBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+                  VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+    VkBuffer ring = m_uniformRing->getBuffer();
+    VkDescriptorSet set = descriptorAllocator->allocate(
+        m_pipelineManager->getSetLayout(m_cullPipeline, 0),
+        {DescriptorBinding::buffer(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, ring, 0, sizeof(CullConstants)),
+         DescriptorBinding::buffer(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, ring, m_instanceOffset, m_instanceSize),
+         DescriptorBinding::buffer(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, m_meshlets.buffer, 0, m_meshlets.size),
+         DescriptorBinding::buffer(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, m_triangles.buffer, 0, m_triangles.size),
+         DescriptorBinding::buffer(4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, m_state.buffer, 0, m_state.size),
+         DescriptorBinding::buffer(5, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, m_clusters.buffer, 0, m_clusters.size),
+         DescriptorBinding::buffer(6, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, m_indices.buffer, 0, m_indices.size),
+         DescriptorBinding::image(7, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, m_pyramidView, m_pointSampler,
+                                  VK_IMAGE_LAYOUT_GENERAL)});
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineManager->getPipeline(m_cullPipeline));
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                            m_pipelineManager->getLayout(m_cullPipeline), 0, 1, &set, 1, &m_constantsOffset);
+    // One row of groups per instance; rows of meshes with fewer meshlets finish early
+    vkCmdDispatch(commandBuffer, (m_maxMeshletCount + GROUP_SIZE - 1) / GROUP_SIZE,
+                  static_cast<uint32_t>(m_instances.size()), 1);
+
+    bufferBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+                  VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT |
+                      VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+                  VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_SHADER_READ_BIT |
+                      VK_ACCESS_TRANSFER_READ_BIT);
+
+    // Counters for getStats(), read once this frame's fence comes around again
+    VkBufferCopy copy{};
+    copy.size = sizeof(MeshletState);
+    vkCmdCopyBuffer(commandBuffer, m_state.buffer, m_readbacks[frameIndex].buffer, 1, &copy);
+    bufferBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+                  VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_READ_BIT);
+}
+
+void MeshletRenderer::draw(VkCommandBuffer commandBuffer, DescriptorAllocator* descriptorAllocator,
+                           VkDescriptorSet frameSet, uint32_t frameOffset, VkDescriptorSet lightSet,
+                           uint32_t lightOffset) {
+    if (!m_active) {
+        return;
+    }
+    PLASTER_VK_LABEL(commandBuffer, "Meshlets");
+
+    VkPipelineLayout layout = m_pipelineManager->getLayout(m_drawPipeline);
+    VkDescriptorSet sets[] = {
+        frameSet,
+        m_drawMaterial,
+        descriptorAllocator->allocate(
+            m_pipelineManager->getSetLayout(m_drawPipeline, CLUSTER_SET),
+            {DescriptorBinding::buffer(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, m_uniformRing->getBuffer(),
+                                       m_instanceOffset, m_instanceSize),
+             DescriptorBinding::buffer(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, m_meshlets.buffer, 0, m_meshlets.size),
+             DescriptorBinding::buffer(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, m_meshletVertices.buffer, 0,
+                                       m_meshletVertices.size),
+             DescriptorBinding::buffer(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, m_vertices.buffer, 0, m_vertices.size),
+             DescriptorBinding::buffer(4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, m_clusters.buffer, 0,
+                                       m_clusters.size)}),
+        lightSet,
+    };
+    uint32_t dynamicOffsets[] = {frameOffset, lightOffset};
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineManager->getPipeline(m_drawPipeline));
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 0, 4, sets, 2, dynamicOffsets);
+    VkPushConstantRange range = m_pipelineManager->getPushConstantRange(m_drawPipeline);
+    if (range.size >= sizeof(glm::vec4)) {
+        vkCmdPushConstants(commandBuffer, layout, range.stageFlags, 0, sizeof(glm::vec4), &m_drawBaseColor);
+    }
+    vkCmdBindIndexBuffer(commandBuffer, m_indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+    vkCmdDrawIndexedIndirect(commandBuffer, m_state.buffer, offsetof(MeshletState, draw), 1,
+                             sizeof(VkDrawIndexedIndirectCommand));
+}
+
+void MeshletRenderer::recordDepthPyramid(VkCommandBuffer commandBuffer, DescriptorAllocator* descriptorAllocator) {
+    if (!m_active || !m_buildPyramid) {
+        return;
+    }
+    PLASTER_VK_LABEL(commandBuffer, "Depth pyramid");
+
+    // Fully rewritten; only this frame's culling read the old contents
+    imageBarrier(commandBuffer, m_pyramidImage, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
+                 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                 VK_ACCESS_SHADER_WRITE_BIT);
+
+    VkPipelineLayout layout = m_pipelineManager->getLayout(m_pyramidPipeline);
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                      m_pipelineManager->getPipeline(m_pyramidPipeline));
+
+    VkExtent2D sourceExtent = m_renderExtent;
+    for (uint32_t level = 0; level < m_pyramidLevels; ++level) {
+        VkExtent2D destinationExtent = pyramidLevelExtent(m_renderExtent, level);
+        VkDescriptorSet set = descriptorAllocator->allocate(
+            m_pipelineManager->getSetLayout(m_pyramidPipeline, 0),
+            {level == 0 ? DescriptorBinding::image(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, m_sceneDepth,
+                                                   m_pointSampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
+                        : DescriptorBinding::image(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                                                   m_pyramidLevelViews[level - 1], m_pointSampler,
+                                                   VK_IMAGE_LAYOUT_GENERAL),
+             DescriptorBinding::image(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, m_pyramidLevelViews[level], VK_NULL_HANDLE,
+                                      VK_IMAGE_LAYOUT_GENERAL)});
+
+        PyramidConstants constants;
+        constants.sourceSize[0] = static_cast<int32_t>(sourceExtent.width);
+        constants.sourceSize[1] = static_cast<int32_t>(sourceExtent.height);
+        constants.destinationSize[0] = static_cast<int32_t>(destinationExtent.width);
+        constants.destinationSize[1] = static_cast<int32_t>(destinationExtent.height);
+
+        if (level > 0) {
+            bufferBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+                          VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+        }
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, layout, 0, 1, &set, 0, nullptr);
+        vkCmdPushConstants(commandBuffer, layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+        vkCmdDispatch(commandBuffer, (destinationExtent.width + 7) / 8, (destinationExtent.height + 7) / 8, 1);
+        sourceExtent = destinationExtent;
+    }
+
+    // For the next frame's culling
+    bufferBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+                  VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+}
+
+} // namespace plaster
@@ -0,0 +1,339 @@
+#include "Graphics/ParticleSystem.h"
+#include "Graphics/VulkanContext.h"
+#include "Graphics/DeletionQueue.h"
+#include "Graphics/VulkanDebug.h"
+#include "Core/Metrics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace plaster {
+
+namespace {
+
+// Mirrors ParticleState in shaders/particle.glsl (std430)
+struct ParticleState {
+    uint32_t aliveCount[2];
+    uint32_t deadCount;
+    uint32_t emitCount;
+    uint32_t sortCount;
+    uint32_t drawCount;
+    uint32_t padding[2];
+    uint32_t emitArgs[4];
+    uint32_t updateArgs[4];
+    uint32_t sortArgs[4];
+    uint32_t drawArgs[4];
+};
+
+// Mirrors Particle in shaders/particle.glsl
+const VkDeviceSize PARTICLE_SIZE = 32;
+
+struct SimulationConstants {
+    float emitterPosition[4];
+    float emitterDirection[4];
+    float gravity[4];
+    float speed[2];
+    float lifetime[2];
+    uint32_t emitCount;
+    uint32_t seed;
+    uint32_t current;
+    uint32_t capacity;
+    float deltaTime;
+};
+
+struct SortConstants {
+    uint32_t k;
+    uint32_t j;
+};
+
+struct DrawConstants {
+    float startColor[4];
+    float endColor[4];
+    float size;
+};
+
+// A hitch would otherwise emit its whole duration's worth in one spot and
+// integrate it in one step
+const float MAX_TIME_STEP = 0.1f;
+
+void bufferBarrier(VkCommandBuffer commandBuffer, VkPipelineStageFlags srcStage, VkAccessFlags srcAccess,
+                   VkPipelineStageFlags dstStage, VkAccessFlags dstAccess) {
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = srcAccess;
+    barrier.dstAccessMask = dstAccess;
+    vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+// Between two passes, the second of which may also take its size from the state buffer
+void computeBarrier(VkCommandBuffer commandBuffer) {
+    bufferBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+                  VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+                  VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT);
+}
+
+void setVector(float* destination, const glm::vec3& value, float w) {
+    destination[0] = value.x;
+    destination[1] = value.y;
+    destination[2] = value.z;
+    destination[3] = w;
+}
+
+void setColor(float* destination, const glm::vec4& value) {
+    destination[0] = value.x;
+    destination[1] = value.y;
+    destination[2] = value.z;
+    destination[3] = value.w;
+}
+
+// minimum has to be a power of two
+uint32_t nextPowerOfTwo(uint32_t value, uint32_t minimum) {
+    uint32_t result = minimum;
+    while (result < value) {
+        result <<= 1;
+    }
+    return result;
+}
+
+} // namespace
+
+ParticleSystem::ParticleSystem(VulkanContext* vulkanContext, PipelineManager* pipelineManager,
+                               DeletionQueue* deletionQueue, uint32_t scenePass, uint32_t capacity)
+    : m_vulkanContext(vulkanContext), m_pipelineManager(pipelineManager), m_deletionQueue(deletionQueue),
+      m_capacity(std::max(capacity, 1u)), m_sortCapacity(nextPowerOfTwo(m_capacity, SORT_BLOCK)),
+      m_active(false), m_reset(false), m_resetPending(true), m_current(0), m_emitCount(0), m_seed(0),
+      m_deltaTime(0.0f), m_emitRemainder(0.0f) {
+    auto compute = [this](const char* path, std::vector<std::string> defines) {
+        ComputePipelineDesc desc;
+        desc.compute.path = path;
+        desc.compute.stage = ShaderStage::Compute;
+        desc.compute.defines = std::move(defines);
+        return m_pipelineManager->requestCompute(desc);
+    };
+    m_resetPipeline = compute("particle_reset.comp", {});
+    m_beginPipeline = compute("particle_args.comp", {});
+    m_emitPipeline = compute("particle_emit.comp", {});
+    m_updatePipeline = compute("particle_update.comp", {});
+    m_finishPipeline = compute("particle_args.comp", {"FINISH"});
+    m_sortLocalPipeline = compute("particle_sort.comp", {"LOCAL_SORT"});
+    m_sortStepPipeline = compute("particle_sort.comp", {});
+    m_sortMergePipeline = compute("particle_sort.comp", {"LOCAL_MERGE"});
+
+    GraphicsPipelineDesc draw;
+    draw.vertex.path = "particle.vert";
+    draw.vertex.stage = ShaderStage::Vertex;
+    draw.fragment.path = "particle.frag";
+    draw.fragment.stage = ShaderStage::Fragment;
+    draw.renderPass = scenePass;
+    draw.vertexLayout = VertexLayout::None;
+    draw.cullMode = VK_CULL_MODE_NONE;
+    draw.blend = BlendMode::Alpha;
+    draw.depthTest = true;
+    draw.depthWrite = false;
+    m_drawPipeline = m_pipelineManager->requestGraphics(draw);
+
+    m_particles = createStorageBuffer(PARTICLE_SIZE * m_capacity, 0, "Particles");
+    m_deadList = createStorageBuffer(sizeof(uint32_t) * m_capacity, 0, "Particle dead list");
+    m_aliveLists = createStorageBuffer(sizeof(uint32_t) * m_capacity * 2, 0, "Particle alive lists");
+    m_state = createStorageBuffer(sizeof(ParticleState), VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, "Particle state");
+    m_sortKeys = createStorageBuffer(sizeof(uint32_t) * 2 * m_sortCapacity, 0, "Particle sort keys");
+}
+
+ParticleSystem::~ParticleSystem() {
+    for (StorageBuffer* buffer : {&m_particles, &m_deadList, &m_aliveLists, &m_state, &m_sortKeys}) {
+        m_deletionQueue->release(buffer->buffer, buffer->memory);
+    }
+}
+
+ParticleSystem::StorageBuffer ParticleSystem::createStorageBuffer(VkDeviceSize size, VkBufferUsageFlags usage,
+                                                                  const char* name) {
+    StorageBuffer result;
+    result.size = size;
+    m_vulkanContext->createBuffer(size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | usage,
+                                  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, result.buffer, result.memory);
+    PLASTER_VK_NAME(m_vulkanContext->getDevice(), VK_OBJECT_TYPE_BUFFER, result.buffer, name);
+    (void)name;   // only debug builds name objects
+    return result;
+}
+
+bool ParticleSystem::isReady() const {
+    for (PipelineHandle pipeline : {m_resetPipeline, m_beginPipeline, m_emitPipeline, m_updatePipeline,
+                                    m_finishPipeline, m_sortLocalPipeline, m_sortStepPipeline, m_sortMergePipeline,
+                                    m_drawPipeline}) {
+        if (!m_pipelineManager->isReady(pipeline)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void ParticleSystem::update(float deltaTime) {
+    m_active = m_settings.enabled && isReady();
+    if (!m_active) {
+        return;
+    }
+
+    m_deltaTime = std::clamp(deltaTime, 0.0f, MAX_TIME_STEP);
+    float emit = m_settings.rate * m_deltaTime + m_emitRemainder;
+    m_emitCount = static_cast<uint32_t>(std::min(emit, static_cast<float>(m_capacity)));
+    m_emitRemainder = std::min(emit - m_emitCount, 1.0f);
+
+    m_reset = m_resetPending;
+    m_resetPending = false;
+    m_current ^= 1;
+    ++m_seed;
+
+    // What the dead list can't cover is dropped on the GPU, so this is an upper bound
+    static Counter& emitted = Metrics::counter("particles.emit_requested");
+    emitted.add(m_emitCount);
+}
+
+void ParticleSystem::bind(VkCommandBuffer commandBuffer, DescriptorAllocator* descriptorAllocator,
+                          PipelineHandle pipeline, std::initializer_list<DescriptorBinding> bindings,
+                          const void* pushConstants, uint32_t pushSize) {
+    VkPipelineLayout layout = m_pipelineManager->getLayout(pipeline);
+    VkDescriptorSet set = descriptorAllocator->allocate(m_pipelineManager->getSetLayout(pipeline, PARTICLE_SET),
+                                                        bindings);
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineManager->getPipeline(pipeline));
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, layout, PARTICLE_SET, 1, &set, 0,
+                            nullptr);
+    if (pushSize > 0) {
+        vkCmdPushConstants(commandBuffer, layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, pushSize, pushConstants);
+    }
+}
+
+void ParticleSystem::record(VkCommandBuffer commandBuffer, DescriptorAllocator* descriptorAllocator,
+                            VkDescriptorSet frameSet, uint32_t frameOffset) {
+    if (!m_active) {
+        return;
+    }
+    PLASTER_VK_LABEL(commandBuffer, "Particles");
+
+    SimulationConstants constants{};
+    setVector(constants.emitterPosition, m_settings.position, m_settings.radius);
+    setVector(constants.emitterDirection, m_settings.direction, std::cos(m_settings.spread));
+    setVector(constants.gravity, m_settings.gravity, m_settings.drag);
+    constants.speed[0] = m_settings.minSpeed;
+    constants.speed[1] = m_settings.maxSpeed;
+    constants.lifetime[0] = m_settings.minLifetime;
+    constants.lifetime[1] = m_settings.maxLifetime;
+    constants.emitCount = m_emitCount;
+    constants.seed = m_seed;
+    constants.current = m_current;
+    constants.capacity = m_capacity;
+    constants.deltaTime = m_deltaTime;
+
+    auto storage = [](uint32_t binding, const StorageBuffer& buffer) {
+        return DescriptorBinding::buffer(binding, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, buffer.buffer, 0, buffer.size);
+    };
+
+    // The previous frame's sort and draw read everything this frame rewrites
+    bufferBarrier(commandBuffer,
+                  VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT |
+                      VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+                  VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                  VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+    if (m_reset) {
+        bind(commandBuffer, descriptorAllocator, m_resetPipeline, {storage(1, m_deadList), storage(3, m_state)},
+             &constants, sizeof(constants));
+        vkCmdDispatch(commandBuffer, (m_capacity + 63) / 64, 1, 1);
+        computeBarrier(commandBuffer);
+    }
+
+    bind(commandBuffer, descriptorAllocator, m_beginPipeline, {storage(3, m_state)}, &constants, sizeof(constants));
+    vkCmdDispatch(commandBuffer, 1, 1, 1);
+    computeBarrier(commandBuffer);
+
+    bind(commandBuffer, descriptorAllocator, m_emitPipeline,
+         {storage(0, m_particles), storage(1, m_deadList), storage(2, m_aliveLists), storage(3, m_state)},
+         &constants, sizeof(constants));
+    vkCmdDispatchIndirect(commandBuffer, m_state.buffer, offsetof(ParticleState, emitArgs));
+    computeBarrier(commandBuffer);
+
+    bind(commandBuffer, descriptorAllocator, m_updatePipeline,
+         {storage(0, m_particles), storage(1, m_deadList), storage(2, m_aliveLists), storage(3, m_state),
+          storage(4, m_sortKeys)},
+         &constants, sizeof(constants));
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                            m_pipelineManager->getLayout(m_updatePipeline), 0, 1, &frameSet, 1, &frameOffset);
+    vkCmdDispatchIndirect(commandBuffer, m_state.buffer, offsetof(ParticleState, updateArgs));
+    computeBarrier(commandBuffer);
+
+    bind(commandBuffer, descriptorAllocator, m_finishPipeline, {storage(3, m_state)}, &constants, sizeof(constants));
+    vkCmdDispatch(commandBuffer, 1, 1, 1);
+    computeBarrier(commandBuffer);
+
+    // The network is recorded for the whole capacity; merges longer than this
+    // frame's sortCount return straight away, and every pass only launches
+    // enough workgroups for sortCount
+    {
+        PLASTER_VK_LABEL(commandBuffer, "Particle sort");
+        VkDeviceSize sortArgs = offsetof(ParticleState, sortArgs);
+        bind(commandBuffer, descriptorAllocator, m_sortLocalPipeline, {storage(3, m_state), storage(4, m_sortKeys)},
+             nullptr, 0);
+        vkCmdDispatchIndirect(commandBuffer, m_state.buffer, sortArgs);
+
+        // Step and merge declare the same resources and push constants, so they
+        // share a pipeline layout and one set stays bound across the switches
+        bind(commandBuffer, descriptorAllocator, m_sortStepPipeline, {storage(3, m_state), storage(4, m_sortKeys)},
+             nullptr, 0);
+        VkPipelineLayout sortLayout = m_pipelineManager->getLayout(m_sortStepPipeline);
+        VkPipeline step = m_pipelineManager->getPipeline(m_sortStepPipeline);
+        VkPipeline merge = m_pipelineManager->getPipeline(m_sortMergePipeline);
+        for (uint32_t k = SORT_BLOCK * 2; k <= m_sortCapacity; k <<= 1) {
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, step);
+            for (uint32_t j = k / 2; j >= SORT_BLOCK; j >>= 1) {
+                computeBarrier(commandBuffer);
+                SortConstants sort = {k, j};
+                vkCmdPushConstants(commandBuffer, sortLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(sort), &sort);
+                vkCmdDispatchIndirect(commandBuffer, m_state.buffer, sortArgs);
+            }
+
+            computeBarrier(commandBuffer);
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, merge);
+            SortConstants sort = {k, 0};
+            vkCmdPushConstants(commandBuffer, sortLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(sort), &sort);
+            vkCmdDispatchIndirect(commandBuffer, m_state.buffer, sortArgs);
+        }
+    }
+
+    bufferBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+                  VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+                  VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT);
+}
+
+void ParticleSystem::draw(VkCommandBuffer commandBuffer, DescriptorAllocator* descriptorAllocator,
+                          VkDescriptorSet frameSet, uint32_t frameOffset) {
+    if (!m_active) {
+        return;
+    }
+    PLASTER_VK_LABEL(commandBuffer, "Particles");
+
+    VkPipelineLayout layout = m_pipelineManager->getLayout(m_drawPipeline);
+    VkDescriptorSet sets[] = {
+        frameSet,
+        descriptorAllocator->allocate(
+            m_pipelineManager->getSetLayout(m_drawPipeline, PARTICLE_SET),
+            {DescriptorBinding::buffer(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, m_particles.buffer, 0, m_particles.size),
+             DescriptorBinding::buffer(4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, m_sortKeys.buffer, 0,
+                                       m_sortKeys.size)}),
+    };
+
+    DrawConstants constants{};
+    setColor(constants.startColor, m_settings.startColor);
+    setColor(constants.endColor, m_settings.endColor);
+    constants.size = m_settings.size;
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineManager->getPipeline(m_drawPipeline));
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 0, 2, sets, 1, &frameOffset);
+    vkCmdPushConstants(commandBuffer, layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(constants), &constants);
+    vkCmdDrawIndirect(commandBuffer, m_state.buffer, offsetof(ParticleState, drawArgs), 1,
+                      sizeof(VkDrawIndirectCommand));
+}
+
+} // namespace plaster
@@ -0,0 +1,651 @@
+#include "Graphics/PipelineManager.h"
+#include "Graphics/VulkanContext.h"
+#include "Graphics/DeletionQueue.h"
+#include "Graphics/Mesh.h"
+#include "Graphics/VulkanDebug.h"
+#include "Core/JobSystem.h"
+#include "Core/Hash.h"
+#include "Core/Log.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace plaster {
+
+namespace {
+
+const char* PIPELINE_CACHE_FILE = "pipelines.bin";
+const char* PRECOMPILE_LIST_FILE = "pipelines.txt";
+
+// "path;stage;entry;DEFINE,DEFINE=1"
+std::string serializeShader(const ShaderDesc& desc) {
+    std::string result = desc.path + ";" + std::to_string(static_cast<int>(desc.stage)) + ";" + desc.entryPoint + ";";
+    for (size_t i = 0; i < desc.defines.size(); ++i) {
+        result += (i ? "," : "") + desc.defines[i];
+    }
+    return result;
+}
+
+bool parseShader(const std::string& text, ShaderDesc& desc) {
+    std::istringstream stream(text);
+    std::string stage, defines;
+    if (!std::getline(stream, desc.path, ';') || !std::getline(stream, stage, ';') ||
+        !std::getline(stream, desc.entryPoint, ';')) {
+        return false;
+    }
+    desc.stage = static_cast<ShaderStage>(std::stoi(stage));
+    std::getline(stream, defines);
+
+    std::istringstream defineStream(defines);
+    std::string define;
+    while (std::getline(defineStream, define, ',')) {
+        desc.defines.push_back(define);
+    }
+    return true;
+}
+
+// One line of the precompile list; also the identity used to dedupe requests
+std::string serialize(const GraphicsPipelineDesc& desc) {
+    std::ostringstream stream;
+    stream << "G\t" << desc.renderPass << '\t' << desc.subpass << '\t' << static_cast<uint32_t>(desc.vertexLayout)
+           << '\t' << desc.topology << '\t' << desc.cullMode << '\t' << static_cast<uint32_t>(desc.blend) << '\t'
+           << desc.depthTest << '\t' << desc.depthWrite << '\t' << serializeShader(desc.vertex) << '\t'
+           << serializeShader(desc.fragment);
+    return stream.str();
+}
+
+std::string serialize(const ComputePipelineDesc& desc) {
+    return "C\t" + serializeShader(desc.compute);
+}
+
+bool parse(const std::string& line, GraphicsPipelineDesc& desc) {
+    std::istringstream stream(line);
+    std::string tag, vertex, fragment;
+    uint32_t layout, topology, cull, blend;
+    stream >> tag >> desc.renderPass >> desc.subpass >> layout >> topology >> cull >> blend >> desc.depthTest >>
+        desc.depthWrite >> vertex >> fragment;
+    if (!stream || tag != "G") {
+        return false;
+    }
+    desc.vertexLayout = static_cast<VertexLayout>(layout);
+    desc.topology = static_cast<VkPrimitiveTopology>(topology);
+    desc.cullMode = cull;
+    desc.blend = static_cast<BlendMode>(blend);
+    return parseShader(vertex, desc.vertex) && parseShader(fragment, desc.fragment);
+}
+
+bool parse(const std::string& line, ComputePipelineDesc& desc) {
+    std::istringstream stream(line);
+    std::string tag, compute;
+    stream >> tag >> compute;
+    return stream && tag == "C" && parseShader(compute, desc.compute);
+}
+
+} // namespace
+
+PipelineManager::PipelineManager(VulkanContext* vulkanContext, JobSystem* jobSystem, ShaderCache* shaderCache,
+                                 DeletionQueue* deletionQueue, const std::string& cacheDirectory)
+    : m_vulkanContext(vulkanContext), m_jobSystem(jobSystem), m_shaderCache(shaderCache),
+      m_deletionQueue(deletionQueue), m_cacheDirectory(cacheDirectory),
+      m_pipelineCache(VK_NULL_HANDLE), m_pendingJobs(0) {
+    loadPipelineCache();
+    loadPrecompileList();
+
+    m_shaderCache->setReloadCallback([this](const std::vector<ShaderHandle>& shaders) {
+        onShadersReloaded(shaders);
+    });
+}
+
+PipelineManager::~PipelineManager() {
+    waitIdle();
+    m_shaderCache->setReloadCallback(nullptr);
+
+    savePipelineCache();
+    savePrecompileList();
+
+    VkDevice device = m_vulkanContext->getDevice();
+    for (auto& pipeline : m_pipelines) {
+        vkDestroyPipeline(device, pipeline->pipeline.load(), nullptr);
+        vkDestroyPipeline(device, pipeline->replacement.load(), nullptr);
+    }
+    for (const auto& entry : m_renderPasses) {
+        vkDestroyPipeline(device, entry.second.fallback, nullptr);
+    }
+    for (const auto& entry : m_pipelineLayoutCache) {
+        vkDestroyPipelineLayout(device, entry.second, nullptr);
+    }
+    for (const auto& entry : m_setLayoutCache) {
+        vkDestroyDescriptorSetLayout(device, entry.second, nullptr);
+    }
+    vkDestroyPipelineCache(device, m_pipelineCache, nullptr);
+}
+
+void PipelineManager::registerRenderPass(uint32_t id, VkRenderPass renderPass, uint32_t colorAttachmentCount) {
+    RenderPass& pass = m_renderPasses[id];
+    pass.renderPass = renderPass;
+    pass.colorAttachmentCount = colorAttachmentCount;
+    pass.colorFormats.clear();
+    pass.depthFormat = VK_FORMAT_UNDEFINED;
+    buildFallback(id, pass);
+}
+
+void PipelineManager::registerRenderingFormats(uint32_t id, const std::vector<VkFormat>& colorFormats,
+                                               VkFormat depthFormat) {
+    RenderPass& pass = m_renderPasses[id];
+    pass.renderPass = VK_NULL_HANDLE;
+    pass.colorAttachmentCount = 0;
+    pass.colorFormats = colorFormats;
+    pass.depthFormat = depthFormat;
+    buildFallback(id, pass);
+}
+
+void PipelineManager::buildFallback(uint32_t id, RenderPass& pass) {
+    // The fallback only needs the mesh layout and the frame constants,
+    // so it is compatible with every material's vertex input
+    GraphicsPipelineDesc desc;
+    desc.vertex.path = "fallback.vert";
+    desc.vertex.stage = ShaderStage::Vertex;
+    desc.fragment.path = "fallback.frag";
+    desc.fragment.stage = ShaderStage::Fragment;
+    desc.renderPass = id;
+    desc.depthTest = true;
+    desc.depthWrite = true;
+
+    ShaderHandle vertex = m_shaderCache->load(desc.vertex);
+    ShaderHandle fragment = m_shaderCache->load(desc.fragment);
+
+    std::vector<VkDescriptorSetLayout> setLayouts;
+    buildLayout({&m_shaderCache->getReflection(vertex), &m_shaderCache->getReflection(fragment)},
+                pass.fallbackLayout, setLayouts);
+
+    // Frames in flight may still be drawing with the old one
+    m_deletionQueue->release(pass.fallback);
+    pass.fallback = createGraphics(desc, pass, m_shaderCache->getModule(vertex),
+                                   m_shaderCache->getModule(fragment), pass.fallbackLayout);
+}
+
+void PipelineManager::warmUp() {
+    for (const auto& line : m_precompileList) {
+        // Shaders may have been renamed or removed since the list was written
+        try {
+            GraphicsPipelineDesc graphics;
+            ComputePipelineDesc compute;
+            if (parse(line, graphics)) {
+                if (m_renderPasses.count(graphics.renderPass)) {
+                    requestGraphics(graphics);
+                }
+            } else if (parse(line, compute)) {
+                requestCompute(compute);
+            }
+        } catch (const std::exception& e) {
+            logWarning("pipelines", std::string("Skipping precompiled pipeline: ") + e.what());
+        }
+    }
+}
+
+PipelineHandle PipelineManager::requestGraphics(const GraphicsPipelineDesc& desc) {
+    std::string key = serialize(desc);
+    uint64_t hash = hashString(key);
+    auto found = m_pipelineLookup.find(hash);
+    if (found != m_pipelineLookup.end()) {
+        return {found->second};
+    }
+    if (!m_renderPasses.count(desc.renderPass)) {
+        throw std::runtime_error("Pipeline requested for unregistered render pass " + std::to_string(desc.renderPass));
+    }
+
+    auto pipeline = std::make_unique<Pipeline>();
+    pipeline->graphics = desc;
+    pipeline->shaders[0] = m_shaderCache->load(desc.vertex);
+    pipeline->shaders[1] = m_shaderCache->load(desc.fragment);
+    buildLayout({&m_shaderCache->getReflection(pipeline->shaders[0]),
+                 &m_shaderCache->getReflection(pipeline->shaders[1])},
+                pipeline->layout, pipeline->setLayouts);
+
+    uint32_t index = static_cast<uint32_t>(m_pipelines.size());
+    m_pipelines.push_back(std::move(pipeline));
+    m_pipelineLookup[hash] = index;
+    m_recorded.push_back(key);
+
+    schedule(index, false);
+    return {index};
+}
+
+PipelineHandle PipelineManager::requestCompute(const ComputePipelineDesc& desc) {
+    std::string key = serialize(desc);
+    uint64_t hash = hashString(key);
+    auto found = m_pipelineLookup.find(hash);
+    if (found != m_pipelineLookup.end()) {
+        return {found->second};
+    }
+
+    auto pipeline = std::make_unique<Pipeline>();
+    pipeline->compute = true;
+    pipeline->computeDesc = desc;
+    pipeline->shaders[0] = m_shaderCache->load(desc.compute);
+    buildLayout({&m_shaderCache->getReflection(pipeline->shaders[0])}, pipeline->layout, pipeline->setLayouts);
+
+    uint32_t index = static_cast<uint32_t>(m_pipelines.size());
+    m_pipelines.push_back(std::move(pipeline));
+    m_pipelineLookup[hash] = index;
+    m_recorded.push_back(key);
+
+    schedule(index, false);
+    return {index};
+}
+
+bool PipelineManager::isReady(PipelineHandle handle) const {
+    return m_pipelines[handle.index]->pipeline.load(std::memory_order_acquire) != VK_NULL_HANDLE;
+}
+
+VkPipeline PipelineManager::getPipeline(PipelineHandle handle) const {
+    return m_pipelines[handle.index]->pipeline.load(std::memory_order_acquire);
+}
+
+VkPipeline PipelineManager::resolve(PipelineHandle handle) const {
+    const Pipeline& pipeline = *m_pipelines[handle.index];
+    VkPipeline compiled = pipeline.pipeline.load(std::memory_order_acquire);
+    if (compiled || pipeline.compute || pipeline.graphics.vertexLayout != VertexLayout::Mesh) {
+        return compiled;
+    }
+    return m_renderPasses.at(pipeline.graphics.renderPass).fallback;
+}
+
+VkPipelineLayout PipelineManager::getLayout(PipelineHandle handle) const {
+    return m_pipelines[handle.index]->layout;
+}
+
+VkPipeline PipelineManager::resolve(PipelineHandle handle, VkPipelineLayout& layout) const {
+    const Pipeline& pipeline = *m_pipelines[handle.index];
+    VkPipeline compiled = pipeline.pipeline.load(std::memory_order_acquire);
+    layout = pipeline.layout;
+    if (compiled || pipeline.compute || pipeline.graphics.vertexLayout != VertexLayout::Mesh) {
+        return compiled;
+    }
+    const RenderPass& pass = m_renderPasses.at(pipeline.graphics.renderPass);
+    layout = pass.fallbackLayout;
+    return pass.fallback;
+}
+
+VkDescriptorSetLayout PipelineManager::getSetLayout(PipelineHandle handle, uint32_t set) const {
+    const auto& setLayouts = m_pipelines[handle.index]->setLayouts;
+    return set < setLayouts.size() ? setLayouts[set] : VK_NULL_HANDLE;
+}
+
+VkDescriptorSetLayout PipelineManager::getSetLayout(const std::vector<VkDescriptorSetLayoutBinding>& bindings) {
+    uint64_t hash = hashBytes(bindings.data(), bindings.size() * sizeof(VkDescriptorSetLayoutBinding));
+    auto found = m_setLayoutCache.find(hash);
+    if (found != m_setLayoutCache.end()) {
+        return found->second;
+    }
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    layoutInfo.pBindings = bindings.data();
+
+    VkDescriptorSetLayout setLayout;
+    if (vkCreateDescriptorSetLayout(m_vulkanContext->getDevice(), &layoutInfo, nullptr, &setLayout) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create descriptor set layout");
+    }
+    m_setLayoutCache.emplace(hash, setLayout);
+    return setLayout;
+}
+
+VkPushConstantRange PipelineManager::getPushConstantRange(PipelineHandle handle) const {
+    auto found = m_pushConstantRanges.find(m_pipelines[handle.index]->layout);
+    return found != m_pushConstantRanges.end() ? found->second : VkPushConstantRange{};
+}
+
+void PipelineManager::update() {
+    for (auto& pipeline : m_pipelines) {
+        VkPipeline replacement = pipeline->replacement.exchange(VK_NULL_HANDLE);
+        if (!replacement) {
+            continue;
+        }
+
+        m_deletionQueue->release(pipeline->pipeline.exchange(replacement));
+        pipeline->layout = pipeline->replacementLayout;
+        pipeline->setLayouts = pipeline->replacementSetLayouts;
+    }
+}
+
+void PipelineManager::waitIdle() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_idleCondition.wait(lock, [this]() { return m_pendingJobs.load() == 0; });
+}
+
+void PipelineManager::buildLayout(const std::vector<const ShaderReflection*>& stages, VkPipelineLayout& layout,
+                                  std::vector<VkDescriptorSetLayout>& setLayouts) {
+    VkDevice device = m_vulkanContext->getDevice();
+
+    uint32_t setCount = 0;
+    VkPushConstantRange pushConstants{};
+    for (const ShaderReflection* reflection : stages) {
+        for (const auto& binding : reflection->bindings) {
+            setCount = std::max(setCount, binding.set + 1);
+        }
+        if (reflection->pushConstantSize > 0) {
+            pushConstants.stageFlags |= reflection->stage;
+            pushConstants.size = std::max(pushConstants.size, reflection->pushConstantSize);
+        }
+    }
+
+    // Identical set layouts are shared so descriptor sets work across pipelines
+    setLayouts.clear();
+    uint64_t layoutHash = hashValue(pushConstants);
+    for (uint32_t set = 0; set < setCount; ++set) {
+        std::vector<VkDescriptorSetLayoutBinding> bindings = mergeSetBindings(stages, set);
+        setLayouts.push_back(getSetLayout(bindings));
+        layoutHash = hashCombine(layoutHash,
+                                 hashBytes(bindings.data(), bindings.size() * sizeof(VkDescriptorSetLayoutBinding)));
+    }
+
+    auto found = m_pipelineLayoutCache.find(layoutHash);
+    if (found != m_pipelineLayoutCache.end()) {
+        layout = found->second;
+        return;
+    }
+
+    VkPipelineLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    layoutInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+    layoutInfo.pSetLayouts = setLayouts.data();
+    layoutInfo.pushConstantRangeCount = pushConstants.size > 0 ? 1 : 0;
+    layoutInfo.pPushConstantRanges = &pushConstants;
+
+    if (vkCreatePipelineLayout(device, &layoutInfo, nullptr, &layout) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create pipeline layout");
+    }
+    m_pipelineLayoutCache.emplace(layoutHash, layout);
+    m_pushConstantRanges.emplace(layout, pushConstants);
+}
+
+void PipelineManager::schedule(uint32_t index, bool replace) {
+    Pipeline* pipeline = m_pipelines[index].get();
+
+    // Everything the job needs is captured now; it never touches main-thread state
+    VkShaderModule modules[2] = {m_shaderCache->getModule(pipeline->shaders[0]),
+                                 pipeline->compute ? VK_NULL_HANDLE : m_shaderCache->getModule(pipeline->shaders[1])};
+    RenderPass pass = pipeline->compute ? RenderPass{} : m_renderPasses.at(pipeline->graphics.renderPass);
+    VkPipelineLayout layout = replace ? pipeline->replacementLayout : pipeline->layout;
+
+    ++m_pendingJobs;
+    m_jobSystem->schedule([this, pipeline, modules, pass, layout, replace]() {
+        VkPipeline result = VK_NULL_HANDLE;
+        try {
+            result = pipeline->compute ? createCompute(pipeline->computeDesc, modules[0], layout)
+                                       : createGraphics(pipeline->graphics, pass, modules[0], modules[1], layout);
+        } catch (const std::exception& e) {
+            logError("pipelines", std::string("Pipeline creation failed: ") + e.what());
+        }
+
+        if (result) {
+            if (replace) {
+                // A newer reload may have finished first; the older result was never used
+                VkPipeline superseded = pipeline->replacement.exchange(result);
+                if (superseded) {
+                    vkDestroyPipeline(m_vulkanContext->getDevice(), superseded, nullptr);
+                }
+            } else {
+                pipeline->pipeline.store(result, std::memory_order_release);
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        --m_pendingJobs;
+        m_idleCondition.notify_all();
+    });
+}
+
+VkPipeline PipelineManager::createGraphics(const GraphicsPipelineDesc& desc, const RenderPass& pass,
+                                           VkShaderModule vertex, VkShaderModule fragment,
+                                           VkPipelineLayout layout) const {
+    VkPipelineShaderStageCreateInfo stages[2]{};
+    stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+    stages[0].module = vertex;
+    stages[0].pName = desc.vertex.entryPoint.c_str();
+    stages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    stages[1].module = fragment;
+    stages[1].pName = desc.fragment.entryPoint.c_str();
+
+    auto bindings = getMeshBindingDescriptions();
+    auto attributes = getMeshAttributeDescriptions();
+
+    VkPipelineVertexInputStateCreateInfo vertexInput{};
+    vertexInput.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    if (desc.vertexLayout == VertexLayout::Mesh) {
+        vertexInput.vertexBindingDescriptionCount = static_cast<uint32_t>(bindings.size());
+        vertexInput.pVertexBindingDescriptions = bindings.data();
+        vertexInput.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributes.size());
+        vertexInput.pVertexAttributeDescriptions = attributes.data();
+    }
+
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+    inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    inputAssembly.topology = desc.topology;
+
+    VkPipelineViewportStateCreateInfo viewportState{};
+    viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewportState.viewportCount = 1;
+    viewportState.scissorCount = 1;
+
+    VkPipelineRasterizationStateCreateInfo rasterizer{};
+    rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+    rasterizer.cullMode = desc.cullMode;
+    rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+    rasterizer.lineWidth = 1.0f;
+
+    VkPipelineMultisampleStateCreateInfo multisampling{};
+    multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+    VkPipelineDepthStencilStateCreateInfo depthStencil{};
+    depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depthStencil.depthTestEnable = desc.depthTest ? VK_TRUE : VK_FALSE;
+    depthStencil.depthWriteEnable = desc.depthWrite ? VK_TRUE : VK_FALSE;
+    depthStencil.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+
+    VkPipelineColorBlendAttachmentState blendAttachment{};
+    blendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+                                     VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    if (desc.blend != BlendMode::Opaque) {
+        blendAttachment.blendEnable = VK_TRUE;
+        blendAttachment.srcColorBlendFactor = desc.blend == BlendMode::Alpha ? VK_BLEND_FACTOR_SRC_ALPHA
+                                                                             : VK_BLEND_FACTOR_ONE;
+        blendAttachment.dstColorBlendFactor = desc.blend == BlendMode::Alpha ? VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA
+                                                                             : VK_BLEND_FACTOR_ONE;
+        blendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+        blendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+        blendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+        blendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+    }
+
+    // Every color attachment of the pass needs a blend state; depth-only passes have none
+    uint32_t colorCount = pass.renderPass ? pass.colorAttachmentCount
+                                          : static_cast<uint32_t>(pass.colorFormats.size());
+    std::vector<VkPipelineColorBlendAttachmentState> blendAttachments(colorCount, blendAttachment);
+
+    VkPipelineColorBlendStateCreateInfo colorBlending{};
+    colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    colorBlending.attachmentCount = colorCount;
+    colorBlending.pAttachments = blendAttachments.data();
+
+    VkDynamicState dynamicStates[] = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+    VkPipelineDynamicStateCreateInfo dynamicState{};
+    dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamicState.dynamicStateCount = 2;
+    dynamicState.pDynamicStates = dynamicStates;
+
+    VkGraphicsPipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineInfo.stageCount = 2;
+    pipelineInfo.pStages = stages;
+    pipelineInfo.pVertexInputState = &vertexInput;
+    pipelineInfo.pInputAssemblyState = &inputAssembly;
+    pipelineInfo.pViewportState = &viewportState;
+    pipelineInfo.pRasterizationState = &rasterizer;
+    pipelineInfo.pMultisampleState = &multisampling;
+    pipelineInfo.pDepthStencilState = &depthStencil;
+    pipelineInfo.pColorBlendState = &colorBlending;
+    pipelineInfo.pDynamicState = &dynamicState;
+    pipelineInfo.layout = layout;
+    pipelineInfo.renderPass = pass.renderPass;
+    pipelineInfo.subpass = desc.subpass;
+
+    VkPipelineRenderingCreateInfo renderingInfo{};
+    if (!pass.renderPass) {
+        renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+        renderingInfo.colorAttachmentCount = colorCount;
+        renderingInfo.pColorAttachmentFormats = pass.colorFormats.data();
+        renderingInfo.depthAttachmentFormat = pass.depthFormat;
+        pipelineInfo.pNext = &renderingInfo;
+    }
+
+    // The pipeline cache is internally synchronized, so workers share it freely
+    VkPipeline pipeline;
+    if (vkCreateGraphicsPipelines(m_vulkanContext->getDevice(), m_pipelineCache, 1, &pipelineInfo, nullptr,
+                                  &pipeline) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create graphics pipeline for " + desc.vertex.path + " / " +
+                                 desc.fragment.path);
+    }
+    PLASTER_VK_NAME(m_vulkanContext->getDevice(), VK_OBJECT_TYPE_PIPELINE, pipeline,
+                    desc.vertex.path + " / " + desc.fragment.path);
+    return pipeline;
+}
+
+VkPipeline PipelineManager::createCompute(const ComputePipelineDesc& desc, VkShaderModule module,
+                                          VkPipelineLayout layout) const {
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = module;
+    pipelineInfo.stage.pName = desc.compute.entryPoint.c_str();
+    pipelineInfo.layout = layout;
+
+    VkPipeline pipeline;
+    if (vkCreateComputePipelines(m_vulkanContext->getDevice(), m_pipelineCache, 1, &pipelineInfo, nullptr,
+                                 &pipeline) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create compute pipeline for " + desc.compute.path);
+    }
+    PLASTER_VK_NAME(m_vulkanContext->getDevice(), VK_OBJECT_TYPE_PIPELINE, pipeline, desc.compute.path);
+    return pipeline;
+}
+
+void PipelineManager::onShadersReloaded(const std::vector<ShaderHandle>& shaders) {
+    // Queued compiles captured the modules that are about to be retired
+    waitIdle();
+
+    for (uint32_t i = 0; i < m_pipelines.size(); ++i) {
+        Pipeline& pipeline = *m_pipelines[i];
+        uint32_t shaderCount = pipeline.compute ? 1 : 2;
+
+        bool affected = false;
+        for (const ShaderHandle& shader : shaders) {
+            for (uint32_t s = 0; s < shaderCount; ++s) {
+                affected |= pipeline.shaders[s].index == shader.index;
+            }
+        }
+        if (!affected) {
+            continue;
+        }
+
+        std::vector<const ShaderReflection*> stages;
+        for (uint32_t s = 0; s < shaderCount; ++s) {
+            stages.push_back(&m_shaderCache->getReflection(pipeline.shaders[s]));
+        }
+        // A rebuild from an earlier reload that update() hasn't swapped in yet is stale now
+        VkPipeline stale = pipeline.replacement.exchange(VK_NULL_HANDLE);
+        if (stale) {
+            vkDestroyPipeline(m_vulkanContext->getDevice(), stale, nullptr);
+        }
+
+        buildLayout(stages, pipeline.replacementLayout, pipeline.replacementSetLayouts);
+        schedule(i, true);
+    }
+}
+
+void PipelineManager::loadPipelineCache() {
+    std::vector<char> data;
+    std::ifstream file(m_cacheDirectory + "/" + PIPELINE_CACHE_FILE, std::ios::binary | std::ios::ate);
+    if (file) {
+        data.resize(static_cast<size_t>(file.tellg()));
+        file.seekg(0);
+        file.read(data.data(), static_cast<std::streamsize>(data.size()));
+    }
+
+    // Data from another driver or GPU is ignored by the driver, but check the
+    // header ourselves so a stale file never reaches it
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(m_vulkanContext->getPhysicalDevice(), &properties);
+
+    VkPipelineCacheHeaderVersionOne header{};
+    if (data.size() < sizeof(header)) {
+        data.clear();
+    } else {
+        std::memcpy(&header, data.data(), sizeof(header));
+        if (header.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE ||
+            header.vendorID != properties.vendorID || header.deviceID != properties.deviceID ||
+            std::memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+            data.clear();
+        }
+    }
+
+    VkPipelineCacheCreateInfo cacheInfo{};
+    cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    cacheInfo.initialDataSize = data.size();
+    cacheInfo.pInitialData = data.empty() ? nullptr : data.data();
+
+    if (vkCreatePipelineCache(m_vulkanContext->getDevice(), &cacheInfo, nullptr, &m_pipelineCache) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create pipeline cache");
+    }
+}
+
+void PipelineManager::savePipelineCache() const {
+    VkDevice device = m_vulkanContext->getDevice();
+
+    size_t size = 0;
+    if (vkGetPipelineCacheData(device, m_pipelineCache, &size, nullptr) != VK_SUCCESS || size == 0) {
+        return;
+    }
+    std::vector<char> data(size);
+    if (vkGetPipelineCacheData(device, m_pipelineCache, &size, data.data()) != VK_SUCCESS) {
+        return;
+    }
+
+    std::ofstream file(m_cacheDirectory + "/" + PIPELINE_CACHE_FILE, std::ios::binary | std::ios::trunc);
+    file.write(data.data(), static_cast<std::streamsize>(size));
+}
+
+void PipelineManager::loadPrecompileList() {
+    std::ifstream file(m_cacheDirectory + "/" + PRECOMPILE_LIST_FILE);
+    std::string line;
+    while (std::getline(file, line)) {
+        if (!line.empty()) {
+            m_precompileList.push_back(line);
+        }
+    }
+}
+
+void PipelineManager::savePrecompileList() const {
+    // Pipelines listed last session but not requested this time are kept too
+    std::vector<std::string> lines = m_recorded;
+    lines.insert(lines.end(), m_precompileList.begin(), m_precompileList.end());
+    std::sort(lines.begin(), lines.end());
+    lines.erase(std::unique(lines.begin(), lines.end()), lines.end());
+
+    std::ofstream file(m_cacheDirectory + "/" + PRECOMPILE_LIST_FILE, std::ios::trunc);
+    for (const auto& line : lines) {
+        file << line << '\n';
+    }
+}
+
+} // namespace plaster
@@ -0,0 +1,348 @@
+#include "Graphics/PostProcess.h"
+#include "Graphics/VulkanContext.h"
+#include "Graphics/DeletionQueue.h"
+#include "Graphics/VulkanDebug.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace plaster {
+
+namespace {
+
+struct DownsampleConstants {
+    float sourceScale[2];
+    int32_t destinationSize[2];
+    float sourceLod;
+    float threshold;
+    float knee;
+};
+
+struct UpsampleConstants {
+    float sourceScale[2];
+    int32_t destinationSize[2];
+    float sourceLod;
+    float radius;
+};
+
+struct TonemapConstants {
+    float exposure;
+    float bloomIntensity;
+    float bloomScale[2];
+    int32_t size[2];
+};
+
+struct CompositeConstants {
+    float uvScale[2];
+    float uvMax[2];
+};
+
+void imageBarrier(VkCommandBuffer commandBuffer, VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout,
+                  VkPipelineStageFlags srcStage, VkAccessFlags srcAccess,
+                  VkPipelineStageFlags dstStage, VkAccessFlags dstAccess) {
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = srcAccess;
+    barrier.dstAccessMask = dstAccess;
+    barrier.oldLayout = oldLayout;
+    barrier.newLayout = newLayout;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, VK_REMAINING_MIP_LEVELS, 0, 1};
+    vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+// Between passes over the bloom pyramid, which stays in GENERAL throughout
+void computeBarrier(VkCommandBuffer commandBuffer) {
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+VkImageView createView(VkDevice device, VkImage image, VkFormat format, uint32_t baseMip, uint32_t levelCount) {
+    VkImageViewCreateInfo viewInfo{};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = image;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = format;
+    viewInfo.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, baseMip, levelCount, 0, 1};
+
+    VkImageView view;
+    PLASTER_VK_CHECK(vkCreateImageView(device, &viewInfo, nullptr, &view));
+    return view;
+}
+
+VkExtent2D bloomLevelExtent(VkExtent2D extent, uint32_t level) {
+    return {std::max(1u, extent.width >> (level + 1)), std::max(1u, extent.height >> (level + 1))};
+}
+
+// Stop once the smallest level would drop below a few texels
+uint32_t bloomLevelCount(VkExtent2D extent, uint32_t maxLevels) {
+    uint32_t levels = 1;
+    while (levels < maxLevels) {
+        VkExtent2D next = bloomLevelExtent(extent, levels);
+        if (std::min(next.width, next.height) < 4) {
+            break;
+        }
+        ++levels;
+    }
+    return levels;
+}
+
+void setUsedFraction(float (&scale)[2], VkExtent2D used, VkExtent2D allocated) {
+    scale[0] = static_cast<float>(used.width) / allocated.width;
+    scale[1] = static_cast<float>(used.height) / allocated.height;
+}
+
+void setSize(int32_t (&size)[2], VkExtent2D extent) {
+    size[0] = static_cast<int32_t>(extent.width);
+    size[1] = static_cast<int32_t>(extent.height);
+}
+
+} // namespace
+
+PostProcess::PostProcess(VulkanContext* vulkanContext, PipelineManager* pipelineManager, DeletionQueue* deletionQueue,
+                         uint32_t presentPass, bool srgbPresent)
+    : m_vulkanContext(vulkanContext), m_pipelineManager(pipelineManager), m_deletionQueue(deletionQueue),
+      m_srgbPresent(srgbPresent),
+      m_linearSampler(VK_NULL_HANDLE), m_sceneColor(VK_NULL_HANDLE), m_extent({0, 0}),
+      m_bloomImage(VK_NULL_HANDLE), m_bloomMemory(VK_NULL_HANDLE), m_bloomView(VK_NULL_HANDLE), m_bloomLevels(0),
+      m_outputImage(VK_NULL_HANDLE), m_outputMemory(VK_NULL_HANDLE), m_outputStorageView(VK_NULL_HANDLE),
+      m_outputSampledView(VK_NULL_HANDLE) {
+    ComputePipelineDesc prefilter;
+    prefilter.compute.path = "bloom_downsample.comp";
+    prefilter.compute.stage = ShaderStage::Compute;
+    prefilter.compute.defines = {"PREFILTER"};
+    m_prefilterPipeline = m_pipelineManager->requestCompute(prefilter);
+
+    ComputePipelineDesc downsample;
+    downsample.compute.path = "bloom_downsample.comp";
+    downsample.compute.stage = ShaderStage::Compute;
+    m_downsamplePipeline = m_pipelineManager->requestCompute(downsample);
+
+    ComputePipelineDesc upsample;
+    upsample.compute.path = "bloom_upsample.comp";
+    upsample.compute.stage = ShaderStage::Compute;
+    m_upsamplePipeline = m_pipelineManager->requestCompute(upsample);
+
+    ComputePipelineDesc tonemap;
+    tonemap.compute.path = "tonemap.comp";
+    tonemap.compute.stage = ShaderStage::Compute;
+    m_tonemapPipeline = m_pipelineManager->requestCompute(tonemap);
+
+    GraphicsPipelineDesc composite;
+    composite.vertex.path = "composite.vert";
+    composite.vertex.stage = ShaderStage::Vertex;
+    composite.fragment.path = "composite.frag";
+    composite.fragment.stage = ShaderStage::Fragment;
+    composite.renderPass = presentPass;
+    composite.vertexLayout = VertexLayout::None;
+    composite.cullMode = VK_CULL_MODE_NONE;
+    m_compositePipeline = m_pipelineManager->requestGraphics(composite);
+
+    // There is no fallback for any of these, and nothing can be presented without them
+    m_pipelineManager->waitIdle();
+
+    VkSamplerCreateInfo samplerInfo{};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_LINEAR;
+    samplerInfo.minFilter = VK_FILTER_LINEAR;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+    PLASTER_VK_CHECK(vkCreateSampler(m_vulkanContext->getDevice(), &samplerInfo, nullptr, &m_linearSampler));
+}
+
+PostProcess::~PostProcess() {
+    releaseTargets();
+    m_deletionQueue->release(m_linearSampler);
+}
+
+void PostProcess::releaseTargets() {
+    for (VkImageView view : m_bloomLevelViews) {
+        m_deletionQueue->release(view);
+    }
+    m_bloomLevelViews.clear();
+    m_deletionQueue->release(m_bloomImage, m_bloomMemory, m_bloomView);
+    m_deletionQueue->release(m_outputStorageView);
+    m_deletionQueue->release(m_outputImage, m_outputMemory, m_outputSampledView);
+    m_bloomImage = VK_NULL_HANDLE;
+    m_outputImage = VK_NULL_HANDLE;
+}
+
+void PostProcess::resize(VkImageView sceneColor, VkExtent2D extent) {
+    releaseTargets();
+    VkDevice device = m_vulkanContext->getDevice();
+    m_sceneColor = sceneColor;
+    m_extent = extent;
+
+    m_bloomLevels = bloomLevelCount(extent, MAX_BLOOM_LEVELS);
+
+    VkExtent2D bloomExtent = bloomLevelExtent(extent, 0);
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.format = VK_FORMAT_R16G16B16A16_SFLOAT;
+    imageInfo.extent = {bloomExtent.width, bloomExtent.height, 1};
+    imageInfo.mipLevels = m_bloomLevels;
+    imageInfo.arrayLayers = 1;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    m_vulkanContext->createImage(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_bloomImage, m_bloomMemory);
+    PLASTER_VK_NAME(device, VK_OBJECT_TYPE_IMAGE, m_bloomImage, "Bloom pyramid");
+
+    m_bloomView = createView(device, m_bloomImage, imageInfo.format, 0, m_bloomLevels);
+    for (uint32_t level = 0; level < m_bloomLevels; ++level) {
+        m_bloomLevelViews.push_back(createView(device, m_bloomImage, imageInfo.format, level, 1));
+    }
+
+    imageInfo.flags = VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT;
+    imageInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+    imageInfo.extent = {extent.width, extent.height, 1};
+    imageInfo.mipLevels = 1;
+    imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    m_vulkanContext->createImage(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_outputImage, m_outputMemory);
+    PLASTER_VK_NAME(device, VK_OBJECT_TYPE_IMAGE, m_outputImage, "Tonemapped output");
+
+    m_outputStorageView = createView(device, m_outputImage, VK_FORMAT_R8G8B8A8_UNORM, 0, 1);
+    m_outputSampledView = createView(device, m_outputImage,
+                                     m_srgbPresent ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM, 0, 1);
+}
+
+void PostProcess::dispatch(VkCommandBuffer commandBuffer, DescriptorAllocator* descriptorAllocator,
+                           PipelineHandle pipeline, std::initializer_list<DescriptorBinding> bindings,
+                           const void* pushConstants, uint32_t pushSize, VkExtent2D size) {
+    VkPipelineLayout layout = m_pipelineManager->getLayout(pipeline);
+    VkDescriptorSet set = descriptorAllocator->allocate(m_pipelineManager->getSetLayout(pipeline, 0), bindings);
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineManager->getPipeline(pipeline));
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, layout, 0, 1, &set, 0, nullptr);
+    vkCmdPushConstants(commandBuffer, layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, pushSize, pushConstants);
+    vkCmdDispatch(commandBuffer, (size.width + 7) / 8, (size.height + 7) / 8, 1);
+}
+
+void PostProcess::record(VkCommandBuffer commandBuffer, DescriptorAllocator* descriptorAllocator,
+                         VkExtent2D renderExtent) {
+    PLASTER_VK_LABEL(commandBuffer, "Post process");
+
+    // Both are fully rewritten each frame, so the old contents can be dropped; the
+    // source stages only order against the previous frame's reads
+    imageBarrier(commandBuffer, m_bloomImage, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
+                 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+                 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+                 VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT);
+    imageBarrier(commandBuffer, m_outputImage, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
+                 VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                 VK_ACCESS_SHADER_WRITE_BIT);
+
+    // Levels that would be too small at the current render scale are skipped
+    uint32_t bloomLevels = std::min(bloomLevelCount(renderExtent, MAX_BLOOM_LEVELS), m_bloomLevels);
+
+    if (m_settings.bloom) {
+        DownsampleConstants downsample{};
+        setUsedFraction(downsample.sourceScale, renderExtent, m_extent);
+        setSize(downsample.destinationSize, bloomLevelExtent(renderExtent, 0));
+        downsample.threshold = m_settings.bloomThreshold;
+        downsample.knee = m_settings.bloomKnee;
+        dispatch(commandBuffer, descriptorAllocator, m_prefilterPipeline,
+                 {DescriptorBinding::image(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, m_sceneColor,
+                                           m_linearSampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+                  DescriptorBinding::image(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, m_bloomLevelViews[0],
+                                           VK_NULL_HANDLE, VK_IMAGE_LAYOUT_GENERAL)},
+                 &downsample, sizeof(downsample), bloomLevelExtent(renderExtent, 0));
+
+        for (uint32_t level = 1; level < bloomLevels; ++level) {
+            computeBarrier(commandBuffer);
+            setUsedFraction(downsample.sourceScale, bloomLevelExtent(renderExtent, level - 1),
+                            bloomLevelExtent(m_extent, level - 1));
+            setSize(downsample.destinationSize, bloomLevelExtent(renderExtent, level));
+            downsample.sourceLod = static_cast<float>(level - 1);
+            dispatch(commandBuffer, descriptorAllocator, m_downsamplePipeline,
+                     {DescriptorBinding::image(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, m_bloomView,
+                                               m_linearSampler, VK_IMAGE_LAYOUT_GENERAL),
+                      DescriptorBinding::image(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, m_bloomLevelViews[level],
+                                               VK_NULL_HANDLE, VK_IMAGE_LAYOUT_GENERAL)},
+                     &downsample, sizeof(downsample), bloomLevelExtent(renderExtent, level));
+        }
+
+        for (uint32_t level = bloomLevels - 1; level-- > 0;) {
+            computeBarrier(commandBuffer);
+            UpsampleConstants upsample{};
+            setUsedFraction(upsample.sourceScale, bloomLevelExtent(renderExtent, level + 1),
+                            bloomLevelExtent(m_extent, level + 1));
+            setSize(upsample.destinationSize, bloomLevelExtent(renderExtent, level));
+            upsample.sourceLod = static_cast<float>(level + 1);
+            upsample.radius = m_settings.bloomRadius;
+            dispatch(commandBuffer, descriptorAllocator, m_upsamplePipeline,
+                     {DescriptorBinding::image(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, m_bloomView,
+                                               m_linearSampler, VK_IMAGE_LAYOUT_GENERAL),
+                      DescriptorBinding::image(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, m_bloomLevelViews[level],
+                                               VK_NULL_HANDLE, VK_IMAGE_LAYOUT_GENERAL)},
+                     &upsample, sizeof(upsample), bloomLevelExtent(renderExtent, level));
+        }
+        computeBarrier(commandBuffer);
+    } else {
+        // The tonemap pass always samples level 0
+        VkClearColorValue black{};
+        VkImageSubresourceRange range = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+        vkCmdClearColorImage(commandBuffer, m_bloomImage, VK_IMAGE_LAYOUT_GENERAL, &black, 1, &range);
+
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             0, 1, &barrier, 0, nullptr, 0, nullptr);
+    }
+
+    TonemapConstants tonemap{};
+    tonemap.exposure = m_settings.exposure;
+    tonemap.bloomIntensity = m_settings.bloom ? m_settings.bloomIntensity : 0.0f;
+    setUsedFraction(tonemap.bloomScale, bloomLevelExtent(renderExtent, 0), bloomLevelExtent(m_extent, 0));
+    setSize(tonemap.size, renderExtent);
+    dispatch(commandBuffer, descriptorAllocator, m_tonemapPipeline,
+             {DescriptorBinding::image(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, m_sceneColor,
+                                       m_linearSampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+              DescriptorBinding::image(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, m_bloomView,
+                                       m_linearSampler, VK_IMAGE_LAYOUT_GENERAL),
+              DescriptorBinding::image(2, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, m_outputStorageView,
+                                       VK_NULL_HANDLE, VK_IMAGE_LAYOUT_GENERAL)},
+             &tonemap, sizeof(tonemap), renderExtent);
+
+    imageBarrier(commandBuffer, m_outputImage, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+                 VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+}
+
+void PostProcess::composite(VkCommandBuffer commandBuffer, DescriptorAllocator* descriptorAllocator,
+                            VkExtent2D renderExtent) {
+    PLASTER_VK_LABEL(commandBuffer, "Composite");
+
+    VkPipelineLayout layout = m_pipelineManager->getLayout(m_compositePipeline);
+    VkDescriptorSet set = descriptorAllocator->allocate(
+        m_pipelineManager->getSetLayout(m_compositePipeline, 0),
+        {DescriptorBinding::image(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, m_outputSampledView,
+                                  m_linearSampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)});
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                      m_pipelineManager->getPipeline(m_compositePipeline));
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 0, 1, &set, 0, nullptr);
+
+    CompositeConstants constants{};
+    setUsedFraction(constants.uvScale, renderExtent, m_extent);
+    constants.uvMax[0] = constants.uvScale[0] - 0.5f / m_extent.width;
+    constants.uvMax[1] = constants.uvScale[1] - 0.5f / m_extent.height;
+    vkCmdPushConstants(commandBuffer, layout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(constants), &constants);
+    vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+}
+
+} // namespace plaster
@@ -0,0 +1,70 @@
+#include "Graphics/RenderThread.h"
+
+namespace plaster {
+
+RenderThread::RenderThread()
+    : m_busy(false), m_stopping(false) {
+    m_thread = std::thread(&RenderThread::threadLoop, this);
+}
+
+RenderThread::~RenderThread() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_condition.notify_all();
+    m_thread.join();
+}
+
+void RenderThread::run(std::function<void()> job) {
+    wait();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_job = std::move(job);
+        m_busy = true;
+    }
+    m_condition.notify_all();
+}
+
+void RenderThread::wait() {
+    std::exception_ptr error;
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_condition.wait(lock, [this] { return !m_busy; });
+        std::swap(error, m_error);
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+void RenderThread::threadLoop() {
+    for (;;) {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_condition.wait(lock, [this] { return m_stopping || m_busy; });
+            // A pending job still runs, so stopping never abandons a recorded frame
+            if (!m_busy) {
+                return;
+            }
+            job = std::move(m_job);
+        }
+
+        std::exception_ptr error;
+        try {
+            job();
+        } catch (...) {
+            error = std::current_exception();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_error = error;
+            m_busy = false;
+        }
+        m_condition.notify_all();
+    }
+}
+
+} // namespace plaster
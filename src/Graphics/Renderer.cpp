@@ -1,40 +1,265 @@
 #include "Graphics/Renderer.h"
 #include "Graphics/VulkanContext.h"
 #include "Graphics/ImGuiManager.h"
+#include "Graphics/DescriptorAllocator.h"
+#include "Graphics/DrawBatcher.h"
+#include "Graphics/TextureStreamer.h"
+#include "Graphics/ShaderCache.h"
+#include "Graphics/PipelineManager.h"
+#include "Graphics/PostProcess.h"
+#include "Graphics/ParticleSystem.h"
+#include "Graphics/SkinningPass.h"
+#include "Graphics/MeshletRenderer.h"
+#include "Graphics/Meshlet.h"
+#include "Graphics/MeshLod.h"
+#include "Graphics/ClusteredLighting.h"
+#include "Graphics/ShadowCascades.h"
+#include "Graphics/DeletionQueue.h"
+#include "Graphics/UniformRing.h"
+#include "Graphics/RenderThread.h"
+#include "Graphics/Mesh.h"
+#include "Graphics/VulkanDebug.h"
 #include "Core/Window.h"
 #include "Core/Input.h"
+#include "Core/Metrics.h"
 #include "imgui.h"
 
 #include <algorithm>
 #include <memory>
 #include <stdexcept>
 #include <array>
+#include <chrono>
+#include <cfloat>
+#include <cstdio>
+#include <cstring>
 
 namespace plaster {
 
-Renderer::Renderer(Window* window, VulkanContext* vulkanContext)
+namespace {
+
+// Per frame in flight; frame constants take a few hundred bytes of it, the
+// rest is for passes that stream their own uniform or storage data. Skinning
+// palettes are the largest: 48 bytes a joint, so about 80000 joints fit.
+const VkDeviceSize UNIFORM_RING_FRAME_SIZE = 4 * 1024 * 1024;
+
+// About 52 MB of device memory with the sort keys and lists
+const uint32_t PARTICLE_CAPACITY = 1u << 20;
+
+// In vertices: 40 MB of skinned mesh sources, 64 MB of skinned output
+const uint32_t SKINNING_SOURCE_CAPACITY = 1u << 20;
+const uint32_t SKINNING_OUTPUT_CAPACITY = 1u << 21;
+
+// 64 MB of meshlet mesh vertices, 22 MB of meshlets with their vertex
+// references and triangles, and 48 MB of indices drawn per frame
+const uint32_t MESHLET_VERTEX_CAPACITY = 1u << 21;
+const uint32_t MESHLET_CAPACITY = 1u << 16;
+const uint32_t MESHLET_INDEX_CAPACITY = 3u << 22;
+
+// 320 KB of lights and their bounds in the uniform ring at most, and a 4 MB
+// index buffer: an average of about 300 lights for every cluster
+const uint32_t LIGHT_CAPACITY = 1u << 12;
+const uint32_t LIGHT_INDEX_CAPACITY = 1u << 20;
+
+// Four 2048 texel cascades: 64 MB of 32 bit depth, and as much again for the static caster cache
+const uint32_t SHADOW_ATLAS_SIZE = 4096;
+
+// The render pass path gets these transitions from its attachment description
+void transitionImage(VkCommandBuffer commandBuffer, VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout,
+                     VkPipelineStageFlags2 srcStage, VkAccessFlags2 srcAccess,
+                     VkPipelineStageFlags2 dstStage, VkAccessFlags2 dstAccess,
+                     VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT) {
+    VkImageMemoryBarrier2 barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+    barrier.srcStageMask = srcStage;
+    barrier.srcAccessMask = srcAccess;
+    barrier.dstStageMask = dstStage;
+    barrier.dstAccessMask = dstAccess;
+    barrier.oldLayout = oldLayout;
+    barrier.newLayout = newLayout;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange.aspectMask = aspect;
+    barrier.subresourceRange.levelCount = 1;
+    barrier.subresourceRange.layerCount = 1;
+
+    VkDependencyInfo dependency{};
+    dependency.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+    dependency.imageMemoryBarrierCount = 1;
+    dependency.pImageMemoryBarriers = &barrier;
+    vkCmdPipelineBarrier2(commandBuffer, &dependency);
+}
+
+void setViewportAndScissor(VkCommandBuffer commandBuffer, VkExtent2D extent) {
+    VkViewport viewport{};
+    viewport.x = 0.0f;
+    viewport.y = 0.0f;
+    viewport.width = static_cast<float>(extent.width);
+    viewport.height = static_cast<float>(extent.height);
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+    VkRect2D scissor{};
+    scissor.offset = {0, 0};
+    scissor.extent = extent;
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+}
+
+VkImageView createTargetView(VkDevice device, VkImage image, VkFormat format, VkImageAspectFlags aspect) {
+    VkImageViewCreateInfo viewInfo{};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = image;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = format;
+    viewInfo.subresourceRange = {aspect, 0, 1, 0, 1};
+
+    VkImageView view;
+    PLASTER_VK_CHECK(vkCreateImageView(device, &viewInfo, nullptr, &view));
+    return view;
+}
+
+bool isSrgbFormat(VkFormat format) {
+    return format == VK_FORMAT_B8G8R8A8_SRGB || format == VK_FORMAT_R8G8B8A8_SRGB;
+}
+
+} // namespace
+
+Renderer::Renderer(Window* window, VulkanContext* vulkanContext, JobSystem* jobSystem, RenderPath preferredPath)
     : m_window(window), m_vulkanContext(vulkanContext),
       m_swapchain(VK_NULL_HANDLE), m_swapchainImageFormat(VK_FORMAT_UNDEFINED),
-      m_swapchainExtent({0, 0}), m_renderPass(VK_NULL_HANDLE),
-      m_commandPool(VK_NULL_HANDLE), m_currentFrame(0) {
-    
+      m_swapchainExtent({0, 0}), m_renderPath(RenderPath::RenderPass), m_renderPass(VK_NULL_HANDLE),
+      m_renderScale(1.0f), m_maxRenderScale(1.0f), m_sceneTargetsDirty(false), m_sceneExtent({0, 0}),
+      m_sceneTargetExtent({0, 0}), m_frameRenderScales(MAX_FRAMES_IN_FLIGHT, 1.0f),
+      m_sceneColorFormat(VK_FORMAT_UNDEFINED), m_sceneDepthFormat(VK_FORMAT_UNDEFINED),
+      m_sceneColorImage(VK_NULL_HANDLE), m_sceneColorMemory(VK_NULL_HANDLE), m_sceneColorView(VK_NULL_HANDLE),
+      m_sceneDepthImage(VK_NULL_HANDLE), m_sceneDepthMemory(VK_NULL_HANDLE), m_sceneDepthView(VK_NULL_HANDLE),
+      m_sceneRenderPass(VK_NULL_HANDLE), m_sceneFramebuffer(VK_NULL_HANDLE), m_shadowRenderPass(VK_NULL_HANDLE),
+      m_commandPool(VK_NULL_HANDLE), m_currentFrame(0), m_frameNumber(0),
+      m_timestampPool(VK_NULL_HANDLE), m_timestampPeriod(0.0f), m_timestampMask(0),
+      m_view(1.0f), m_projection(1.0f), m_frameSet(VK_NULL_HANDLE), m_frameConstantsOffset(0),
+      m_startTime(std::chrono::steady_clock::now()), m_lastFrameTime(m_startTime), m_frameDeltaTime(0.0f),
+      m_swapchainOutOfDate(false),
+      m_recordMs(0.0f) {
+
+    if (preferredPath == RenderPath::DynamicRendering && m_vulkanContext->getCapabilities().dynamicRendering) {
+        m_renderPath = RenderPath::DynamicRendering;
+    }
+
+    m_deletionQueue = std::make_unique<DeletionQueue>(m_vulkanContext);
+
     createSwapchain();
     createImageViews();
-    createRenderPass();
-    createFramebuffers();
+    chooseSceneFormats();
+    if (m_renderPath == RenderPath::RenderPass) {
+        createRenderPass();
+        createSceneRenderPass();
+        createShadowRenderPass();
+        createFramebuffers();
+    }
+    createSceneTargets();
     createCommandPool();
     createCommandBuffers();
     createSyncObjects();
-
-    m_imguiManager = std::make_unique<ImGuiManager>(m_window, m_vulkanContext, m_renderPass);
+    createTimestampPool();
+
+    m_descriptorAllocator = std::make_unique<DescriptorAllocator>(m_vulkanContext, MAX_FRAMES_IN_FLIGHT);
+    m_drawBatcher = std::make_unique<DrawBatcher>(m_vulkanContext, MAX_FRAMES_IN_FLIGHT);
+    m_textureStreamer = std::make_unique<TextureStreamer>(m_vulkanContext, m_deletionQueue.get(), MAX_FRAMES_IN_FLIGHT,
+                                                          m_vulkanContext->getDeviceLocalBudget() / 4);
+
+    m_shaderCache = std::make_unique<ShaderCache>(m_vulkanContext, m_deletionQueue.get(), PLASTER_SHADER_DIR,
+                                                  "shadercache");
+#ifndef NDEBUG
+    m_shaderCache->setHotReload(true);
+#endif
+
+    m_pipelineManager = std::make_unique<PipelineManager>(m_vulkanContext, jobSystem, m_shaderCache.get(),
+                                                          m_deletionQueue.get(), "shadercache");
+    if (m_renderPath == RenderPath::DynamicRendering) {
+        m_pipelineManager->registerRenderingFormats(SCENE_RENDER_PASS, {m_sceneColorFormat}, m_sceneDepthFormat);
+        m_pipelineManager->registerRenderingFormats(PRESENT_RENDER_PASS, {m_swapchainImageFormat},
+                                                    VK_FORMAT_UNDEFINED);
+        m_pipelineManager->registerRenderingFormats(SHADOW_RENDER_PASS, {}, m_sceneDepthFormat);
+    } else {
+        m_pipelineManager->registerRenderPass(SCENE_RENDER_PASS, m_sceneRenderPass);
+        m_pipelineManager->registerRenderPass(PRESENT_RENDER_PASS, m_renderPass);
+        m_pipelineManager->registerRenderPass(SHADOW_RENDER_PASS, m_shadowRenderPass, 0);
+    }
+    m_pipelineManager->warmUp();
+
+    m_postProcess = std::make_unique<PostProcess>(m_vulkanContext, m_pipelineManager.get(), m_deletionQueue.get(),
+                                                  PRESENT_RENDER_PASS, isSrgbFormat(m_swapchainImageFormat));
+    m_postProcess->resize(m_sceneColorView, m_sceneTargetExtent);
+    m_particleSystem = std::make_unique<ParticleSystem>(m_vulkanContext, m_pipelineManager.get(),
+                                                        m_deletionQueue.get(), SCENE_RENDER_PASS, PARTICLE_CAPACITY);
+
+    m_uniformRing = std::make_unique<UniformRing>(m_vulkanContext, MAX_FRAMES_IN_FLIGHT, UNIFORM_RING_FRAME_SIZE);
+    m_skinningPass = std::make_unique<SkinningPass>(m_vulkanContext, m_pipelineManager.get(), m_deletionQueue.get(),
+                                                    m_uniformRing.get(), SKINNING_SOURCE_CAPACITY,
+                                                    SKINNING_OUTPUT_CAPACITY);
+    m_meshletRenderer = std::make_unique<MeshletRenderer>(m_vulkanContext, m_pipelineManager.get(),
+                                                          m_deletionQueue.get(), m_uniformRing.get(),
+                                                          MAX_FRAMES_IN_FLIGHT, SCENE_RENDER_PASS,
+                                                          MESHLET_VERTEX_CAPACITY, MESHLET_CAPACITY,
+                                                          MESHLET_INDEX_CAPACITY);
+    m_meshletRenderer->resize(m_sceneDepthView, m_sceneTargetExtent);
+    m_lodSelector = std::make_unique<LodSelector>();
+    m_shadows = std::make_unique<ShadowCascades>(m_vulkanContext, m_pipelineManager.get(), m_deletionQueue.get(),
+                                                 m_drawBatcher.get(), MAX_FRAMES_IN_FLIGHT, SHADOW_RENDER_PASS,
+                                                 m_shadowRenderPass, m_sceneDepthFormat, SHADOW_ATLAS_SIZE);
+    m_lighting = std::make_unique<ClusteredLighting>(m_vulkanContext, m_pipelineManager.get(), m_deletionQueue.get(),
+                                                     m_uniformRing.get(), m_shadows.get(), MAX_FRAMES_IN_FLIGHT,
+                                                     LIGHT_CAPACITY, LIGHT_INDEX_CAPACITY);
+
+    // One set covers the whole ring; each frame binds it at its own dynamic offset
+    VkDescriptorSetLayoutBinding frameBinding{};
+    frameBinding.binding = 0;
+    frameBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    frameBinding.descriptorCount = 1;
+    frameBinding.stageFlags = VK_SHADER_STAGE_ALL;
+    VkDescriptorSetLayout frameLayout = m_pipelineManager->getSetLayout({frameBinding});
+    m_frameSet = m_descriptorAllocator->getImmutable(
+        frameLayout, {DescriptorBinding::buffer(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, m_uniformRing->getBuffer(),
+                                                0, sizeof(FrameConstants))});
+
+    m_imguiManager = std::make_unique<ImGuiManager>(m_window, m_vulkanContext, m_renderPass, m_swapchainImageFormat,
+                                                    MAX_FRAMES_IN_FLIGHT, m_pipelineManager->getPipelineCache());
+
+    m_renderThread = std::make_unique<RenderThread>();
 }
 
 Renderer::~Renderer() {
     VkDevice device = m_vulkanContext->getDevice();
 
+    // Lets the last frame finish submitting; an error it raised no longer matters
+    m_renderThread.reset();
+
     // Wait for device to finish
     vkDeviceWaitIdle(device);
 
+    m_descriptorAllocator.reset();
+    m_drawBatcher.reset();
+    m_textureStreamer.reset();
+    m_postProcess.reset();
+    m_particleSystem.reset();
+    m_skinningPass.reset();
+    m_meshletRenderer.reset();
+    m_lodSelector.reset();
+    m_lighting.reset();
+    m_shadows.reset();
+    m_uniformRing.reset();
+    m_pipelineManager.reset();
+    m_shaderCache.reset();
+
+    // Cleanup mesh buffers
+    for (const auto& allocation : m_meshAllocations) {
+        vkDestroyBuffer(device, allocation.vertexBuffer, nullptr);
+        vkFreeMemory(device, allocation.vertexMemory, nullptr);
+        vkDestroyBuffer(device, allocation.indexBuffer, nullptr);
+        vkFreeMemory(device, allocation.indexMemory, nullptr);
+    }
+
     // Cleanup sync objects
     for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
         vkDestroySemaphore(device, m_imageAvailableSemaphores[i], nullptr);
@@ -42,6 +267,10 @@ Renderer::~Renderer() {
         vkDestroyFence(device, m_inFlightFences[i], nullptr);
     }
 
+    if (m_timestampPool) {
+        vkDestroyQueryPool(device, m_timestampPool, nullptr);
+    }
+
     // Cleanup command pool
     if (m_commandPool) {
         vkDestroyCommandPool(device, m_commandPool, nullptr);
@@ -52,10 +281,19 @@ Renderer::~Renderer() {
         vkDestroyFramebuffer(device, framebuffer, nullptr);
     }
 
-    // Cleanup render pass
+    releaseSceneTargets();
+    m_deletionQueue->flush();
+
+    // Cleanup render passes
     if (m_renderPass) {
         vkDestroyRenderPass(device, m_renderPass, nullptr);
     }
+    if (m_sceneRenderPass) {
+        vkDestroyRenderPass(device, m_sceneRenderPass, nullptr);
+    }
+    if (m_shadowRenderPass) {
+        vkDestroyRenderPass(device, m_shadowRenderPass, nullptr);
+    }
 
     // Cleanup image views
     for (auto imageView : m_swapchainImageViews) {
@@ -68,7 +306,7 @@ Renderer::~Renderer() {
     }
 }
 
-VkSurfaceFormatKHR Renderer::chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats) {
+VkSurfaceFormatKHR Renderer::chooseSwapSurfaceFormat(const FrameVector<VkSurfaceFormatKHR>& availableFormats) {
     for (const auto& availableFormat : availableFormats) {
         if (availableFormat.format == VK_FORMAT_B8G8R8A8_SRGB &&
             availableFormat.colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR) {
@@ -78,7 +316,7 @@ VkSurfaceFormatKHR Renderer::chooseSwapSurfaceFormat(const std::vector<VkSurface
     return availableFormats[0];
 }
 
-VkPresentModeKHR Renderer::chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes) {
+VkPresentModeKHR Renderer::chooseSwapPresentMode(const FrameVector<VkPresentModeKHR>& availablePresentModes) {
     for (const auto& availablePresentMode : availablePresentModes) {
         if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR) {
             return availablePresentMode;
@@ -103,7 +341,7 @@ VkExtent2D Renderer::chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabiliti
     }
 }
 
-void Renderer::createSwapchain() {
+void Renderer::createSwapchain(VkSwapchainKHR oldSwapchain) {
     VkPhysicalDevice physicalDevice = m_vulkanContext->getPhysicalDevice();
     VkDevice device = m_vulkanContext->getDevice();
     VkSurfaceKHR surface = m_vulkanContext->getSurface();
@@ -113,12 +351,12 @@ void Renderer::createSwapchain() {
 
     uint32_t formatCount;
     vkGetPhysicalDeviceSurfaceFormatsKHR(physicalDevice, surface, &formatCount, nullptr);
-    std::vector<VkSurfaceFormatKHR> formats(formatCount);
+    FrameVector<VkSurfaceFormatKHR> formats(formatCount);
     vkGetPhysicalDeviceSurfaceFormatsKHR(physicalDevice, surface, &formatCount, formats.data());
 
     uint32_t presentModeCount;
     vkGetPhysicalDeviceSurfacePresentModesKHR(physicalDevice, surface, &presentModeCount, nullptr);
-    std::vector<VkPresentModeKHR> presentModes(presentModeCount);
+    FrameVector<VkPresentModeKHR> presentModes(presentModeCount);
     vkGetPhysicalDeviceSurfacePresentModesKHR(physicalDevice, surface, &presentModeCount, presentModes.data());
 
     VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(formats);
@@ -144,13 +382,16 @@ void Renderer::createSwapchain() {
     createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
     createInfo.presentMode = presentMode;
     createInfo.clipped = VK_TRUE;
-    createInfo.oldSwapchain = VK_NULL_HANDLE;
+    createInfo.oldSwapchain = oldSwapchain;
 
-    vkCreateSwapchainKHR(device, &createInfo, nullptr, &m_swapchain);
+    PLASTER_VK_CHECK(vkCreateSwapchainKHR(device, &createInfo, nullptr, &m_swapchain));
 
     vkGetSwapchainImagesKHR(device, m_swapchain, &imageCount, nullptr);
     m_swapchainImages.resize(imageCount);
     vkGetSwapchainImagesKHR(device, m_swapchain, &imageCount, m_swapchainImages.data());
+    for (size_t i = 0; i < m_swapchainImages.size(); ++i) {
+        PLASTER_VK_NAME(device, VK_OBJECT_TYPE_IMAGE, m_swapchainImages[i], "Swapchain image " + std::to_string(i));
+    }
 
     m_swapchainImageFormat = surfaceFormat.format;
     m_swapchainExtent = extent;
@@ -177,7 +418,9 @@ void Renderer::createImageViews() {
         createInfo.subresourceRange.baseArrayLayer = 0;
         createInfo.subresourceRange.layerCount = 1;
 
-        vkCreateImageView(device, &createInfo, nullptr, &m_swapchainImageViews[i]);
+        PLASTER_VK_CHECK(vkCreateImageView(device, &createInfo, nullptr, &m_swapchainImageViews[i]));
+        PLASTER_VK_NAME(device, VK_OBJECT_TYPE_IMAGE_VIEW, m_swapchainImageViews[i],
+                        "Swapchain view " + std::to_string(i));
     }
 }
 
@@ -187,7 +430,8 @@ void Renderer::createRenderPass() {
     VkAttachmentDescription colorAttachment{};
     colorAttachment.format = m_swapchainImageFormat;
     colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-    colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    // The composite covers every pixel, so nothing needs clearing
+    colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
     colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
@@ -220,7 +464,242 @@ void Renderer::createRenderPass() {
     renderPassInfo.dependencyCount = 1;
     renderPassInfo.pDependencies = &dependency;
 
-    vkCreateRenderPass(device, &renderPassInfo, nullptr, &m_renderPass);
+    PLASTER_VK_CHECK(vkCreateRenderPass(device, &renderPassInfo, nullptr, &m_renderPass));
+    PLASTER_VK_NAME(device, VK_OBJECT_TYPE_RENDER_PASS, m_renderPass, "Present render pass");
+}
+
+void Renderer::createSceneRenderPass() {
+    VkDevice device = m_vulkanContext->getDevice();
+
+    std::array<VkAttachmentDescription, 2> attachments{};
+    attachments[0].format = m_sceneColorFormat;
+    attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
+    attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    attachments[0].finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    attachments[1].format = m_sceneDepthFormat;
+    attachments[1].samples = VK_SAMPLE_COUNT_1_BIT;
+    attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    attachments[1].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    attachments[1].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    attachments[1].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    attachments[1].finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    VkAttachmentReference colorAttachmentRef{0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+    VkAttachmentReference depthAttachmentRef{1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+
+    VkSubpassDescription subpass{};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount = 1;
+    subpass.pColorAttachments = &colorAttachmentRef;
+    subpass.pDepthStencilAttachment = &depthAttachmentRef;
+
+    // In: the previous frame's post chain and depth pyramid may still be reading the targets.
+    // Out: the post chain samples the color target and the depth pyramid the depth from compute.
+    std::array<VkSubpassDependency, 2> dependencies{};
+    dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+    dependencies[0].dstSubpass = 0;
+    dependencies[0].srcStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT |
+                                   VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+                                   VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    dependencies[0].srcAccessMask = 0;
+    dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+                                   VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+    dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+    dependencies[1].srcSubpass = 0;
+    dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+    dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+                                   VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    dependencies[1].dstStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+    VkRenderPassCreateInfo renderPassInfo{};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+    renderPassInfo.pAttachments = attachments.data();
+    renderPassInfo.subpassCount = 1;
+    renderPassInfo.pSubpasses = &subpass;
+    renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+    renderPassInfo.pDependencies = dependencies.data();
+
+    PLASTER_VK_CHECK(vkCreateRenderPass(device, &renderPassInfo, nullptr, &m_sceneRenderPass));
+    PLASTER_VK_NAME(device, VK_OBJECT_TYPE_RENDER_PASS, m_sceneRenderPass, "Scene render pass");
+}
+
+void Renderer::createShadowRenderPass() {
+    VkDevice device = m_vulkanContext->getDevice();
+
+    // Kept across passes: ShadowCascades clears and redraws only parts of the
+    // atlas, and does its own layout transitions around the pass
+    VkAttachmentDescription attachment{};
+    attachment.format = m_sceneDepthFormat;
+    attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    attachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+    attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    attachment.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    attachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    VkAttachmentReference depthAttachmentRef{0, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+
+    VkSubpassDescription subpass{};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.pDepthStencilAttachment = &depthAttachmentRef;
+
+    VkRenderPassCreateInfo renderPassInfo{};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    renderPassInfo.attachmentCount = 1;
+    renderPassInfo.pAttachments = &attachment;
+    renderPassInfo.subpassCount = 1;
+    renderPassInfo.pSubpasses = &subpass;
+
+    PLASTER_VK_CHECK(vkCreateRenderPass(device, &renderPassInfo, nullptr, &m_shadowRenderPass));
+    PLASTER_VK_NAME(device, VK_OBJECT_TYPE_RENDER_PASS, m_shadowRenderPass, "Shadow render pass");
+}
+
+void Renderer::chooseSceneFormats() {
+    VkPhysicalDevice physicalDevice = m_vulkanContext->getPhysicalDevice();
+    auto supports = [physicalDevice](VkFormat format, VkFormatFeatureFlags features) {
+        VkFormatProperties properties;
+        vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &properties);
+        return (properties.optimalTilingFeatures & features) == features;
+    };
+
+    // Half the bandwidth of RGBA16F for every scene and bloom prefilter access;
+    // the scene has no use for alpha
+    VkFormatFeatureFlags colorFeatures = VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT |
+                                         VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    m_sceneColorFormat = supports(VK_FORMAT_B10G11R11_UFLOAT_PACK32, colorFeatures)
+                             ? VK_FORMAT_B10G11R11_UFLOAT_PACK32 : VK_FORMAT_R16G16B16A16_SFLOAT;
+
+    // The spec guarantees one of the two; the depth pyramid samples it
+    VkFormatFeatureFlags depthFeatures = VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT |
+                                         VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT;
+    m_sceneDepthFormat = supports(VK_FORMAT_D32_SFLOAT, depthFeatures)
+                             ? VK_FORMAT_D32_SFLOAT : VK_FORMAT_X8_D24_UNORM_PACK32;
+}
+
+void Renderer::createSceneTargets() {
+    VkDevice device = m_vulkanContext->getDevice();
+
+    m_sceneTargetExtent.width =
+        std::max(1u, static_cast<uint32_t>(m_swapchainExtent.width * m_maxRenderScale + 0.5f));
+    m_sceneTargetExtent.height =
+        std::max(1u, static_cast<uint32_t>(m_swapchainExtent.height * m_maxRenderScale + 0.5f));
+    updateSceneExtent();
+
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.format = m_sceneColorFormat;
+    imageInfo.extent = {m_sceneTargetExtent.width, m_sceneTargetExtent.height, 1};
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    m_vulkanContext->createImage(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_sceneColorImage,
+                                 m_sceneColorMemory);
+    m_sceneColorView = createTargetView(device, m_sceneColorImage, m_sceneColorFormat, VK_IMAGE_ASPECT_COLOR_BIT);
+    PLASTER_VK_NAME(device, VK_OBJECT_TYPE_IMAGE, m_sceneColorImage, "Scene color");
+
+    imageInfo.format = m_sceneDepthFormat;
+    imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    m_vulkanContext->createImage(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_sceneDepthImage,
+                                 m_sceneDepthMemory);
+    m_sceneDepthView = createTargetView(device, m_sceneDepthImage, m_sceneDepthFormat, VK_IMAGE_ASPECT_DEPTH_BIT);
+    PLASTER_VK_NAME(device, VK_OBJECT_TYPE_IMAGE, m_sceneDepthImage, "Scene depth");
+
+    if (m_renderPath == RenderPath::RenderPass) {
+        VkImageView attachments[] = {m_sceneColorView, m_sceneDepthView};
+
+        VkFramebufferCreateInfo framebufferInfo{};
+        framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        framebufferInfo.renderPass = m_sceneRenderPass;
+        framebufferInfo.attachmentCount = 2;
+        framebufferInfo.pAttachments = attachments;
+        framebufferInfo.width = m_sceneTargetExtent.width;
+        framebufferInfo.height = m_sceneTargetExtent.height;
+        framebufferInfo.layers = 1;
+
+        PLASTER_VK_CHECK(vkCreateFramebuffer(device, &framebufferInfo, nullptr, &m_sceneFramebuffer));
+    }
+}
+
+void Renderer::releaseSceneTargets() {
+    m_deletionQueue->release(m_sceneFramebuffer);
+    m_deletionQueue->release(m_sceneColorImage, m_sceneColorMemory, m_sceneColorView);
+    m_deletionQueue->release(m_sceneDepthImage, m_sceneDepthMemory, m_sceneDepthView);
+    m_sceneFramebuffer = VK_NULL_HANDLE;
+    m_sceneColorImage = VK_NULL_HANDLE;
+    m_sceneDepthImage = VK_NULL_HANDLE;
+}
+
+void Renderer::rebuildSceneTargets() {
+    // The frames in flight keep using the old targets until they retire
+    releaseSceneTargets();
+    createSceneTargets();
+    m_postProcess->resize(m_sceneColorView, m_sceneTargetExtent);
+    if (m_meshletRenderer) {
+        m_meshletRenderer->resize(m_sceneDepthView, m_sceneTargetExtent);
+    }
+    m_sceneTargetsDirty = false;
+}
+
+void Renderer::updateSceneExtent() {
+    // Never larger than m_sceneTargetExtent, as the scale is at most m_maxRenderScale
+    m_sceneExtent.width = std::max(1u, static_cast<uint32_t>(m_swapchainExtent.width * m_renderScale + 0.5f));
+    m_sceneExtent.height = std::max(1u, static_cast<uint32_t>(m_swapchainExtent.height * m_renderScale + 0.5f));
+}
+
+void Renderer::setRenderScale(float scale) {
+    waitForRenderThread();
+    m_renderScale = std::clamp(scale, 0.25f, m_maxRenderScale);
+    updateSceneExtent();
+}
+
+void Renderer::setCamera(const glm::mat4& view, const glm::mat4& projection) {
+    m_view = view;
+    m_projection = projection;
+    m_lodSelector->setCamera(view, projection, static_cast<float>(m_sceneExtent.height));
+}
+
+void Renderer::writeFrameConstants() {
+    auto now = std::chrono::steady_clock::now();
+
+    FrameConstants constants;
+    constants.view = m_view;
+    constants.projection = m_projection;
+    constants.viewProjection = m_projection * m_view;
+    constants.cameraPosition = glm::inverse(m_view)[3];
+    m_frameDeltaTime = std::chrono::duration<float>(now - m_lastFrameTime).count();
+    constants.time = glm::vec4(std::chrono::duration<float>(now - m_startTime).count(), m_frameDeltaTime,
+                               static_cast<float>(m_frameNumber), 0.0f);
+    constants.viewport = glm::vec4(m_sceneExtent.width, m_sceneExtent.height,
+                                   1.0f / m_sceneExtent.width, 1.0f / m_sceneExtent.height);
+    m_frameConstantsOffset = m_uniformRing->push(constants);
+    m_lastFrameTime = now;
+}
+
+void Renderer::setMaxRenderScale(float scale) {
+    waitForRenderThread();
+    scale = std::clamp(scale, 0.25f, 2.0f);
+    if (scale != m_maxRenderScale) {
+        m_maxRenderScale = scale;
+        m_sceneTargetsDirty = true;
+        m_dynamicResolution.getSettings().maxScale = scale;
+        setRenderScale(m_renderScale);
+    }
 }
 
 void Renderer::createFramebuffers() {
@@ -242,7 +721,7 @@ void Renderer::createFramebuffers() {
         framebufferInfo.height = m_swapchainExtent.height;
         framebufferInfo.layers = 1;
 
-        vkCreateFramebuffer(device, &framebufferInfo, nullptr, &m_framebuffers[i]);
+        PLASTER_VK_CHECK(vkCreateFramebuffer(device, &framebufferInfo, nullptr, &m_framebuffers[i]));
     }
 }
 
@@ -254,7 +733,7 @@ void Renderer::createCommandPool() {
     poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
     poolInfo.queueFamilyIndex = m_vulkanContext->getGraphicsQueueFamily();
 
-    vkCreateCommandPool(device, &poolInfo, nullptr, &m_commandPool);
+    PLASTER_VK_CHECK(vkCreateCommandPool(device, &poolInfo, nullptr, &m_commandPool));
 }
 
 void Renderer::createCommandBuffers() {
@@ -268,7 +747,11 @@ void Renderer::createCommandBuffers() {
     allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
     allocInfo.commandBufferCount = static_cast<uint32_t>(m_commandBuffers.size());
 
-    vkAllocateCommandBuffers(device, &allocInfo, m_commandBuffers.data());
+    PLASTER_VK_CHECK(vkAllocateCommandBuffers(device, &allocInfo, m_commandBuffers.data()));
+    for (size_t i = 0; i < m_commandBuffers.size(); ++i) {
+        PLASTER_VK_NAME(device, VK_OBJECT_TYPE_COMMAND_BUFFER, m_commandBuffers[i],
+                        "Frame " + std::to_string(i) + " commands");
+    }
 }
 
 void Renderer::createSyncObjects() {
@@ -286,62 +769,509 @@ void Renderer::createSyncObjects() {
     fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
 
     for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-        vkCreateSemaphore(device, &semaphoreInfo, nullptr, &m_imageAvailableSemaphores[i]);
-        vkCreateSemaphore(device, &semaphoreInfo, nullptr, &m_renderFinishedSemaphores[i]);
-        vkCreateFence(device, &fenceInfo, nullptr, &m_inFlightFences[i]);
+        PLASTER_VK_CHECK(vkCreateSemaphore(device, &semaphoreInfo, nullptr, &m_imageAvailableSemaphores[i]));
+        PLASTER_VK_CHECK(vkCreateSemaphore(device, &semaphoreInfo, nullptr, &m_renderFinishedSemaphores[i]));
+        PLASTER_VK_CHECK(vkCreateFence(device, &fenceInfo, nullptr, &m_inFlightFences[i]));
+        PLASTER_VK_NAME(device, VK_OBJECT_TYPE_SEMAPHORE, m_imageAvailableSemaphores[i],
+                        "Frame " + std::to_string(i) + " image available");
+        PLASTER_VK_NAME(device, VK_OBJECT_TYPE_SEMAPHORE, m_renderFinishedSemaphores[i],
+                        "Frame " + std::to_string(i) + " render finished");
+        PLASTER_VK_NAME(device, VK_OBJECT_TYPE_FENCE, m_inFlightFences[i], "Frame " + std::to_string(i) + " in flight");
     }
 }
 
-void Renderer::recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex) {
-    VkCommandBufferBeginInfo beginInfo{};
-    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+void Renderer::createTimestampPool() {
+    VkPhysicalDevice physicalDevice = m_vulkanContext->getPhysicalDevice();
 
-    vkBeginCommandBuffer(commandBuffer, &beginInfo);
+    uint32_t queueFamilyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
 
-    VkRenderPassBeginInfo renderPassInfo{};
-    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-    renderPassInfo.renderPass = m_renderPass;
-    renderPassInfo.framebuffer = m_framebuffers[imageIndex];
-    renderPassInfo.renderArea.offset = {0, 0};
-    renderPassInfo.renderArea.extent = m_swapchainExtent;
+    uint32_t validBits = queueFamilies[m_vulkanContext->getGraphicsQueueFamily()].timestampValidBits;
+    if (validBits == 0) {
+        return;
+    }
+    m_timestampMask = validBits >= 64 ? UINT64_MAX : (1ull << validBits) - 1;
 
-    VkClearValue clearColor = {{{0.1f, 0.1f, 0.1f, 1.0f}}};
-    renderPassInfo.clearValueCount = 1;
-    renderPassInfo.pClearValues = &clearColor;
+    m_timestampPeriod = m_vulkanContext->getCapabilities().timestampPeriod;
 
-    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+    VkQueryPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    poolInfo.queryCount = MAX_FRAMES_IN_FLIGHT * 2;
 
-    // Render ImGui
-    m_imguiManager->render(commandBuffer);
+    PLASTER_VK_CHECK(vkCreateQueryPool(m_vulkanContext->getDevice(), &poolInfo, nullptr, &m_timestampPool));
+    PLASTER_VK_NAME(m_vulkanContext->getDevice(), VK_OBJECT_TYPE_QUERY_POOL, m_timestampPool, "Frame timestamps");
+    m_timestampsWritten.assign(MAX_FRAMES_IN_FLIGHT, false);
+}
 
-    vkCmdEndRenderPass(commandBuffer);
+bool Renderer::readTimestamps(uint32_t frame) {
+    if (!m_timestampPool || !m_timestampsWritten[frame]) {
+        return false;
+    }
 
-    vkEndCommandBuffer(commandBuffer);
+    // The frame's fence has signaled, so the results are available without waiting
+    uint64_t timestamps[2];
+    VkResult result = vkGetQueryPoolResults(m_vulkanContext->getDevice(), m_timestampPool, frame * 2, 2,
+                                            sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+    if (result == VK_SUCCESS) {
+        uint64_t ticks = (timestamps[1] - timestamps[0]) & m_timestampMask;
+        m_frameTimings.gpuMs = static_cast<float>(ticks * m_timestampPeriod / 1e6);
+        m_frameTimings.renderScale = m_frameRenderScales[frame];
+        static Gauge& gpuMs = Metrics::gauge("renderer.gpu_ms", "ms");
+        static Gauge& renderScale = Metrics::gauge("renderer.render_scale");
+        gpuMs.set(m_frameTimings.gpuMs);
+        renderScale.set(m_frameTimings.renderScale);
+        return true;
+    }
+    return false;
 }
 
-void Renderer::render() {
+void Renderer::recreateSwapchain() {
+    waitForRenderThread();
+    m_swapchainOutOfDate = false;
+
+    // A minimized window has no framebuffer to present to until it is restored
+    while (m_window->getWidth() == 0 || m_window->getHeight() == 0) {
+        m_window->waitEvents();
+    }
+    m_window->clearResized();
+
+    // Swapchain images aren't covered by the frame fences (presentation may
+    // still be reading them), so this is the one place that waits for idle
     VkDevice device = m_vulkanContext->getDevice();
+    vkDeviceWaitIdle(device);
+    m_deletionQueue->flush();
 
-    // Wait for previous frame
-    vkWaitForFences(device, 1, &m_inFlightFences[m_currentFrame], VK_TRUE, UINT64_MAX);
+    for (auto framebuffer : m_framebuffers) {
+        vkDestroyFramebuffer(device, framebuffer, nullptr);
+    }
+    m_framebuffers.clear();
+    for (auto imageView : m_swapchainImageViews) {
+        vkDestroyImageView(device, imageView, nullptr);
+    }
+    m_swapchainImageViews.clear();
 
-    // Acquire next image
-    uint32_t imageIndex;
-    VkResult result = vkAcquireNextImageKHR(device, m_swapchain, UINT64_MAX,
-                                            m_imageAvailableSemaphores[m_currentFrame],
-                                            VK_NULL_HANDLE, &imageIndex);
+    // The surface format doesn't change with the size, so the render pass and
+    // every pipeline built against it stay valid
+    VkSwapchainKHR oldSwapchain = m_swapchain;
+    createSwapchain(oldSwapchain);
+    vkDestroySwapchainKHR(device, oldSwapchain, nullptr);
 
-    if (result == VK_ERROR_OUT_OF_DATE_KHR) {
-        // Swapchain needs recreation (window resized)
+    createImageViews();
+    if (m_renderPath == RenderPath::RenderPass) {
+        createFramebuffers();
+    }
+    rebuildSceneTargets();
+}
+
+uint32_t Renderer::uploadMesh(const MeshData& mesh) {
+    return uploadMesh(mesh.vertices.data(), static_cast<uint32_t>(mesh.vertices.size()),
+                      mesh.indices.data(), static_cast<uint32_t>(mesh.indices.size()));
+}
+
+uint32_t Renderer::uploadMesh(const Vertex* vertices, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount) {
+    if (vertexCount == 0 || indexCount == 0) {
+        throw std::runtime_error("Cannot upload a mesh without vertices or indices");
+    }
+    // Shares the command pool and queue with the render thread
+    waitForRenderThread();
+    MeshAllocation allocation{};
+    uploadToDeviceLocal(vertices, vertexCount * sizeof(Vertex),
+                        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, allocation.vertexBuffer, allocation.vertexMemory);
+    uploadToDeviceLocal(indices, indexCount * sizeof(uint32_t),
+                        VK_BUFFER_USAGE_INDEX_BUFFER_BIT, allocation.indexBuffer, allocation.indexMemory);
+    m_meshAllocations.push_back(allocation);
+
+    GpuMesh gpuMesh;
+    gpuMesh.vertexBuffer = allocation.vertexBuffer;
+    gpuMesh.indexBuffer = allocation.indexBuffer;
+    gpuMesh.firstIndex = 0;
+    gpuMesh.indexCount = indexCount;
+    gpuMesh.vertexOffset = 0;
+    return m_drawBatcher->registerMesh(gpuMesh);
+}
+
+void Renderer::releaseMesh(uint32_t mesh) {
+    waitForRenderThread();
+    const GpuMesh& gpuMesh = m_drawBatcher->getMesh(mesh);
+    auto allocation = std::find_if(m_meshAllocations.begin(), m_meshAllocations.end(),
+                                   [&](const MeshAllocation& candidate) {
+                                       return candidate.vertexBuffer == gpuMesh.vertexBuffer &&
+                                              candidate.indexBuffer == gpuMesh.indexBuffer;
+                                   });
+    if (allocation == m_meshAllocations.end()) {
+        throw std::runtime_error("Mesh was not uploaded with uploadMesh");
+    }
+
+    m_deletionQueue->release(allocation->vertexBuffer, allocation->vertexMemory);
+    m_deletionQueue->release(allocation->indexBuffer, allocation->indexMemory);
+    *allocation = m_meshAllocations.back();
+    m_meshAllocations.pop_back();
+    m_drawBatcher->releaseMesh(mesh);
+}
+
+uint32_t Renderer::uploadSkinnedMesh(const SkinnedMeshData& mesh) {
+    if (mesh.vertices.empty() || mesh.indices.empty()) {
+        throw std::runtime_error("Cannot upload a mesh without vertices or indices");
+    }
+    waitForRenderThread();
+    MeshAllocation allocation{};
+    uploadToDeviceLocal(mesh.indices.data(), mesh.indices.size() * sizeof(uint32_t),
+                        VK_BUFFER_USAGE_INDEX_BUFFER_BIT, allocation.indexBuffer, allocation.indexMemory);
+    m_meshAllocations.push_back(allocation);
+
+    // Vertices go into the skinning pass's shared source buffer instead of their own
+    uint32_t id = m_skinningPass->addMesh(static_cast<uint32_t>(mesh.vertices.size()), allocation.indexBuffer,
+                                          static_cast<uint32_t>(mesh.indices.size()));
+    copyToBuffer(mesh.vertices.data(), mesh.vertices.size() * sizeof(SkinnedVertex),
+                 m_skinningPass->getSourceBuffer(), m_skinningPass->getSourceOffset(id));
+    return id;
+}
+
+uint32_t Renderer::addSkinnedInstance(uint32_t skinnedMesh, uint32_t paletteOffset) {
+    waitForRenderThread();
+    return m_drawBatcher->registerMesh(m_skinningPass->addInstance(skinnedMesh, paletteOffset));
+}
+
+uint32_t Renderer::uploadLodMesh(const MeshData& mesh, const MeshLodData& lods) {
+    return uploadLodMesh(mesh.vertices.data(), static_cast<uint32_t>(mesh.vertices.size()), lods.levels.data(),
+                         static_cast<uint32_t>(lods.levels.size()), lods.indices.data(),
+                         static_cast<uint32_t>(lods.indices.size()));
+}
+
+uint32_t Renderer::uploadLodMesh(const Vertex* vertices, uint32_t vertexCount, const MeshLodLevel* levels,
+                                 uint32_t levelCount, const uint32_t* indices, uint32_t indexCount) {
+    if (vertexCount == 0 || levelCount == 0 || indexCount == 0) {
+        throw std::runtime_error("Cannot upload a mesh without vertices, levels or indices");
+    }
+    waitForRenderThread();
+    // One vertex buffer and one index buffer for the whole chain
+    MeshAllocation allocation{};
+    uploadToDeviceLocal(vertices, vertexCount * sizeof(Vertex),
+                        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, allocation.vertexBuffer, allocation.vertexMemory);
+    uploadToDeviceLocal(indices, indexCount * sizeof(uint32_t),
+                        VK_BUFFER_USAGE_INDEX_BUFFER_BIT, allocation.indexBuffer, allocation.indexMemory);
+    m_meshAllocations.push_back(allocation);
+
+    std::vector<uint32_t> levelMeshes(levelCount);
+    std::vector<float> errors(levelCount);
+    std::vector<uint32_t> triangleCounts(levelCount);
+    for (uint32_t level = 0; level < levelCount; ++level) {
+        GpuMesh gpuMesh;
+        gpuMesh.vertexBuffer = allocation.vertexBuffer;
+        gpuMesh.indexBuffer = allocation.indexBuffer;
+        gpuMesh.firstIndex = levels[level].firstIndex;
+        gpuMesh.indexCount = levels[level].indexCount;
+        gpuMesh.vertexOffset = 0;
+        levelMeshes[level] = m_drawBatcher->registerMesh(gpuMesh);
+        errors[level] = levels[level].error;
+        triangleCounts[level] = levels[level].indexCount / 3;
+    }
+
+    glm::vec3 lower(FLT_MAX);
+    glm::vec3 upper(-FLT_MAX);
+    for (uint32_t i = 0; i < vertexCount; ++i) {
+        lower = glm::min(lower, vertices[i].position);
+        upper = glm::max(upper, vertices[i].position);
+    }
+    glm::vec3 center = (lower + upper) * 0.5f;
+    float radius = 0.0f;
+    for (uint32_t i = 0; i < vertexCount; ++i) {
+        radius = std::max(radius, glm::length(vertices[i].position - center));
+    }
+    return m_lodSelector->addMesh(levelMeshes.data(), errors.data(), triangleCounts.data(), levelCount, center,
+                                  radius);
+}
+
+uint32_t Renderer::uploadMeshletMesh(const MeshData& mesh, const MeshletData& meshlets) {
+    return uploadMeshletMesh(mesh.vertices.data(), static_cast<uint32_t>(mesh.vertices.size()),
+                             meshlets.meshlets.data(), static_cast<uint32_t>(meshlets.meshlets.size()),
+                             meshlets.vertices.data(), static_cast<uint32_t>(meshlets.vertices.size()),
+                             meshlets.triangles.data(), static_cast<uint32_t>(meshlets.triangles.size()));
+}
+
+uint32_t Renderer::uploadMeshletMesh(const Vertex* vertices, uint32_t vertexCount, const Meshlet* meshlets,
+                                     uint32_t meshletCount, const uint32_t* meshletVertices,
+                                     uint32_t meshletVertexCount, const uint8_t* triangles,
+                                     uint32_t triangleByteCount) {
+    waitForRenderThread();
+    uint32_t id = m_meshletRenderer->addMesh(vertexCount, meshletCount, meshletVertexCount, triangleByteCount);
+    MeshletRenderer::UploadOffsets offsets = m_meshletRenderer->getUploadOffsets(id);
+    copyToBuffer(vertices, vertexCount * sizeof(Vertex), m_meshletRenderer->getVertexBuffer(), offsets.vertices);
+    copyToBuffer(meshlets, meshletCount * sizeof(Meshlet), m_meshletRenderer->getMeshletBuffer(), offsets.meshlets);
+    copyToBuffer(meshletVertices, meshletVertexCount * sizeof(uint32_t), m_meshletRenderer->getMeshletVertexBuffer(),
+                 offsets.meshletVertices);
+    copyToBuffer(triangles, triangleByteCount, m_meshletRenderer->getTriangleBuffer(), offsets.triangles);
+    return id;
+}
+
+uint32_t Renderer::addMeshletInstance(uint32_t meshletMesh, const glm::mat4& transform) {
+    return m_meshletRenderer->addInstance(meshletMesh, transform);
+}
+
+void Renderer::uploadToDeviceLocal(const void* data, VkDeviceSize size, VkBufferUsageFlags usage,
+                                   VkBuffer& buffer, VkDeviceMemory& memory) {
+    // Zero-sized buffers are invalid usage
+    if (size == 0) {
+        throw std::runtime_error("Cannot create an empty device-local buffer");
+    }
+    m_vulkanContext->createBuffer(size, usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer, memory);
+    copyToBuffer(data, size, buffer, 0);
+}
+
+void Renderer::copyToBuffer(const void* data, VkDeviceSize size, VkBuffer buffer, VkDeviceSize offset) {
+    // Nothing to stage, and a zero-sized staging buffer would be invalid usage
+    if (size == 0) {
         return;
     }
+    VkDevice device = m_vulkanContext->getDevice();
+
+    VkBuffer stagingBuffer;
+    VkDeviceMemory stagingMemory;
+    m_vulkanContext->createBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                  VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                  stagingBuffer, stagingMemory);
+
+    void* mapped = nullptr;
+    vkMapMemory(device, stagingMemory, 0, size, 0, &mapped);
+    std::memcpy(mapped, data, static_cast<size_t>(size));
+    vkUnmapMemory(device, stagingMemory);
+
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.commandPool = m_commandPool;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount = 1;
+
+    VkCommandBuffer commandBuffer;
+    PLASTER_VK_CHECK(vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer));
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    PLASTER_VK_CHECK(vkBeginCommandBuffer(commandBuffer, &beginInfo));
+
+    VkBufferCopy copyRegion{};
+    copyRegion.dstOffset = offset;
+    copyRegion.size = size;
+    vkCmdCopyBuffer(commandBuffer, stagingBuffer, buffer, 1, &copyRegion);
+
+    PLASTER_VK_CHECK(vkEndCommandBuffer(commandBuffer));
+
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &commandBuffer;
+
+    PLASTER_VK_CHECK(vkQueueSubmit(m_vulkanContext->getGraphicsQueue(), 1, &submitInfo, VK_NULL_HANDLE));
+    PLASTER_VK_CHECK(vkQueueWaitIdle(m_vulkanContext->getGraphicsQueue()));
+    static Counter& meshBytes = Metrics::counter("upload.mesh_bytes", "bytes");
+    meshBytes.add(size);
+
+    vkFreeCommandBuffers(device, m_commandPool, 1, &commandBuffer);
+    vkDestroyBuffer(device, stagingBuffer, nullptr);
+    vkFreeMemory(device, stagingMemory, nullptr);
+}
+
+void Renderer::recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t frameIndex, uint32_t imageIndex) {
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+
+    PLASTER_VK_CHECK(vkBeginCommandBuffer(commandBuffer, &beginInfo));
+
+    m_frameRenderScales[frameIndex] = m_renderScale;
+
+    if (m_timestampPool) {
+        vkCmdResetQueryPool(commandBuffer, m_timestampPool, frameIndex * 2, 2);
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_timestampPool, frameIndex * 2);
+    }
 
-    vkResetFences(device, 1, &m_inFlightFences[m_currentFrame]);
+    std::array<VkClearValue, 2> sceneClear{};
+    sceneClear[0].color = {{0.1f, 0.1f, 0.1f, 1.0f}};
+    sceneClear[1].depthStencil = {1.0f, 0};
+
+    // Skinned vertices for every pass below that draws animated meshes
+    m_skinningPass->record(commandBuffer, m_descriptorAllocator.get());
+
+    // Meshlet culling against last frame's depth pyramid, and the indices of the survivors
+    m_meshletRenderer->record(commandBuffer, frameIndex, m_descriptorAllocator.get());
+
+    // Cascades due this frame, into the atlas the scene pass samples
+    m_shadows->record(commandBuffer, frameIndex);
+
+    // Lights binned into the clusters every scene pipeline shades with
+    m_lighting->record(commandBuffer, frameIndex, m_descriptorAllocator.get());
+
+    // Particle simulation and sorting, drawn after the opaque geometry
+    m_particleSystem->record(commandBuffer, m_descriptorAllocator.get(), m_frameSet, m_frameConstantsOffset);
+
+    // Scene geometry into the HDR target, sorted and instanced
+    {
+        PLASTER_VK_LABEL(commandBuffer, "Scene");
+        if (m_renderPath == RenderPath::DynamicRendering) {
+            // Only the previous frame's post chain and depth pyramid read these, and their contents are dropped
+            transitionImage(commandBuffer, m_sceneColorImage, VK_IMAGE_LAYOUT_UNDEFINED,
+                            VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+                            VK_ACCESS_2_NONE, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+                            VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT);
+            transitionImage(commandBuffer, m_sceneDepthImage, VK_IMAGE_LAYOUT_UNDEFINED,
+                            VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+                            VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+                            VK_ACCESS_2_NONE,
+                            VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+                            VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                                VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                            VK_IMAGE_ASPECT_DEPTH_BIT);
+
+            VkRenderingAttachmentInfo colorAttachment{};
+            colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+            colorAttachment.imageView = m_sceneColorView;
+            colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+            colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+            colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+            colorAttachment.clearValue = sceneClear[0];
+
+            VkRenderingAttachmentInfo depthAttachment{};
+            depthAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+            depthAttachment.imageView = m_sceneDepthView;
+            depthAttachment.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+            depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+            depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+            depthAttachment.clearValue = sceneClear[1];
+
+            VkRenderingInfo renderingInfo{};
+            renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+            renderingInfo.renderArea.offset = {0, 0};
+            renderingInfo.renderArea.extent = m_sceneExtent;
+            renderingInfo.layerCount = 1;
+            renderingInfo.colorAttachmentCount = 1;
+            renderingInfo.pColorAttachments = &colorAttachment;
+            renderingInfo.pDepthAttachment = &depthAttachment;
+
+            vkCmdBeginRendering(commandBuffer, &renderingInfo);
+        } else {
+            VkRenderPassBeginInfo renderPassInfo{};
+            renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+            renderPassInfo.renderPass = m_sceneRenderPass;
+            renderPassInfo.framebuffer = m_sceneFramebuffer;
+            renderPassInfo.renderArea.offset = {0, 0};
+            renderPassInfo.renderArea.extent = m_sceneExtent;
+            renderPassInfo.clearValueCount = static_cast<uint32_t>(sceneClear.size());
+            renderPassInfo.pClearValues = sceneClear.data();
+
+            vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+        }
+
+        setViewportAndScissor(commandBuffer, m_sceneExtent);
+        m_drawBatcher->record(commandBuffer, frameIndex, m_frameSet, m_frameConstantsOffset,
+                              m_lighting->getShadingSet(), m_lighting->getShadingOffset());
+        m_meshletRenderer->draw(commandBuffer, m_descriptorAllocator.get(), m_frameSet, m_frameConstantsOffset,
+                                m_lighting->getShadingSet(), m_lighting->getShadingOffset());
+        m_particleSystem->draw(commandBuffer, m_descriptorAllocator.get(), m_frameSet, m_frameConstantsOffset);
+
+        if (m_renderPath == RenderPath::DynamicRendering) {
+            vkCmdEndRendering(commandBuffer);
+            transitionImage(commandBuffer, m_sceneColorImage, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+                            VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+                            VK_ACCESS_2_SHADER_SAMPLED_READ_BIT);
+            transitionImage(commandBuffer, m_sceneDepthImage, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+                            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+                            VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+                            VK_ACCESS_2_SHADER_SAMPLED_READ_BIT, VK_IMAGE_ASPECT_DEPTH_BIT);
+        } else {
+            // The render pass' final layout and outgoing dependency cover the transition
+            vkCmdEndRenderPass(commandBuffer);
+        }
+    }
+
+    // Tested against by the next frame's meshlet culling
+    m_meshletRenderer->recordDepthPyramid(commandBuffer, m_descriptorAllocator.get());
+
+    // Bloom and tonemapping at the internal resolution
+    m_postProcess->record(commandBuffer, m_descriptorAllocator.get(), m_sceneExtent);
+
+    if (m_renderPath == RenderPath::DynamicRendering) {
+        // Waits on the acquire semaphore's stage, so nothing before it needs ordering
+        transitionImage(commandBuffer, m_swapchainImages[imageIndex], VK_IMAGE_LAYOUT_UNDEFINED,
+                        VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+                        VK_ACCESS_2_NONE, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+                        VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT);
+
+        VkRenderingAttachmentInfo colorAttachment{};
+        colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+        colorAttachment.imageView = m_swapchainImageViews[imageIndex];
+        colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+
+        VkRenderingInfo renderingInfo{};
+        renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+        renderingInfo.renderArea.offset = {0, 0};
+        renderingInfo.renderArea.extent = m_swapchainExtent;
+        renderingInfo.layerCount = 1;
+        renderingInfo.colorAttachmentCount = 1;
+        renderingInfo.pColorAttachments = &colorAttachment;
+
+        vkCmdBeginRendering(commandBuffer, &renderingInfo);
+    } else {
+        VkRenderPassBeginInfo renderPassInfo{};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        renderPassInfo.renderPass = m_renderPass;
+        renderPassInfo.framebuffer = m_framebuffers[imageIndex];
+        renderPassInfo.renderArea.offset = {0, 0};
+        renderPassInfo.renderArea.extent = m_swapchainExtent;
+
+        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+    }
 
-    // Record command buffer
-    vkResetCommandBuffer(m_commandBuffers[m_currentFrame], 0);
+    setViewportAndScissor(commandBuffer, m_swapchainExtent);
 
-    // ImGui frame
+    // Upscale to the swapchain, then ImGui on top at native resolution
+    m_postProcess->composite(commandBuffer, m_descriptorAllocator.get(), m_sceneExtent);
+    {
+        PLASTER_VK_LABEL(commandBuffer, "ImGui");
+        m_imguiManager->render(commandBuffer, frameIndex);
+    }
+
+    if (m_renderPath == RenderPath::DynamicRendering) {
+        vkCmdEndRendering(commandBuffer);
+
+        // Presentation waits on the render finished semaphore, which covers visibility
+        transitionImage(commandBuffer, m_swapchainImages[imageIndex], VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                        VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+                        VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT, VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE);
+    } else {
+        vkCmdEndRenderPass(commandBuffer);
+    }
+
+    if (m_timestampPool) {
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_timestampPool,
+                            frameIndex * 2 + 1);
+        m_timestampsWritten[frameIndex] = true;
+    }
+
+    PLASTER_VK_CHECK(vkEndCommandBuffer(commandBuffer));
+}
+
+void Renderer::waitIdle() {
+    waitForRenderThread();
+    vkDeviceWaitIdle(m_vulkanContext->getDevice());
+}
+
+void Renderer::waitForRenderThread() {
+    m_renderThread->wait();
+}
+
+void Renderer::render() {
+    VkDevice device = m_vulkanContext->getDevice();
+
+    // The UI is built while the render thread is still recording the previous
+    // frame, so the panel edits copies of what recording reads and they are
+    // applied once it has finished
     m_imguiManager->newFrame();
     
     ImGui::SetNextWindowPos(ImVec2(10, 10), ImGuiCond_FirstUseEver);
@@ -350,6 +1280,102 @@ void Renderer::render() {
     ImGui::Begin("PlasterEngine");
     ImGui::Text("Welcome to PlasterEngine!");
     ImGui::Text("FPS: %.1f", ImGui::GetIO().Framerate);
+    ImGui::Text("Draw calls: %zu (%u objects)", m_drawBatcher->getBatches().size(),
+                m_drawBatcher->getSubmittedCount());
+
+    TextureStreamingStats textureStats = m_textureStreamer->getStats();
+    ImGui::Text("Textures: %u (%u pending), %.1f / %.1f MB", textureStats.textureCount,
+                textureStats.pendingPromotions, textureStats.residentBytes / (1024.0 * 1024.0),
+                textureStats.budgetBytes / (1024.0 * 1024.0));
+    ImGui::Text("Pipelines: %u (%u compiling)", m_pipelineManager->getPipelineCount(),
+                m_pipelineManager->getPendingCount());
+    ImGui::Text("Deferred deletions: %zu", m_deletionQueue->getPendingCount());
+    ImGui::Text("Uniform ring: %.1f / %.1f KB per frame%s", m_uniformRing->getUsed() / 1024.0f,
+                m_uniformRing->getFrameSize() / 1024.0f, m_uniformRing->isCoherent() ? "" : ", flushed");
+    ImGui::Text("Skinned instances: %u", m_skinningPass->getInstanceCount());
+    FrameArenaStats arenaStats = FrameArena::getStats();
+    ImGui::Text("Frame arenas: %u threads, %.1f / %.1f KB (peak %.1f KB, %u chunks)", arenaStats.threadCount,
+                arenaStats.usedBytes / 1024.0f, arenaStats.capacityBytes / 1024.0f, arenaStats.peakBytes / 1024.0f,
+                arenaStats.chunkCount);
+    ImGui::Text("%s: CPU %.2f ms, GPU %.2f ms",
+                m_renderPath == RenderPath::DynamicRendering ? "Dynamic rendering" : "Render pass",
+                m_frameTimings.cpuRecordMs, m_frameTimings.gpuMs);
+
+    ImGui::Separator();
+    ImGui::Text("Scene %ux%u of %ux%u %s", m_sceneExtent.width, m_sceneExtent.height, m_sceneTargetExtent.width,
+                m_sceneTargetExtent.height,
+                m_sceneColorFormat == VK_FORMAT_B10G11R11_UFLOAT_PACK32 ? "B10G11R11" : "RGBA16F");
+    DynamicResolutionSettings& dynamicResolution = m_dynamicResolution.getSettings();
+    ImGui::Checkbox("Dynamic resolution", &dynamicResolution.enabled);
+    float renderScale = m_renderScale;
+    bool renderScaleChanged = false;
+    if (dynamicResolution.enabled) {
+        ImGui::SliderFloat("Target GPU ms", &dynamicResolution.targetMs, 4.0f, 50.0f, "%.1f");
+        ImGui::SliderFloat("Min scale", &dynamicResolution.minScale, 0.25f, 1.0f, "%.2f");
+        ImGui::Text("Render scale %.2f, GPU %.2f ms smoothed", m_renderScale, m_dynamicResolution.getSmoothedMs());
+    } else {
+        renderScaleChanged = ImGui::SliderFloat("Render scale", &renderScale, 0.25f, m_maxRenderScale, "%.2f");
+    }
+    float maxRenderScale = m_maxRenderScale;
+    bool maxRenderScaleChanged = ImGui::SliderFloat("Max scale", &maxRenderScale, 0.25f, 2.0f, "%.2f");
+    PostProcessSettings post = m_postProcess->getSettings();
+    ImGui::SliderFloat("Exposure", &post.exposure, 0.1f, 8.0f, "%.2f");
+    ImGui::Checkbox("Bloom", &post.bloom);
+    if (post.bloom) {
+        ImGui::SliderFloat("Bloom threshold", &post.bloomThreshold, 0.0f, 4.0f, "%.2f");
+        ImGui::SliderFloat("Bloom intensity", &post.bloomIntensity, 0.0f, 0.5f, "%.3f");
+        ImGui::SliderFloat("Bloom radius", &post.bloomRadius, 0.5f, 3.0f, "%.2f");
+    }
+    ParticleEmitterSettings particles = m_particleSystem->getSettings();
+    ImGui::Checkbox("Particles", &particles.enabled);
+    if (particles.enabled) {
+        ImGui::SameLine();
+        ImGui::Text("(capacity %u)", m_particleSystem->getCapacity());
+        ImGui::SliderFloat("Emit rate", &particles.rate, 0.0f, 1000000.0f, "%.0f/s");
+        ImGui::SliderFloat("Max lifetime", &particles.maxLifetime, particles.minLifetime, 10.0f, "%.1f s");
+    }
+    const LodStats& lodStats = m_lodSelector->getStats();
+    ImGui::Text("LOD: %u selections, %.1fk of %.1fk triangles, %u switches", lodStats.selections,
+                lodStats.triangles / 1000.0f, lodStats.fullDetailTriangles / 1000.0f, lodStats.switches);
+    LodSettings lodSettings = m_lodSelector->getSettings();
+    ImGui::SliderFloat("LOD pixel error", &lodSettings.pixelError, 0.25f, 16.0f, "%.2f px");
+    ImGui::SliderFloat("LOD hysteresis", &lodSettings.hysteresis, 0.0f, 0.9f, "%.2f");
+    ShadowSettings shadows = m_shadows->getSettings();
+    const ShadowStats& shadowStats = m_shadows->getStats();
+    ImGui::Checkbox("Shadows", &shadows.enabled);
+    ImGui::SameLine();
+    ImGui::Text("%u casters, %u cascades updated (%u full), %u regions, %.2f Mtexels", shadowStats.casterCount,
+                shadowStats.cascadesUpdated, shadowStats.fullRenders, shadowStats.staticRegions,
+                shadowStats.staticTexels / 1000000.0f);
+    ImGui::Text("Shadow casters: %u static, %u dynamic instances in %u draws", shadowStats.staticInstances,
+                shadowStats.dynamicInstances, shadowStats.drawCalls);
+    ImGui::SliderFloat("Shadow distance", &shadows.maxDistance, 20.0f, 1000.0f, "%.0f");
+    ImGui::Checkbox("Cache static casters", &shadows.cacheStatic);
+    ImGui::SameLine();
+    ImGui::Checkbox("Alternate distant cascades", &shadows.alternateDistant);
+    LightingSettings lighting = m_lighting->getSettings();
+    const LightingStats& lightingStats = m_lighting->getStats();
+    ImGui::Text("Lights: %u of %u binned, %u indices in %u of %u clusters (max %u, %u overflowed)",
+                lightingStats.visibleLights, lightingStats.lightCount, lightingStats.lightIndices,
+                lightingStats.occupiedClusters, LIGHT_CLUSTER_COUNT, lightingStats.maxClusterLights,
+                lightingStats.overflowedClusters);
+    ImGui::SliderFloat("Light cluster far depth", &lighting.farDepth, 10.0f, 2000.0f, "%.0f");
+    ImGui::Checkbox("Light heatmap", &lighting.heatmap);
+    if (lighting.heatmap) {
+        ImGui::SameLine();
+        ImGui::SliderFloat("Red at", &lighting.heatmapScale, 1.0f, 256.0f, "%.0f lights");
+    }
+    MeshletCullSettings meshletCulling = m_meshletRenderer->getSettings();
+    const MeshletCullStats& meshletStats = m_meshletRenderer->getStats();
+    ImGui::Text("Meshlets: %u instances, %u clusters, %u triangles visible", m_meshletRenderer->getInstanceCount(),
+                meshletStats.visibleClusters, meshletStats.visibleTriangles);
+    ImGui::Text("Culled: %u frustum, %u cone, %u occlusion", meshletStats.frustumCulled, meshletStats.coneCulled,
+                meshletStats.occlusionCulled);
+    ImGui::Checkbox("Frustum culling", &meshletCulling.frustum);
+    ImGui::SameLine();
+    ImGui::Checkbox("Cone culling", &meshletCulling.cone);
+    ImGui::SameLine();
+    ImGui::Checkbox("Occlusion culling", &meshletCulling.occlusion);
     
     ImGui::Separator();
     ImGui::Text("Input System Test:");
@@ -371,27 +1397,163 @@ void Renderer::render() {
     
     ImGui::End();
 
-    ImGui::Render();
+    drawMetricsPanel();
+    m_imguiManager->endFrame(m_currentFrame);
 
-    recordCommandBuffer(m_commandBuffers[m_currentFrame], imageIndex);
+    {
+        static Histogram& renderThreadWait = Metrics::histogram("renderer.render_thread_wait_us");
+        ScopedTimer timer(renderThreadWait);
+        waitForRenderThread();
+    }
+    m_frameTimings.cpuRecordMs = m_recordMs;
+    Metrics::collect();
+
+    if (maxRenderScaleChanged) {
+        setMaxRenderScale(maxRenderScale);
+    }
+    if (renderScaleChanged) {
+        setRenderScale(renderScale);
+    }
+    m_postProcess->getSettings() = post;
+    m_particleSystem->getSettings() = particles;
+    m_meshletRenderer->getSettings() = meshletCulling;
+    m_lodSelector->getSettings() = lodSettings;
+    m_lighting->getSettings() = lighting;
+    m_shadows->getSettings() = shadows;
+
+    if (m_swapchainOutOfDate || m_window->wasResized()) {
+        recreateSwapchain();
+    }
+    if (m_sceneTargetsDirty) {
+        rebuildSceneTargets();
+    }
+
+    // Wait for previous frame
+    {
+        static Histogram& fenceWait = Metrics::histogram("renderer.fence_wait_us");
+        ScopedTimer timer(fenceWait);
+        PLASTER_VK_CHECK(vkWaitForFences(device, 1, &m_inFlightFences[m_currentFrame], VK_TRUE, UINT64_MAX));
+    }
+    if (readTimestamps(m_currentFrame)) {
+        setRenderScale(m_dynamicResolution.update(m_frameTimings.gpuMs, m_frameTimings.renderScale, m_renderScale));
+    }
+
+    // Acquire next image
+    uint32_t imageIndex;
+    VkResult result = vkAcquireNextImageKHR(device, m_swapchain, UINT64_MAX,
+                                            m_imageAvailableSemaphores[m_currentFrame],
+                                            VK_NULL_HANDLE, &imageIndex);
+
+    if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+        // Nothing was signaled, so the frame can simply be skipped
+        recreateSwapchain();
+        return;
+    }
+    PLASTER_VK_CHECK(result);
+
+    PLASTER_VK_CHECK(vkResetFences(device, 1, &m_inFlightFences[m_currentFrame]));
+
+    // The fence just waited on belonged to the frame MAX_FRAMES_IN_FLIGHT back
+    ++m_frameNumber;
+    if (m_frameNumber > MAX_FRAMES_IN_FLIGHT) {
+        m_deletionQueue->collect(m_frameNumber - MAX_FRAMES_IN_FLIGHT);
+    }
+    m_deletionQueue->beginFrame(m_frameNumber);
+    FrameArena::beginFrame(m_frameNumber, MAX_FRAMES_IN_FLIGHT);
+
+    // This frame's descriptor pools are no longer referenced by the GPU
+    m_descriptorAllocator->beginFrame(m_currentFrame);
+    m_drawBatcher->build(m_currentFrame);
+    {
+        // Selections made for the draws just built
+        const LodStats& lodStats = m_lodSelector->getStats();
+        static Gauge& lodTriangles = Metrics::gauge("lod.triangles");
+        static Gauge& lodSwitches = Metrics::gauge("lod.switches");
+        lodTriangles.set(static_cast<double>(lodStats.triangles));
+        lodSwitches.set(static_cast<double>(lodStats.switches));
+        m_lodSelector->resetStats();
+    }
+    m_textureStreamer->update(m_frameNumber);
+    m_shaderCache->update();
+    m_pipelineManager->update();
+    m_imguiManager->updateTextures(m_currentFrame);
+
+    m_uniformRing->beginFrame(m_currentFrame);
+    writeFrameConstants();
+    m_skinningPass->update();
+    m_meshletRenderer->update(m_currentFrame, m_projection * m_view, glm::vec3(glm::inverse(m_view)[3]),
+                              m_sceneExtent);
+    m_shadows->update(m_currentFrame, m_view, m_projection, m_lighting->getSettings().sunDirection);
+    m_lighting->update(m_currentFrame, m_view, m_projection);
+    m_particleSystem->update(m_frameDeltaTime);
+
+    // Recorded, submitted and presented while the caller moves on to the next frame
+    uint32_t frameIndex = m_currentFrame;
+    m_renderThread->run([this, frameIndex, imageIndex] { submitFrame(frameIndex, imageIndex); });
+
+    m_currentFrame = (m_currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+}
+
+void Renderer::drawMetricsPanel() {
+    ImGui::SetNextWindowPos(ImVec2(420, 10), ImGuiCond_FirstUseEver);
+    ImGui::SetNextWindowSize(ImVec2(420, 600), ImGuiCond_FirstUseEver);
+    if (ImGui::Begin("Metrics")) {
+        Metrics::forEach([](const MetricSnapshot& metric) {
+            float latest = 0.0f;
+            if (metric.historyCount > 0) {
+                latest = metric.history[(metric.historyOffset + metric.historyCount - 1) % Metrics::HISTORY_LENGTH];
+            }
+
+            char overlay[128];
+            const char* unit = metric.unit->c_str();
+            switch (metric.type) {
+            case MetricType::Counter:
+                std::snprintf(overlay, sizeof(overlay), "%.0f %s/frame, %.0f total", latest, unit, metric.value);
+                break;
+            case MetricType::Gauge:
+                std::snprintf(overlay, sizeof(overlay), "%.3f %s", latest, unit);
+                break;
+            case MetricType::Histogram:
+                std::snprintf(overlay, sizeof(overlay), "frame p99 %.0f, p50 %.0f p99 %.0f max %.0f %s", latest,
+                              metric.p50, metric.p99, metric.max, unit);
+                break;
+            }
+            ImGui::PlotLines(metric.name->c_str(), metric.history, static_cast<int>(metric.historyCount),
+                             static_cast<int>(metric.historyOffset), overlay, FLT_MAX, FLT_MAX, ImVec2(0, 40));
+        });
+    }
+    ImGui::End();
+}
+
+void Renderer::submitFrame(uint32_t frameIndex, uint32_t imageIndex) {
+    VkCommandBuffer commandBuffer = m_commandBuffers[frameIndex];
+    vkResetCommandBuffer(commandBuffer, 0);
+
+    auto recordStart = std::chrono::steady_clock::now();
+    recordCommandBuffer(commandBuffer, frameIndex, imageIndex);
+    // Everything the frame reads from the ring has been written by now
+    m_uniformRing->flush();
 
     // Submit command buffer
     VkSubmitInfo submitInfo{};
     submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
-    VkSemaphore waitSemaphores[] = {m_imageAvailableSemaphores[m_currentFrame]};
+    VkSemaphore waitSemaphores[] = {m_imageAvailableSemaphores[frameIndex]};
     VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
     submitInfo.waitSemaphoreCount = 1;
     submitInfo.pWaitSemaphores = waitSemaphores;
     submitInfo.pWaitDstStageMask = waitStages;
     submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &m_commandBuffers[m_currentFrame];
+    submitInfo.pCommandBuffers = &commandBuffer;
 
-    VkSemaphore signalSemaphores[] = {m_renderFinishedSemaphores[m_currentFrame]};
+    VkSemaphore signalSemaphores[] = {m_renderFinishedSemaphores[frameIndex]};
     submitInfo.signalSemaphoreCount = 1;
     submitInfo.pSignalSemaphores = signalSemaphores;
 
-    vkQueueSubmit(m_vulkanContext->getGraphicsQueue(), 1, &submitInfo, m_inFlightFences[m_currentFrame]);
+    PLASTER_VK_CHECK(vkQueueSubmit(m_vulkanContext->getGraphicsQueue(), 1, &submitInfo, m_inFlightFences[frameIndex]));
+    m_recordMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - recordStart).count();
+    static Histogram& recordTime = Metrics::histogram("renderer.record_us");
+    recordTime.record(static_cast<uint64_t>(m_recordMs * 1000.0f));
 
     // Present
     VkPresentInfoKHR presentInfo{};
@@ -404,9 +1566,13 @@ void Renderer::render() {
     presentInfo.pSwapchains = swapChains;
     presentInfo.pImageIndices = &imageIndex;
 
-    vkQueuePresentKHR(m_vulkanContext->getGraphicsQueue(), &presentInfo);
-
-    m_currentFrame = (m_currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+    // The main thread recreates the swapchain at the start of its next frame
+    VkResult result = vkQueuePresentKHR(m_vulkanContext->getGraphicsQueue(), &presentInfo);
+    if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
+        m_swapchainOutOfDate = true;
+    } else {
+        PLASTER_VK_CHECK(result);
+    }
 }
 
 } // namespace plaster
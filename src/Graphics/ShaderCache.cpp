@@ -0,0 +1,422 @@
+#include "Graphics/ShaderCache.h"
+#include "Graphics/VulkanContext.h"
+#include "Graphics/DeletionQueue.h"
+#include "Core/Hash.h"
+#include "Core/Log.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace fs = std::filesystem;
+
+namespace plaster {
+
+namespace {
+
+const auto WATCH_INTERVAL = std::chrono::milliseconds(250);
+
+bool isHlsl(const ShaderDesc& desc) {
+    return fs::path(desc.path).extension() == ".hlsl";
+}
+
+bool readFile(const fs::path& path, std::string& contents) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    std::ostringstream stream;
+    stream << file.rdbuf();
+    contents = stream.str();
+    return true;
+}
+
+// Runs a shell command and captures stdout + stderr; returns the exit status
+int runCommand(const std::string& command, std::string& output) {
+#ifdef _WIN32
+    // cmd /c strips one pair of outer quotes
+    FILE* pipe = _popen(("\"" + command + " 2>&1\"").c_str(), "r");
+#else
+    FILE* pipe = popen((command + " 2>&1").c_str(), "r");
+#endif
+    if (!pipe) {
+        return -1;
+    }
+
+    char buffer[512];
+    size_t read;
+    while ((read = fread(buffer, 1, sizeof(buffer), pipe)) > 0) {
+        output.append(buffer, read);
+    }
+
+#ifdef _WIN32
+    return _pclose(pipe);
+#else
+    return pclose(pipe);
+#endif
+}
+
+std::string quote(const fs::path& path) {
+    return "\"" + path.string() + "\"";
+}
+
+std::string findCompiler(bool hlsl) {
+    const char* override = std::getenv(hlsl ? "PLASTER_DXC" : "PLASTER_GLSLC");
+    if (override && *override) {
+        return quote(override);
+    }
+
+    const char* name = hlsl ? "dxc" : "glslc";
+    if (const char* sdk = std::getenv("VULKAN_SDK")) {
+        fs::path path = fs::path(sdk) / "bin" / name;
+#ifdef _WIN32
+        path += ".exe";
+#endif
+        if (fs::exists(path)) {
+            return quote(path);
+        }
+    }
+    return name;
+}
+
+std::string toHex(uint64_t value) {
+    char buffer[17];
+    std::snprintf(buffer, sizeof(buffer), "%016llx", static_cast<unsigned long long>(value));
+    return buffer;
+}
+
+fs::file_time_type newestWriteTime(const std::vector<fs::path>& files) {
+    fs::file_time_type newest = fs::file_time_type::min();
+    for (const auto& file : files) {
+        std::error_code ec;
+        fs::file_time_type time = fs::last_write_time(file, ec);
+        if (!ec && time > newest) {
+            newest = time;
+        }
+    }
+    return newest;
+}
+
+uint64_t hashDesc(const ShaderDesc& desc) {
+    uint64_t hash = hashString(desc.path);
+    hash = hashCombine(hash, static_cast<uint64_t>(desc.stage));
+    hash = hashCombine(hash, hashString(desc.entryPoint));
+    for (const auto& define : desc.defines) {
+        hash = hashCombine(hash, hashString(define));
+    }
+    return hash;
+}
+
+} // namespace
+
+ShaderCache::ShaderCache(VulkanContext* vulkanContext, DeletionQueue* deletionQueue,
+                         const std::string& shaderDirectory, const std::string& cacheDirectory)
+    : m_vulkanContext(vulkanContext), m_deletionQueue(deletionQueue), m_shaderDirectory(shaderDirectory), m_cacheDirectory(cacheDirectory),
+      m_watching(false), m_compileCount(0), m_cacheHitCount(0) {
+    std::error_code ec;
+    fs::create_directories(m_cacheDirectory, ec);
+}
+
+ShaderCache::~ShaderCache() {
+    setHotReload(false);
+
+    VkDevice device = m_vulkanContext->getDevice();
+    for (const auto& shader : m_shaders) {
+        vkDestroyShaderModule(device, shader.module, nullptr);
+    }
+}
+
+ShaderHandle ShaderCache::load(const ShaderDesc& desc) {
+    uint64_t descHash = hashDesc(desc);
+    for (uint32_t i = 0; i < m_shaders.size(); ++i) {
+        if (m_shaders[i].descHash == descHash) {
+            return {i};
+        }
+    }
+
+    CompiledShader compiled;
+    std::string error;
+    if (!compile(desc, compiled, error)) {
+        throw std::runtime_error("Failed to compile shader " + desc.path + ":\n" + error);
+    }
+
+    Shader shader;
+    shader.desc = desc;
+    shader.descHash = descHash;
+    shader.module = createModule(compiled.spirv);
+    shader.spirv = std::move(compiled.spirv);
+    shader.reflection = compiled.reflection;
+    shader.dependencies = std::move(compiled.dependencies);
+    shader.newestWrite = compiled.newestWrite;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_shaders.push_back(std::move(shader));
+    return {static_cast<uint32_t>(m_shaders.size() - 1)};
+}
+
+void ShaderCache::setHotReload(bool enabled) {
+    if (enabled == m_watcher.joinable()) {
+        return;
+    }
+
+    if (enabled) {
+        m_watching = true;
+        m_watcher = std::thread(&ShaderCache::watcherLoop, this);
+    } else {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_watching = false;
+        }
+        m_condition.notify_all();
+        m_watcher.join();
+    }
+}
+
+void ShaderCache::update() {
+    std::vector<Reloaded> reloaded;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        reloaded.swap(m_reloaded);
+    }
+    if (reloaded.empty()) {
+        return;
+    }
+
+    std::vector<ShaderHandle> changed;
+    for (auto& entry : reloaded) {
+        Shader& shader = m_shaders[entry.index];
+
+        m_deletionQueue->release(shader.module);
+        shader.module = createModule(entry.compiled.spirv);
+        shader.spirv = std::move(entry.compiled.spirv);
+        shader.reflection = entry.compiled.reflection;
+        changed.push_back({entry.index});
+    }
+
+    if (m_reloadCallback) {
+        m_reloadCallback(changed);
+    }
+}
+
+bool ShaderCache::compile(const ShaderDesc& desc, CompiledShader& result, std::string& error) {
+    const bool hlsl = isHlsl(desc);
+    const fs::path source = m_shaderDirectory / desc.path;
+
+    result.dependencies.clear();
+    if (!collectSources(source, result.dependencies, error)) {
+        return false;
+    }
+    result.newestWrite = newestWriteTime(result.dependencies);
+
+    // Key: compiler version, flags, and the contents of every file that went in
+    const std::string arguments = buildArguments(desc, hlsl);
+    uint64_t key = hashString(getCompilerVersion(hlsl));
+    key = hashCombine(key, hashString(arguments));
+    for (const auto& file : result.dependencies) {
+        std::string contents;
+        if (!readFile(file, contents)) {
+            error = "Cannot read " + file.string();
+            return false;
+        }
+        key = hashCombine(key, hashString(fs::relative(file, m_shaderDirectory).generic_string()));
+        key = hashCombine(key, xxHash64(contents.data(), contents.size()));
+    }
+
+    const fs::path cached = m_cacheDirectory / (toHex(key) + ".spv");
+    std::string binary;
+
+    if (readFile(cached, binary) && !binary.empty() && binary.size() % 4 == 0) {
+        ++m_cacheHitCount;
+    } else {
+        // Unique per thread so the watcher and a load() never share a temp file
+        const fs::path temp = m_cacheDirectory /
+            (toHex(key) + "." + toHex(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp");
+
+        std::string command = findCompiler(hlsl) + " " + arguments + " -I " + quote(m_shaderDirectory) +
+                              (hlsl ? " -Fo " : " -o ") + quote(temp) + " " + quote(source);
+
+        std::string output;
+        if (runCommand(command, output) != 0 || !readFile(temp, binary) || binary.size() % 4 != 0) {
+            std::error_code ec;
+            fs::remove(temp, ec);
+            error = output.empty() ? "Compiler failed: " + command : output;
+            return false;
+        }
+        ++m_compileCount;
+
+        // Rename is atomic, so a concurrent reader never sees a partial file
+        std::error_code ec;
+        fs::rename(temp, cached, ec);
+        if (ec) {
+            fs::remove(temp, ec);
+        }
+    }
+
+    result.spirv.resize(binary.size() / 4);
+    std::memcpy(result.spirv.data(), binary.data(), binary.size());
+
+    result.reflection = ShaderReflection();
+    if (!reflectSpirv(result.spirv.data(), result.spirv.size(), result.reflection)) {
+        error = "Invalid SPIR-V in " + cached.string();
+        std::error_code ec;
+        fs::remove(cached, ec);
+        return false;
+    }
+    return true;
+}
+
+bool ShaderCache::collectSources(const fs::path& file, std::vector<fs::path>& files, std::string& error) const {
+    fs::path normalized = file.lexically_normal();
+    for (const auto& existing : files) {
+        if (existing == normalized) {
+            return true;
+        }
+    }
+
+    std::ifstream stream(normalized);
+    if (!stream) {
+        error = "Cannot open " + normalized.string();
+        return false;
+    }
+    files.push_back(normalized);
+
+    // Only quoted includes are followed; the compiler reports anything unresolved
+    std::string line;
+    while (std::getline(stream, line)) {
+        size_t start = line.find_first_not_of(" \t");
+        if (start == std::string::npos || line.compare(start, 8, "#include") != 0) {
+            continue;
+        }
+        size_t open = line.find('"', start + 8);
+        size_t close = open == std::string::npos ? open : line.find('"', open + 1);
+        if (close == std::string::npos) {
+            continue;
+        }
+
+        std::string name = line.substr(open + 1, close - open - 1);
+        fs::path include = normalized.parent_path() / name;
+        if (!fs::exists(include)) {
+            include = m_shaderDirectory / name;
+        }
+        if (fs::exists(include) && !collectSources(include, files, error)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+const std::string& ShaderCache::getCompilerVersion(bool hlsl) {
+    int index = hlsl ? 1 : 0;
+    std::call_once(m_versionOnce[index], [this, hlsl, index]() {
+        std::string output;
+        if (runCommand(findCompiler(hlsl) + " --version", output) == 0) {
+            m_compilerVersions[index] = output;
+        }
+    });
+    return m_compilerVersions[index];
+}
+
+std::string ShaderCache::buildArguments(const ShaderDesc& desc, bool hlsl) const {
+    std::string arguments;
+
+    if (hlsl) {
+        static const char* profiles[] = {"vs_6_0", "ps_6_0", "cs_6_0"};
+        arguments = "-spirv -fspv-target-env=vulkan1.0 -T ";
+        arguments += profiles[static_cast<int>(desc.stage)];
+        arguments += " -E " + desc.entryPoint;
+#ifdef NDEBUG
+        arguments += " -O3";
+#else
+        arguments += " -Zi";
+#endif
+    } else {
+        static const char* stages[] = {"vert", "frag", "comp"};
+        arguments = "--target-env=vulkan1.0 -fshader-stage=";
+        arguments += stages[static_cast<int>(desc.stage)];
+#ifdef NDEBUG
+        arguments += " -O";
+#else
+        arguments += " -g";
+#endif
+    }
+
+    for (const auto& define : desc.defines) {
+        arguments += (hlsl ? " -D " : " -D") + define;
+    }
+    return arguments;
+}
+
+VkShaderModule ShaderCache::createModule(const std::vector<uint32_t>& spirv) const {
+    VkShaderModuleCreateInfo createInfo{};
+    createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    createInfo.codeSize = spirv.size() * sizeof(uint32_t);
+    createInfo.pCode = spirv.data();
+
+    VkShaderModule module;
+    if (vkCreateShaderModule(m_vulkanContext->getDevice(), &createInfo, nullptr, &module) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create shader module");
+    }
+    return module;
+}
+
+void ShaderCache::watcherLoop() {
+    struct Watched {
+        uint32_t index;
+        ShaderDesc desc;
+        std::vector<fs::path> dependencies;
+        fs::file_time_type newestWrite;
+    };
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (m_watching) {
+        m_condition.wait_for(lock, WATCH_INTERVAL, [this]() { return !m_watching; });
+        if (!m_watching) {
+            break;
+        }
+
+        std::vector<Watched> watched;
+        for (uint32_t i = 0; i < m_shaders.size(); ++i) {
+            const Shader& shader = m_shaders[i];
+            watched.push_back({i, shader.desc, shader.dependencies, shader.newestWrite});
+        }
+        lock.unlock();
+
+        // Compile outside the lock so load() and update() never wait on a compiler
+        std::vector<Reloaded> reloaded;
+        std::vector<std::pair<uint32_t, CompiledShader>> failed;
+        for (auto& shader : watched) {
+            if (newestWriteTime(shader.dependencies) <= shader.newestWrite) {
+                continue;
+            }
+
+            CompiledShader compiled;
+            std::string error;
+            if (compile(shader.desc, compiled, error)) {
+                reloaded.push_back({shader.index, std::move(compiled)});
+            } else {
+                // Keep the old module; retry once the files change again
+                logError("shaders", "Reload failed for " + shader.desc.path + ":\n" + error);
+                failed.push_back({shader.index, std::move(compiled)});
+            }
+        }
+
+        lock.lock();
+        for (auto& entry : reloaded) {
+            m_shaders[entry.index].dependencies = entry.compiled.dependencies;
+            m_shaders[entry.index].newestWrite = entry.compiled.newestWrite;
+            m_reloaded.push_back(std::move(entry));
+        }
+        for (auto& entry : failed) {
+            if (!entry.second.dependencies.empty()) {
+                m_shaders[entry.first].dependencies = entry.second.dependencies;
+            }
+            m_shaders[entry.first].newestWrite = newestWriteTime(m_shaders[entry.first].dependencies);
+        }
+    }
+}
+
+} // namespace plaster
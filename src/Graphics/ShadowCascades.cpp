@@ -0,0 +1,686 @@
+#include "Graphics/ShadowCascades.h"
+#include "Graphics/VulkanContext.h"
+#include "Graphics/DeletionQueue.h"
+#include "Graphics/DrawBatcher.h"
+#include "Graphics/VulkanDebug.h"
+#include "Core/Metrics.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace plaster {
+
+namespace {
+
+// Cascades updated every frame; the rest alternate
+const uint32_t NEAR_CASCADES = 2;
+
+// Static caster changes a cascade collects before it gives up on rectangles
+// and redraws whole
+const size_t MAX_DIRTY_REGIONS = 8;
+
+const VkPipelineStageFlags DEPTH_STAGES =
+    VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+const VkAccessFlags DEPTH_ACCESS =
+    VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+// Where an image was last left by the barriers of one record()
+struct ImageState {
+    VkImage image;
+    VkImageLayout layout;
+    VkPipelineStageFlags stage;
+    VkAccessFlags access;
+};
+
+void transition(VkCommandBuffer commandBuffer, ImageState& state, VkImageLayout layout, VkPipelineStageFlags stage,
+                VkAccessFlags access) {
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = state.access;
+    barrier.dstAccessMask = access;
+    barrier.oldLayout = state.layout;
+    barrier.newLayout = layout;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = state.image;
+    barrier.subresourceRange = {VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 1};
+    vkCmdPipelineBarrier(commandBuffer, state.stage, stage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+    state.layout = layout;
+    state.stage = stage;
+    state.access = access;
+}
+
+VkImageCopy depthCopy(int32_t srcX, int32_t srcY, int32_t dstX, int32_t dstY, uint32_t width, uint32_t height) {
+    VkImageCopy copy{};
+    copy.srcSubresource = {VK_IMAGE_ASPECT_DEPTH_BIT, 0, 0, 1};
+    copy.srcOffset = {srcX, srcY, 0};
+    copy.dstSubresource = copy.srcSubresource;
+    copy.dstOffset = {dstX, dstY, 0};
+    copy.extent = {width, height, 1};
+    return copy;
+}
+
+glm::vec4 worldSphere(const glm::mat4& transform, const glm::vec3& center, float radius) {
+    float scale = std::max(glm::length(glm::vec3(transform[0])),
+                           std::max(glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2]))));
+    return glm::vec4(glm::vec3(transform * glm::vec4(center, 1.0f)), radius * scale);
+}
+
+} // namespace
+
+ShadowCascades::ShadowCascades(VulkanContext* vulkanContext, PipelineManager* pipelineManager,
+                               DeletionQueue* deletionQueue, DrawBatcher* drawBatcher, uint32_t framesInFlight,
+                               uint32_t renderPass, VkRenderPass vkRenderPass, VkFormat depthFormat,
+                               uint32_t atlasSize)
+    : m_vulkanContext(vulkanContext), m_pipelineManager(pipelineManager), m_deletionQueue(deletionQueue),
+      m_drawBatcher(drawBatcher), m_renderPass(vkRenderPass), m_depthFormat(depthFormat), m_atlasSize(atlasSize),
+      m_tileSize(atlasSize / 2), m_atlas(VK_NULL_HANDLE), m_atlasMemory(VK_NULL_HANDLE), m_atlasView(VK_NULL_HANDLE),
+      m_staticAtlas(VK_NULL_HANDLE), m_staticMemory(VK_NULL_HANDLE), m_framebuffer(VK_NULL_HANDLE),
+      m_sampler(VK_NULL_HANDLE), m_atlasInitialized(false), m_staticInitialized(false), m_sunDirection(0.0f),
+      m_lightView(1.0f), m_casterDistance(0.0f), m_frame(0), m_record(false) {
+    GraphicsPipelineDesc desc;
+    desc.vertex.path = "shadow.vert";
+    desc.vertex.stage = ShaderStage::Vertex;
+    desc.fragment.path = "shadow.frag";
+    desc.fragment.stage = ShaderStage::Fragment;
+    desc.renderPass = renderPass;
+    // Single sided geometry casts from both sides
+    desc.cullMode = VK_CULL_MODE_NONE;
+    desc.depthTest = true;
+    desc.depthWrite = true;
+    m_pipeline = m_pipelineManager->requestGraphics(desc);
+
+    VkDevice device = m_vulkanContext->getDevice();
+
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.format = m_depthFormat;
+    imageInfo.extent = {m_atlasSize, m_atlasSize, 1};
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT |
+                      VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    m_vulkanContext->createImage(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_atlas, m_atlasMemory);
+    PLASTER_VK_NAME(device, VK_OBJECT_TYPE_IMAGE, m_atlas, "Shadow atlas");
+
+    // Only ever copied to and from
+    imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    m_vulkanContext->createImage(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_staticAtlas, m_staticMemory);
+    PLASTER_VK_NAME(device, VK_OBJECT_TYPE_IMAGE, m_staticAtlas, "Shadow static cache");
+
+    VkImageViewCreateInfo viewInfo{};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = m_atlas;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = m_depthFormat;
+    viewInfo.subresourceRange = {VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 1};
+    PLASTER_VK_CHECK(vkCreateImageView(device, &viewInfo, nullptr, &m_atlasView));
+
+    if (m_renderPass) {
+        VkFramebufferCreateInfo framebufferInfo{};
+        framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        framebufferInfo.renderPass = m_renderPass;
+        framebufferInfo.attachmentCount = 1;
+        framebufferInfo.pAttachments = &m_atlasView;
+        framebufferInfo.width = m_atlasSize;
+        framebufferInfo.height = m_atlasSize;
+        framebufferInfo.layers = 1;
+        PLASTER_VK_CHECK(vkCreateFramebuffer(device, &framebufferInfo, nullptr, &m_framebuffer));
+    }
+
+    // Hardware 2x2 filtered comparisons; shaders keep their taps inside a cascade's tile
+    VkSamplerCreateInfo samplerInfo{};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_LINEAR;
+    samplerInfo.minFilter = VK_FILTER_LINEAR;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.compareEnable = VK_TRUE;
+    samplerInfo.compareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+    PLASTER_VK_CHECK(vkCreateSampler(device, &samplerInfo, nullptr, &m_sampler));
+
+    m_instanceBuffers.resize(framesInFlight);
+}
+
+ShadowCascades::~ShadowCascades() {
+    m_deletionQueue->release(m_framebuffer);
+    m_deletionQueue->release(m_atlas, m_atlasMemory, m_atlasView);
+    m_deletionQueue->release(m_staticAtlas);
+    m_deletionQueue->release(m_staticMemory);
+    m_deletionQueue->release(m_sampler);
+    for (InstanceBuffer& buffer : m_instanceBuffers) {
+        // Freeing the memory unmaps it
+        m_deletionQueue->release(buffer.buffer, buffer.memory);
+    }
+}
+
+uint32_t ShadowCascades::addCaster(uint32_t mesh, const glm::mat4& transform, const glm::vec3& center, float radius,
+                                   bool isStatic) {
+    Caster caster;
+    caster.mesh = mesh;
+    caster.transform = transform;
+    caster.center = center;
+    caster.radius = radius;
+    caster.sphere = worldSphere(transform, center, radius);
+    caster.isStatic = isStatic;
+    caster.active = true;
+    if (isStatic) {
+        invalidate(caster.sphere);
+    }
+
+    if (!m_freeCasters.empty()) {
+        uint32_t id = m_freeCasters.back();
+        m_freeCasters.pop_back();
+        m_casters[id] = caster;
+        return id;
+    }
+    m_casters.push_back(caster);
+    return static_cast<uint32_t>(m_casters.size() - 1);
+}
+
+void ShadowCascades::setTransform(uint32_t caster, const glm::mat4& transform) {
+    Caster& target = m_casters[caster];
+    glm::vec4 sphere = worldSphere(transform, target.center, target.radius);
+    // Both where it was and where it is now need redrawing
+    if (target.isStatic) {
+        invalidate(target.sphere);
+        invalidate(sphere);
+    }
+    target.transform = transform;
+    target.sphere = sphere;
+}
+
+void ShadowCascades::removeCaster(uint32_t caster) {
+    Caster& target = m_casters[caster];
+    if (!target.active) {
+        return;
+    }
+    if (target.isStatic) {
+        invalidate(target.sphere);
+    }
+    target.active = false;
+    m_freeCasters.push_back(caster);
+}
+
+void ShadowCascades::invalidate(const glm::vec4& sphere) {
+    for (Cascade& cascade : m_cascades) {
+        if (!cascade.cached) {
+            continue;
+        }
+        if (cascade.dirty.size() >= MAX_DIRTY_REGIONS) {
+            cascade.cached = false;
+            cascade.dirty.clear();
+            continue;
+        }
+        cascade.dirty.push_back(sphere);
+    }
+}
+
+bool ShadowCascades::isReady() const {
+    if (!m_settings.enabled) {
+        return false;
+    }
+    for (const Cascade& cascade : m_cascades) {
+        if (!cascade.rendered) {
+            return false;
+        }
+    }
+    return true;
+}
+
+ShadowCascades::Rect ShadowCascades::casterRect(const Cascade& cascade, const glm::vec4& sphere) const {
+    glm::vec3 center = glm::vec3(m_lightView * glm::vec4(glm::vec3(sphere), 1.0f));
+    float radius = sphere.w;
+    // Past the far end, or so near the sun that it would be clipped anyway
+    if (-center.z + radius < cascade.depthMin || -center.z - radius > cascade.depthMax) {
+        return Rect{0, 0, 0, 0};
+    }
+
+    double texelSize = cascade.sampled.texelSize;
+    double tileSize = m_tileSize;
+    auto toTile = [tileSize](double texel, int64_t origin) {
+        return static_cast<int32_t>(std::clamp(texel - static_cast<double>(origin), 0.0, tileSize));
+    };
+    return Rect{toTile(std::floor((center.x - radius) / texelSize), cascade.originX),
+                toTile(std::floor((center.y - radius) / texelSize), cascade.originY),
+                toTile(std::floor((center.x + radius) / texelSize) + 1.0, cascade.originX),
+                toTile(std::floor((center.y + radius) / texelSize) + 1.0, cascade.originY)};
+}
+
+void ShadowCascades::update(uint32_t frameIndex, const glm::mat4& view, const glm::mat4& projection,
+                            const glm::vec3& sunDirection) {
+    m_draws.clear();
+    m_staticRegions.clear();
+    m_dynamicRegions.clear();
+    m_restoreCopies.clear();
+    m_storeCopies.clear();
+    m_instances.clear();
+    m_record = false;
+    m_stats = ShadowStats();
+    m_stats.casterCount = static_cast<uint32_t>(m_casters.size() - m_freeCasters.size());
+    ++m_frame;
+
+    if (!m_settings.enabled || !m_pipelineManager->isReady(m_pipeline)) {
+        return;
+    }
+
+    // A new sun direction or depth range moves every cached texel
+    glm::vec3 sun = glm::length(sunDirection) > 0.0f ? glm::normalize(sunDirection) : glm::vec3(0.0f, 1.0f, 0.0f);
+    float casterDistance = std::max(m_settings.casterDistance, 0.0f);
+    if (sun != m_sunDirection || casterDistance != m_casterDistance || !m_settings.cacheStatic) {
+        for (Cascade& cascade : m_cascades) {
+            cascade.cached = false;
+            cascade.dirty.clear();
+        }
+        m_sunDirection = sun;
+        m_casterDistance = casterDistance;
+    }
+    glm::vec3 up = std::abs(sun.y) < 0.99f ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+    m_lightView = glm::lookAt(glm::vec3(0.0f), -sun, up);
+
+    // The near plane, and how far the frustum's corner rays stray from the
+    // view axis at view depth 1 (squared)
+    glm::mat4 inverseProjection = glm::inverse(projection);
+    glm::vec4 nearPoint = inverseProjection * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+    float nearDepth = std::max(-nearPoint.z / nearPoint.w, 1e-3f);
+    float farDepth = std::max(m_settings.maxDistance, nearDepth * 1.01f);
+    float spread = 0.0f;
+    for (float x : {-1.0f, 1.0f}) {
+        for (float y : {-1.0f, 1.0f}) {
+            glm::vec4 corner = inverseProjection * glm::vec4(x, y, 0.5f, 1.0f);
+            glm::vec3 ray = glm::vec3(corner) / corner.w;
+            ray /= -ray.z;
+            spread = std::max(spread, ray.x * ray.x + ray.y * ray.y);
+        }
+    }
+    glm::mat4 inverseView = glm::inverse(view);
+    float lambda = std::clamp(m_settings.splitLambda, 0.0f, 1.0f);
+
+    float sliceNear = nearDepth;
+    for (uint32_t i = 0; i < SHADOW_CASCADE_COUNT; ++i) {
+        // Practical split scheme: logarithmic blended with uniform
+        float t = static_cast<float>(i + 1) / SHADOW_CASCADE_COUNT;
+        float sliceFar = lambda * nearDepth * std::pow(farDepth / nearDepth, t) +
+                         (1.0f - lambda) * (nearDepth + (farDepth - nearDepth) * t);
+
+        // Smallest sphere around the slice centered on the view axis. It moves
+        // with the camera but its size depends only on the projection; rounded
+        // up so it does not jitter with the float math.
+        float center = std::clamp((1.0f + spread) * (sliceNear + sliceFar) * 0.5f, sliceNear, sliceFar);
+        float nearReach = (center - sliceNear) * (center - sliceNear) + sliceNear * sliceNear * spread;
+        float farReach = (sliceFar - center) * (sliceFar - center) + sliceFar * sliceFar * spread;
+        float radius = std::ceil(std::sqrt(std::max(nearReach, farReach)) * 16.0f) / 16.0f;
+
+        const Cascade& cascade = m_cascades[i];
+        bool due = !cascade.rendered || i < NEAR_CASCADES || !m_settings.alternateDistant || m_frame % 2 == i % 2;
+        if (due) {
+            updateCascade(i, glm::vec3(inverseView * glm::vec4(0.0f, 0.0f, -center, 1.0f)), radius, sliceFar);
+        }
+        sliceNear = sliceFar;
+    }
+
+    if (!m_instances.empty()) {
+        InstanceBuffer& buffer = m_instanceBuffers[frameIndex];
+        ensureInstanceCapacity(buffer, static_cast<uint32_t>(m_instances.size()));
+        std::memcpy(buffer.mapped, m_instances.data(), m_instances.size() * sizeof(InstanceData));
+    }
+
+    static Gauge& staticTexels = Metrics::gauge("shadows.static_texels");
+    static Gauge& instances = Metrics::gauge("shadows.instances");
+    staticTexels.set(static_cast<double>(m_stats.staticTexels));
+    instances.set(static_cast<double>(m_stats.staticInstances + m_stats.dynamicInstances));
+}
+
+void ShadowCascades::updateCascade(uint32_t index, const glm::vec3& center, float radius, float splitDepth) {
+    Cascade& cascade = m_cascades[index];
+    int32_t tileSize = static_cast<int32_t>(m_tileSize);
+    int32_t tileX = static_cast<int32_t>(index % 2 * m_tileSize);
+    int32_t tileY = static_cast<int32_t>(index / 2 * m_tileSize);
+
+    // One texel short of the tile, so the sphere still fits once the origin is snapped down
+    float texelSize = 2.0f * radius / static_cast<float>(m_tileSize - 1);
+    glm::vec3 lightCenter = glm::vec3(m_lightView * glm::vec4(center, 1.0f));
+    int64_t originX = static_cast<int64_t>(std::floor((lightCenter.x - radius) / texelSize));
+    int64_t originY = static_cast<int64_t>(std::floor((lightCenter.y - radius) / texelSize));
+    // Toward the sun in steps of the radius, so depths stay put until the camera has moved that far
+    int64_t depthStep = static_cast<int64_t>(std::floor(-lightCenter.z / radius));
+
+    int64_t shiftX = originX - cascade.originX;
+    int64_t shiftY = originY - cascade.originY;
+    bool reuse = cascade.cached && radius == cascade.radius && depthStep == cascade.depthStep &&
+                 std::abs(shiftX) < tileSize && std::abs(shiftY) < tileSize;
+
+    cascade.originX = originX;
+    cascade.originY = originY;
+    cascade.depthStep = depthStep;
+    cascade.radius = radius;
+    cascade.depthMin = static_cast<float>(depthStep) * radius - radius - m_casterDistance;
+    cascade.depthMax = static_cast<float>(depthStep + 1) * radius + radius;
+    cascade.sampled.texelSize = texelSize;
+    cascade.sampled.splitDepth = splitDepth;
+    cascade.sampled.depthRange = cascade.depthMax - cascade.depthMin;
+
+    bool dynamicCasters = false;
+    m_casterRects.resize(m_casters.size());
+    for (size_t i = 0; i < m_casters.size(); ++i) {
+        const Caster& caster = m_casters[i];
+        m_casterRects[i] = caster.active ? casterRect(cascade, caster.sphere) : Rect{0, 0, 0, 0};
+        const Rect& rect = m_casterRects[i];
+        dynamicCasters |= caster.active && !caster.isStatic && rect.x0 < rect.x1 && rect.y0 < rect.y1;
+    }
+
+    size_t staticRegionCount = m_staticRegions.size();
+    int32_t dx = static_cast<int32_t>(shiftX);
+    int32_t dy = static_cast<int32_t>(shiftY);
+    if (reuse) {
+        // The strips that came into view, then around static casters that changed
+        if (dx != 0) {
+            addRegion(m_staticRegions, index, dx > 0 ? Rect{tileSize - dx, 0, tileSize, tileSize}
+                                                     : Rect{0, 0, -dx, tileSize}, true, true);
+        }
+        if (dy != 0) {
+            int32_t x0 = std::max(-dx, 0);
+            int32_t x1 = tileSize - std::max(dx, 0);
+            addRegion(m_staticRegions, index, dy > 0 ? Rect{x0, tileSize - dy, x1, tileSize}
+                                                     : Rect{x0, 0, x1, -dy}, true, true);
+        }
+        for (const glm::vec4& sphere : cascade.dirty) {
+            addRegion(m_staticRegions, index, casterRect(cascade, sphere), true, true);
+        }
+    } else {
+        addRegion(m_staticRegions, index, Rect{0, 0, tileSize, tileSize}, true, true);
+        ++m_stats.fullRenders;
+    }
+    cascade.dirty.clear();
+    bool staticWork = m_staticRegions.size() > staticRegionCount;
+
+    // Same place, same static casters and no dynamic ones then or now: the tile is already right
+    if (reuse && cascade.rendered && !staticWork && !dynamicCasters && !cascade.hadDynamic) {
+        return;
+    }
+
+    if (reuse) {
+        // What of the cached map is still in view, moved to where it now lands
+        m_restoreCopies.push_back(depthCopy(tileX + std::max(dx, 0), tileY + std::max(dy, 0),
+                                            tileX + std::max(-dx, 0), tileY + std::max(-dy, 0),
+                                            static_cast<uint32_t>(tileSize - std::abs(dx)),
+                                            static_cast<uint32_t>(tileSize - std::abs(dy))));
+    }
+    if (staticWork && m_settings.cacheStatic) {
+        m_storeCopies.push_back(depthCopy(tileX, tileY, tileX, tileY, m_tileSize, m_tileSize));
+    }
+    cascade.cached = m_settings.cacheStatic;
+
+    addRegion(m_dynamicRegions, index, Rect{0, 0, tileSize, tileSize}, false, false);
+    cascade.hadDynamic = dynamicCasters;
+
+    // Light view, then an orthographic projection of the snapped window onto
+    // the tile with depth 0 to 1 from depthMin to depthMax
+    double left = static_cast<double>(originX) * texelSize;
+    double bottom = static_cast<double>(originY) * texelSize;
+    double width = static_cast<double>(m_tileSize) * texelSize;
+    glm::mat4 projection(1.0f);
+    projection[0][0] = static_cast<float>(2.0 / width);
+    projection[1][1] = static_cast<float>(2.0 / width);
+    projection[2][2] = -1.0f / cascade.sampled.depthRange;
+    projection[3][0] = static_cast<float>(-1.0 - 2.0 * left / width);
+    projection[3][1] = static_cast<float>(-1.0 - 2.0 * bottom / width);
+    projection[3][2] = -cascade.depthMin / cascade.sampled.depthRange;
+    cascade.viewProjection = projection * m_lightView;
+
+    // Clip space onto the cascade's tile of the atlas
+    float scale = 0.5f * static_cast<float>(m_tileSize) / static_cast<float>(m_atlasSize);
+    glm::mat4 toAtlas(1.0f);
+    toAtlas[0][0] = scale;
+    toAtlas[1][1] = scale;
+    toAtlas[3][0] = scale + static_cast<float>(tileX) / static_cast<float>(m_atlasSize);
+    toAtlas[3][1] = scale + static_cast<float>(tileY) / static_cast<float>(m_atlasSize);
+    cascade.sampled.atlasMatrix = toAtlas * cascade.viewProjection;
+
+    cascade.rendered = true;
+    ++m_stats.cascadesUpdated;
+    m_record = true;
+}
+
+void ShadowCascades::addRegion(std::vector<Region>& regions, uint32_t cascade, const Rect& rect, bool clear,
+                               bool isStatic) {
+    if (rect.x0 >= rect.x1 || rect.y0 >= rect.y1) {
+        return;
+    }
+
+    m_visible.clear();
+    for (uint32_t i = 0; i < m_casters.size(); ++i) {
+        const Caster& caster = m_casters[i];
+        const Rect& bounds = m_casterRects[i];
+        if (caster.active && caster.isStatic == isStatic && bounds.x0 < rect.x1 && rect.x0 < bounds.x1 &&
+            bounds.y0 < rect.y1 && rect.y0 < bounds.y1) {
+            m_visible.push_back(i);
+        }
+    }
+    if (m_visible.empty() && !clear) {
+        return;
+    }
+    std::sort(m_visible.begin(), m_visible.end(),
+              [this](uint32_t a, uint32_t b) { return m_casters[a].mesh < m_casters[b].mesh; });
+
+    Region region;
+    region.cascade = cascade;
+    region.rect.offset = {static_cast<int32_t>(cascade % 2 * m_tileSize) + rect.x0,
+                          static_cast<int32_t>(cascade / 2 * m_tileSize) + rect.y0};
+    region.rect.extent = {static_cast<uint32_t>(rect.x1 - rect.x0), static_cast<uint32_t>(rect.y1 - rect.y0)};
+    region.clear = clear;
+    region.firstDraw = static_cast<uint32_t>(m_draws.size());
+    for (size_t i = 0; i < m_visible.size(); ++i) {
+        const Caster& caster = m_casters[m_visible[i]];
+        if (i == 0 || caster.mesh != m_casters[m_visible[i - 1]].mesh) {
+            Draw draw;
+            draw.mesh = m_drawBatcher->getMesh(caster.mesh);
+            draw.firstInstance = static_cast<uint32_t>(m_instances.size());
+            draw.instanceCount = 0;
+            m_draws.push_back(draw);
+        }
+        m_instances.push_back(InstanceData{caster.transform});
+        ++m_draws.back().instanceCount;
+    }
+    region.drawCount = static_cast<uint32_t>(m_draws.size()) - region.firstDraw;
+    regions.push_back(region);
+
+    uint32_t instances = static_cast<uint32_t>(m_visible.size());
+    if (isStatic) {
+        ++m_stats.staticRegions;
+        m_stats.staticTexels += static_cast<uint64_t>(region.rect.extent.width) * region.rect.extent.height;
+        m_stats.staticInstances += instances;
+    } else {
+        m_stats.dynamicInstances += instances;
+    }
+    m_stats.drawCalls += region.drawCount;
+}
+
+void ShadowCascades::ensureInstanceCapacity(InstanceBuffer& buffer, uint32_t count) {
+    if (buffer.capacity >= count) {
+        return;
+    }
+
+    // The frame that owned this buffer has retired
+    m_deletionQueue->release(buffer.buffer, buffer.memory);
+
+    uint32_t capacity = std::max(256u, buffer.capacity);
+    while (capacity < count) {
+        capacity *= 2;
+    }
+
+    m_vulkanContext->createBuffer(capacity * sizeof(InstanceData), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                                  VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                  buffer.buffer, buffer.memory);
+    PLASTER_VK_NAME(m_vulkanContext->getDevice(), VK_OBJECT_TYPE_BUFFER, buffer.buffer, "Shadow caster instances");
+
+    void* mapped = nullptr;
+    PLASTER_VK_CHECK(vkMapMemory(m_vulkanContext->getDevice(), buffer.memory, 0, VK_WHOLE_SIZE, 0, &mapped));
+    buffer.mapped = static_cast<InstanceData*>(mapped);
+    buffer.capacity = capacity;
+}
+
+void ShadowCascades::record(VkCommandBuffer commandBuffer, uint32_t frameIndex) {
+    PLASTER_VK_LABEL(commandBuffer, "Shadows");
+
+    // Sampled by the previous frame's scene pass, or never written
+    ImageState atlas{m_atlas, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0};
+    if (!m_atlasInitialized) {
+        atlas.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+        atlas.stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+    }
+    // Left readable by the last copy into it
+    ImageState staticAtlas{m_staticAtlas, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, 0};
+    if (!m_staticInitialized) {
+        staticAtlas.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+        staticAtlas.stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+    }
+
+    if (m_record) {
+        VkBuffer instanceBuffer = m_instanceBuffers[frameIndex].buffer;
+
+        if (!m_restoreCopies.empty()) {
+            transition(commandBuffer, atlas, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_ACCESS_TRANSFER_WRITE_BIT);
+            vkCmdCopyImage(commandBuffer, m_staticAtlas, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, m_atlas,
+                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(m_restoreCopies.size()),
+                           m_restoreCopies.data());
+        }
+
+        if (!m_staticRegions.empty()) {
+            transition(commandBuffer, atlas, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, DEPTH_STAGES,
+                       DEPTH_ACCESS);
+            beginPass(commandBuffer);
+            drawRegions(commandBuffer, m_staticRegions, instanceBuffer);
+            endPass(commandBuffer);
+        }
+
+        // Static casters only, before the dynamic ones go on top
+        if (!m_storeCopies.empty()) {
+            transition(commandBuffer, atlas, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_ACCESS_TRANSFER_READ_BIT);
+            transition(commandBuffer, staticAtlas, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_ACCESS_TRANSFER_WRITE_BIT);
+            vkCmdCopyImage(commandBuffer, m_atlas, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, m_staticAtlas,
+                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(m_storeCopies.size()),
+                           m_storeCopies.data());
+            transition(commandBuffer, staticAtlas, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_ACCESS_TRANSFER_READ_BIT);
+            m_staticInitialized = true;
+        }
+
+        if (!m_dynamicRegions.empty()) {
+            transition(commandBuffer, atlas, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, DEPTH_STAGES,
+                       DEPTH_ACCESS);
+            beginPass(commandBuffer);
+            drawRegions(commandBuffer, m_dynamicRegions, instanceBuffer);
+            endPass(commandBuffer);
+        }
+    }
+
+    if (!m_atlasInitialized || m_record) {
+        transition(commandBuffer, atlas, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                   VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+        m_atlasInitialized = true;
+    }
+}
+
+void ShadowCascades::beginPass(VkCommandBuffer commandBuffer) {
+    VkRect2D renderArea{{0, 0}, {m_atlasSize, m_atlasSize}};
+
+    if (m_renderPass) {
+        VkRenderPassBeginInfo renderPassInfo{};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        renderPassInfo.renderPass = m_renderPass;
+        renderPassInfo.framebuffer = m_framebuffer;
+        renderPassInfo.renderArea = renderArea;
+        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+        return;
+    }
+
+    VkRenderingAttachmentInfo depthAttachment{};
+    depthAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+    depthAttachment.imageView = m_atlasView;
+    depthAttachment.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+    depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+
+    VkRenderingInfo renderingInfo{};
+    renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+    renderingInfo.renderArea = renderArea;
+    renderingInfo.layerCount = 1;
+    renderingInfo.pDepthAttachment = &depthAttachment;
+    vkCmdBeginRendering(commandBuffer, &renderingInfo);
+}
+
+void ShadowCascades::endPass(VkCommandBuffer commandBuffer) {
+    if (m_renderPass) {
+        vkCmdEndRenderPass(commandBuffer);
+    } else {
+        vkCmdEndRendering(commandBuffer);
+    }
+}
+
+void ShadowCascades::drawRegions(VkCommandBuffer commandBuffer, const std::vector<Region>& regions,
+                                 VkBuffer instanceBuffer) {
+    VkPipelineLayout layout = m_pipelineManager->getLayout(m_pipeline);
+    VkShaderStageFlags pushStages = m_pipelineManager->getPushConstantRange(m_pipeline).stageFlags;
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineManager->getPipeline(m_pipeline));
+
+    uint32_t boundCascade = UINT32_MAX;
+    VkBuffer boundVertexBuffer = VK_NULL_HANDLE;
+    VkBuffer boundIndexBuffer = VK_NULL_HANDLE;
+    for (const Region& region : regions) {
+        if (region.cascade != boundCascade) {
+            VkViewport viewport{};
+            viewport.x = static_cast<float>(region.cascade % 2 * m_tileSize);
+            viewport.y = static_cast<float>(region.cascade / 2 * m_tileSize);
+            viewport.width = static_cast<float>(m_tileSize);
+            viewport.height = static_cast<float>(m_tileSize);
+            viewport.minDepth = 0.0f;
+            viewport.maxDepth = 1.0f;
+            vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+            vkCmdPushConstants(commandBuffer, layout, pushStages, 0, sizeof(glm::mat4),
+                               &m_cascades[region.cascade].viewProjection);
+            boundCascade = region.cascade;
+        }
+
+        vkCmdSetScissor(commandBuffer, 0, 1, &region.rect);
+        if (region.clear) {
+            VkClearAttachment clear{};
+            clear.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+            clear.clearValue.depthStencil = {1.0f, 0};
+            VkClearRect clearRect{region.rect, 0, 1};
+            vkCmdClearAttachments(commandBuffer, 1, &clear, 1, &clearRect);
+        }
+
+        for (uint32_t i = 0; i < region.drawCount; ++i) {
+            const Draw& draw = m_draws[region.firstDraw + i];
+            if (draw.mesh.vertexBuffer != boundVertexBuffer) {
+                VkBuffer buffers[] = {draw.mesh.vertexBuffer, instanceBuffer};
+                VkDeviceSize offsets[] = {0, 0};
+                vkCmdBindVertexBuffers(commandBuffer, 0, 2, buffers, offsets);
+                boundVertexBuffer = draw.mesh.vertexBuffer;
+            }
+            if (draw.mesh.indexBuffer != boundIndexBuffer) {
+                vkCmdBindIndexBuffer(commandBuffer, draw.mesh.indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+                boundIndexBuffer = draw.mesh.indexBuffer;
+            }
+            vkCmdDrawIndexed(commandBuffer, draw.mesh.indexCount, draw.instanceCount, draw.mesh.firstIndex,
+                             draw.mesh.vertexOffset, draw.firstInstance);
+        }
+    }
+}
+
+} // namespace plaster
@@ -0,0 +1,163 @@
+#include "Graphics/SkinningPass.h"
+#include "Graphics/VulkanContext.h"
+#include "Graphics/DeletionQueue.h"
+#include "Graphics/DescriptorAllocator.h"
+#include "Graphics/UniformRing.h"
+#include "Graphics/VulkanDebug.h"
+#include "Animation/Skeleton.h"
+#include "Core/Metrics.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+namespace plaster {
+
+namespace {
+
+const uint32_t GROUP_SIZE = 64;   // see shaders/skinning.comp
+
+void bufferBarrier(VkCommandBuffer commandBuffer, VkPipelineStageFlags srcStage, VkAccessFlags srcAccess,
+                   VkPipelineStageFlags dstStage, VkAccessFlags dstAccess) {
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = srcAccess;
+    barrier.dstAccessMask = dstAccess;
+    vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+} // namespace
+
+SkinningPass::SkinningPass(VulkanContext* vulkanContext, PipelineManager* pipelineManager,
+                           DeletionQueue* deletionQueue, UniformRing* uniformRing, uint32_t sourceCapacity,
+                           uint32_t outputCapacity)
+    : m_vulkanContext(vulkanContext), m_pipelineManager(pipelineManager), m_deletionQueue(deletionQueue),
+      m_uniformRing(uniformRing), m_sourceCapacity(sourceCapacity), m_outputCapacity(outputCapacity),
+      m_sourceUsed(0), m_outputUsed(0), m_maxVertexCount(0), m_palettes(nullptr), m_paletteCount(0),
+      m_active(false), m_paletteOffset(0), m_paletteSize(0), m_instanceOffset(0), m_instanceSize(0) {
+    ComputePipelineDesc desc;
+    desc.compute.path = "skinning.comp";
+    desc.compute.stage = ShaderStage::Compute;
+    m_pipeline = m_pipelineManager->requestCompute(desc);
+
+    m_source = createStorageBuffer(sizeof(SkinnedVertex) * static_cast<VkDeviceSize>(m_sourceCapacity),
+                                   VK_BUFFER_USAGE_TRANSFER_DST_BIT, "Skinning source vertices");
+    m_output = createStorageBuffer(sizeof(Vertex) * static_cast<VkDeviceSize>(m_outputCapacity),
+                                   VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, "Skinned vertices");
+}
+
+SkinningPass::~SkinningPass() {
+    m_deletionQueue->release(m_source.buffer, m_source.memory);
+    m_deletionQueue->release(m_output.buffer, m_output.memory);
+}
+
+SkinningPass::StorageBuffer SkinningPass::createStorageBuffer(VkDeviceSize size, VkBufferUsageFlags usage,
+                                                              const char* name) {
+    StorageBuffer result;
+    result.size = size;
+    m_vulkanContext->createBuffer(size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | usage,
+                                  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, result.buffer, result.memory);
+    PLASTER_VK_NAME(m_vulkanContext->getDevice(), VK_OBJECT_TYPE_BUFFER, result.buffer, name);
+    (void)name;   // only debug builds name objects
+    return result;
+}
+
+uint32_t SkinningPass::addMesh(uint32_t vertexCount, VkBuffer indexBuffer, uint32_t indexCount) {
+    if (vertexCount > m_sourceCapacity - m_sourceUsed) {
+        throw std::runtime_error("Skinned mesh source buffer is full (" + std::to_string(m_sourceCapacity) +
+                                 " vertices)");
+    }
+    SkinnedMesh mesh;
+    mesh.firstVertex = m_sourceUsed;
+    mesh.vertexCount = vertexCount;
+    mesh.indexBuffer = indexBuffer;
+    mesh.indexCount = indexCount;
+    m_sourceUsed += vertexCount;
+    m_meshes.push_back(mesh);
+    return static_cast<uint32_t>(m_meshes.size() - 1);
+}
+
+GpuMesh SkinningPass::addInstance(uint32_t mesh, uint32_t paletteOffset) {
+    const SkinnedMesh& source = m_meshes[mesh];
+    if (source.vertexCount > m_outputCapacity - m_outputUsed) {
+        throw std::runtime_error("Skinned vertex output buffer is full (" + std::to_string(m_outputCapacity) +
+                                 " vertices)");
+    }
+    Instance instance;
+    instance.firstSource = source.firstVertex;
+    instance.vertexCount = source.vertexCount;
+    instance.firstOutput = m_outputUsed;
+    instance.firstJoint = paletteOffset;
+    m_outputUsed += source.vertexCount;
+    m_maxVertexCount = std::max(m_maxVertexCount, source.vertexCount);
+    m_instances.push_back(instance);
+
+    GpuMesh gpuMesh;
+    gpuMesh.vertexBuffer = m_output.buffer;
+    gpuMesh.indexBuffer = source.indexBuffer;
+    gpuMesh.firstIndex = 0;
+    gpuMesh.indexCount = source.indexCount;
+    gpuMesh.vertexOffset = static_cast<int32_t>(instance.firstOutput);
+    return gpuMesh;
+}
+
+void SkinningPass::setPalettes(const SkinningMatrix* palettes, uint32_t count) {
+    m_palettes = palettes;
+    m_paletteCount = count;
+}
+
+void SkinningPass::update() {
+    m_active = !m_instances.empty() && m_paletteCount > 0 && m_pipelineManager->isReady(m_pipeline);
+    if (!m_active) {
+        return;
+    }
+
+    m_paletteSize = m_paletteCount * static_cast<uint32_t>(sizeof(SkinningMatrix));
+    UniformAllocation palettes = m_uniformRing->allocate(m_paletteSize);
+    std::memcpy(palettes.data, m_palettes, m_paletteSize);
+    m_paletteOffset = palettes.offset;
+
+    m_instanceSize = static_cast<uint32_t>(m_instances.size() * sizeof(Instance));
+    UniformAllocation instances = m_uniformRing->allocate(m_instanceSize);
+    std::memcpy(instances.data, m_instances.data(), m_instanceSize);
+    m_instanceOffset = instances.offset;
+
+    static Gauge& skinnedVertices = Metrics::gauge("animation.skinned_vertices");
+    skinnedVertices.set(static_cast<double>(m_outputUsed));
+}
+
+void SkinningPass::record(VkCommandBuffer commandBuffer, DescriptorAllocator* descriptorAllocator) {
+    if (!m_active) {
+        return;
+    }
+    PLASTER_VK_LABEL(commandBuffer, "Skinning");
+
+    // The previous frame's passes read the output this dispatch rewrites
+    bufferBarrier(commandBuffer,
+                  VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+                      VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                  0, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0);
+
+    VkBuffer ring = m_uniformRing->getBuffer();
+    VkDescriptorSet set = descriptorAllocator->allocate(
+        m_pipelineManager->getSetLayout(m_pipeline, 0),
+        {DescriptorBinding::buffer(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, ring, m_paletteOffset, m_paletteSize),
+         DescriptorBinding::buffer(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, ring, m_instanceOffset, m_instanceSize),
+         DescriptorBinding::buffer(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, m_source.buffer, 0, m_source.size),
+         DescriptorBinding::buffer(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, m_output.buffer, 0, m_output.size)});
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineManager->getPipeline(m_pipeline));
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineManager->getLayout(m_pipeline),
+                            0, 1, &set, 0, nullptr);
+    // One row of groups per instance; rows of shorter meshes finish early
+    vkCmdDispatch(commandBuffer, (m_maxVertexCount + GROUP_SIZE - 1) / GROUP_SIZE,
+                  static_cast<uint32_t>(m_instances.size()), 1);
+
+    bufferBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+                  VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+                      VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                  VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_SHADER_READ_BIT);
+}
+
+} // namespace plaster
@@ -0,0 +1,360 @@
+#include "Graphics/SpirvReflection.h"
+
+#include <algorithm>
+
+namespace plaster {
+
+namespace {
+
+const uint32_t SPIRV_MAGIC = 0x07230203;
+
+enum Op : uint32_t {
+    OpEntryPoint = 15,
+    OpExecutionMode = 16,
+    OpTypeInt = 21,
+    OpTypeFloat = 22,
+    OpTypeVector = 23,
+    OpTypeMatrix = 24,
+    OpTypeImage = 25,
+    OpTypeSampler = 26,
+    OpTypeSampledImage = 27,
+    OpTypeArray = 28,
+    OpTypeRuntimeArray = 29,
+    OpTypeStruct = 30,
+    OpTypePointer = 32,
+    OpConstant = 43,
+    OpVariable = 59,
+    OpDecorate = 71,
+    OpMemberDecorate = 72
+};
+
+enum Decoration : uint32_t {
+    DecorationBlock = 2,
+    DecorationBufferBlock = 3,
+    DecorationArrayStride = 6,
+    DecorationMatrixStride = 7,
+    DecorationBinding = 33,
+    DecorationDescriptorSet = 34,
+    DecorationOffset = 35
+};
+
+enum StorageClass : uint32_t {
+    StorageUniformConstant = 0,
+    StorageUniform = 2,
+    StoragePushConstant = 9,
+    StorageBuffer = 12
+};
+
+const uint32_t EXECUTION_MODE_LOCAL_SIZE = 17;
+const uint32_t DIM_BUFFER = 5;
+const uint32_t DIM_SUBPASS_DATA = 6;
+
+struct Member {
+    uint32_t offset = 0;
+    uint32_t matrixStride = 0;
+};
+
+struct Id {
+    uint32_t opcode = 0;
+    uint32_t typeId = 0;            // element / pointee / component type
+    uint32_t storageClass = 0;
+    uint32_t width = 0;             // scalar bits, vector/matrix count, image Sampled
+    uint32_t dim = 0;
+    uint32_t value = 0;             // OpConstant
+    uint32_t set = UINT32_MAX;
+    uint32_t binding = UINT32_MAX;
+    uint32_t arrayStride = 0;
+    bool block = false;
+    bool bufferBlock = false;
+    std::vector<uint32_t> members;
+    std::vector<Member> memberDecorations;
+};
+
+uint32_t typeSize(const std::vector<Id>& ids, uint32_t typeId, uint32_t matrixStride) {
+    const Id& type = ids[typeId];
+    switch (type.opcode) {
+        case OpTypeInt:
+        case OpTypeFloat:
+            return type.width / 8;
+        case OpTypeVector:
+            return type.width * typeSize(ids, type.typeId, 0);
+        case OpTypeMatrix:
+            return type.width * (matrixStride ? matrixStride : typeSize(ids, type.typeId, 0));
+        case OpTypeArray:
+            return ids[type.value].value * (type.arrayStride ? type.arrayStride : typeSize(ids, type.typeId, 0));
+        case OpTypeStruct: {
+            uint32_t size = 0;
+            for (size_t i = 0; i < type.members.size(); ++i) {
+                const Member& member = type.memberDecorations[i];
+                size = std::max(size, member.offset + typeSize(ids, type.members[i], member.matrixStride));
+            }
+            return size;
+        }
+        default:
+            return 0;
+    }
+}
+
+bool descriptorType(const std::vector<Id>& ids, uint32_t storageClass, uint32_t typeId, VkDescriptorType& result) {
+    const Id& type = ids[typeId];
+
+    if (storageClass == StorageBuffer) {
+        result = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        return true;
+    }
+    if (storageClass == StorageUniform) {
+        // Uniform blocks always come from the UniformRing, bound with dynamic offsets
+        result = type.bufferBlock ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+        return true;
+    }
+    if (storageClass != StorageUniformConstant) {
+        return false;
+    }
+
+    switch (type.opcode) {
+        case OpTypeSampledImage:
+            result = ids[type.typeId].dim == DIM_BUFFER ? VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER
+                                                        : VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            return true;
+        case OpTypeSampler:
+            result = VK_DESCRIPTOR_TYPE_SAMPLER;
+            return true;
+        case OpTypeImage:
+            if (type.dim == DIM_SUBPASS_DATA) {
+                result = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+            } else if (type.dim == DIM_BUFFER) {
+                result = type.width == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER
+                                         : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+            } else {
+                result = type.width == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+            }
+            return true;
+        default:
+            return false;
+    }
+}
+
+} // namespace
+
+bool reflectSpirv(const uint32_t* words, size_t wordCount, ShaderReflection& reflection) {
+    if (wordCount < 5 || words[0] != SPIRV_MAGIC) {
+        return false;
+    }
+
+    const uint32_t bound = words[3];
+    std::vector<Id> ids(bound);
+    std::vector<uint32_t> variables;
+    uint32_t entryPoint = UINT32_MAX;
+    bool hasEntryPoint = false;
+
+    size_t offset = 5;
+    while (offset < wordCount) {
+        const uint32_t opcode = words[offset] & 0xffff;
+        const uint32_t count = words[offset] >> 16;
+        if (count == 0 || offset + count > wordCount) {
+            return false;
+        }
+        const uint32_t* op = words + offset + 1;
+
+        // Every id operand read below must be < bound
+        auto valid = [&](uint32_t id) { return id < bound; };
+
+        switch (opcode) {
+            case OpEntryPoint:
+                // The first entry point wins; the engine compiles one per module
+                if (!hasEntryPoint && count >= 3) {
+                    hasEntryPoint = true;
+                    entryPoint = op[1];
+                    switch (op[0]) {
+                        case 0: reflection.stage = VK_SHADER_STAGE_VERTEX_BIT; break;
+                        case 4: reflection.stage = VK_SHADER_STAGE_FRAGMENT_BIT; break;
+                        case 5: reflection.stage = VK_SHADER_STAGE_COMPUTE_BIT; break;
+                        default: return false;
+                    }
+                }
+                break;
+            case OpExecutionMode:
+                if (count >= 6 && op[0] == entryPoint && op[1] == EXECUTION_MODE_LOCAL_SIZE) {
+                    reflection.localSize[0] = op[2];
+                    reflection.localSize[1] = op[3];
+                    reflection.localSize[2] = op[4];
+                }
+                break;
+            case OpTypeInt:
+            case OpTypeFloat:
+                if (!valid(op[0])) return false;
+                ids[op[0]].opcode = opcode;
+                ids[op[0]].width = op[1];
+                break;
+            case OpTypeVector:
+            case OpTypeMatrix:
+                if (!valid(op[0]) || !valid(op[1])) return false;
+                ids[op[0]].opcode = opcode;
+                ids[op[0]].typeId = op[1];
+                ids[op[0]].width = op[2];
+                break;
+            case OpTypeImage:
+                if (count < 9 || !valid(op[0])) return false;
+                ids[op[0]].opcode = opcode;
+                ids[op[0]].dim = op[2];
+                ids[op[0]].width = op[6];
+                break;
+            case OpTypeSampler:
+                if (!valid(op[0])) return false;
+                ids[op[0]].opcode = opcode;
+                break;
+            case OpTypeSampledImage:
+            case OpTypeRuntimeArray:
+                if (!valid(op[0]) || !valid(op[1])) return false;
+                ids[op[0]].opcode = opcode;
+                ids[op[0]].typeId = op[1];
+                break;
+            case OpTypeArray:
+                if (!valid(op[0]) || !valid(op[1]) || !valid(op[2])) return false;
+                ids[op[0]].opcode = opcode;
+                ids[op[0]].typeId = op[1];
+                ids[op[0]].value = op[2];
+                break;
+            case OpTypeStruct: {
+                if (!valid(op[0])) return false;
+                Id& type = ids[op[0]];
+                type.opcode = opcode;
+                type.members.assign(op + 1, op + count - 1);
+                type.memberDecorations.resize(type.members.size());
+                for (uint32_t member : type.members) {
+                    if (!valid(member)) return false;
+                }
+                break;
+            }
+            case OpTypePointer:
+                if (!valid(op[0]) || !valid(op[2])) return false;
+                ids[op[0]].opcode = opcode;
+                ids[op[0]].storageClass = op[1];
+                ids[op[0]].typeId = op[2];
+                break;
+            case OpConstant:
+                if (!valid(op[1])) return false;
+                ids[op[1]].opcode = opcode;
+                ids[op[1]].value = op[2];
+                break;
+            case OpVariable:
+                if (!valid(op[0]) || !valid(op[1])) return false;
+                ids[op[1]].opcode = opcode;
+                ids[op[1]].typeId = op[0];
+                ids[op[1]].storageClass = op[2];
+                variables.push_back(op[1]);
+                break;
+            case OpDecorate:
+                if (!valid(op[0])) return false;
+                switch (op[1]) {
+                    case DecorationBlock: ids[op[0]].block = true; break;
+                    case DecorationBufferBlock: ids[op[0]].bufferBlock = true; break;
+                    case DecorationArrayStride: ids[op[0]].arrayStride = op[2]; break;
+                    case DecorationBinding: ids[op[0]].binding = op[2]; break;
+                    case DecorationDescriptorSet: ids[op[0]].set = op[2]; break;
+                    default: break;
+                }
+                break;
+            case OpMemberDecorate: {
+                // Decorations precede the struct definition, so collect them by index first
+                if (!valid(op[0])) return false;
+                Id& type = ids[op[0]];
+                if (type.memberDecorations.size() <= op[1]) {
+                    type.memberDecorations.resize(op[1] + 1);
+                }
+                if (op[2] == DecorationOffset) type.memberDecorations[op[1]].offset = op[3];
+                if (op[2] == DecorationMatrixStride) type.memberDecorations[op[1]].matrixStride = op[3];
+                break;
+            }
+            default:
+                break;
+        }
+
+        offset += count;
+    }
+
+    if (!hasEntryPoint) {
+        return false;
+    }
+
+    for (uint32_t variableId : variables) {
+        const Id& variable = ids[variableId];
+        const Id& pointer = ids[variable.typeId];
+        uint32_t typeId = pointer.typeId;
+
+        if (variable.storageClass == StoragePushConstant) {
+            reflection.pushConstantSize = std::max(reflection.pushConstantSize, typeSize(ids, typeId, 0));
+            continue;
+        }
+        if (variable.set == UINT32_MAX || variable.binding == UINT32_MAX) {
+            continue;
+        }
+
+        ShaderResourceBinding binding;
+        binding.set = variable.set;
+        binding.binding = variable.binding;
+        binding.stages = reflection.stage;
+
+        // Unwrap descriptor arrays
+        if (ids[typeId].opcode == OpTypeArray) {
+            binding.count = ids[ids[typeId].value].value;
+            typeId = ids[typeId].typeId;
+        } else if (ids[typeId].opcode == OpTypeRuntimeArray) {
+            binding.count = 0;
+            typeId = ids[typeId].typeId;
+        }
+
+        if (!descriptorType(ids, variable.storageClass, typeId, binding.type)) {
+            continue;
+        }
+        reflection.bindings.push_back(binding);
+    }
+
+    std::sort(reflection.bindings.begin(), reflection.bindings.end(),
+              [](const ShaderResourceBinding& a, const ShaderResourceBinding& b) {
+                  return a.set != b.set ? a.set < b.set : a.binding < b.binding;
+              });
+    return true;
+}
+
+std::vector<VkDescriptorSetLayoutBinding> mergeSetBindings(const std::vector<const ShaderReflection*>& stages,
+                                                           uint32_t set) {
+    std::vector<VkDescriptorSetLayoutBinding> result;
+
+    for (const ShaderReflection* reflection : stages) {
+        for (const auto& resource : reflection->bindings) {
+            if (resource.set != set) {
+                continue;
+            }
+
+            auto it = std::find_if(result.begin(), result.end(), [&](const VkDescriptorSetLayoutBinding& b) {
+                return b.binding == resource.binding;
+            });
+            if (it != result.end()) {
+                it->stageFlags |= resource.stages;
+                it->descriptorCount = std::max(it->descriptorCount, resource.count);
+                continue;
+            }
+
+            VkDescriptorSetLayoutBinding binding{};
+            binding.binding = resource.binding;
+            binding.descriptorType = resource.type;
+            binding.descriptorCount = std::max(resource.count, 1u);
+            binding.stageFlags = resource.stages;
+            if (resource.type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC) {
+                // Visible everywhere, so a set layout holding shared blocks like the frame
+                // constants is the same whichever stages of a pipeline read them
+                binding.stageFlags = VK_SHADER_STAGE_ALL;
+            }
+            result.push_back(binding);
+        }
+    }
+
+    std::sort(result.begin(), result.end(),
+              [](const VkDescriptorSetLayoutBinding& a, const VkDescriptorSetLayoutBinding& b) {
+                  return a.binding < b.binding;
+              });
+    return result;
+}
+
+} // namespace plaster
@@ -0,0 +1,629 @@
+#include "Graphics/TextureStreamer.h"
+#include "Graphics/VulkanContext.h"
+#include "Graphics/DeletionQueue.h"
+#include "Graphics/VulkanDebug.h"
+#include "Asset/AssetArchive.h"
+#include "Core/FrameArena.h"
+#include "Core/Metrics.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace plaster {
+
+namespace {
+
+VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+// Covers every texel block size, so block-compressed copies stay legal
+const VkDeviceSize STAGING_ALIGNMENT = 16;
+
+// True if [offset, offset + size) lies within limit, without wrapping
+bool fits(uint64_t offset, uint64_t size, uint64_t limit) {
+    return offset <= limit && size <= limit - offset;
+}
+
+// Checks the header and mip table against the blob's size before anything
+// trusts them, so a corrupt archive can't send mip reads out of bounds
+bool validTextureBlob(const uint8_t* blob, uint64_t blobSize) {
+    if (blobSize < sizeof(TextureBlobHeader)) {
+        return false;
+    }
+    const TextureBlobHeader* header = reinterpret_cast<const TextureBlobHeader*>(blob);
+    if (header->magic != TEXTURE_BLOB_MAGIC || header->width == 0 || header->height == 0 ||
+        header->mipCount == 0) {
+        return false;
+    }
+
+    uint32_t maxMipCount = 1;
+    for (uint32_t size = std::max(header->width, header->height); size > 1; size >>= 1) {
+        ++maxMipCount;
+    }
+    if (header->mipCount > maxMipCount ||
+        !fits(sizeof(TextureBlobHeader), uint64_t(header->mipCount) * sizeof(TextureBlobMip), blobSize)) {
+        return false;
+    }
+
+    const TextureBlobMip* mips = reinterpret_cast<const TextureBlobMip*>(blob + sizeof(TextureBlobHeader));
+    for (uint32_t mip = 0; mip < header->mipCount; ++mip) {
+        if (!fits(mips[mip].offset, mips[mip].size, blobSize)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+TextureStreamer::TextureStreamer(VulkanContext* vulkanContext, DeletionQueue* deletionQueue, uint32_t framesInFlight,
+                                 VkDeviceSize budget)
+    : m_vulkanContext(vulkanContext), m_deletionQueue(deletionQueue), m_budget(budget),
+      m_residentBytes(0), m_uploadedBytes(0), m_frameNumber(0), m_commandPool(VK_NULL_HANDLE),
+      m_currentSlot(0), m_recording(false),
+      m_stagingBuffer(VK_NULL_HANDLE), m_stagingMemory(VK_NULL_HANDLE), m_stagingMapped(nullptr),
+      m_stagingOffset(0), m_sampler(VK_NULL_HANDLE), m_placeholderImage(VK_NULL_HANDLE),
+      m_placeholderMemory(VK_NULL_HANDLE), m_placeholderView(VK_NULL_HANDLE) {
+    VkDevice device = m_vulkanContext->getDevice();
+
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    poolInfo.queueFamilyIndex = m_vulkanContext->getGraphicsQueueFamily();
+    PLASTER_VK_CHECK(vkCreateCommandPool(device, &poolInfo, nullptr, &m_commandPool));
+
+    m_uploadSlots.resize(framesInFlight);
+    for (auto& slot : m_uploadSlots) {
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = m_commandPool;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandBufferCount = 1;
+        PLASTER_VK_CHECK(vkAllocateCommandBuffers(device, &allocInfo, &slot.commandBuffer));
+        PLASTER_VK_NAME(device, VK_OBJECT_TYPE_COMMAND_BUFFER, slot.commandBuffer, "Texture uploads");
+
+        VkFenceCreateInfo fenceInfo{};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+        PLASTER_VK_CHECK(vkCreateFence(device, &fenceInfo, nullptr, &slot.fence));
+    }
+
+    // One staging region per slot, persistently mapped
+    m_vulkanContext->createBuffer(STAGING_SLOT_SIZE * framesInFlight, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                  VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                  m_stagingBuffer, m_stagingMemory);
+    void* mapped = nullptr;
+    PLASTER_VK_CHECK(vkMapMemory(device, m_stagingMemory, 0, VK_WHOLE_SIZE, 0, &mapped));
+    PLASTER_VK_NAME(device, VK_OBJECT_TYPE_BUFFER, m_stagingBuffer, "Texture staging");
+    m_stagingMapped = static_cast<uint8_t*>(mapped);
+
+    VkSamplerCreateInfo samplerInfo{};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_LINEAR;
+    samplerInfo.minFilter = VK_FILTER_LINEAR;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    samplerInfo.minLod = 0.0f;
+    samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+    PLASTER_VK_CHECK(vkCreateSampler(device, &samplerInfo, nullptr, &m_sampler));
+
+    createPlaceholder();
+}
+
+TextureStreamer::~TextureStreamer() {
+    VkDevice device = m_vulkanContext->getDevice();
+
+    for (const auto& slot : m_uploadSlots) {
+        vkWaitForFences(device, 1, &slot.fence, VK_TRUE, UINT64_MAX);
+    }
+
+    for (auto& texture : m_textures) {
+        if (texture.alive && texture.image) {
+            vkDestroyImageView(device, texture.view, nullptr);
+            vkDestroyImage(device, texture.image, nullptr);
+            vkFreeMemory(device, texture.memory, nullptr);
+        }
+    }
+
+    vkUnmapMemory(device, m_stagingMemory);
+    vkDestroyBuffer(device, m_stagingBuffer, nullptr);
+    vkFreeMemory(device, m_stagingMemory, nullptr);
+
+    for (const auto& slot : m_uploadSlots) {
+        vkDestroyFence(device, slot.fence, nullptr);
+    }
+    vkDestroyCommandPool(device, m_commandPool, nullptr);
+
+    vkDestroySampler(device, m_sampler, nullptr);
+    vkDestroyImageView(device, m_placeholderView, nullptr);
+    vkDestroyImage(device, m_placeholderImage, nullptr);
+    vkFreeMemory(device, m_placeholderMemory, nullptr);
+}
+
+TextureHandle TextureStreamer::load(const AssetArchive& archive, const std::string& path) {
+    const ArchiveEntry* entry = archive.find(path);
+    if (!entry) {
+        throw std::runtime_error("Texture not found in archive: " + path);
+    }
+
+    Texture texture;
+    texture.archive = &archive;
+    texture.entry = entry;
+
+    const uint8_t* blob = archive.view(*entry).data;
+    if (!blob) {
+        // Compressed entries can't be read in place, keep one decoded copy around
+        texture.decompressed.resize(static_cast<size_t>(entry->size));
+        if (!archive.read(*entry, texture.decompressed.data())) {
+            throw std::runtime_error("Failed to decompress texture: " + path);
+        }
+        blob = texture.decompressed.data();
+    }
+
+    if (!validTextureBlob(blob, entry->size)) {
+        throw std::runtime_error("Not a valid texture blob: " + path);
+    }
+    const TextureBlobHeader* header = reinterpret_cast<const TextureBlobHeader*>(blob);
+
+    texture.format = static_cast<VkFormat>(header->format);
+    texture.width = header->width;
+    texture.height = header->height;
+    texture.mipCount = header->mipCount;
+
+    texture.mipTail = texture.mipCount - 1;
+    for (uint32_t mip = 0; mip < texture.mipCount; ++mip) {
+        VkExtent2D extent = getMipExtent(texture, mip);
+        if (std::max(extent.width, extent.height) <= MIP_TAIL_DIMENSION) {
+            texture.mipTail = mip;
+            break;
+        }
+    }
+    texture.desiredMip = texture.mipTail;
+    texture.lastRequestFrame = m_frameNumber;
+    texture.alive = true;
+
+    TextureHandle handle;
+    if (!m_freeSlots.empty()) {
+        handle.index = m_freeSlots.back();
+        m_freeSlots.pop_back();
+        m_textures[handle.index] = std::move(texture);
+    } else {
+        if (m_textures.size() >= MAX_TEXTURES) {
+            throw std::runtime_error("Too many streamed textures");
+        }
+        handle.index = static_cast<uint32_t>(m_textures.size());
+        m_textures.push_back(std::move(texture));
+    }
+    return handle;
+}
+
+void TextureStreamer::release(TextureHandle handle) {
+    Texture& texture = m_textures[handle.index];
+    if (texture.image) {
+        m_deletionQueue->release(texture.image, texture.memory, texture.view);
+        m_residentBytes -= texture.memorySize;
+    }
+    texture = Texture();
+    m_freeSlots.push_back(handle.index);
+}
+
+void TextureStreamer::requestMip(TextureHandle handle, uint32_t mip) {
+    Texture& texture = m_textures[handle.index];
+    texture.requestedThisFrame = std::min(texture.requestedThisFrame, mip);
+}
+
+VkImageView TextureStreamer::getImageView(TextureHandle handle) const {
+    const Texture& texture = m_textures[handle.index];
+    return texture.view ? texture.view : m_placeholderView;
+}
+
+uint32_t TextureStreamer::getResidentMip(TextureHandle handle) const {
+    const Texture& texture = m_textures[handle.index];
+    return texture.residentMip == UINT32_MAX ? texture.mipTail : texture.residentMip;
+}
+
+TextureStreamingStats TextureStreamer::getStats() const {
+    TextureStreamingStats stats;
+    for (const auto& texture : m_textures) {
+        if (!texture.alive) {
+            continue;
+        }
+        ++stats.textureCount;
+        if (texture.residentMip == UINT32_MAX || texture.desiredMip < texture.residentMip) {
+            ++stats.pendingPromotions;
+        }
+    }
+    stats.residentBytes = m_residentBytes;
+    stats.budgetBytes = m_budget;
+    stats.uploadedBytes = m_uploadedBytes;
+    return stats;
+}
+
+void TextureStreamer::update(uint64_t frameNumber) {
+    m_frameNumber = frameNumber;
+
+    for (auto& texture : m_textures) {
+        if (texture.alive && texture.requestedThisFrame != UINT32_MAX) {
+            texture.desiredMip = std::min(texture.requestedThisFrame, texture.mipTail);
+            texture.lastRequestFrame = frameNumber;
+            texture.requestedThisFrame = UINT32_MAX;
+        }
+    }
+
+    // Don't stall: if this slot's previous upload is still running, try next frame
+    UploadSlot& slot = m_uploadSlots[m_currentSlot];
+    if (vkGetFenceStatus(m_vulkanContext->getDevice(), slot.fence) != VK_SUCCESS) {
+        return;
+    }
+
+    VkCommandBuffer commandBuffer = slot.commandBuffer;
+    m_stagingOffset = 0;
+    uint32_t changes = 0;
+
+    auto ensureRecording = [&]() {
+        if (!m_recording) {
+            vkResetCommandBuffer(commandBuffer, 0);
+            VkCommandBufferBeginInfo beginInfo{};
+            beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+            beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+            PLASTER_VK_CHECK(vkBeginCommandBuffer(commandBuffer, &beginInfo));
+            m_recording = true;
+        }
+    };
+
+    // Mip tails first so nothing samples the placeholder longer than needed
+    for (auto& texture : m_textures) {
+        if (changes >= MAX_RESIDENCY_CHANGES_PER_FRAME) {
+            break;
+        }
+        if (texture.alive && texture.residentMip == UINT32_MAX) {
+            ensureRecording();
+            if (!changeResidency(commandBuffer, texture, texture.mipTail)) {
+                break;
+            }
+            ++changes;
+        }
+    }
+
+    // Promote the textures furthest from their desired detail, one level each
+    FrameVector<uint32_t> candidates;
+    for (uint32_t i = 0; i < m_textures.size(); ++i) {
+        const Texture& texture = m_textures[i];
+        if (texture.alive && texture.residentMip != UINT32_MAX && texture.desiredMip < texture.residentMip) {
+            candidates.push_back(i);
+        }
+    }
+    std::sort(candidates.begin(), candidates.end(), [this](uint32_t a, uint32_t b) {
+        const Texture& ta = m_textures[a];
+        const Texture& tb = m_textures[b];
+        return ta.residentMip - ta.desiredMip > tb.residentMip - tb.desiredMip;
+    });
+
+    for (uint32_t index : candidates) {
+        if (changes >= MAX_RESIDENCY_CHANGES_PER_FRAME) {
+            break;
+        }
+        Texture& texture = m_textures[index];
+
+        // Each level up roughly quadruples the footprint
+        VkDeviceSize growth = texture.memorySize * 3;
+        if (m_residentBytes + growth > m_budget) {
+            continue;
+        }
+
+        ensureRecording();
+        if (!changeResidency(commandBuffer, texture, texture.residentMip - 1)) {
+            break;
+        }
+        ++changes;
+    }
+
+    // Memory pressure: drop top mips, starting with textures that have more
+    // detail than they asked for, then the least recently requested
+    if (m_residentBytes > m_budget) {
+        candidates.clear();
+        for (uint32_t i = 0; i < m_textures.size(); ++i) {
+            const Texture& texture = m_textures[i];
+            if (texture.alive && texture.residentMip < texture.mipTail) {
+                candidates.push_back(i);
+            }
+        }
+        std::sort(candidates.begin(), candidates.end(), [this](uint32_t a, uint32_t b) {
+            const Texture& ta = m_textures[a];
+            const Texture& tb = m_textures[b];
+            bool overA = ta.desiredMip > ta.residentMip;
+            bool overB = tb.desiredMip > tb.residentMip;
+            if (overA != overB) return overA;
+            return ta.lastRequestFrame < tb.lastRequestFrame;
+        });
+
+        for (uint32_t index : candidates) {
+            if (m_residentBytes <= m_budget || changes >= MAX_RESIDENCY_CHANGES_PER_FRAME) {
+                break;
+            }
+            Texture& texture = m_textures[index];
+
+            // Recently requested detail is only dropped if it's more than was asked for
+            bool recentlyUsed = texture.lastRequestFrame + DEMOTE_AFTER_FRAMES > frameNumber;
+            if (recentlyUsed && texture.desiredMip <= texture.residentMip) {
+                continue;
+            }
+
+            ensureRecording();
+            changeResidency(commandBuffer, texture, texture.residentMip + 1);
+            ++changes;
+        }
+    }
+
+    if (!m_recording) {
+        return;
+    }
+
+    PLASTER_VK_CHECK(vkEndCommandBuffer(commandBuffer));
+    m_recording = false;
+
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &commandBuffer;
+
+    PLASTER_VK_CHECK(vkResetFences(m_vulkanContext->getDevice(), 1, &slot.fence));
+    PLASTER_VK_CHECK(vkQueueSubmit(m_vulkanContext->getGraphicsQueue(), 1, &submitInfo, slot.fence));
+
+    m_currentSlot = (m_currentSlot + 1) % static_cast<uint32_t>(m_uploadSlots.size());
+}
+
+const uint8_t* TextureStreamer::getMipData(const Texture& texture, uint32_t mip, VkDeviceSize& size) const {
+    const uint8_t* blob = texture.decompressed.empty() ? texture.archive->view(*texture.entry).data
+                                                       : texture.decompressed.data();
+    const TextureBlobMip* mips = reinterpret_cast<const TextureBlobMip*>(blob + sizeof(TextureBlobHeader));
+    size = mips[mip].size;
+    return blob + mips[mip].offset;
+}
+
+VkExtent2D TextureStreamer::getMipExtent(const Texture& texture, uint32_t mip) const {
+    return {std::max(1u, texture.width >> mip), std::max(1u, texture.height >> mip)};
+}
+
+VkDeviceSize TextureStreamer::getStagingSize(const Texture& texture, uint32_t firstMip, uint32_t endMip) const {
+    VkDeviceSize total = 0;
+    for (uint32_t mip = firstMip; mip < endMip; ++mip) {
+        VkDeviceSize size;
+        getMipData(texture, mip, size);
+        total = alignUp(total, STAGING_ALIGNMENT) + size;
+    }
+    return total;
+}
+
+bool TextureStreamer::stageMip(const Texture& texture, uint32_t mip, VkDeviceSize& stagingOffset) {
+    VkDeviceSize size;
+    const uint8_t* data = getMipData(texture, mip, size);
+
+    VkDeviceSize offset = alignUp(m_stagingOffset, STAGING_ALIGNMENT);
+    if (offset + size > STAGING_SLOT_SIZE) {
+        return false;
+    }
+
+    stagingOffset = m_currentSlot * STAGING_SLOT_SIZE + offset;
+    std::memcpy(m_stagingMapped + stagingOffset, data, static_cast<size_t>(size));
+    m_stagingOffset = offset + size;
+    m_uploadedBytes += size;
+    static Counter& textureBytes = Metrics::counter("upload.texture_bytes", "bytes");
+    textureBytes.add(size);
+    return true;
+}
+
+bool TextureStreamer::changeResidency(VkCommandBuffer commandBuffer, Texture& texture, uint32_t newResidentMip) {
+    bool hasOld = texture.image != VK_NULL_HANDLE;
+    uint32_t oldResidentMip = hasOld ? texture.residentMip : texture.mipCount;
+
+    // Levels the old image doesn't have must come from staging; bail before touching anything
+    uint32_t uploadEnd = std::min(oldResidentMip, texture.mipCount);
+    if (newResidentMip < uploadEnd) {
+        VkDeviceSize needed = alignUp(m_stagingOffset, STAGING_ALIGNMENT) +
+                              getStagingSize(texture, newResidentMip, uploadEnd);
+        if (needed > STAGING_SLOT_SIZE) {
+            return false;
+        }
+    }
+
+    VkImage image;
+    VkDeviceMemory memory;
+    VkImageView view;
+    VkDeviceSize memorySize;
+    createImage(texture, newResidentMip, image, memory, view, memorySize);
+
+    uint32_t levelCount = texture.mipCount - newResidentMip;
+
+    VkImageMemoryBarrier barriers[2];
+    uint32_t barrierCount = 0;
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = 1;
+    barrier.subresourceRange.baseMipLevel = 0;
+
+    barrier.image = image;
+    barrier.subresourceRange.levelCount = levelCount;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barriers[barrierCount++] = barrier;
+
+    if (hasOld) {
+        barrier.image = texture.image;
+        barrier.subresourceRange.levelCount = texture.mipCount - oldResidentMip;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        barriers[barrierCount++] = barrier;
+    }
+
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         0, 0, nullptr, 0, nullptr, barrierCount, barriers);
+
+    for (uint32_t mip = newResidentMip; mip < texture.mipCount; ++mip) {
+        VkExtent2D extent = getMipExtent(texture, mip);
+
+        if (hasOld && mip >= oldResidentMip) {
+            VkImageCopy copy{};
+            copy.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, mip - oldResidentMip, 0, 1};
+            copy.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, mip - newResidentMip, 0, 1};
+            copy.extent = {extent.width, extent.height, 1};
+            vkCmdCopyImage(commandBuffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                           image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy);
+        } else {
+            VkDeviceSize stagingOffset = 0;
+            stageMip(texture, mip, stagingOffset);
+
+            VkBufferImageCopy copy{};
+            copy.bufferOffset = stagingOffset;
+            copy.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, mip - newResidentMip, 0, 1};
+            copy.imageExtent = {extent.width, extent.height, 1};
+            vkCmdCopyBufferToImage(commandBuffer, m_stagingBuffer, image,
+                                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy);
+        }
+    }
+
+    barrier.image = image;
+    barrier.subresourceRange.levelCount = levelCount;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                         0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+    if (hasOld) {
+        m_deletionQueue->release(texture.image, texture.memory, texture.view);
+        m_residentBytes -= texture.memorySize;
+    }
+
+    texture.image = image;
+    texture.memory = memory;
+    texture.view = view;
+    texture.memorySize = memorySize;
+    texture.residentMip = newResidentMip;
+    m_residentBytes += memorySize;
+    return true;
+}
+
+void TextureStreamer::createImage(const Texture& texture, uint32_t baseMip, VkImage& image,
+                                  VkDeviceMemory& memory, VkImageView& view, VkDeviceSize& memorySize) {
+    VkDevice device = m_vulkanContext->getDevice();
+    VkExtent2D extent = getMipExtent(texture, baseMip);
+    uint32_t levelCount = texture.mipCount - baseMip;
+
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.format = texture.format;
+    imageInfo.extent = {extent.width, extent.height, 1};
+    imageInfo.mipLevels = levelCount;
+    imageInfo.arrayLayers = 1;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    if (vkCreateImage(device, &imageInfo, nullptr, &image) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create streamed texture image");
+    }
+
+    VkMemoryRequirements memRequirements;
+    vkGetImageMemoryRequirements(device, image, &memRequirements);
+
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = memRequirements.size;
+    allocInfo.memoryTypeIndex = m_vulkanContext->findMemoryType(memRequirements.memoryTypeBits,
+                                                                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    if (vkAllocateMemory(device, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+        vkDestroyImage(device, image, nullptr);
+        throw std::runtime_error("Failed to allocate streamed texture memory");
+    }
+    static Counter& allocations = Metrics::counter("gpu.memory_allocations");
+    allocations.add();
+    PLASTER_VK_CHECK(vkBindImageMemory(device, image, memory, 0));
+    memorySize = memRequirements.size;
+    PLASTER_VK_NAME(device, VK_OBJECT_TYPE_IMAGE, image,
+                    texture.archive ? texture.archive->getName(*texture.entry) : "Texture placeholder");
+
+    VkImageViewCreateInfo viewInfo{};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = image;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = texture.format;
+    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    viewInfo.subresourceRange.baseMipLevel = 0;
+    viewInfo.subresourceRange.levelCount = levelCount;
+    viewInfo.subresourceRange.baseArrayLayer = 0;
+    viewInfo.subresourceRange.layerCount = 1;
+    PLASTER_VK_CHECK(vkCreateImageView(device, &viewInfo, nullptr, &view));
+}
+
+void TextureStreamer::createPlaceholder() {
+    VkDevice device = m_vulkanContext->getDevice();
+
+    Texture placeholder;
+    placeholder.format = VK_FORMAT_R8G8B8A8_UNORM;
+    placeholder.width = 1;
+    placeholder.height = 1;
+    placeholder.mipCount = 1;
+
+    VkDeviceSize memorySize;
+    createImage(placeholder, 0, m_placeholderImage, m_placeholderMemory, m_placeholderView, memorySize);
+
+    UploadSlot& slot = m_uploadSlots[0];
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    PLASTER_VK_CHECK(vkBeginCommandBuffer(slot.commandBuffer, &beginInfo));
+
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = m_placeholderImage;
+    barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+    barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    vkCmdPipelineBarrier(slot.commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+    VkClearColorValue grey = {{0.5f, 0.5f, 0.5f, 1.0f}};
+    vkCmdClearColorImage(slot.commandBuffer, m_placeholderImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                         &grey, 1, &barrier.subresourceRange);
+
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(slot.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                         0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+    PLASTER_VK_CHECK(vkEndCommandBuffer(slot.commandBuffer));
+
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &slot.commandBuffer;
+
+    PLASTER_VK_CHECK(vkResetFences(device, 1, &slot.fence));
+    PLASTER_VK_CHECK(vkQueueSubmit(m_vulkanContext->getGraphicsQueue(), 1, &submitInfo, slot.fence));
+    PLASTER_VK_CHECK(vkWaitForFences(device, 1, &slot.fence, VK_TRUE, UINT64_MAX));
+}
+
+} // namespace plaster
@@ -0,0 +1,127 @@
+#include "Graphics/UniformRing.h"
+#include "Graphics/VulkanContext.h"
+#include "Graphics/VulkanDebug.h"
+#include "Core/Metrics.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+namespace plaster {
+
+namespace {
+
+VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+// Device local + host visible (resizable BAR or unified memory) saves the
+// GPU reading every constant over PCIe; any host visible type works otherwise
+uint32_t chooseMemoryType(VkPhysicalDevice physicalDevice, uint32_t typeFilter, VkMemoryPropertyFlags& flags) {
+    VkPhysicalDeviceMemoryProperties properties;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &properties);
+
+    const VkMemoryPropertyFlags preferences[] = {
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+    };
+    for (VkMemoryPropertyFlags wanted : preferences) {
+        for (uint32_t i = 0; i < properties.memoryTypeCount; ++i) {
+            if ((typeFilter & (1u << i)) && (properties.memoryTypes[i].propertyFlags & wanted) == wanted) {
+                flags = properties.memoryTypes[i].propertyFlags;
+                return i;
+            }
+        }
+    }
+    throw std::runtime_error("No host visible memory type for the uniform ring");
+}
+
+} // namespace
+
+UniformRing::UniformRing(VulkanContext* vulkanContext, uint32_t framesInFlight, VkDeviceSize frameSize)
+    : m_vulkanContext(vulkanContext), m_buffer(VK_NULL_HANDLE), m_memory(VK_NULL_HANDLE), m_mapped(nullptr),
+      m_coherent(false), m_frameStart(0), m_head(0), m_flushed(0) {
+    VkDevice device = m_vulkanContext->getDevice();
+    const DeviceCapabilities& caps = m_vulkanContext->getCapabilities();
+
+    // Both limits are powers of two, so the larger satisfies either use
+    m_alignment = std::max(caps.minUniformBufferOffsetAlignment, caps.minStorageBufferOffsetAlignment);
+    m_atomSize = std::max<VkDeviceSize>(caps.nonCoherentAtomSize, 1);
+    // Whole atoms per region, so a flush never spills into another frame's region
+    m_frameSize = alignUp(alignUp(frameSize, m_alignment), m_atomSize);
+
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = m_frameSize * framesInFlight;
+    bufferInfo.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    PLASTER_VK_CHECK(vkCreateBuffer(device, &bufferInfo, nullptr, &m_buffer));
+
+    VkMemoryRequirements requirements;
+    vkGetBufferMemoryRequirements(device, m_buffer, &requirements);
+
+    VkMemoryPropertyFlags memoryFlags = 0;
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = requirements.size;
+    allocInfo.memoryTypeIndex = chooseMemoryType(m_vulkanContext->getPhysicalDevice(), requirements.memoryTypeBits,
+                                                 memoryFlags);
+    PLASTER_VK_CHECK(vkAllocateMemory(device, &allocInfo, nullptr, &m_memory));
+    static Counter& allocations = Metrics::counter("gpu.memory_allocations");
+    allocations.add();
+    PLASTER_VK_CHECK(vkBindBufferMemory(device, m_buffer, m_memory, 0));
+    m_coherent = (memoryFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+
+    void* mapped = nullptr;
+    PLASTER_VK_CHECK(vkMapMemory(device, m_memory, 0, VK_WHOLE_SIZE, 0, &mapped));
+    m_mapped = static_cast<char*>(mapped);
+    PLASTER_VK_NAME(device, VK_OBJECT_TYPE_BUFFER, m_buffer, "Uniform ring");
+}
+
+UniformRing::~UniformRing() {
+    VkDevice device = m_vulkanContext->getDevice();
+    vkUnmapMemory(device, m_memory);
+    vkDestroyBuffer(device, m_buffer, nullptr);
+    vkFreeMemory(device, m_memory, nullptr);
+}
+
+void UniformRing::beginFrame(uint32_t frameIndex) {
+    m_frameStart = m_frameSize * frameIndex;
+    m_head = 0;
+    m_flushed = 0;
+}
+
+UniformAllocation UniformRing::allocate(VkDeviceSize size) {
+    VkDeviceSize offset = m_head;
+    if (offset + size > m_frameSize) {
+        throw std::runtime_error("Uniform ring is out of space for this frame (" + std::to_string(m_frameSize) +
+                                 " bytes)");
+    }
+    m_head = std::min(alignUp(offset + size, m_alignment), m_frameSize);
+
+    UniformAllocation allocation;
+    allocation.data = m_mapped + m_frameStart + offset;
+    allocation.offset = static_cast<uint32_t>(m_frameStart + offset);
+    return allocation;
+}
+
+void UniformRing::flush() {
+    if (m_head == m_flushed) {
+        return;
+    }
+    static Counter& uniformBytes = Metrics::counter("upload.uniform_bytes", "bytes");
+    uniformBytes.add(m_head - m_flushed);
+
+    if (!m_coherent) {
+        // Ranges have to start and end on atom boundaries; the region itself is atom aligned
+        VkMappedMemoryRange range{};
+        range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+        range.memory = m_memory;
+        range.offset = m_frameStart + m_flushed / m_atomSize * m_atomSize;
+        range.size = m_frameStart + alignUp(m_head, m_atomSize) - range.offset;
+        PLASTER_VK_CHECK(vkFlushMappedMemoryRanges(m_vulkanContext->getDevice(), 1, &range));
+    }
+    m_flushed = m_head;
+}
+
+} // namespace plaster
@@ -1,18 +1,207 @@
 #include "Graphics/VulkanContext.h"
+#include "Graphics/VulkanDebug.h"
 #include "Core/Window.h"
+#include "Core/Log.h"
+#include "Core/Metrics.h"
 
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
 #include <vector>
 #include <stdexcept>
 
 namespace plaster {
 
+namespace {
+
+// Feature structs for every core version the engine uses, linked into one
+// pNext chain: filled by the driver to query support, then by us to enable
+struct FeatureChain {
+    VkPhysicalDeviceFeatures2 features{};
+    VkPhysicalDeviceVulkan11Features vulkan11{};
+    VkPhysicalDeviceVulkan12Features vulkan12{};
+    VkPhysicalDeviceVulkan13Features vulkan13{};
+
+    // Structs for versions the device doesn't have stay out of the chain
+    explicit FeatureChain(uint32_t apiVersion) {
+        features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        vulkan11.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_1_FEATURES;
+        vulkan12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+        vulkan13.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+        if (apiVersion >= VK_API_VERSION_1_2) {
+            features.pNext = &vulkan11;
+            vulkan11.pNext = &vulkan12;
+        }
+        if (apiVersion >= VK_API_VERSION_1_3) {
+            vulkan12.pNext = &vulkan13;
+        }
+    }
+
+    // The chain points into itself
+    FeatureChain(const FeatureChain&) = delete;
+    FeatureChain& operator=(const FeatureChain&) = delete;
+};
+
+struct Candidate {
+    VkPhysicalDevice device = VK_NULL_HANDLE;
+    uint32_t queueFamily = 0;
+    DeviceCapabilities capabilities;
+    bool suitable = false;
+    int64_t score = -1;
+};
+
+std::vector<VkExtensionProperties> getDeviceExtensions(VkPhysicalDevice device) {
+    uint32_t count = 0;
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &count, nullptr);
+    std::vector<VkExtensionProperties> extensions(count);
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &count, extensions.data());
+    return extensions;
+}
+
+bool hasExtension(const std::vector<VkExtensionProperties>& extensions, const char* name) {
+    return std::any_of(extensions.begin(), extensions.end(), [name](const VkExtensionProperties& extension) {
+        return std::strcmp(extension.extensionName, name) == 0;
+    });
+}
+
+const char* deviceTypeName(VkPhysicalDeviceType type) {
+    switch (type) {
+    case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU: return "discrete";
+    case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: return "integrated";
+    case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU: return "virtual";
+    case VK_PHYSICAL_DEVICE_TYPE_CPU: return "software";
+    default: return "other";
+    }
+}
+
+// Fills in everything but the score; false if the device can't run the engine at all
+bool queryCandidate(VkPhysicalDevice device, VkSurfaceKHR surface, uint32_t instanceVersion, Candidate& candidate) {
+    candidate.device = device;
+    DeviceCapabilities& caps = candidate.capabilities;
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(device, &properties);
+    caps.deviceName = properties.deviceName;
+    caps.deviceType = properties.deviceType;
+    caps.apiVersion = std::min(instanceVersion, properties.apiVersion);
+    caps.timestampPeriod = properties.limits.timestampPeriod;
+    caps.maxSamplerAnisotropy = properties.limits.maxSamplerAnisotropy;
+    caps.maxPushConstantsSize = properties.limits.maxPushConstantsSize;
+    caps.minUniformBufferOffsetAlignment = properties.limits.minUniformBufferOffsetAlignment;
+    caps.minStorageBufferOffsetAlignment = properties.limits.minStorageBufferOffsetAlignment;
+    caps.nonCoherentAtomSize = properties.limits.nonCoherentAtomSize;
+    caps.maxUniformBufferRange = properties.limits.maxUniformBufferRange;
+
+    VkPhysicalDeviceMemoryProperties memoryProperties;
+    vkGetPhysicalDeviceMemoryProperties(device, &memoryProperties);
+    for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; ++i) {
+        if (memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+            caps.deviceLocalMemory = std::max(caps.deviceLocalMemory, memoryProperties.memoryHeaps[i].size);
+        }
+    }
+
+    FeatureChain supported(caps.apiVersion);
+    if (caps.apiVersion >= VK_API_VERSION_1_1) {
+        vkGetPhysicalDeviceFeatures2(device, &supported.features);
+    } else {
+        vkGetPhysicalDeviceFeatures(device, &supported.features.features);
+    }
+    const VkPhysicalDeviceVulkan12Features& vulkan12 = supported.vulkan12;
+    caps.samplerAnisotropy = supported.features.features.samplerAnisotropy;
+    caps.multiDrawIndirect = supported.features.features.multiDrawIndirect &&
+                             supported.features.features.drawIndirectFirstInstance;
+    caps.shaderDrawParameters = supported.vulkan11.shaderDrawParameters;
+    caps.descriptorIndexing = vulkan12.descriptorIndexing && vulkan12.shaderSampledImageArrayNonUniformIndexing &&
+                              vulkan12.runtimeDescriptorArray && vulkan12.descriptorBindingPartiallyBound &&
+                              vulkan12.descriptorBindingVariableDescriptorCount &&
+                              vulkan12.descriptorBindingSampledImageUpdateAfterBind;
+    caps.timelineSemaphore = vulkan12.timelineSemaphore;
+    caps.drawIndirectCount = vulkan12.drawIndirectCount;
+    caps.dynamicRendering = supported.vulkan13.dynamicRendering && supported.vulkan13.synchronization2;
+
+    std::vector<VkExtensionProperties> extensions = getDeviceExtensions(device);
+    // Reading the budget goes through vkGetPhysicalDeviceMemoryProperties2
+    caps.memoryBudget = caps.apiVersion >= VK_API_VERSION_1_1 &&
+                        hasExtension(extensions, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    if (!hasExtension(extensions, VK_KHR_SWAPCHAIN_EXTENSION_NAME)) {
+        return false;
+    }
+
+    uint32_t queueFamilyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
+
+    for (uint32_t i = 0; i < queueFamilyCount; ++i) {
+        VkBool32 presentSupport = false;
+        vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+
+        if ((queueFamilies[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) && presentSupport) {
+            candidate.queueFamily = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Device type dominates so a discrete GPU always beats an integrated one and
+// software rasterizers (lavapipe, SwiftShader) come last. VRAM in MB and
+// optional features then order devices of the same type.
+int64_t scoreDevice(const DeviceCapabilities& caps) {
+    int64_t score = 0;
+    switch (caps.deviceType) {
+    case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU: score += 10000000; break;
+    case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: score += 1000000; break;
+    case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU: score += 500000; break;
+    case VK_PHYSICAL_DEVICE_TYPE_CPU: break;
+    default: score += 100000; break;
+    }
+    score += static_cast<int64_t>(caps.deviceLocalMemory / (1024 * 1024));
+
+    if (caps.dynamicRendering) score += 4000;
+    if (caps.descriptorIndexing) score += 2000;
+    if (caps.timelineSemaphore) score += 1000;
+    if (caps.drawIndirectCount) score += 500;
+    if (caps.memoryBudget) score += 250;
+    return score;
+}
+
+// PLASTER_GPU is an index from the logged device list or a case-insensitive part of the name
+int findRequestedDevice(const std::vector<Candidate>& candidates, const std::string& requested) {
+    bool isIndex = !requested.empty() && std::all_of(requested.begin(), requested.end(), [](char c) {
+        return std::isdigit(static_cast<unsigned char>(c));
+    });
+    if (isIndex) {
+        size_t index = std::stoul(requested);
+        return index < candidates.size() && candidates[index].suitable ? static_cast<int>(index) : -1;
+    }
+
+    auto lower = [](std::string text) {
+        std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) {
+            return static_cast<char>(std::tolower(c));
+        });
+        return text;
+    };
+    std::string needle = lower(requested);
+    for (size_t i = 0; i < candidates.size(); ++i) {
+        if (candidates[i].suitable && lower(candidates[i].capabilities.deviceName).find(needle) != std::string::npos) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+} // namespace
+
 VulkanContext::VulkanContext(Window* window)
     : m_instance(VK_NULL_HANDLE), m_physicalDevice(VK_NULL_HANDLE),
       m_device(VK_NULL_HANDLE), m_surface(VK_NULL_HANDLE),
-      m_graphicsQueue(VK_NULL_HANDLE), m_graphicsQueueFamily(0), m_window(window) {
+      m_graphicsQueue(VK_NULL_HANDLE), m_graphicsQueueFamily(0), m_instanceVersion(VK_API_VERSION_1_0),
+      m_debugMessenger(VK_NULL_HANDLE), m_validationEnabled(false), m_window(window) {
     
     createInstance();
     createSurface();
@@ -27,19 +216,34 @@ VulkanContext::~VulkanContext() {
     if (m_surface) {
         vkDestroySurfaceKHR(m_instance, m_surface, nullptr);
     }
+#ifdef PLASTER_VULKAN_DEBUG
+    if (m_debugMessenger) {
+        vkdebug::destroyMessenger(m_instance, m_debugMessenger);
+    }
+#endif
     if (m_instance) {
         vkDestroyInstance(m_instance, nullptr);
     }
 }
 
 void VulkanContext::createInstance() {
+    // Ask for the newest version the engine knows; each device is then capped to
+    // what it supports. vkEnumerateInstanceVersion itself is missing from 1.0 loaders
+    uint32_t loaderVersion = VK_API_VERSION_1_0;
+    auto enumerateInstanceVersion = reinterpret_cast<PFN_vkEnumerateInstanceVersion>(
+        vkGetInstanceProcAddr(VK_NULL_HANDLE, "vkEnumerateInstanceVersion"));
+    if (enumerateInstanceVersion) {
+        enumerateInstanceVersion(&loaderVersion);
+    }
+    m_instanceVersion = std::min(loaderVersion, VK_API_VERSION_1_3);
+
     VkApplicationInfo appInfo{};
     appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
     appInfo.pApplicationName = "PlasterEngine";
     appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
     appInfo.pEngineName = "PlasterEngine";
     appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-    appInfo.apiVersion = VK_API_VERSION_1_0;
+    appInfo.apiVersion = m_instanceVersion;
 
     VkInstanceCreateInfo createInfo{};
     createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -47,15 +251,78 @@ void VulkanContext::createInstance() {
 
     uint32_t glfwExtensionCount = 0;
     const char** glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-    
-    createInfo.enabledExtensionCount = glfwExtensionCount;
-    createInfo.ppEnabledExtensionNames = glfwExtensions;
-    createInfo.enabledLayerCount = 0;
+    std::vector<const char*> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+    std::vector<const char*> layers;
+
+#ifdef PLASTER_VULKAN_DEBUG
+    const char* validationLayer = "VK_LAYER_KHRONOS_validation";
+    std::string options = std::getenv("PLASTER_VALIDATION") ? std::getenv("PLASTER_VALIDATION") : "";
+    bool verbose = options.find("verbose") != std::string::npos;
+
+    uint32_t layerCount = 0;
+    vkEnumerateInstanceLayerProperties(&layerCount, nullptr);
+    std::vector<VkLayerProperties> availableLayers(layerCount);
+    vkEnumerateInstanceLayerProperties(&layerCount, availableLayers.data());
+    bool layerFound = std::any_of(availableLayers.begin(), availableLayers.end(), [&](const VkLayerProperties& layer) {
+        return std::strcmp(layer.layerName, validationLayer) == 0;
+    });
+
+    if (options != "0") {
+        if (layerFound) {
+            layers.push_back(validationLayer);
+            m_validationEnabled = true;
+        } else {
+            logWarning("vulkan", std::string(validationLayer) + " not installed, running without validation");
+        }
+    }
+
+    // Names and labels are useful in capture tools even without the layer
+    uint32_t extensionCount = 0;
+    vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, nullptr);
+    std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+    vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, availableExtensions.data());
+    bool debugUtils = m_validationEnabled || hasExtension(availableExtensions, VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+    if (debugUtils) {
+        extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+    }
+
+    // Chained into the create info as well, so instance creation itself is validated
+    VkDebugUtilsMessengerCreateInfoEXT messengerInfo = vkdebug::messengerCreateInfo(verbose);
+    VkValidationFeatureEnableEXT syncValidation = VK_VALIDATION_FEATURE_ENABLE_SYNCHRONIZATION_VALIDATION_EXT;
+    VkValidationFeaturesEXT validationFeatures{};
+    validationFeatures.sType = VK_STRUCTURE_TYPE_VALIDATION_FEATURES_EXT;
+    validationFeatures.enabledValidationFeatureCount = 1;
+    validationFeatures.pEnabledValidationFeatures = &syncValidation;
+
+    if (m_validationEnabled) {
+        createInfo.pNext = &messengerInfo;
+        if (options.find("sync") != std::string::npos) {
+            // VK_EXT_validation_features is provided by the layer itself
+            extensions.push_back(VK_EXT_VALIDATION_FEATURES_EXTENSION_NAME);
+            messengerInfo.pNext = &validationFeatures;
+        }
+    }
+#endif
+
+    createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+    createInfo.ppEnabledExtensionNames = extensions.data();
+    createInfo.enabledLayerCount = static_cast<uint32_t>(layers.size());
+    createInfo.ppEnabledLayerNames = layers.data();
 
     VkResult result = vkCreateInstance(&createInfo, nullptr, &m_instance);
     if (result != VK_SUCCESS) {
         throw std::runtime_error("Failed to create Vulkan instance");
     }
+
+#ifdef PLASTER_VULKAN_DEBUG
+    if (debugUtils) {
+        vkdebug::loadFunctions(m_instance);
+    }
+    if (m_validationEnabled) {
+        m_debugMessenger = vkdebug::createMessenger(m_instance, verbose);
+        logInfo("vulkan", std::string("Validation enabled") + (messengerInfo.pNext ? " with synchronization checks" : ""));
+    }
+#endif
 }
 
 void VulkanContext::createSurface() {
@@ -76,26 +343,41 @@ void VulkanContext::pickPhysicalDevice() {
     std::vector<VkPhysicalDevice> devices(deviceCount);
     vkEnumeratePhysicalDevices(m_instance, &deviceCount, devices.data());
 
-    for (const auto& device : devices) {
-        uint32_t queueFamilyCount = 0;
-        vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, nullptr);
+    std::vector<Candidate> candidates(deviceCount);
+    for (uint32_t i = 0; i < deviceCount; ++i) {
+        candidates[i].suitable = queryCandidate(devices[i], m_surface, m_instanceVersion, candidates[i]);
+        candidates[i].score = candidates[i].suitable ? scoreDevice(candidates[i].capabilities) : -1;
 
-        std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
-        vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
-
-        for (uint32_t i = 0; i < queueFamilyCount; ++i) {
-            VkBool32 presentSupport = false;
-            vkGetPhysicalDeviceSurfaceSupportKHR(device, i, m_surface, &presentSupport);
+        const DeviceCapabilities& caps = candidates[i].capabilities;
+        logInfo("vulkan", "GPU " + std::to_string(i) + ": " + caps.deviceName + " (" +
+                              deviceTypeName(caps.deviceType) + ", " +
+                              std::to_string(caps.deviceLocalMemory / (1024 * 1024)) + " MB) " +
+                              (candidates[i].suitable ? "score " + std::to_string(candidates[i].score)
+                                                      : std::string("unsuitable")));
+    }
 
-            if ((queueFamilies[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) && presentSupport) {
-                m_physicalDevice = device;
-                m_graphicsQueueFamily = i;
-                return;
+    int selected = -1;
+    if (const char* requested = std::getenv("PLASTER_GPU")) {
+        selected = findRequestedDevice(candidates, requested);
+        if (selected < 0) {
+            logWarning("vulkan", std::string("PLASTER_GPU=") + requested + " matches no suitable GPU, picking by score");
+        }
+    }
+    if (selected < 0) {
+        for (uint32_t i = 0; i < deviceCount; ++i) {
+            if (candidates[i].suitable && (selected < 0 || candidates[i].score > candidates[selected].score)) {
+                selected = static_cast<int>(i);
             }
         }
     }
-    
-    throw std::runtime_error("Failed to find suitable GPU");
+    if (selected < 0) {
+        throw std::runtime_error("Failed to find suitable GPU");
+    }
+
+    m_physicalDevice = candidates[selected].device;
+    m_graphicsQueueFamily = candidates[selected].queueFamily;
+    m_capabilities = candidates[selected].capabilities;
+    logInfo("vulkan", "Using GPU " + std::to_string(selected) + ": " + m_capabilities.deviceName);
 }
 
 void VulkanContext::createLogicalDevice() {
@@ -107,17 +389,46 @@ void VulkanContext::createLogicalDevice() {
   float queuePriority = 1.0f;
   queueCreateInfo.pQueuePriorities = &queuePriority;
 
-  VkPhysicalDeviceFeatures deviceFeatures{};
+  // Capabilities only report what the device supports, so enabling them all is safe
+  const DeviceCapabilities& caps = m_capabilities;
+  FeatureChain enabled(caps.apiVersion);
+  enabled.features.features.samplerAnisotropy = caps.samplerAnisotropy;
+  enabled.features.features.multiDrawIndirect = caps.multiDrawIndirect;
+  enabled.features.features.drawIndirectFirstInstance = caps.multiDrawIndirect;
+  enabled.vulkan11.shaderDrawParameters = caps.shaderDrawParameters;
+  enabled.vulkan12.descriptorIndexing = caps.descriptorIndexing;
+  enabled.vulkan12.shaderSampledImageArrayNonUniformIndexing = caps.descriptorIndexing;
+  enabled.vulkan12.runtimeDescriptorArray = caps.descriptorIndexing;
+  enabled.vulkan12.descriptorBindingPartiallyBound = caps.descriptorIndexing;
+  enabled.vulkan12.descriptorBindingVariableDescriptorCount = caps.descriptorIndexing;
+  enabled.vulkan12.descriptorBindingSampledImageUpdateAfterBind = caps.descriptorIndexing;
+  enabled.vulkan12.timelineSemaphore = caps.timelineSemaphore;
+  enabled.vulkan12.drawIndirectCount = caps.drawIndirectCount;
+  enabled.vulkan13.dynamicRendering = caps.dynamicRendering;
+  enabled.vulkan13.synchronization2 = caps.dynamicRendering;
 
-  const char* extensionNames[] = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
+  std::vector<VkExtensionProperties> available = getDeviceExtensions(m_physicalDevice);
+  std::vector<const char*> extensionNames = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
+  if (caps.memoryBudget) {
+      extensionNames.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+  }
+  // Required by the spec whenever the implementation exposes it (MoltenVK)
+  if (hasExtension(available, "VK_KHR_portability_subset")) {
+      extensionNames.push_back("VK_KHR_portability_subset");
+  }
 
   VkDeviceCreateInfo createInfo{};
   createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
   createInfo.queueCreateInfoCount = 1;
   createInfo.pQueueCreateInfos = &queueCreateInfo;
-  createInfo.pEnabledFeatures = &deviceFeatures;
-  createInfo.enabledExtensionCount = 1;
-  createInfo.ppEnabledExtensionNames = extensionNames;
+  // Features2 in the chain replaces pEnabledFeatures
+  if (caps.apiVersion >= VK_API_VERSION_1_1) {
+      createInfo.pNext = &enabled.features;
+  } else {
+      createInfo.pEnabledFeatures = &enabled.features.features;
+  }
+  createInfo.enabledExtensionCount = static_cast<uint32_t>(extensionNames.size());
+  createInfo.ppEnabledExtensionNames = extensionNames.data();
   createInfo.enabledLayerCount = 0;
 
   VkResult result = vkCreateDevice(m_physicalDevice, &createInfo, nullptr, &m_device);
@@ -128,6 +439,112 @@ void VulkanContext::createLogicalDevice() {
   vkGetDeviceQueue(m_device, m_graphicsQueueFamily, 0, &m_graphicsQueue);
 }
 
-} // namespace plaster
+VkDeviceSize VulkanContext::getDeviceLocalMemorySize() const {
+    VkPhysicalDeviceMemoryProperties memProperties;
+    vkGetPhysicalDeviceMemoryProperties(m_physicalDevice, &memProperties);
+
+    VkDeviceSize size = 0;
+    for (uint32_t i = 0; i < memProperties.memoryHeapCount; ++i) {
+        if (memProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+            size = std::max(size, memProperties.memoryHeaps[i].size);
+        }
+    }
+    return size;
+}
+
+VkDeviceSize VulkanContext::getDeviceLocalBudget() const {
+    if (!m_capabilities.memoryBudget) {
+        return getDeviceLocalMemorySize();
+    }
+
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT budget{};
+    budget.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+    VkPhysicalDeviceMemoryProperties2 memProperties{};
+    memProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+    memProperties.pNext = &budget;
+    vkGetPhysicalDeviceMemoryProperties2(m_physicalDevice, &memProperties);
+
+    // Budget of the largest device-local heap, matching getDeviceLocalMemorySize()
+    VkDeviceSize largest = 0;
+    VkDeviceSize result = 0;
+    const VkPhysicalDeviceMemoryProperties& heaps = memProperties.memoryProperties;
+    for (uint32_t i = 0; i < heaps.memoryHeapCount; ++i) {
+        if ((heaps.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) && heaps.memoryHeaps[i].size > largest) {
+            largest = heaps.memoryHeaps[i].size;
+            result = budget.heapBudget[i];
+        }
+    }
+    return result;
+}
+
+uint32_t VulkanContext::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const {
+    VkPhysicalDeviceMemoryProperties memProperties;
+    vkGetPhysicalDeviceMemoryProperties(m_physicalDevice, &memProperties);
+
+    for (uint32_t i = 0; i < memProperties.memoryTypeCount; ++i) {
+        if ((typeFilter & (1u << i)) &&
+            (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+            return i;
+        }
+    }
+
+    throw std::runtime_error("Failed to find suitable memory type");
+}
+
+void VulkanContext::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
+                                 VkBuffer& buffer, VkDeviceMemory& memory) const {
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = size;
+    bufferInfo.usage = usage;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    if (vkCreateBuffer(m_device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create buffer");
+    }
+
+    VkMemoryRequirements memRequirements;
+    vkGetBufferMemoryRequirements(m_device, buffer, &memRequirements);
 
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = memRequirements.size;
+    allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
 
+    if (vkAllocateMemory(m_device, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+        vkDestroyBuffer(m_device, buffer, nullptr);
+        buffer = VK_NULL_HANDLE;
+        throw std::runtime_error("Failed to allocate buffer memory");
+    }
+    static Counter& allocations = Metrics::counter("gpu.memory_allocations");
+    allocations.add();
+
+    vkBindBufferMemory(m_device, buffer, memory, 0);
+}
+
+void VulkanContext::createImage(const VkImageCreateInfo& imageInfo, VkMemoryPropertyFlags properties,
+                                VkImage& image, VkDeviceMemory& memory) const {
+    if (vkCreateImage(m_device, &imageInfo, nullptr, &image) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create image");
+    }
+
+    VkMemoryRequirements memRequirements;
+    vkGetImageMemoryRequirements(m_device, image, &memRequirements);
+
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = memRequirements.size;
+    allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
+
+    if (vkAllocateMemory(m_device, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+        vkDestroyImage(m_device, image, nullptr);
+        image = VK_NULL_HANDLE;
+        throw std::runtime_error("Failed to allocate image memory");
+    }
+    static Counter& allocations = Metrics::counter("gpu.memory_allocations");
+    allocations.add();
+
+    vkBindImageMemory(m_device, image, memory, 0);
+}
+
+} // namespace plaster
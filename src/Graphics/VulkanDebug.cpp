@@ -0,0 +1,163 @@
+#include "Graphics/VulkanDebug.h"
+
+#ifdef PLASTER_VULKAN_DEBUG
+
+#include "Core/Log.h"
+
+#include <stdexcept>
+#include <string>
+
+namespace plaster {
+namespace vkdebug {
+
+namespace {
+
+PFN_vkSetDebugUtilsObjectNameEXT s_setObjectName = nullptr;
+PFN_vkCmdBeginDebugUtilsLabelEXT s_beginLabel = nullptr;
+PFN_vkCmdEndDebugUtilsLabelEXT s_endLabel = nullptr;
+
+const char* resultName(VkResult result) {
+    switch (result) {
+    case VK_SUCCESS: return "VK_SUCCESS";
+    case VK_NOT_READY: return "VK_NOT_READY";
+    case VK_TIMEOUT: return "VK_TIMEOUT";
+    case VK_INCOMPLETE: return "VK_INCOMPLETE";
+    case VK_SUBOPTIMAL_KHR: return "VK_SUBOPTIMAL_KHR";
+    case VK_ERROR_OUT_OF_HOST_MEMORY: return "VK_ERROR_OUT_OF_HOST_MEMORY";
+    case VK_ERROR_OUT_OF_DEVICE_MEMORY: return "VK_ERROR_OUT_OF_DEVICE_MEMORY";
+    case VK_ERROR_INITIALIZATION_FAILED: return "VK_ERROR_INITIALIZATION_FAILED";
+    case VK_ERROR_DEVICE_LOST: return "VK_ERROR_DEVICE_LOST";
+    case VK_ERROR_LAYER_NOT_PRESENT: return "VK_ERROR_LAYER_NOT_PRESENT";
+    case VK_ERROR_EXTENSION_NOT_PRESENT: return "VK_ERROR_EXTENSION_NOT_PRESENT";
+    case VK_ERROR_FEATURE_NOT_PRESENT: return "VK_ERROR_FEATURE_NOT_PRESENT";
+    case VK_ERROR_INCOMPATIBLE_DRIVER: return "VK_ERROR_INCOMPATIBLE_DRIVER";
+    case VK_ERROR_OUT_OF_POOL_MEMORY: return "VK_ERROR_OUT_OF_POOL_MEMORY";
+    case VK_ERROR_FRAGMENTED_POOL: return "VK_ERROR_FRAGMENTED_POOL";
+    case VK_ERROR_OUT_OF_DATE_KHR: return "VK_ERROR_OUT_OF_DATE_KHR";
+    case VK_ERROR_SURFACE_LOST_KHR: return "VK_ERROR_SURFACE_LOST_KHR";
+    default: return "unknown VkResult";
+    }
+}
+
+VKAPI_ATTR VkBool32 VKAPI_CALL messengerCallback(VkDebugUtilsMessageSeverityFlagBitsEXT severity,
+                                                 VkDebugUtilsMessageTypeFlagsEXT,
+                                                 const VkDebugUtilsMessengerCallbackDataEXT* callbackData, void*) {
+    LogLevel level = LogLevel::Verbose;
+    if (severity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT) {
+        level = LogLevel::Error;
+    } else if (severity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT) {
+        level = LogLevel::Warning;
+    } else if (severity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT) {
+        level = LogLevel::Info;
+    }
+
+    std::string message = callbackData->pMessage ? callbackData->pMessage : "";
+    // Debug names of the objects involved, as set through PLASTER_VK_NAME
+    for (uint32_t i = 0; i < callbackData->objectCount; ++i) {
+        if (callbackData->pObjects[i].pObjectName) {
+            message += i == 0 ? "\n    objects: " : ", ";
+            message += callbackData->pObjects[i].pObjectName;
+        }
+    }
+    logMessage(level, "vulkan", message);
+
+    // Never abort the call that triggered the message
+    return VK_FALSE;
+}
+
+} // namespace
+
+void check(VkResult result, const char* expression, const char* file, int line) {
+    // Positive codes are statuses the caller may still want to look at
+    if (result >= VK_SUCCESS) {
+        return;
+    }
+    std::string message = std::string(expression) + " returned " + resultName(result) + " at " + file + ":" +
+                          std::to_string(line);
+    logError("vulkan", message);
+    throw std::runtime_error(message);
+}
+
+void loadFunctions(VkInstance instance) {
+    s_setObjectName = reinterpret_cast<PFN_vkSetDebugUtilsObjectNameEXT>(
+        vkGetInstanceProcAddr(instance, "vkSetDebugUtilsObjectNameEXT"));
+    s_beginLabel = reinterpret_cast<PFN_vkCmdBeginDebugUtilsLabelEXT>(
+        vkGetInstanceProcAddr(instance, "vkCmdBeginDebugUtilsLabelEXT"));
+    s_endLabel = reinterpret_cast<PFN_vkCmdEndDebugUtilsLabelEXT>(
+        vkGetInstanceProcAddr(instance, "vkCmdEndDebugUtilsLabelEXT"));
+}
+
+VkDebugUtilsMessengerCreateInfoEXT messengerCreateInfo(bool verbose) {
+    VkDebugUtilsMessengerCreateInfoEXT createInfo{};
+    createInfo.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT;
+    createInfo.messageSeverity = VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT |
+                                 VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
+    if (verbose) {
+        createInfo.messageSeverity |= VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT |
+                                      VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT;
+    }
+    createInfo.messageType = VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT |
+                             VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT |
+                             VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT;
+    createInfo.pfnUserCallback = messengerCallback;
+    return createInfo;
+}
+
+VkDebugUtilsMessengerEXT createMessenger(VkInstance instance, bool verbose) {
+    auto create = reinterpret_cast<PFN_vkCreateDebugUtilsMessengerEXT>(
+        vkGetInstanceProcAddr(instance, "vkCreateDebugUtilsMessengerEXT"));
+    if (!create) {
+        return VK_NULL_HANDLE;
+    }
+
+    VkDebugUtilsMessengerCreateInfoEXT createInfo = messengerCreateInfo(verbose);
+    VkDebugUtilsMessengerEXT messenger = VK_NULL_HANDLE;
+    if (create(instance, &createInfo, nullptr, &messenger) != VK_SUCCESS) {
+        logWarning("vulkan", "Failed to create debug messenger");
+        return VK_NULL_HANDLE;
+    }
+    return messenger;
+}
+
+void destroyMessenger(VkInstance instance, VkDebugUtilsMessengerEXT messenger) {
+    auto destroy = reinterpret_cast<PFN_vkDestroyDebugUtilsMessengerEXT>(
+        vkGetInstanceProcAddr(instance, "vkDestroyDebugUtilsMessengerEXT"));
+    if (destroy && messenger) {
+        destroy(instance, messenger, nullptr);
+    }
+}
+
+void setObjectName(VkDevice device, VkObjectType type, uint64_t handle, const std::string& name) {
+    if (!s_setObjectName || handle == 0) {
+        return;
+    }
+
+    VkDebugUtilsObjectNameInfoEXT nameInfo{};
+    nameInfo.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_OBJECT_NAME_INFO_EXT;
+    nameInfo.objectType = type;
+    nameInfo.objectHandle = handle;
+    nameInfo.pObjectName = name.c_str();
+    s_setObjectName(device, &nameInfo);
+}
+
+void beginLabel(VkCommandBuffer commandBuffer, const std::string& name) {
+    if (!s_beginLabel) {
+        return;
+    }
+
+    VkDebugUtilsLabelEXT label{};
+    label.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_LABEL_EXT;
+    label.pLabelName = name.c_str();
+    s_beginLabel(commandBuffer, &label);
+}
+
+void endLabel(VkCommandBuffer commandBuffer) {
+    if (s_endLabel) {
+        s_endLabel(commandBuffer);
+    }
+}
+
+} // namespace vkdebug
+} // namespace plaster
+
+#endif
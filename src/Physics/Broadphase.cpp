@@ -0,0 +1,200 @@
+#include "Physics/Broadphase.h"
+#include "Core/JobSystem.h"
+#include "Core/Simd.h"
+
+#include <algorithm>
+#include <cfloat>
+
+namespace plaster {
+
+SweepAndPrune::SweepAndPrune(JobSystem* jobSystem)
+    : m_jobSystem(jobSystem), m_axis(0), m_addedSinceSort(0), m_removedSinceSort(false), m_lastSwapCount(0) {}
+
+void SweepAndPrune::add(uint32_t id, const Aabb& bounds, bool isStatic) {
+    if (id >= m_bounds.size()) {
+        m_bounds.resize(id + 1);
+        m_static.resize(id + 1, 0);
+        m_present.resize(id + 1, 0);
+    }
+    if (m_removedSinceSort) {
+        // The id may be coming back before its old entry was dropped
+        removeStale();
+    }
+    m_bounds[id] = bounds;
+    m_static[id] = isStatic ? 1 : 0;
+    m_present[id] = 1;
+    m_order.push_back({bounds.min[m_axis], id});
+    ++m_addedSinceSort;
+}
+
+void SweepAndPrune::remove(uint32_t id) {
+    m_present[id] = 0;
+    m_removedSinceSort = true;
+}
+
+void SweepAndPrune::findPairs(std::vector<BodyPair>& pairs) {
+    pairs.clear();
+    sortOrder();
+
+    uint32_t count = getProxyCount();
+    uint32_t batchCount = (count + SWEEP_BATCH - 1) / SWEEP_BATCH;
+    if (m_batchPairs.size() < batchCount) {
+        m_batchPairs.resize(batchCount);
+    }
+    // parallelFor hands out batches of exactly SWEEP_BATCH, so each writes to its own list
+    m_jobSystem->parallelFor(count, SWEEP_BATCH, [this](uint32_t begin, uint32_t end) {
+        std::vector<BodyPair>& batchPairs = m_batchPairs[begin / SWEEP_BATCH];
+        batchPairs.clear();
+        sweep(begin, end, batchPairs);
+    });
+
+    for (uint32_t batch = 0; batch < batchCount; ++batch) {
+        pairs.insert(pairs.end(), m_batchPairs[batch].begin(), m_batchPairs[batch].end());
+    }
+    // Sweep order changes as bodies move; key order keeps later stages deterministic
+    std::sort(pairs.begin(), pairs.end(),
+              [](const BodyPair& a, const BodyPair& b) { return a.getKey() < b.getKey(); });
+}
+
+void SweepAndPrune::chooseAxis() {
+    // The axis with the largest variance of centers has the fewest overlapping intervals
+    glm::vec3 sum(0.0f);
+    glm::vec3 sumSquares(0.0f);
+    for (const SortKey& key : m_order) {
+        glm::vec3 center = m_bounds[key.id].getCenter();
+        sum += center;
+        sumSquares += center * center;
+    }
+    float count = static_cast<float>(std::max<size_t>(m_order.size(), 1));
+    glm::vec3 variance = sumSquares / count - (sum / count) * (sum / count);
+
+    uint32_t best = variance.x > variance.y ? (variance.x > variance.z ? 0 : 2) : (variance.y > variance.z ? 1 : 2);
+    // Hysteresis, as switching axes costs a full sort
+    if (variance[best] > variance[m_axis] * 1.5f) {
+        m_axis = best;
+        m_addedSinceSort = static_cast<uint32_t>(m_order.size());
+    }
+}
+
+void SweepAndPrune::removeStale() {
+    // Stable, so what remains stays sorted
+    m_order.erase(std::remove_if(m_order.begin(), m_order.end(),
+                                 [this](const SortKey& key) { return !m_present[key.id]; }),
+                  m_order.end());
+    m_removedSinceSort = false;
+}
+
+void SweepAndPrune::sortOrder() {
+    if (m_removedSinceSort) {
+        removeStale();
+    }
+    chooseAxis();
+
+    for (SortKey& key : m_order) {
+        key.min = m_bounds[key.id].min[m_axis];
+    }
+
+    size_t count = m_order.size();
+    m_lastSwapCount = 0;
+    if (m_addedSinceSort > count / 8) {
+        // Many new proxies, or a new axis: far from sorted, so insertion sort would go quadratic
+        std::sort(m_order.begin(), m_order.end(), [](const SortKey& a, const SortKey& b) { return a.min < b.min; });
+    } else {
+        for (size_t i = 1; i < count; ++i) {
+            SortKey key = m_order[i];
+            size_t j = i;
+            while (j > 0 && m_order[j - 1].min > key.min) {
+                m_order[j] = m_order[j - 1];
+                --j;
+            }
+            m_lastSwapCount += static_cast<uint32_t>(i - j);
+            m_order[j] = key;
+        }
+    }
+    m_addedSinceSort = 0;
+
+    size_t padded = count + SIMD_PADDING;
+    m_sweepMin.resize(padded);
+    m_sweepMax.resize(padded);
+    m_minA.resize(padded);
+    m_maxA.resize(padded);
+    m_minB.resize(padded);
+    m_maxB.resize(padded);
+    m_sortedStatic.resize(padded);
+
+    uint32_t axisA = (m_axis + 1) % 3;
+    uint32_t axisB = (m_axis + 2) % 3;
+    for (size_t i = 0; i < count; ++i) {
+        const Aabb& bounds = m_bounds[m_order[i].id];
+        m_sweepMin[i] = bounds.min[m_axis];
+        m_sweepMax[i] = bounds.max[m_axis];
+        m_minA[i] = bounds.min[axisA];
+        m_maxA[i] = bounds.max[axisA];
+        m_minB[i] = bounds.min[axisB];
+        m_maxB[i] = bounds.max[axisB];
+        m_sortedStatic[i] = m_static[m_order[i].id];
+    }
+    // Padding starts after everything, which ends every sweep, and overlaps nothing
+    for (size_t i = count; i < padded; ++i) {
+        m_sweepMin[i] = FLT_MAX;
+        m_sweepMax[i] = -FLT_MAX;
+        m_minA[i] = FLT_MAX;
+        m_maxA[i] = -FLT_MAX;
+        m_minB[i] = FLT_MAX;
+        m_maxB[i] = -FLT_MAX;
+        m_sortedStatic[i] = 1;
+    }
+}
+
+void SweepAndPrune::sweep(uint32_t begin, uint32_t end, std::vector<BodyPair>& pairs) const {
+    for (uint32_t i = begin; i < end; ++i) {
+        float sweepMax = m_sweepMax[i];
+        uint32_t j = i + 1;
+        // Candidates start before i ends; the padding guarantees the loop stops in bounds
+        while (m_sweepMin[j] <= sweepMax) {
+            uint32_t overlapMask;
+            uint32_t inRangeMask;
+#ifdef PLASTER_SSE2
+            __m128 inRange = _mm_cmple_ps(_mm_loadu_ps(&m_sweepMin[j]), _mm_set1_ps(sweepMax));
+            __m128 overlapA = _mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(&m_minA[j]), _mm_set1_ps(m_maxA[i])),
+                                         _mm_cmpge_ps(_mm_loadu_ps(&m_maxA[j]), _mm_set1_ps(m_minA[i])));
+            __m128 overlapB = _mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(&m_minB[j]), _mm_set1_ps(m_maxB[i])),
+                                         _mm_cmpge_ps(_mm_loadu_ps(&m_maxB[j]), _mm_set1_ps(m_minB[i])));
+            inRangeMask = static_cast<uint32_t>(_mm_movemask_ps(inRange));
+            overlapMask = static_cast<uint32_t>(_mm_movemask_ps(_mm_and_ps(inRange, _mm_and_ps(overlapA, overlapB))));
+#else
+            inRangeMask = 0;
+            overlapMask = 0;
+            for (uint32_t lane = 0; lane < 4; ++lane) {
+                uint32_t k = j + lane;
+                bool inRange = m_sweepMin[k] <= sweepMax;
+                bool overlap = m_minA[k] <= m_maxA[i] && m_maxA[k] >= m_minA[i] && m_minB[k] <= m_maxB[i] &&
+                               m_maxB[k] >= m_minB[i];
+                inRangeMask |= inRange ? 1u << lane : 0u;
+                overlapMask |= inRange && overlap ? 1u << lane : 0u;
+            }
+#endif
+            while (overlapMask) {
+                uint32_t lane = 0;
+                while (!((overlapMask >> lane) & 1)) {
+                    ++lane;
+                }
+                overlapMask &= overlapMask - 1;
+                uint32_t k = j + lane;
+                if (m_sortedStatic[i] && m_sortedStatic[k]) {
+                    continue;
+                }
+                uint32_t a = m_order[i].id;
+                uint32_t b = m_order[k].id;
+                pairs.push_back(a < b ? BodyPair{a, b} : BodyPair{b, a});
+            }
+            // Sorted, so once a lane is out of range every later candidate is
+            if (inRangeMask != 0xf) {
+                break;
+            }
+            j += 4;
+        }
+    }
+}
+
+} // namespace plaster
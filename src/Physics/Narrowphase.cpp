@@ -0,0 +1,384 @@
+#include "Physics/Narrowphase.h"
+
+#include <cfloat>
+#include <cmath>
+
+namespace plaster {
+
+namespace {
+
+// Points this close in body A's frame are taken to be the same contact
+const float MATCH_DISTANCE = 0.05f;
+// Prefer face contacts unless an edge pair separates clearly more, which
+// keeps resting boxes from flickering between the two
+const float AXIS_RELATIVE_TOLERANCE = 0.95f;
+const float AXIS_ABSOLUTE_TOLERANCE = 0.01f;
+// A convex quad clipped by four planes gains at most one vertex per plane
+const uint32_t MAX_CLIP_POINTS = 8;
+
+struct OrientedBox {
+    glm::vec3 center;
+    glm::vec3 axes[3];
+    glm::vec3 halfExtents;
+};
+
+OrientedBox makeBox(const RigidBody& body) {
+    glm::mat3 rotation = glm::mat3_cast(body.orientation);
+    OrientedBox box;
+    box.center = body.position;
+    box.axes[0] = rotation[0];
+    box.axes[1] = rotation[1];
+    box.axes[2] = rotation[2];
+    box.halfExtents = body.shape.halfExtents;
+    return box;
+}
+
+float projectedRadius(const OrientedBox& box, const glm::vec3& axis) {
+    return box.halfExtents.x * std::fabs(glm::dot(box.axes[0], axis)) +
+           box.halfExtents.y * std::fabs(glm::dot(box.axes[1], axis)) +
+           box.halfExtents.z * std::fabs(glm::dot(box.axes[2], axis));
+}
+
+float separationAlong(const OrientedBox& a, const OrientedBox& b, const glm::vec3& offset, const glm::vec3& axis) {
+    return std::fabs(glm::dot(offset, axis)) - projectedRadius(a, axis) - projectedRadius(b, axis);
+}
+
+void addPoint(ContactManifold& manifold, const RigidBody& a, const glm::vec3& position, float separation) {
+    ContactPoint& point = manifold.points[manifold.pointCount++];
+    point.position = position;
+    point.localAnchorA = glm::conjugate(a.orientation) * (position - a.position);
+    point.separation = separation;
+    point.normalImpulse = 0.0f;
+}
+
+bool collideSpheres(const RigidBody& a, const RigidBody& b, float margin, ContactManifold& manifold) {
+    glm::vec3 offset = b.position - a.position;
+    float radii = a.shape.radius + b.shape.radius;
+    float distanceSquared = glm::dot(offset, offset);
+    if (distanceSquared > (radii + margin) * (radii + margin)) {
+        return false;
+    }
+    float distance = std::sqrt(distanceSquared);
+    manifold.normal = distance > 1e-6f ? offset / distance : glm::vec3(0.0f, 1.0f, 0.0f);
+    glm::vec3 surfaceA = a.position + manifold.normal * a.shape.radius;
+    glm::vec3 surfaceB = b.position - manifold.normal * b.shape.radius;
+    addPoint(manifold, a, (surfaceA + surfaceB) * 0.5f, distance - radii);
+    return true;
+}
+
+// normal points from the box towards the sphere
+bool collideBoxSphere(const RigidBody& box, const RigidBody& sphere, float margin, glm::vec3& normal,
+                      glm::vec3& position, float& separation) {
+    glm::vec3 local = glm::conjugate(box.orientation) * (sphere.position - box.position);
+    glm::vec3 halfExtents = box.shape.halfExtents;
+    glm::vec3 closest = glm::clamp(local, -halfExtents, halfExtents);
+    glm::vec3 offset = local - closest;
+    float radius = sphere.shape.radius;
+    float distanceSquared = glm::dot(offset, offset);
+
+    glm::vec3 localNormal(0.0f);
+    float distance;
+    if (distanceSquared > 1e-12f) {
+        if (distanceSquared > (radius + margin) * (radius + margin)) {
+            return false;
+        }
+        distance = std::sqrt(distanceSquared);
+        localNormal = offset / distance;
+    } else {
+        // Center inside the box: out through the nearest face
+        glm::vec3 depth = halfExtents - glm::abs(local);
+        int axis = depth.x < depth.y ? (depth.x < depth.z ? 0 : 2) : (depth.y < depth.z ? 1 : 2);
+        localNormal[axis] = local[axis] < 0.0f ? -1.0f : 1.0f;
+        closest[axis] = localNormal[axis] * halfExtents[axis];
+        distance = -depth[axis];
+    }
+
+    normal = box.orientation * localNormal;
+    glm::vec3 surfaceBox = box.position + box.orientation * closest;
+    glm::vec3 surfaceSphere = sphere.position - normal * radius;
+    position = (surfaceBox + surfaceSphere) * 0.5f;
+    separation = distance - radius;
+    return true;
+}
+
+// Sutherland-Hodgman against one plane, keeping the side where dot(normal, p) <= offset
+uint32_t clipPolygon(const glm::vec3* input, uint32_t count, const glm::vec3& normal, float offset,
+                     glm::vec3* output) {
+    uint32_t outputCount = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+        const glm::vec3& p = input[i];
+        const glm::vec3& q = input[(i + 1) % count];
+        float distanceP = glm::dot(normal, p) - offset;
+        float distanceQ = glm::dot(normal, q) - offset;
+        if (distanceP <= 0.0f) {
+            output[outputCount++] = p;
+        }
+        if ((distanceP <= 0.0f) != (distanceQ <= 0.0f)) {
+            output[outputCount++] = p + (q - p) * (distanceP / (distanceP - distanceQ));
+        }
+    }
+    return outputCount;
+}
+
+// Keeps the deepest point and the three that span the largest area with it
+uint32_t reducePoints(glm::vec3* positions, float* separations, uint32_t count, const glm::vec3& normal) {
+    if (count <= MAX_CONTACT_POINTS) {
+        return count;
+    }
+    uint32_t deepest = 0;
+    for (uint32_t i = 1; i < count; ++i) {
+        deepest = separations[i] < separations[deepest] ? i : deepest;
+    }
+    uint32_t farthest = deepest;
+    float farthestDistance = -1.0f;
+    for (uint32_t i = 0; i < count; ++i) {
+        glm::vec3 offset = positions[i] - positions[deepest];
+        float distance = glm::dot(offset, offset);
+        if (distance > farthestDistance) {
+            farthestDistance = distance;
+            farthest = i;
+        }
+    }
+    uint32_t positive = deepest;
+    uint32_t negative = deepest;
+    float positiveArea = 0.0f;
+    float negativeArea = 0.0f;
+    glm::vec3 edge = positions[farthest] - positions[deepest];
+    for (uint32_t i = 0; i < count; ++i) {
+        float area = glm::dot(glm::cross(edge, positions[i] - positions[deepest]), normal);
+        if (area > positiveArea) {
+            positiveArea = area;
+            positive = i;
+        }
+        if (area < negativeArea) {
+            negativeArea = area;
+            negative = i;
+        }
+    }
+
+    uint32_t keep[MAX_CONTACT_POINTS] = {deepest, farthest, positive, negative};
+    glm::vec3 keptPositions[MAX_CONTACT_POINTS];
+    float keptSeparations[MAX_CONTACT_POINTS];
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < MAX_CONTACT_POINTS; ++i) {
+        bool duplicate = false;
+        for (uint32_t j = 0; j < i; ++j) {
+            duplicate = duplicate || keep[j] == keep[i];
+        }
+        if (!duplicate) {
+            keptPositions[kept] = positions[keep[i]];
+            keptSeparations[kept] = separations[keep[i]];
+            ++kept;
+        }
+    }
+    for (uint32_t i = 0; i < kept; ++i) {
+        positions[i] = keptPositions[i];
+        separations[i] = keptSeparations[i];
+    }
+    return kept;
+}
+
+void collideFaces(const OrientedBox& reference, const OrientedBox& incident, int referenceAxis, bool flipped,
+                  float margin, const RigidBody& bodyA, ContactManifold& manifold) {
+    glm::vec3 toIncident = incident.center - reference.center;
+    glm::vec3 faceNormal = reference.axes[referenceAxis];
+    faceNormal = glm::dot(toIncident, faceNormal) < 0.0f ? -faceNormal : faceNormal;
+
+    // The incident face is the one facing most against the reference face
+    int incidentAxis = 0;
+    float best = -1.0f;
+    for (int axis = 0; axis < 3; ++axis) {
+        float alignment = std::fabs(glm::dot(incident.axes[axis], faceNormal));
+        if (alignment > best) {
+            best = alignment;
+            incidentAxis = axis;
+        }
+    }
+    float incidentSign = glm::dot(incident.axes[incidentAxis], faceNormal) > 0.0f ? -1.0f : 1.0f;
+    glm::vec3 incidentCenter =
+        incident.center + incident.axes[incidentAxis] * (incidentSign * incident.halfExtents[incidentAxis]);
+    int incident1 = (incidentAxis + 1) % 3;
+    int incident2 = (incidentAxis + 2) % 3;
+    glm::vec3 u = incident.axes[incident1] * incident.halfExtents[incident1];
+    glm::vec3 v = incident.axes[incident2] * incident.halfExtents[incident2];
+
+    glm::vec3 polygon[MAX_CLIP_POINTS] = {incidentCenter + u + v, incidentCenter - u + v, incidentCenter - u - v,
+                                          incidentCenter + u - v};
+    glm::vec3 clipped[MAX_CLIP_POINTS];
+    uint32_t count = 4;
+
+    // Clip to the four side planes of the reference face
+    for (int side = 1; side <= 2 && count > 0; ++side) {
+        int axis = (referenceAxis + side) % 3;
+        float extent = reference.halfExtents[axis];
+        float center = glm::dot(reference.axes[axis], reference.center);
+        count = clipPolygon(polygon, count, reference.axes[axis], center + extent, clipped);
+        count = count > 0 ? clipPolygon(clipped, count, -reference.axes[axis], -center + extent, polygon) : 0;
+    }
+
+    glm::vec3 faceCenter = reference.center + faceNormal * reference.halfExtents[referenceAxis];
+    glm::vec3 positions[MAX_CLIP_POINTS];
+    float separations[MAX_CLIP_POINTS];
+    uint32_t pointCount = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+        float separation = glm::dot(polygon[i] - faceCenter, faceNormal);
+        if (separation <= margin) {
+            // Halfway between the incident point and the reference face
+            positions[pointCount] = polygon[i] - faceNormal * (separation * 0.5f);
+            separations[pointCount] = separation;
+            ++pointCount;
+        }
+    }
+    pointCount = reducePoints(positions, separations, pointCount, faceNormal);
+
+    manifold.normal = flipped ? -faceNormal : faceNormal;
+    for (uint32_t i = 0; i < pointCount; ++i) {
+        addPoint(manifold, bodyA, positions[i], separations[i]);
+    }
+}
+
+bool collideBoxes(const RigidBody& bodyA, const RigidBody& bodyB, float margin, ContactManifold& manifold) {
+    OrientedBox a = makeBox(bodyA);
+    OrientedBox b = makeBox(bodyB);
+    glm::vec3 offset = b.center - a.center;
+
+    // Separating axis test: three face normals each, then the nine edge pairs
+    float faceSeparationA = -FLT_MAX;
+    float faceSeparationB = -FLT_MAX;
+    int faceA = 0;
+    int faceB = 0;
+    for (int i = 0; i < 3; ++i) {
+        float separation = separationAlong(a, b, offset, a.axes[i]);
+        if (separation > margin) {
+            return false;
+        }
+        if (separation > faceSeparationA) {
+            faceSeparationA = separation;
+            faceA = i;
+        }
+    }
+    for (int i = 0; i < 3; ++i) {
+        float separation = separationAlong(a, b, offset, b.axes[i]);
+        if (separation > margin) {
+            return false;
+        }
+        if (separation > faceSeparationB) {
+            faceSeparationB = separation;
+            faceB = i;
+        }
+    }
+
+    float edgeSeparation = -FLT_MAX;
+    int edgeA = 0;
+    int edgeB = 0;
+    glm::vec3 edgeAxis(0.0f);
+    for (int i = 0; i < 3; ++i) {
+        for (int j = 0; j < 3; ++j) {
+            glm::vec3 axis = glm::cross(a.axes[i], b.axes[j]);
+            float length = glm::length(axis);
+            // Parallel edges; the face axes already cover that direction
+            if (length < 1e-5f) {
+                continue;
+            }
+            axis /= length;
+            float separation = separationAlong(a, b, offset, axis);
+            if (separation > margin) {
+                return false;
+            }
+            if (separation > edgeSeparation) {
+                edgeSeparation = separation;
+                edgeA = i;
+                edgeB = j;
+                edgeAxis = axis;
+            }
+        }
+    }
+
+    bool useFaceB = faceSeparationB > AXIS_RELATIVE_TOLERANCE * faceSeparationA + AXIS_ABSOLUTE_TOLERANCE;
+    float faceSeparation = useFaceB ? faceSeparationB : faceSeparationA;
+    if (edgeSeparation <= AXIS_RELATIVE_TOLERANCE * faceSeparation + AXIS_ABSOLUTE_TOLERANCE) {
+        if (useFaceB) {
+            collideFaces(b, a, faceB, true, margin, bodyA, manifold);
+        } else {
+            collideFaces(a, b, faceA, false, margin, bodyA, manifold);
+        }
+        return manifold.pointCount > 0;
+    }
+
+    // Edge against edge: one point, between the closest points of the two supporting edges
+    glm::vec3 normal = glm::dot(edgeAxis, offset) < 0.0f ? -edgeAxis : edgeAxis;
+    glm::vec3 pointA = a.center;
+    glm::vec3 pointB = b.center;
+    for (int k = 0; k < 3; ++k) {
+        if (k != edgeA) {
+            pointA += a.axes[k] * (glm::dot(a.axes[k], normal) > 0.0f ? a.halfExtents[k] : -a.halfExtents[k]);
+        }
+        if (k != edgeB) {
+            pointB += b.axes[k] * (glm::dot(b.axes[k], normal) > 0.0f ? -b.halfExtents[k] : b.halfExtents[k]);
+        }
+    }
+    glm::vec3 directionA = a.axes[edgeA];
+    glm::vec3 directionB = b.axes[edgeB];
+    glm::vec3 between = pointA - pointB;
+    float cosine = glm::dot(directionA, directionB);
+    float projectionA = glm::dot(directionA, between);
+    float projectionB = glm::dot(directionB, between);
+    float s = (cosine * projectionB - projectionA) / (1.0f - cosine * cosine);
+    float t = projectionB + s * cosine;
+    s = glm::clamp(s, -a.halfExtents[edgeA], a.halfExtents[edgeA]);
+    t = glm::clamp(t, -b.halfExtents[edgeB], b.halfExtents[edgeB]);
+
+    manifold.normal = normal;
+    addPoint(manifold, bodyA, (pointA + directionA * s + pointB + directionB * t) * 0.5f, edgeSeparation);
+    return true;
+}
+
+} // namespace
+
+bool collide(const RigidBody& a, const RigidBody& b, float margin, ContactManifold& manifold) {
+    manifold.pointCount = 0;
+    manifold.tangentImpulse[0] = 0.0f;
+    manifold.tangentImpulse[1] = 0.0f;
+    manifold.twistImpulse = 0.0f;
+    bool boxA = a.shape.type == ShapeType::Box;
+    bool boxB = b.shape.type == ShapeType::Box;
+    if (boxA && boxB) {
+        return collideBoxes(a, b, margin, manifold);
+    }
+    if (!boxA && !boxB) {
+        return collideSpheres(a, b, margin, manifold);
+    }
+
+    glm::vec3 normal;
+    glm::vec3 position;
+    float separation;
+    if (!collideBoxSphere(boxA ? a : b, boxA ? b : a, margin, normal, position, separation)) {
+        return false;
+    }
+    manifold.normal = boxA ? normal : -normal;
+    addPoint(manifold, a, position, separation);
+    return true;
+}
+
+void matchContacts(const ContactManifold& previous, ContactManifold& current) {
+    bool matched = false;
+    for (uint32_t i = 0; i < current.pointCount; ++i) {
+        ContactPoint& point = current.points[i];
+        for (uint32_t j = 0; j < previous.pointCount; ++j) {
+            const ContactPoint& old = previous.points[j];
+            glm::vec3 offset = point.localAnchorA - old.localAnchorA;
+            if (glm::dot(offset, offset) < MATCH_DISTANCE * MATCH_DISTANCE) {
+                point.normalImpulse = old.normalImpulse;
+                matched = true;
+                break;
+            }
+        }
+    }
+    if (matched) {
+        current.tangentImpulse[0] = previous.tangentImpulse[0];
+        current.tangentImpulse[1] = previous.tangentImpulse[1];
+        current.twistImpulse = previous.twistImpulse;
+    }
+}
+
+} // namespace plaster
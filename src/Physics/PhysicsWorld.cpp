@@ -0,0 +1,589 @@
+#include "Physics/PhysicsWorld.h"
+#include "Core/JobSystem.h"
+#include "Core/FrameArena.h"
+#include "Core/Metrics.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+
+namespace plaster {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const uint32_t NO_ISLAND = 0xffffffffu;
+
+// Contacts are generated this far apart, so the solver can stop bodies
+// right at the surface instead of after they have sunk in
+const float CONTACT_MARGIN = 0.02f;
+const float PENETRATION_SLOP = 0.005f;
+const float BAUMGARTE = 0.2f;
+const float MAX_CORRECTION_VELOCITY = 4.0f;
+const float RESTITUTION_THRESHOLD = 1.0f;
+// Friction carried over in full keeps a tall stack's slow sway going, so
+// some of it is let go every step. Normal impulses are carried in full.
+const float FRICTION_WARM_START = 0.85f;
+const float LINEAR_DAMPING = 0.01f;
+const float ANGULAR_DAMPING = 0.05f;
+const float LINEAR_SLEEP_VELOCITY = 0.05f;
+const float ANGULAR_SLEEP_VELOCITY = 0.05f;
+const float TIME_TO_SLEEP = 0.5f;
+
+// An island's bodies, and copies of the static and kinematic ones its contacts touch
+struct SolverBody {
+    glm::vec3 linearVelocity;
+    glm::vec3 angularVelocity;
+    glm::mat3 inverseInertia;
+    float inverseMass;
+};
+
+// One direction a contact constrains, a normal, a friction direction or the
+// twist about the normal, with everything that doesn't change between iterations
+struct ConstraintRow {
+    glm::vec3 direction;
+    glm::vec3 angularA;         // offset from each body's center, crossed with direction
+    glm::vec3 angularB;
+    glm::vec3 impulseAngularA;  // change in each body's angular velocity per unit of impulse
+    glm::vec3 impulseAngularB;
+    float mass;                 // effective mass along direction
+    float impulse;              // accumulated over the step
+};
+
+struct ConstraintPoint {
+    ConstraintRow normal;
+    float velocityBias;
+};
+
+// Friction is applied once per manifold, at the middle of its points, and
+// limited by the sum of their normal impulses. Per point friction rows on a
+// box's bottom face tilt it, and tall stacks slowly walk over.
+struct ContactConstraint {
+    uint32_t indexA;            // into the island's solver bodies
+    uint32_t indexB;
+    float friction;
+    float twistRadius;          // mean distance of the points from their middle
+    uint32_t pointCount;
+    ConstraintPoint points[MAX_CONTACT_POINTS];
+    ConstraintRow tangents[2];
+    ConstraintRow twist;
+    ContactManifold* manifold;
+};
+
+void computeTangents(const glm::vec3& normal, glm::vec3& tangent1, glm::vec3& tangent2) {
+    tangent1 = std::fabs(normal.x) > 0.57735f ? glm::vec3(normal.y, -normal.x, 0.0f)
+                                              : glm::vec3(0.0f, normal.z, -normal.y);
+    tangent1 = glm::normalize(tangent1);
+    tangent2 = glm::cross(normal, tangent1);
+}
+
+ConstraintRow makeRow(const SolverBody& a, const SolverBody& b, const glm::vec3& offsetA, const glm::vec3& offsetB,
+                      const glm::vec3& direction, float impulse) {
+    ConstraintRow row;
+    row.direction = direction;
+    row.angularA = glm::cross(offsetA, direction);
+    row.angularB = glm::cross(offsetB, direction);
+    row.impulseAngularA = a.inverseInertia * row.angularA;
+    row.impulseAngularB = b.inverseInertia * row.angularB;
+    float inverseMass = a.inverseMass + b.inverseMass + glm::dot(row.angularA, row.impulseAngularA) +
+                        glm::dot(row.angularB, row.impulseAngularB);
+    row.mass = inverseMass > 0.0f ? 1.0f / inverseMass : 0.0f;
+    row.impulse = impulse;
+    return row;
+}
+
+// Relative spin about axis; no linear part
+ConstraintRow makeAngularRow(const SolverBody& a, const SolverBody& b, const glm::vec3& axis, float impulse) {
+    ConstraintRow row;
+    row.direction = glm::vec3(0.0f);
+    row.angularA = axis;
+    row.angularB = axis;
+    row.impulseAngularA = a.inverseInertia * axis;
+    row.impulseAngularB = b.inverseInertia * axis;
+    float inverseMass = glm::dot(axis, row.impulseAngularA) + glm::dot(axis, row.impulseAngularB);
+    row.mass = inverseMass > 0.0f ? 1.0f / inverseMass : 0.0f;
+    row.impulse = impulse;
+    return row;
+}
+
+// Speed of B relative to A along the row at the contact point
+float rowSpeed(const SolverBody& a, const SolverBody& b, const ConstraintRow& row) {
+    return glm::dot(row.direction, b.linearVelocity - a.linearVelocity) + glm::dot(row.angularB, b.angularVelocity) -
+           glm::dot(row.angularA, a.angularVelocity);
+}
+
+void applyRowImpulse(SolverBody& a, SolverBody& b, const ConstraintRow& row, float impulse) {
+    a.linearVelocity -= row.direction * (impulse * a.inverseMass);
+    a.angularVelocity -= row.impulseAngularA * impulse;
+    b.linearVelocity += row.direction * (impulse * b.inverseMass);
+    b.angularVelocity += row.impulseAngularB * impulse;
+}
+
+void integratePosition(RigidBody& body, float timeStep) {
+    body.position += body.linearVelocity * timeStep;
+    glm::vec3 w = body.angularVelocity;
+    glm::quat spin(0.0f, w.x, w.y, w.z);
+    body.orientation = glm::normalize(body.orientation + spin * body.orientation * (0.5f * timeStep));
+}
+
+} // namespace
+
+PhysicsWorld::PhysicsWorld(JobSystem* jobSystem)
+    : m_jobSystem(jobSystem), m_broadphase(jobSystem), m_bodyCount(0), m_gravity(0.0f, -9.81f, 0.0f) {}
+
+uint32_t PhysicsWorld::createBody(const BodyDesc& desc) {
+    uint32_t id;
+    if (!m_freeBodies.empty()) {
+        id = m_freeBodies.back();
+        m_freeBodies.pop_back();
+    } else {
+        id = static_cast<uint32_t>(m_bodies.size());
+        m_bodies.emplace_back();
+    }
+
+    RigidBody& body = m_bodies[id];
+    body.position = desc.position;
+    body.orientation = glm::normalize(desc.orientation);
+    body.linearVelocity = desc.type == BodyType::Static ? glm::vec3(0.0f) : desc.linearVelocity;
+    body.angularVelocity = desc.type == BodyType::Static ? glm::vec3(0.0f) : desc.angularVelocity;
+    body.shape = desc.shape;
+    body.type = desc.type;
+    body.friction = desc.friction;
+    body.restitution = desc.restitution;
+    body.sleepTime = 0.0f;
+    body.awake = true;
+    body.alive = true;
+    body.userData = desc.userData;
+
+    body.inverseMass = 0.0f;
+    body.inverseInertiaLocal = glm::vec3(0.0f);
+    if (desc.type == BodyType::Dynamic && desc.mass > 0.0f) {
+        body.inverseMass = 1.0f / desc.mass;
+        glm::vec3 inertia;
+        if (desc.shape.type == ShapeType::Sphere) {
+            inertia = glm::vec3(0.4f * desc.mass * desc.shape.radius * desc.shape.radius);
+        } else {
+            glm::vec3 squared = desc.shape.halfExtents * desc.shape.halfExtents;
+            inertia = glm::vec3(squared.y + squared.z, squared.x + squared.z, squared.x + squared.y) *
+                      (desc.mass / 3.0f);
+        }
+        body.inverseInertiaLocal = glm::vec3(1.0f) / inertia;
+    }
+    body.updateInertia();
+
+    m_broadphase.add(id, body.computeBounds(), desc.type == BodyType::Static);
+    ++m_bodyCount;
+    return id;
+}
+
+void PhysicsWorld::destroyBody(uint32_t body) {
+    m_broadphase.remove(body);
+    m_bodies[body].alive = false;
+    m_freeBodies.push_back(body);
+    --m_bodyCount;
+
+    // Whatever rested on it has to fall, and the id may come back as a different body
+    auto touches = [body](const ContactManifold& manifold) {
+        return manifold.bodyA == body || manifold.bodyB == body;
+    };
+    for (const ContactManifold& manifold : m_manifolds) {
+        if (touches(manifold)) {
+            wake(m_bodies[manifold.bodyA == body ? manifold.bodyB : manifold.bodyA]);
+        }
+    }
+    m_manifolds.erase(std::remove_if(m_manifolds.begin(), m_manifolds.end(), touches), m_manifolds.end());
+}
+
+glm::mat4 PhysicsWorld::getTransform(uint32_t body) const {
+    const RigidBody& rigidBody = m_bodies[body];
+    return glm::translate(glm::mat4(1.0f), rigidBody.position) * glm::mat4_cast(rigidBody.orientation);
+}
+
+void PhysicsWorld::setTransform(uint32_t body, const glm::vec3& position, const glm::quat& orientation) {
+    RigidBody& rigidBody = m_bodies[body];
+    rigidBody.position = position;
+    rigidBody.orientation = glm::normalize(orientation);
+    rigidBody.updateInertia();
+    m_broadphase.setBounds(body, rigidBody.computeBounds());
+    wake(rigidBody);
+}
+
+void PhysicsWorld::setVelocity(uint32_t body, const glm::vec3& linear, const glm::vec3& angular) {
+    RigidBody& rigidBody = m_bodies[body];
+    if (rigidBody.type == BodyType::Static) {
+        return;
+    }
+    rigidBody.linearVelocity = linear;
+    rigidBody.angularVelocity = angular;
+    wake(rigidBody);
+}
+
+void PhysicsWorld::applyImpulse(uint32_t body, const glm::vec3& impulse, const glm::vec3& point) {
+    RigidBody& rigidBody = m_bodies[body];
+    rigidBody.linearVelocity += impulse * rigidBody.inverseMass;
+    rigidBody.angularVelocity += rigidBody.inverseInertiaWorld * glm::cross(point - rigidBody.position, impulse);
+    wake(rigidBody);
+}
+
+void PhysicsWorld::step(float timeStep) {
+    static Histogram& stepTime = Metrics::histogram("physics.step_us");
+    static Gauge& pairGauge = Metrics::gauge("physics.pairs");
+    static Gauge& contactGauge = Metrics::gauge("physics.contacts");
+    static Gauge& islandGauge = Metrics::gauge("physics.islands");
+    static Gauge& awakeGauge = Metrics::gauge("physics.awake_bodies");
+    ScopedTimer timer(stepTime);
+
+    auto start = Clock::now();
+    m_broadphase.findPairs(m_pairs);
+    auto broadphaseEnd = Clock::now();
+    findContacts();
+    auto narrowphaseEnd = Clock::now();
+
+    buildIslands();
+    m_jobSystem->parallelFor(static_cast<uint32_t>(m_islands.size()), ISLANDS_PER_JOB,
+                             [this, timeStep](uint32_t begin, uint32_t end) {
+                                 for (uint32_t i = begin; i < end; ++i) {
+                                     solveIsland(m_islands[i], timeStep);
+                                 }
+                             });
+    for (uint32_t id = 0; id < m_bodies.size(); ++id) {
+        RigidBody& body = m_bodies[id];
+        if (body.alive && body.type == BodyType::Kinematic) {
+            integratePosition(body, timeStep);
+            body.updateInertia();
+            m_broadphase.setBounds(id, body.computeBounds());
+        }
+    }
+    auto end = Clock::now();
+
+    m_stats.broadphaseMs = std::chrono::duration<double, std::milli>(broadphaseEnd - start).count();
+    m_stats.narrowphaseMs = std::chrono::duration<double, std::milli>(narrowphaseEnd - broadphaseEnd).count();
+    m_stats.solverMs = std::chrono::duration<double, std::milli>(end - narrowphaseEnd).count();
+    m_stats.pairCount = static_cast<uint32_t>(m_pairs.size());
+    m_stats.contactCount = static_cast<uint32_t>(m_manifolds.size());
+    m_stats.islandCount = static_cast<uint32_t>(m_islands.size());
+    m_stats.awakeBodyCount = static_cast<uint32_t>(m_islandBodies.size());
+    pairGauge.set(m_stats.pairCount);
+    contactGauge.set(m_stats.contactCount);
+    islandGauge.set(m_stats.islandCount);
+    awakeGauge.set(m_stats.awakeBodyCount);
+}
+
+void PhysicsWorld::findContacts() {
+    // Last step's manifolds, with the impulses the solver left in them
+    std::swap(m_previousManifolds, m_manifolds);
+    m_pairManifolds.resize(m_pairs.size());
+    // Each pair writes only its own manifold; bodies and last step's manifolds are read only
+    m_jobSystem->parallelFor(static_cast<uint32_t>(m_pairs.size()), PAIRS_PER_JOB, [this](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; ++i) {
+            const BodyPair& pair = m_pairs[i];
+            ContactManifold& manifold = m_pairManifolds[i];
+            manifold.bodyA = pair.bodyA;
+            manifold.bodyB = pair.bodyB;
+            manifold.pointCount = 0;
+
+            const RigidBody& a = m_bodies[pair.bodyA];
+            const RigidBody& b = m_bodies[pair.bodyB];
+            // Nothing to do between sleeping and static bodies, or for two that nothing pushes
+            if ((!a.isActive() && !b.isActive()) || (!a.isDynamic() && !b.isDynamic())) {
+                continue;
+            }
+            if (!collide(a, b, CONTACT_MARGIN, manifold)) {
+                continue;
+            }
+            auto previous = std::lower_bound(
+                m_previousManifolds.begin(), m_previousManifolds.end(), pair.getKey(),
+                [](const ContactManifold& candidate, uint64_t key) { return candidate.getKey() < key; });
+            if (previous != m_previousManifolds.end() && previous->getKey() == pair.getKey()) {
+                matchContacts(*previous, manifold);
+            }
+        }
+    });
+
+    // Pairs come sorted by key, so the manifolds stay sorted for the next step's lookups
+    m_manifolds.clear();
+    for (const ContactManifold& manifold : m_pairManifolds) {
+        if (manifold.pointCount > 0) {
+            m_manifolds.push_back(manifold);
+        }
+    }
+}
+
+uint32_t PhysicsWorld::findIslandRoot(uint32_t body) {
+    while (m_islandParents[body] != body) {
+        m_islandParents[body] = m_islandParents[m_islandParents[body]];
+        body = m_islandParents[body];
+    }
+    return body;
+}
+
+void PhysicsWorld::wake(RigidBody& body) {
+    // Only a sleeping body restarts its timer; awake ones touch every step
+    if (body.type == BodyType::Dynamic && !body.awake) {
+        body.awake = true;
+        body.sleepTime = 0.0f;
+    }
+}
+
+void PhysicsWorld::buildIslands() {
+    uint32_t bodyCount = static_cast<uint32_t>(m_bodies.size());
+    m_islandParents.resize(bodyCount);
+    m_islandIndices.assign(bodyCount, NO_ISLAND);
+    m_solverIndices.resize(bodyCount);
+    for (uint32_t id = 0; id < bodyCount; ++id) {
+        m_islandParents[id] = id;
+    }
+
+    // Contacts join dynamic bodies; static and kinematic ones would merge
+    // everything resting on the ground into one island, so they don't
+    for (const ContactManifold& manifold : m_manifolds) {
+        RigidBody& a = m_bodies[manifold.bodyA];
+        RigidBody& b = m_bodies[manifold.bodyB];
+        // Something moving touched a sleeping body
+        if (a.isActive()) {
+            wake(b);
+        }
+        if (b.isActive()) {
+            wake(a);
+        }
+        if (a.isDynamic() && b.isDynamic()) {
+            m_islandParents[findIslandRoot(manifold.bodyA)] = findIslandRoot(manifold.bodyB);
+        }
+    }
+
+    m_islands.clear();
+    for (uint32_t id = 0; id < bodyCount; ++id) {
+        const RigidBody& body = m_bodies[id];
+        if (!body.alive || !body.isDynamic() || !body.awake) {
+            continue;
+        }
+        uint32_t root = findIslandRoot(id);
+        if (m_islandIndices[root] == NO_ISLAND) {
+            m_islandIndices[root] = static_cast<uint32_t>(m_islands.size());
+            m_islands.push_back({0, 0, 0, 0});
+        }
+        m_islandIndices[id] = m_islandIndices[root];
+        ++m_islands[m_islandIndices[id]].bodyCount;
+    }
+    for (const ContactManifold& manifold : m_manifolds) {
+        uint32_t body = m_bodies[manifold.bodyA].isDynamic() ? manifold.bodyA : manifold.bodyB;
+        ++m_islands[m_islandIndices[body]].manifoldCount;
+    }
+
+    // Counting sort of bodies and manifolds into contiguous runs per island
+    uint32_t bodyOffset = 0;
+    uint32_t manifoldOffset = 0;
+    for (Island& island : m_islands) {
+        island.bodyBegin = bodyOffset;
+        island.manifoldBegin = manifoldOffset;
+        bodyOffset += island.bodyCount;
+        manifoldOffset += island.manifoldCount;
+        island.bodyCount = 0;
+        island.manifoldCount = 0;
+    }
+    m_islandBodies.resize(bodyOffset);
+    m_islandManifolds.resize(manifoldOffset);
+    for (uint32_t id = 0; id < bodyCount; ++id) {
+        if (m_islandIndices[id] != NO_ISLAND) {
+            Island& island = m_islands[m_islandIndices[id]];
+            m_islandBodies[island.bodyBegin + island.bodyCount++] = id;
+        }
+    }
+    for (uint32_t i = 0; i < m_manifolds.size(); ++i) {
+        const ContactManifold& manifold = m_manifolds[i];
+        uint32_t body = m_bodies[manifold.bodyA].isDynamic() ? manifold.bodyA : manifold.bodyB;
+        Island& island = m_islands[m_islandIndices[body]];
+        m_islandManifolds[island.manifoldBegin + island.manifoldCount++] = i;
+    }
+
+    // Big islands first, so one doesn't start last and hold up the whole step
+    std::sort(m_islands.begin(), m_islands.end(),
+              [](const Island& a, const Island& b) { return a.manifoldCount > b.manifoldCount; });
+    m_stats.largestIsland = 0;
+    for (const Island& island : m_islands) {
+        m_stats.largestIsland = std::max(m_stats.largestIsland, island.bodyCount);
+    }
+}
+
+void PhysicsWorld::solveIsland(const Island& island, float timeStep) {
+    // Scratch from this worker's frame arena
+    FrameVector<SolverBody> bodies;
+    FrameVector<ContactConstraint> constraints;
+    bodies.reserve(island.bodyCount + island.manifoldCount * 2);
+    constraints.reserve(island.manifoldCount);
+
+    float linearDamping = 1.0f / (1.0f + timeStep * LINEAR_DAMPING);
+    float angularDamping = 1.0f / (1.0f + timeStep * ANGULAR_DAMPING);
+    for (uint32_t i = 0; i < island.bodyCount; ++i) {
+        uint32_t id = m_islandBodies[island.bodyBegin + i];
+        const RigidBody& body = m_bodies[id];
+        m_solverIndices[id] = i;
+        SolverBody solverBody;
+        solverBody.linearVelocity = (body.linearVelocity + m_gravity * timeStep) * linearDamping;
+        solverBody.angularVelocity = body.angularVelocity * angularDamping;
+        solverBody.inverseInertia = body.inverseInertiaWorld;
+        solverBody.inverseMass = body.inverseMass;
+        bodies.push_back(solverBody);
+    }
+
+    // Static and kinematic bodies are shared between islands, so each
+    // contact gets its own copy to read instead of writing to the body
+    auto solverIndex = [this, &bodies](uint32_t id) {
+        const RigidBody& body = m_bodies[id];
+        if (body.isDynamic()) {
+            return m_solverIndices[id];
+        }
+        SolverBody solverBody;
+        solverBody.linearVelocity = body.linearVelocity;
+        solverBody.angularVelocity = body.angularVelocity;
+        solverBody.inverseInertia = glm::mat3(0.0f);
+        solverBody.inverseMass = 0.0f;
+        bodies.push_back(solverBody);
+        return static_cast<uint32_t>(bodies.size() - 1);
+    };
+
+    for (uint32_t i = 0; i < island.manifoldCount; ++i) {
+        ContactManifold& manifold = m_manifolds[m_islandManifolds[island.manifoldBegin + i]];
+        const RigidBody& a = m_bodies[manifold.bodyA];
+        const RigidBody& b = m_bodies[manifold.bodyB];
+
+        ContactConstraint constraint;
+        constraint.indexA = solverIndex(manifold.bodyA);
+        constraint.indexB = solverIndex(manifold.bodyB);
+        constraint.friction = std::sqrt(a.friction * b.friction);
+        constraint.pointCount = manifold.pointCount;
+        constraint.manifold = &manifold;
+        float restitution = std::max(a.restitution, b.restitution);
+        glm::vec3 tangents[2];
+        computeTangents(manifold.normal, tangents[0], tangents[1]);
+
+        const SolverBody& solverA = bodies[constraint.indexA];
+        const SolverBody& solverB = bodies[constraint.indexB];
+        glm::vec3 center(0.0f);
+        for (uint32_t j = 0; j < manifold.pointCount; ++j) {
+            center += manifold.points[j].position;
+        }
+        center /= static_cast<float>(manifold.pointCount);
+        constraint.twistRadius = 0.0f;
+        for (uint32_t j = 0; j < manifold.pointCount; ++j) {
+            constraint.twistRadius += glm::length(manifold.points[j].position - center);
+        }
+        constraint.twistRadius /= static_cast<float>(manifold.pointCount);
+        for (int k = 0; k < 2; ++k) {
+            constraint.tangents[k] = makeRow(solverA, solverB, center - a.position, center - b.position, tangents[k],
+                                             manifold.tangentImpulse[k] * FRICTION_WARM_START);
+        }
+        constraint.twist = makeAngularRow(solverA, solverB, manifold.normal,
+                                          manifold.twistImpulse * FRICTION_WARM_START);
+
+        for (uint32_t j = 0; j < manifold.pointCount; ++j) {
+            const ContactPoint& contact = manifold.points[j];
+            ConstraintPoint& point = constraint.points[j];
+            point.normal = makeRow(solverA, solverB, contact.position - a.position, contact.position - b.position,
+                                   manifold.normal, contact.normalImpulse);
+
+            // Apart: may close the gap this step and no more. Penetrating:
+            // pushed out over a few steps, leaving a little overlap so the
+            // contact persists.
+            if (contact.separation > 0.0f) {
+                point.velocityBias = -contact.separation / timeStep;
+            } else {
+                float correction = std::max(-contact.separation - PENETRATION_SLOP, 0.0f) * BAUMGARTE / timeStep;
+                point.velocityBias = std::min(correction, MAX_CORRECTION_VELOCITY);
+            }
+            float approach = rowSpeed(solverA, solverB, point.normal);
+            if (approach < -RESTITUTION_THRESHOLD) {
+                point.velocityBias = std::max(point.velocityBias, -restitution * approach);
+            }
+        }
+        constraints.push_back(constraint);
+    }
+
+    // Warm start with last step's impulses
+    for (ContactConstraint& constraint : constraints) {
+        SolverBody& a = bodies[constraint.indexA];
+        SolverBody& b = bodies[constraint.indexB];
+        for (uint32_t j = 0; j < constraint.pointCount; ++j) {
+            applyRowImpulse(a, b, constraint.points[j].normal, constraint.points[j].normal.impulse);
+        }
+        for (const ConstraintRow& row : constraint.tangents) {
+            applyRowImpulse(a, b, row, row.impulse);
+        }
+        applyRowImpulse(a, b, constraint.twist, constraint.twist.impulse);
+    }
+
+    for (uint32_t iteration = 0; iteration < VELOCITY_ITERATIONS; ++iteration) {
+        for (ContactConstraint& constraint : constraints) {
+            SolverBody& a = bodies[constraint.indexA];
+            SolverBody& b = bodies[constraint.indexB];
+            // Friction first; the normal impulse matters more, so it gets the last word
+            float normalImpulse = 0.0f;
+            for (uint32_t j = 0; j < constraint.pointCount; ++j) {
+                normalImpulse += constraint.points[j].normal.impulse;
+            }
+            float limit = constraint.friction * normalImpulse;
+            for (ConstraintRow& row : constraint.tangents) {
+                float impulse = row.impulse - rowSpeed(a, b, row) * row.mass;
+                impulse = std::min(std::max(impulse, -limit), limit);
+                applyRowImpulse(a, b, row, impulse - row.impulse);
+                row.impulse = impulse;
+            }
+            ConstraintRow& twist = constraint.twist;
+            float twistLimit = limit * constraint.twistRadius;
+            float twistImpulse = twist.impulse - rowSpeed(a, b, twist) * twist.mass;
+            twistImpulse = std::min(std::max(twistImpulse, -twistLimit), twistLimit);
+            applyRowImpulse(a, b, twist, twistImpulse - twist.impulse);
+            twist.impulse = twistImpulse;
+
+            for (uint32_t j = 0; j < constraint.pointCount; ++j) {
+                ConstraintPoint& point = constraint.points[j];
+                ConstraintRow& row = point.normal;
+                float impulse = std::max(row.impulse + (point.velocityBias - rowSpeed(a, b, row)) * row.mass, 0.0f);
+                applyRowImpulse(a, b, row, impulse - row.impulse);
+                row.impulse = impulse;
+            }
+        }
+    }
+
+    for (const ContactConstraint& constraint : constraints) {
+        ContactManifold& manifold = *constraint.manifold;
+        for (uint32_t j = 0; j < constraint.pointCount; ++j) {
+            manifold.points[j].normalImpulse = constraint.points[j].normal.impulse;
+        }
+        manifold.tangentImpulse[0] = constraint.tangents[0].impulse;
+        manifold.tangentImpulse[1] = constraint.tangents[1].impulse;
+        manifold.twistImpulse = constraint.twist.impulse;
+    }
+
+    float islandSleepTime = FLT_MAX;
+    for (uint32_t i = 0; i < island.bodyCount; ++i) {
+        uint32_t id = m_islandBodies[island.bodyBegin + i];
+        RigidBody& body = m_bodies[id];
+        body.linearVelocity = bodies[i].linearVelocity;
+        body.angularVelocity = bodies[i].angularVelocity;
+        integratePosition(body, timeStep);
+        body.updateInertia();
+        m_broadphase.setBounds(id, body.computeBounds());
+
+        bool resting = glm::dot(body.linearVelocity, body.linearVelocity) < LINEAR_SLEEP_VELOCITY * LINEAR_SLEEP_VELOCITY &&
+                       glm::dot(body.angularVelocity, body.angularVelocity) < ANGULAR_SLEEP_VELOCITY * ANGULAR_SLEEP_VELOCITY;
+        body.sleepTime = resting ? body.sleepTime + timeStep : 0.0f;
+        islandSleepTime = std::min(islandSleepTime, body.sleepTime);
+    }
+
+    // Islands sleep as a whole, or bodies would fall asleep on moving ones
+    if (islandSleepTime >= TIME_TO_SLEEP) {
+        for (uint32_t i = 0; i < island.bodyCount; ++i) {
+            RigidBody& body = m_bodies[m_islandBodies[island.bodyBegin + i]];
+            body.awake = false;
+            body.linearVelocity = glm::vec3(0.0f);
+            body.angularVelocity = glm::vec3(0.0f);
+        }
+    }
+}
+
+} // namespace plaster
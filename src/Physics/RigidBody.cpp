@@ -0,0 +1,39 @@
+#include "Physics/RigidBody.h"
+
+#include <cmath>
+
+namespace plaster {
+
+CollisionShape CollisionShape::sphere(float radius) {
+    CollisionShape shape;
+    shape.type = ShapeType::Sphere;
+    shape.radius = radius;
+    return shape;
+}
+
+CollisionShape CollisionShape::box(const glm::vec3& halfExtents) {
+    CollisionShape shape;
+    shape.type = ShapeType::Box;
+    shape.halfExtents = halfExtents;
+    return shape;
+}
+
+Aabb RigidBody::computeBounds() const {
+    if (shape.type == ShapeType::Sphere) {
+        return Aabb::fromCenter(position, glm::vec3(shape.radius));
+    }
+    // Each world axis takes the box's extents projected onto it
+    glm::mat3 rotation = glm::mat3_cast(orientation);
+    glm::vec3 extent = glm::abs(rotation[0]) * shape.halfExtents.x + glm::abs(rotation[1]) * shape.halfExtents.y +
+                       glm::abs(rotation[2]) * shape.halfExtents.z;
+    return Aabb::fromCenter(position, extent);
+}
+
+void RigidBody::updateInertia() {
+    glm::mat3 rotation = glm::mat3_cast(orientation);
+    glm::mat3 scaled(rotation[0] * inverseInertiaLocal.x, rotation[1] * inverseInertiaLocal.y,
+                     rotation[2] * inverseInertiaLocal.z);
+    inverseInertiaWorld = scaled * glm::transpose(rotation);
+}
+
+} // namespace plaster
@@ -0,0 +1,64 @@
+#include "Scene/Bounds.h"
+
+#include <algorithm>
+
+namespace plaster {
+
+Aabb Aabb::transformed(const glm::mat4& transform) const {
+    if (isEmpty()) {
+        return *this;
+    }
+    // Arvo: each output axis takes the smaller and larger of every column's contribution
+    glm::vec3 newMin(transform[3]);
+    glm::vec3 newMax = newMin;
+    for (int column = 0; column < 3; ++column) {
+        glm::vec3 axis(transform[column]);
+        glm::vec3 a = axis * min[column];
+        glm::vec3 b = axis * max[column];
+        newMin += glm::min(a, b);
+        newMax += glm::max(a, b);
+    }
+    return Aabb(newMin, newMax);
+}
+
+Frustum Frustum::fromViewProjection(const glm::mat4& viewProjection) {
+    // Gribb and Hartmann: each plane is the last row plus or minus another row
+    glm::mat4 rows = glm::transpose(viewProjection);
+    Frustum frustum;
+    frustum.planes[0] = rows[3] + rows[0];
+    frustum.planes[1] = rows[3] - rows[0];
+    frustum.planes[2] = rows[3] + rows[1];
+    frustum.planes[3] = rows[3] - rows[1];
+    frustum.planes[4] = rows[2];
+    frustum.planes[5] = rows[3] - rows[2];
+    for (glm::vec4& plane : frustum.planes) {
+        plane /= glm::length(glm::vec3(plane));
+    }
+    return frustum;
+}
+
+bool intersectRay(const Ray& ray, const glm::vec3& inverseDirection, const Aabb& box, float maxDistance,
+                  float& distance) {
+    glm::vec3 t1 = (box.min - ray.origin) * inverseDirection;
+    glm::vec3 t2 = (box.max - ray.origin) * inverseDirection;
+    glm::vec3 entries = glm::min(t1, t2);
+    glm::vec3 exits = glm::max(t1, t2);
+    float enter = std::max(std::max(entries.x, entries.y), std::max(entries.z, 0.0f));
+    float exit = std::min(std::min(exits.x, exits.y), std::min(exits.z, maxDistance));
+    distance = enter;
+    return enter <= exit;
+}
+
+Ray makePickRay(const glm::vec2& pixel, const glm::vec2& viewportSize, const glm::mat4& viewProjection) {
+    glm::vec2 ndc = pixel / viewportSize * 2.0f - glm::vec2(1.0f);
+    glm::mat4 inverse = glm::inverse(viewProjection);
+    glm::vec4 nearPoint = inverse * glm::vec4(ndc.x, ndc.y, 0.0f, 1.0f);
+    glm::vec4 farPoint = inverse * glm::vec4(ndc.x, ndc.y, 1.0f, 1.0f);
+
+    Ray ray;
+    ray.origin = glm::vec3(nearPoint) / nearPoint.w;
+    ray.direction = glm::normalize(glm::vec3(farPoint) / farPoint.w - ray.origin);
+    return ray;
+}
+
+} // namespace plaster
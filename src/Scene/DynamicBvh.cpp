@@ -0,0 +1,581 @@
+#include "Scene/DynamicBvh.h"
+#include "Core/JobSystem.h"
+#include "Core/Metrics.h"
+#include "Core/Simd.h"
+
+#include <algorithm>
+#include <cfloat>
+
+namespace plaster {
+
+namespace {
+
+// Traversal stack that only touches the heap for trees deeper than any
+// sensible one, so queries from many threads don't contend on the allocator
+class NodeStack {
+public:
+    explicit NodeStack(uint32_t root) : m_size(0) {
+        if (root != DynamicBvh::NULL_NODE) {
+            push(root);
+        }
+    }
+
+    bool empty() const { return m_size == 0; }
+
+    void push(uint32_t node) {
+        if (m_size < INLINE_SIZE) {
+            m_inline[m_size] = node;
+        } else {
+            m_spill.push_back(node);
+        }
+        ++m_size;
+    }
+
+    uint32_t pop() {
+        --m_size;
+        if (m_size < INLINE_SIZE) {
+            return m_inline[m_size];
+        }
+        uint32_t node = m_spill.back();
+        m_spill.pop_back();
+        return node;
+    }
+
+private:
+    static const uint32_t INLINE_SIZE = 64;
+    uint32_t m_inline[INLINE_SIZE];
+    std::vector<uint32_t> m_spill;
+    uint32_t m_size;
+};
+
+// Four rays in structure of arrays form, one lane each
+struct RayPacket {
+    alignas(16) float origin[3][4];
+    alignas(16) float inverse[3][4];
+    alignas(16) float closest[4];
+};
+
+// The slab test of Bounds.cpp against four rays at once. Returns a bit per
+// lane that enters the box within its closest hit and writes where each
+// lane enters.
+uint32_t slabTest(const RayPacket& packet, const Aabb& box, float* entries) {
+#ifdef PLASTER_SSE2
+    __m128 enter = _mm_setzero_ps();
+    __m128 exit = _mm_load_ps(packet.closest);
+    for (int axis = 0; axis < 3; ++axis) {
+        __m128 origin = _mm_load_ps(packet.origin[axis]);
+        __m128 inverse = _mm_load_ps(packet.inverse[axis]);
+        __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(box.min[axis]), origin), inverse);
+        __m128 t2 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(box.max[axis]), origin), inverse);
+        enter = _mm_max_ps(enter, _mm_min_ps(t1, t2));
+        exit = _mm_min_ps(exit, _mm_max_ps(t1, t2));
+    }
+    _mm_storeu_ps(entries, enter);
+    return static_cast<uint32_t>(_mm_movemask_ps(_mm_cmple_ps(enter, exit)));
+#else
+    uint32_t lanes = 0;
+    for (uint32_t lane = 0; lane < 4; ++lane) {
+        float enter = 0.0f;
+        float exit = packet.closest[lane];
+        for (int axis = 0; axis < 3; ++axis) {
+            float t1 = (box.min[axis] - packet.origin[axis][lane]) * packet.inverse[axis][lane];
+            float t2 = (box.max[axis] - packet.origin[axis][lane]) * packet.inverse[axis][lane];
+            enter = std::max(enter, std::min(t1, t2));
+            exit = std::min(exit, std::max(t1, t2));
+        }
+        entries[lane] = enter;
+        lanes |= enter <= exit ? 1u << lane : 0u;
+    }
+    return lanes;
+#endif
+}
+
+bool overlapsSphere(const Aabb& box, const glm::vec3& center, float radiusSquared) {
+    glm::vec3 offset = glm::clamp(center, box.min, box.max) - center;
+    return glm::dot(offset, offset) <= radiusSquared;
+}
+
+} // namespace
+
+DynamicBvh::DynamicBvh(float margin, float displacementScale)
+    : m_root(NULL_NODE), m_freeList(NULL_NODE), m_proxyCount(0), m_optimizeCursor(0), m_margin(margin),
+      m_displacementScale(displacementScale) {}
+
+uint32_t DynamicBvh::allocateNode() {
+    uint32_t index;
+    if (m_freeList != NULL_NODE) {
+        index = m_freeList;
+        m_freeList = m_nodes[index].parent;
+    } else {
+        index = static_cast<uint32_t>(m_nodes.size());
+        m_nodes.emplace_back();
+    }
+    Node& node = m_nodes[index];
+    node.bounds = Aabb();
+    node.tightBounds = Aabb();
+    node.parent = NULL_NODE;
+    node.child1 = NULL_NODE;
+    node.child2 = NULL_NODE;
+    node.userData = 0;
+    node.height = 0;
+    node.dirty = false;
+    return index;
+}
+
+void DynamicBvh::freeNode(uint32_t node) {
+    m_nodes[node].parent = m_freeList;
+    m_nodes[node].height = -1;
+    m_freeList = node;
+}
+
+Aabb DynamicBvh::fatten(const Aabb& bounds, const glm::vec3& displacement) const {
+    Aabb fat = bounds.expanded(m_margin);
+    glm::vec3 predicted = displacement * m_displacementScale;
+    for (int axis = 0; axis < 3; ++axis) {
+        if (predicted[axis] < 0.0f) {
+            fat.min[axis] += predicted[axis];
+        } else {
+            fat.max[axis] += predicted[axis];
+        }
+    }
+    return fat;
+}
+
+uint32_t DynamicBvh::createProxy(const Aabb& bounds, uint32_t userData) {
+    uint32_t proxy = allocateNode();
+    Node& node = m_nodes[proxy];
+    node.tightBounds = bounds;
+    node.bounds = fatten(bounds, glm::vec3(0.0f));
+    node.userData = userData;
+    insertLeaf(proxy);
+    ++m_proxyCount;
+    return proxy;
+}
+
+void DynamicBvh::destroyProxy(uint32_t proxy) {
+    removeLeaf(proxy);
+    freeNode(proxy);
+    --m_proxyCount;
+}
+
+bool DynamicBvh::moveProxy(uint32_t proxy, const Aabb& bounds, const glm::vec3& displacement) {
+    Node& node = m_nodes[proxy];
+    node.tightBounds = bounds;
+    if (node.bounds.contains(bounds)) {
+        return false;
+    }
+    removeLeaf(proxy);
+    m_nodes[proxy].bounds = fatten(bounds, displacement);
+    insertLeaf(proxy);
+
+    static Counter& reinserts = Metrics::counter("bvh.reinserts");
+    reinserts.add();
+    return true;
+}
+
+void DynamicBvh::moveProxies(const uint32_t* proxies, const Aabb* bounds, uint32_t count) {
+    m_dirtyNodes.clear();
+    for (uint32_t i = 0; i < count; ++i) {
+        Node& node = m_nodes[proxies[i]];
+        node.tightBounds = bounds[i];
+        if (node.bounds.contains(bounds[i])) {
+            continue;
+        }
+        node.bounds = fatten(bounds[i], glm::vec3(0.0f));
+        // Stops at the first ancestor another leaf already marked
+        for (uint32_t parent = node.parent; parent != NULL_NODE && !m_nodes[parent].dirty;
+             parent = m_nodes[parent].parent) {
+            m_nodes[parent].dirty = true;
+            m_dirtyNodes.push_back(parent);
+        }
+    }
+
+    // A node is higher than all of its descendants, so refitting in order of
+    // height sees every child before its parent
+    std::sort(m_dirtyNodes.begin(), m_dirtyNodes.end(),
+              [this](uint32_t a, uint32_t b) { return m_nodes[a].height < m_nodes[b].height; });
+    for (uint32_t node : m_dirtyNodes) {
+        updateNode(node);
+        m_nodes[node].dirty = false;
+    }
+
+    static Counter& refits = Metrics::counter("bvh.refit_nodes");
+    refits.add(m_dirtyNodes.size());
+}
+
+void DynamicBvh::optimize(uint32_t count) {
+    uint32_t nodeCount = static_cast<uint32_t>(m_nodes.size());
+    uint32_t reinserted = 0;
+    for (uint32_t visited = 0; visited < nodeCount && reinserted < count; ++visited) {
+        uint32_t node = m_optimizeCursor;
+        m_optimizeCursor = (m_optimizeCursor + 1) % nodeCount;
+        if (m_nodes[node].height == 0) {
+            removeLeaf(node);
+            insertLeaf(node);
+            ++reinserted;
+        }
+    }
+}
+
+void DynamicBvh::clear() {
+    m_nodes.clear();
+    m_dirtyNodes.clear();
+    m_root = NULL_NODE;
+    m_freeList = NULL_NODE;
+    m_proxyCount = 0;
+    m_optimizeCursor = 0;
+}
+
+void DynamicBvh::updateNode(uint32_t index) {
+    Node& node = m_nodes[index];
+    const Node& child1 = m_nodes[node.child1];
+    const Node& child2 = m_nodes[node.child2];
+    node.bounds = Aabb::merge(child1.bounds, child2.bounds);
+    node.height = 1 + std::max(child1.height, child2.height);
+}
+
+void DynamicBvh::insertLeaf(uint32_t leaf) {
+    if (m_root == NULL_NODE) {
+        m_root = leaf;
+        m_nodes[leaf].parent = NULL_NODE;
+        return;
+    }
+
+    // Descend towards the sibling that adds the least surface area, counting
+    // what every ancestor grows by on the way
+    Aabb leafBounds = m_nodes[leaf].bounds;
+    uint32_t index = m_root;
+    while (!m_nodes[index].isLeaf()) {
+        const Node& node = m_nodes[index];
+        float area = node.bounds.getSurfaceArea();
+        float combinedArea = Aabb::merge(node.bounds, leafBounds).getSurfaceArea();
+        float cost = 2.0f * combinedArea;                  // a new parent of this node and the leaf
+        float inheritance = 2.0f * (combinedArea - area);  // pushing the leaf further down
+
+        auto descendCost = [&](uint32_t child) {
+            const Aabb& bounds = m_nodes[child].bounds;
+            float merged = Aabb::merge(bounds, leafBounds).getSurfaceArea();
+            return m_nodes[child].isLeaf() ? merged + inheritance
+                                           : merged - bounds.getSurfaceArea() + inheritance;
+        };
+        float cost1 = descendCost(node.child1);
+        float cost2 = descendCost(node.child2);
+        if (cost < cost1 && cost < cost2) {
+            break;
+        }
+        index = cost1 < cost2 ? node.child1 : node.child2;
+    }
+
+    uint32_t sibling = index;
+    uint32_t oldParent = m_nodes[sibling].parent;
+    uint32_t newParent = allocateNode();
+    Node& parent = m_nodes[newParent];
+    parent.parent = oldParent;
+    parent.child1 = sibling;
+    parent.child2 = leaf;
+    parent.bounds = Aabb::merge(leafBounds, m_nodes[sibling].bounds);
+    parent.height = m_nodes[sibling].height + 1;
+
+    if (oldParent == NULL_NODE) {
+        m_root = newParent;
+    } else if (m_nodes[oldParent].child1 == sibling) {
+        m_nodes[oldParent].child1 = newParent;
+    } else {
+        m_nodes[oldParent].child2 = newParent;
+    }
+    m_nodes[sibling].parent = newParent;
+    m_nodes[leaf].parent = newParent;
+
+    refitAncestors(oldParent);
+}
+
+void DynamicBvh::removeLeaf(uint32_t leaf) {
+    if (leaf == m_root) {
+        m_root = NULL_NODE;
+        return;
+    }
+
+    uint32_t parent = m_nodes[leaf].parent;
+    uint32_t grandParent = m_nodes[parent].parent;
+    uint32_t sibling = m_nodes[parent].child1 == leaf ? m_nodes[parent].child2 : m_nodes[parent].child1;
+    freeNode(parent);
+
+    m_nodes[sibling].parent = grandParent;
+    if (grandParent == NULL_NODE) {
+        m_root = sibling;
+        return;
+    }
+    if (m_nodes[grandParent].child1 == parent) {
+        m_nodes[grandParent].child1 = sibling;
+    } else {
+        m_nodes[grandParent].child2 = sibling;
+    }
+    refitAncestors(grandParent);
+}
+
+void DynamicBvh::refitAncestors(uint32_t node) {
+    while (node != NULL_NODE) {
+        updateNode(node);
+        rotate(node);
+        node = m_nodes[node].parent;
+    }
+}
+
+// Swaps a child with one of its sibling's children when that shrinks the
+// sibling the most (Kopta et al., "Fast, Effective BVH Updates for Animated
+// Scenes"). The node's own bounds don't change, only how they are split.
+void DynamicBvh::rotate(uint32_t index) {
+    Node& node = m_nodes[index];
+    if (node.height < 2) {
+        return;
+    }
+
+    uint32_t b = node.child1;
+    uint32_t c = node.child2;
+    const Node& nodeB = m_nodes[b];
+    const Node& nodeC = m_nodes[c];
+
+    // Moving `child` under `other` in place of grandchild: other keeps its other child
+    struct Option {
+        uint32_t child;
+        uint32_t other;
+        uint32_t grandchild;
+        float gain;
+    };
+    Option best{NULL_NODE, NULL_NODE, NULL_NODE, 0.0f};
+    auto consider = [&](uint32_t child, uint32_t other, uint32_t grandchild, uint32_t kept) {
+        float before = m_nodes[other].bounds.getSurfaceArea();
+        float after = Aabb::merge(m_nodes[child].bounds, m_nodes[kept].bounds).getSurfaceArea();
+        if (before - after > best.gain) {
+            best = {child, other, grandchild, before - after};
+        }
+    };
+    if (!nodeC.isLeaf()) {
+        consider(b, c, nodeC.child1, nodeC.child2);
+        consider(b, c, nodeC.child2, nodeC.child1);
+    }
+    if (!nodeB.isLeaf()) {
+        consider(c, b, nodeB.child1, nodeB.child2);
+        consider(c, b, nodeB.child2, nodeB.child1);
+    }
+    if (best.child == NULL_NODE) {
+        return;
+    }
+
+    Node& other = m_nodes[best.other];
+    if (other.child1 == best.grandchild) {
+        other.child1 = best.child;
+    } else {
+        other.child2 = best.child;
+    }
+    m_nodes[best.child].parent = best.other;
+
+    Node& rotated = m_nodes[index];
+    if (rotated.child1 == best.child) {
+        rotated.child1 = best.grandchild;
+    } else {
+        rotated.child2 = best.grandchild;
+    }
+    m_nodes[best.grandchild].parent = index;
+
+    updateNode(best.other);
+    rotated.height = 1 + std::max(m_nodes[rotated.child1].height, m_nodes[rotated.child2].height);
+}
+
+float DynamicBvh::getAreaRatio() const {
+    if (m_root == NULL_NODE) {
+        return 0.0f;
+    }
+    float rootArea = m_nodes[m_root].bounds.getSurfaceArea();
+    if (rootArea <= 0.0f) {
+        return 0.0f;
+    }
+    float total = 0.0f;
+    for (const Node& node : m_nodes) {
+        if (node.height > 0) {
+            total += node.bounds.getSurfaceArea();
+        }
+    }
+    return total / rootArea;
+}
+
+void DynamicBvh::queryOverlaps(const Aabb& bounds, std::vector<uint32_t>& proxies) const {
+    NodeStack stack(m_root);
+    while (!stack.empty()) {
+        uint32_t index = stack.pop();
+        const Node& node = m_nodes[index];
+        if (!node.bounds.overlaps(bounds)) {
+            continue;
+        }
+        if (node.isLeaf()) {
+            if (node.tightBounds.overlaps(bounds)) {
+                proxies.push_back(index);
+            }
+        } else {
+            stack.push(node.child1);
+            stack.push(node.child2);
+        }
+    }
+}
+
+void DynamicBvh::querySphere(const glm::vec3& center, float radius, std::vector<uint32_t>& proxies) const {
+    float radiusSquared = radius * radius;
+    NodeStack stack(m_root);
+    while (!stack.empty()) {
+        uint32_t index = stack.pop();
+        const Node& node = m_nodes[index];
+        if (!overlapsSphere(node.bounds, center, radiusSquared)) {
+            continue;
+        }
+        if (node.isLeaf()) {
+            if (overlapsSphere(node.tightBounds, center, radiusSquared)) {
+                proxies.push_back(index);
+            }
+        } else {
+            stack.push(node.child1);
+            stack.push(node.child2);
+        }
+    }
+}
+
+bool DynamicBvh::raycast(const Ray& ray, RayHit& hit, const RaycastFilter& filter) const {
+    glm::vec3 inverseDirection = glm::vec3(1.0f) / ray.direction;
+    hit.proxy = NULL_NODE;
+    hit.userData = 0;
+    hit.distance = ray.maxDistance;
+
+    NodeStack stack(m_root);
+    while (!stack.empty()) {
+        uint32_t index = stack.pop();
+        const Node& node = m_nodes[index];
+        float distance;
+        // Anything entered past the closest hit so far can't be closer
+        if (!intersectRay(ray, inverseDirection, node.bounds, hit.distance, distance)) {
+            continue;
+        }
+        if (!node.isLeaf()) {
+            // Nearer child on top, so hits found there cull the other one
+            float distance1, distance2;
+            bool hit1 = intersectRay(ray, inverseDirection, m_nodes[node.child1].bounds, hit.distance, distance1);
+            bool hit2 = intersectRay(ray, inverseDirection, m_nodes[node.child2].bounds, hit.distance, distance2);
+            if (hit1 && hit2 && distance1 < distance2) {
+                stack.push(node.child2);
+                stack.push(node.child1);
+            } else {
+                if (hit1) {
+                    stack.push(node.child1);
+                }
+                if (hit2) {
+                    stack.push(node.child2);
+                }
+            }
+            continue;
+        }
+        if (!intersectRay(ray, inverseDirection, node.tightBounds, hit.distance, distance)) {
+            continue;
+        }
+        if (filter) {
+            distance = filter(node.userData, ray);
+            if (distance < 0.0f || distance >= hit.distance) {
+                continue;
+            }
+        }
+        hit.proxy = index;
+        hit.userData = node.userData;
+        hit.distance = distance;
+    }
+    return hit.proxy != NULL_NODE;
+}
+
+void DynamicBvh::raycastBatch(const Ray* rays, RayHit* hits, uint32_t count, JobSystem* jobSystem,
+                              const RaycastFilter& filter) const {
+    uint32_t packetCount = (count + PACKET_SIZE - 1) / PACKET_SIZE;
+    auto run = [&](uint32_t begin, uint32_t end) {
+        for (uint32_t packet = begin; packet < end; ++packet) {
+            uint32_t first = packet * PACKET_SIZE;
+            uint32_t remaining = count - first;
+            raycastPacket(rays + first, hits + first, remaining < PACKET_SIZE ? remaining : PACKET_SIZE, filter);
+        }
+    };
+    if (jobSystem) {
+        jobSystem->parallelFor(packetCount, PACKETS_PER_JOB, run);
+    } else {
+        run(0, packetCount);
+    }
+}
+
+void DynamicBvh::raycastPacket(const Ray* rays, RayHit* hits, uint32_t count, const RaycastFilter& filter) const {
+    RayPacket packet;
+    for (uint32_t lane = 0; lane < PACKET_SIZE; ++lane) {
+        // Unused lanes get a negative limit no box can be entered within
+        bool used = lane < count;
+        for (int axis = 0; axis < 3; ++axis) {
+            packet.origin[axis][lane] = used ? rays[lane].origin[axis] : 0.0f;
+            packet.inverse[axis][lane] = used ? 1.0f / rays[lane].direction[axis] : 1.0f;
+        }
+        packet.closest[lane] = used ? rays[lane].maxDistance : -1.0f;
+        if (used) {
+            hits[lane].proxy = NULL_NODE;
+            hits[lane].userData = 0;
+            hits[lane].distance = rays[lane].maxDistance;
+        }
+    }
+
+    NodeStack stack(m_root);
+    float entries[PACKET_SIZE];
+    while (!stack.empty()) {
+        uint32_t index = stack.pop();
+        const Node& node = m_nodes[index];
+        // Hits since the push may have brought every ray's limit closer
+        uint32_t lanes = slabTest(packet, node.bounds, entries);
+        if (lanes == 0) {
+            continue;
+        }
+        if (!node.isLeaf()) {
+            // Nearer child on top, as in raycast()
+            float distance1 = FLT_MAX;
+            float distance2 = FLT_MAX;
+            uint32_t lanes1 = slabTest(packet, m_nodes[node.child1].bounds, entries);
+            for (uint32_t lane = 0; lane < PACKET_SIZE; ++lane) {
+                distance1 = (lanes1 >> lane) & 1 ? std::min(distance1, entries[lane]) : distance1;
+            }
+            uint32_t lanes2 = slabTest(packet, m_nodes[node.child2].bounds, entries);
+            for (uint32_t lane = 0; lane < PACKET_SIZE; ++lane) {
+                distance2 = (lanes2 >> lane) & 1 ? std::min(distance2, entries[lane]) : distance2;
+            }
+            if (lanes1 && lanes2 && distance1 < distance2) {
+                stack.push(node.child2);
+                stack.push(node.child1);
+            } else {
+                if (lanes1) {
+                    stack.push(node.child1);
+                }
+                if (lanes2) {
+                    stack.push(node.child2);
+                }
+            }
+            continue;
+        }
+
+        for (uint32_t lane = 0; lane < count; ++lane) {
+            float distance;
+            glm::vec3 inverseDirection(packet.inverse[0][lane], packet.inverse[1][lane], packet.inverse[2][lane]);
+            if (!((lanes >> lane) & 1) ||
+                !intersectRay(rays[lane], inverseDirection, node.tightBounds, packet.closest[lane], distance)) {
+                continue;
+            }
+            if (filter) {
+                distance = filter(node.userData, rays[lane]);
+                if (distance < 0.0f || distance >= packet.closest[lane]) {
+                    continue;
+                }
+            }
+            packet.closest[lane] = distance;
+            hits[lane].proxy = index;
+            hits[lane].userData = node.userData;
+            hits[lane].distance = distance;
+        }
+    }
+}
+
+} // namespace plaster
@@ -0,0 +1,277 @@
+#include "Asset/ArchiveWriter.h"
+#include "Asset/ArchiveFormat.h"
+#include "Asset/Compression.h"
+#include "Graphics/Mesh.h"
+#include "Graphics/Meshlet.h"
+#include "Graphics/MeshLod.h"
+
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+void printUsage() {
+    std::cerr << "Usage: plasterPacker <input directory> <output.ppak> [--compress none|lz4|zstd] [--meshlets] [--lods]"
+                 " [--static <manifest>]..."
+              << std::endl;
+    std::cerr << "A static manifest lists one instance per line: <mesh path in the input directory> <material>"
+                 " <16 floats of the transform, column by column>; # starts a comment"
+              << std::endl;
+}
+
+std::vector<uint8_t> readFile(const fs::path& path) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file) {
+        throw std::runtime_error("Failed to open " + path.string());
+    }
+
+    std::vector<uint8_t> data(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(data.data()), data.size());
+    return data;
+}
+
+// False unless data is a mesh blob, see MeshBlobHeader
+bool readMeshBlob(const std::vector<uint8_t>& data, plaster::MeshBlobHeader& mesh, const float*& positions,
+                  const uint32_t*& indices) {
+    if (data.size() < sizeof(mesh)) {
+        return false;
+    }
+    std::memcpy(&mesh, data.data(), sizeof(mesh));
+    if (mesh.magic != plaster::MESH_BLOB_MAGIC) {
+        return false;
+    }
+    size_t vertexBytes = static_cast<size_t>(mesh.vertexStride) * mesh.vertexCount;
+    if (mesh.vertexStride < 3 * sizeof(float) || mesh.vertexStride % sizeof(float) != 0 ||
+        data.size() < sizeof(mesh) + vertexBytes + mesh.indexCount * sizeof(uint32_t)) {
+        throw std::runtime_error("Truncated or malformed mesh blob");
+    }
+    positions = reinterpret_cast<const float*>(data.data() + sizeof(mesh));
+    indices = reinterpret_cast<const uint32_t*>(data.data() + sizeof(mesh) + vertexBytes);
+    return true;
+}
+
+// Empty unless data is a mesh blob
+std::vector<uint8_t> buildMeshletBlob(const std::vector<uint8_t>& data) {
+    plaster::MeshBlobHeader mesh{};
+    const float* positions = nullptr;
+    const uint32_t* indices = nullptr;
+    if (!readMeshBlob(data, mesh, positions, indices)) {
+        return {};
+    }
+    plaster::MeshletData meshlets =
+        plaster::buildMeshlets(positions, mesh.vertexStride, mesh.vertexCount, indices, mesh.indexCount);
+
+    plaster::MeshletBlobHeader header{};
+    header.magic = plaster::MESHLET_BLOB_MAGIC;
+    header.meshletCount = static_cast<uint32_t>(meshlets.meshlets.size());
+    header.vertexCount = static_cast<uint32_t>(meshlets.vertices.size());
+    header.triangleByteCount = static_cast<uint32_t>(meshlets.triangles.size());
+
+    size_t meshletBytes = meshlets.meshlets.size() * sizeof(plaster::Meshlet);
+    size_t indexBytes = meshlets.vertices.size() * sizeof(uint32_t);
+    std::vector<uint8_t> blob(sizeof(header) + meshletBytes + indexBytes + meshlets.triangles.size());
+    uint8_t* cursor = blob.data();
+    std::memcpy(cursor, &header, sizeof(header));
+    cursor += sizeof(header);
+    std::memcpy(cursor, meshlets.meshlets.data(), meshletBytes);
+    cursor += meshletBytes;
+    std::memcpy(cursor, meshlets.vertices.data(), indexBytes);
+    cursor += indexBytes;
+    std::memcpy(cursor, meshlets.triangles.data(), meshlets.triangles.size());
+    return blob;
+}
+
+// Empty unless data is a mesh blob
+std::vector<uint8_t> buildLodBlob(const std::vector<uint8_t>& data) {
+    plaster::MeshBlobHeader mesh{};
+    const float* positions = nullptr;
+    const uint32_t* indices = nullptr;
+    if (!readMeshBlob(data, mesh, positions, indices)) {
+        return {};
+    }
+    plaster::MeshLodData lods =
+        plaster::buildMeshLods(positions, mesh.vertexStride, mesh.vertexCount, indices, mesh.indexCount);
+
+    plaster::LodBlobHeader header{};
+    header.magic = plaster::LOD_BLOB_MAGIC;
+    header.levelCount = static_cast<uint32_t>(lods.levels.size());
+    header.indexCount = static_cast<uint32_t>(lods.indices.size());
+
+    size_t levelBytes = lods.levels.size() * sizeof(plaster::MeshLodLevel);
+    size_t indexBytes = lods.indices.size() * sizeof(uint32_t);
+    std::vector<uint8_t> blob(sizeof(header) + levelBytes + indexBytes);
+    uint8_t* cursor = blob.data();
+    std::memcpy(cursor, &header, sizeof(header));
+    cursor += sizeof(header);
+    std::memcpy(cursor, lods.levels.data(), levelBytes);
+    cursor += levelBytes;
+    std::memcpy(cursor, lods.indices.data(), indexBytes);
+    return blob;
+}
+
+// A mesh blob with Vertex layout as MeshData
+plaster::MeshData readStaticMesh(const fs::path& path) {
+    std::vector<uint8_t> data = readFile(path);
+    plaster::MeshBlobHeader mesh{};
+    const float* positions = nullptr;
+    const uint32_t* indices = nullptr;
+    if (!readMeshBlob(data, mesh, positions, indices) || mesh.vertexStride != sizeof(plaster::Vertex)) {
+        throw std::runtime_error("Static instances need a mesh blob with the Vertex layout: " + path.string());
+    }
+    plaster::MeshData result;
+    result.vertices.resize(mesh.vertexCount);
+    std::memcpy(static_cast<void*>(result.vertices.data()), positions, mesh.vertexCount * sizeof(plaster::Vertex));
+    result.indices.assign(indices, indices + mesh.indexCount);
+    return result;
+}
+
+// Merges a manifest's instances offline and adds one static batch per material
+void packStaticBatches(plaster::ArchiveWriter& writer, const fs::path& inputDir, const fs::path& manifestPath,
+                       plaster::Compression compression) {
+    std::ifstream manifest(manifestPath);
+    if (!manifest) {
+        throw std::runtime_error("Failed to open " + manifestPath.string());
+    }
+
+    // Keyed by path so instances of one mesh share its data
+    std::map<std::string, plaster::MeshData> meshes;
+    std::vector<plaster::StaticMeshInstance> instances;
+    std::string line;
+    for (uint32_t lineNumber = 1; std::getline(manifest, line); ++lineNumber) {
+        line = line.substr(0, line.find('#'));
+        std::istringstream fields(line);
+        std::string meshPath;
+        if (!(fields >> meshPath)) {
+            continue;
+        }
+
+        plaster::StaticMeshInstance instance;
+        float* transform = &instance.transform[0][0];
+        bool complete = static_cast<bool>(fields >> instance.material);
+        for (int i = 0; complete && i < 16; ++i) {
+            complete = static_cast<bool>(fields >> transform[i]);
+        }
+        std::string extra;
+        if (!complete || fields >> extra) {
+            throw std::runtime_error(manifestPath.string() + ":" + std::to_string(lineNumber) +
+                                     ": expected a mesh path, a material and 16 floats");
+        }
+
+        auto it = meshes.find(meshPath);
+        if (it == meshes.end()) {
+            it = meshes.emplace(meshPath, readStaticMesh(inputDir / meshPath)).first;
+        }
+        instance.mesh = &it->second;
+        instances.push_back(instance);
+    }
+
+    std::string name = manifestPath.filename().generic_string();
+    for (const plaster::StaticBatch& batch : plaster::mergeStaticGeometry(instances)) {
+        plaster::MeshBlobHeader header{};
+        header.magic = plaster::MESH_BLOB_MAGIC;
+        header.vertexStride = sizeof(plaster::Vertex);
+        header.vertexCount = static_cast<uint32_t>(batch.mesh.vertices.size());
+        header.indexCount = static_cast<uint32_t>(batch.mesh.indices.size());
+
+        size_t vertexBytes = batch.mesh.vertices.size() * sizeof(plaster::Vertex);
+        size_t indexBytes = batch.mesh.indices.size() * sizeof(uint32_t);
+        std::vector<uint8_t> blob(sizeof(header) + vertexBytes + indexBytes);
+        uint8_t* cursor = blob.data();
+        std::memcpy(cursor, &header, sizeof(header));
+        cursor += sizeof(header);
+        std::memcpy(cursor, batch.mesh.vertices.data(), vertexBytes);
+        cursor += vertexBytes;
+        std::memcpy(cursor, batch.mesh.indices.data(), indexBytes);
+        writer.add(name + plaster::STATIC_BATCH_BLOB_SUFFIX + std::to_string(batch.material), std::move(blob),
+                   compression);
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        printUsage();
+        return 1;
+    }
+
+    fs::path inputDir = argv[1];
+    std::string outputPath = argv[2];
+    plaster::Compression compression = plaster::Compression::None;
+    bool meshlets = false;
+    bool lods = false;
+    std::vector<fs::path> staticManifests;
+
+    for (int i = 3; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--compress" && i + 1 < argc) {
+            std::string codec = argv[++i];
+            if (codec == "lz4") {
+                compression = plaster::Compression::LZ4;
+            } else if (codec == "zstd") {
+                compression = plaster::Compression::Zstd;
+            } else if (codec != "none") {
+                printUsage();
+                return 1;
+            }
+        } else if (arg == "--meshlets") {
+            meshlets = true;
+        } else if (arg == "--lods") {
+            lods = true;
+        } else if (arg == "--static" && i + 1 < argc) {
+            staticManifests.push_back(argv[++i]);
+        } else {
+            printUsage();
+            return 1;
+        }
+    }
+
+    if (!plaster::isCompressionSupported(compression)) {
+        std::cerr << "Requested codec was not compiled in, storing uncompressed" << std::endl;
+        compression = plaster::Compression::None;
+    }
+
+    try {
+        plaster::ArchiveWriter writer;
+        for (const auto& item : fs::recursive_directory_iterator(inputDir)) {
+            if (!item.is_regular_file()) {
+                continue;
+            }
+            std::string relative = fs::relative(item.path(), inputDir).generic_string();
+            std::vector<uint8_t> data = readFile(item.path());
+            if (meshlets) {
+                std::vector<uint8_t> blob = buildMeshletBlob(data);
+                if (!blob.empty()) {
+                    writer.add(relative + plaster::MESHLET_BLOB_SUFFIX, std::move(blob), compression);
+                }
+            }
+            if (lods) {
+                std::vector<uint8_t> blob = buildLodBlob(data);
+                if (!blob.empty()) {
+                    writer.add(relative + plaster::LOD_BLOB_SUFFIX, std::move(blob), compression);
+                }
+            }
+            writer.add(relative, std::move(data), compression);
+        }
+        for (const fs::path& manifest : staticManifests) {
+            packStaticBatches(writer, inputDir, manifest, compression);
+        }
+
+        writer.write(outputPath);
+        std::cout << "Packed " << writer.getEntryCount() << " assets into " << outputPath << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "Packing failed: " << e.what() << std::endl;
+        return -1;
+    }
+    return 0;
+}